@@ -32,8 +32,17 @@ namespace OWC
 
 		OWC_FORCE_INLINE bool __vectorcall IsHit(const Ray& ray, Interval rayT) const;
 
+		// same test on bounds stored as (xMin, xMax, yMin, yMax, zMin, zMax) in 32 byte aligned memory, the layout of the intervals in an AABB
+		// the 2 floats after the bounds are read but ignored so other data can be packed in behind them
+		static OWC_FORCE_INLINE bool __vectorcall IsHit(const f32* bounds, const Ray& ray, Interval rayT);
+
 		void Expand(const AABB& newAABB);
 
+		OWC_FORCE_INLINE Point GetCentroid() const
+		{
+			return 0.5f * Point(m_XInterval.GetMin() + m_XInterval.GetMax(), m_YInterval.GetMin() + m_YInterval.GetMax(), m_ZInterval.GetMin() + m_ZInterval.GetMax());
+		}
+
 		inline double GetSurfaceArea() const { return 2.0 * (m_XInterval.Size() * m_YInterval.Size() + m_XInterval.Size() * m_ZInterval.Size() + m_YInterval.Size() * m_ZInterval.Size()); }
 
 		OWC_FORCE_INLINE AABB::Axis LongestAxis() const { return m_LongestAxis; }
@@ -99,6 +108,11 @@ namespace OWC
 	// Ray - AABB intersection test using the "slab" method with SIMD and AVX2 optimizations
 	// taken from one of my previous project but modified to work with 32 bit floats and AVX2 instead of 64 bit floats and AVX512
 	OWC_FORCE_INLINE bool __vectorcall AABB::IsHit(const Ray& ray, Interval rayT) const
+	{
+		return IsHit(std::bit_cast<const f32*>(this), ray, rayT);
+	}
+
+	OWC_FORCE_INLINE bool __vectorcall AABB::IsHit(const f32* bounds, const Ray& ray, Interval rayT)
 	{
 #if (AVX2 & SIMD) == 1
 		const __m256i AVX2i32_FloatLoadPermutationIndex = _mm256_set_epi32(3, 3, 2, 2, 1, 1, 0, 0);
@@ -107,8 +121,9 @@ namespace OWC
 
 
 		// load m_XInterval, m_YInterval and m_ZInterval into an AVX2 register
-		// creates a register filled like (garbage, garbage, m_ZIntervalMax, m_ZIntervalMin, m_YIntervalMax, m_YIntervalMin, m_XIntervalMax, m_XIntervalMin)
-		__m256 AVX2f32_AxisBounds = _mm256_load_ps(std::bit_cast<f32*>(this));
+		// creates a register filled like (0, 0, m_ZIntervalMax, m_ZIntervalMin, m_YIntervalMax, m_YIntervalMin, m_XIntervalMax, m_XIntervalMin)
+		// the top 2 lanes hold whatever is packed behind the bounds, they are zeroed so integer data never reaches the maths as denormals
+		__m256 AVX2f32_AxisBounds = _mm256_blend_ps(_mm256_load_ps(bounds), _mm256_setzero_ps(), 0b11000000);
 
 		// Load ray origin into an AVX2 Register and double each axis into 64 bit lanes
 		// this creates a register filled like (garbage, garbage, RayOriginZ, RayOriginZ, RayOriginY, RayOriginY, RayOriginX, RayOriginX)
@@ -173,11 +188,11 @@ namespace OWC
 #else // !(AVX2 & SIMD)
 		for (Axis axis = Axis::x; axis <= Axis::z; axis++)
 		{
-			const Interval& axisBounds = GetAxisInterval(axis);
+			const Vec2 axisBounds(bounds[2 * +axis], bounds[2 * +axis + 1]);
 			const f32 rAxisOrigin = ray.GetOrigin()[+axis];
 			const f32 rAxisInvDirection = ray.GetInvDirection()[+axis];
 
-			Vec2 t = (axisBounds.GetAsVector() - rAxisOrigin) * rAxisInvDirection;
+			Vec2 t = (axisBounds - rAxisOrigin) * rAxisInvDirection;
 
 			if (t.x > t.y)
 				std::swap(t.x, t.y);
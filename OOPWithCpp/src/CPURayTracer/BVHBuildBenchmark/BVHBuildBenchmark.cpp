@@ -0,0 +1,81 @@
+﻿#include "BVHBuildBenchmark.hpp"
+#include "Application.hpp"
+
+#include <format>
+
+
+namespace OWC
+{
+	void BVHBuildBenchmark::Start(BVHBuildMode originalBuildMode)
+	{
+		m_OriginalBuildMode = originalBuildMode;
+		m_NumberOfResults = 0;
+		m_CurrentStep = 0;
+		m_PassesInStep = 0;
+		m_MeasuredResult = Result();
+		m_IsRunning = true;
+	}
+
+	bool BVHBuildBenchmark::OnPassCompleted(const RenderStats& renderStats, const BVHStats& bvhStats)
+	{
+		if (!m_IsRunning)
+			return false;
+
+		// a merge can hold several passes, the stats are the last one's so they stand in for every measured pass in it
+		uSize warmupPassesLeft = s_WarmupPasses - glm::min(m_PassesInStep, s_WarmupPasses);
+		m_PassesInStep += renderStats.NumberOfMergedPasses;
+		if (m_PassesInStep <= s_WarmupPasses)
+			return false;
+
+		auto measuredPasses = static_cast<f32>(renderStats.NumberOfMergedPasses - warmupPassesLeft);
+		m_MeasuredResult.NodesVisitedPerRay += renderStats.NodesVisitedPerRay * measuredPasses;
+		m_MeasuredResult.PrimitiveTestsPerRay += renderStats.PrimitiveTestsPerRay * measuredPasses;
+		m_MeasuredResult.SamplesPerSecond += renderStats.SamplesPerSecond * measuredPasses;
+		if (m_PassesInStep < s_WarmupPasses + s_MeasuredPasses)
+			return false;
+
+		f32 invMeasuredPasses = 1.0f / static_cast<f32>(m_PassesInStep - s_WarmupPasses);
+		Result& result = m_Results[m_CurrentStep];
+		result.BuildStats = bvhStats;
+		result.NodesVisitedPerRay = m_MeasuredResult.NodesVisitedPerRay * invMeasuredPasses;
+		result.PrimitiveTestsPerRay = m_MeasuredResult.PrimitiveTestsPerRay * invMeasuredPasses;
+		result.SamplesPerSecond = m_MeasuredResult.SamplesPerSecond * invMeasuredPasses;
+		m_NumberOfResults = m_CurrentStep + 1;
+
+		m_PassesInStep = 0;
+		m_MeasuredResult = Result();
+
+		m_CurrentStep++;
+		if (m_CurrentStep == NumberOfBuildModes)
+			m_IsRunning = false; // GetBuildMode now returns the original mode so the BVH is put back
+
+		return true;
+	}
+
+	void BVHBuildBenchmark::ImGuiRender() const
+	{
+		constexpr std::array<const char*, NumberOfBuildModes> buildModeNames = {
+			"Median",
+			"Binned SAH",
+			"Spatial Split"
+		};
+
+		if (m_IsRunning)
+			ImGui::Text("Benchmarking %s BVH", buildModeNames[m_CurrentStep]);
+
+		for (uSize i = 0; i != m_NumberOfResults; i++)
+		{
+			const Result& result = m_Results[i];
+			ImGui::Text(
+				"%s: %.1f nodes/ray, %.2f primitives/ray, %.2f Msamples/s\n    SAH cost %.2f, %s references, build %.3f ms",
+				buildModeNames[i],
+				result.NodesVisitedPerRay,
+				result.PrimitiveTestsPerRay,
+				result.SamplesPerSecond * 1e-6f,
+				result.BuildStats.SAHCost,
+				std::format("{}", result.BuildStats.NumberOfReferences).c_str(),
+				result.BuildStats.BuildTime
+			);
+		}
+	}
+}
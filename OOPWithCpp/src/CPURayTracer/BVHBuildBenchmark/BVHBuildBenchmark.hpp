@@ -0,0 +1,59 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "Camera.hpp"
+#include "SplitBVH.hpp"
+
+#include <array>
+
+
+namespace OWC
+{
+	// Rebuilds the current scene's BVH with every build mode in turn and records how many nodes and primitives
+	// each ray has to test, next to the samples per second and the cost the builder expected.
+	class BVHBuildBenchmark
+	{
+	public:
+		static constexpr uSize NumberOfBuildModes = 3;
+
+		struct Result
+		{
+			BVHStats BuildStats;
+			f32 NodesVisitedPerRay = 0.0f;
+			f32 PrimitiveTestsPerRay = 0.0f;
+			f32 SamplesPerSecond = 0.0f;
+		};
+
+	public:
+		BVHBuildBenchmark() = default;
+		~BVHBuildBenchmark() = default;
+
+		BVHBuildBenchmark(const BVHBuildBenchmark&) = delete;
+		BVHBuildBenchmark& operator=(const BVHBuildBenchmark&) = delete;
+		BVHBuildBenchmark(BVHBuildBenchmark&&) = delete;
+		BVHBuildBenchmark& operator=(BVHBuildBenchmark&&) = delete;
+
+		// originalBuildMode is handed back by GetBuildMode once the benchmark is done
+		void Start(BVHBuildMode originalBuildMode);
+		OWC_FORCE_INLINE bool IsRunning() const { return m_IsRunning; }
+
+		// build mode the BVH should use for the step being measured
+		OWC_FORCE_INLINE BVHBuildMode GetBuildMode() const { return m_IsRunning ? static_cast<BVHBuildMode>(m_CurrentStep) : m_OriginalBuildMode; }
+
+		// returns true when the benchmark moved on to the next step and the BVH has to be rebuilt
+		bool OnPassCompleted(const RenderStats& renderStats, const BVHStats& bvhStats);
+
+		void ImGuiRender() const;
+
+	private:
+		static constexpr uSize s_WarmupPasses = 2;
+		static constexpr uSize s_MeasuredPasses = 8;
+
+		std::array<Result, NumberOfBuildModes> m_Results; // indexed by build mode
+		uSize m_NumberOfResults = 0;
+		uSize m_CurrentStep = 0;
+		uSize m_PassesInStep = 0;
+		Result m_MeasuredResult;
+		BVHBuildMode m_OriginalBuildMode = BVHBuildMode::BinnedSAH;
+		bool m_IsRunning = false;
+	};
+}
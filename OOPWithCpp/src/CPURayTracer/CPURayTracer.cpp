@@ -2,6 +2,8 @@
 #include "Application.hpp"
 #include "CPURayTracer.hpp"
 #include "ImageLoader.hpp"
+#include "SceneArena.hpp"
+#include "MaterialRegistry.hpp"
 
 #include "BaseEvent.hpp"
 #include "WindowResize.hpp"
@@ -9,6 +11,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <array>
+#include <thread>
 
 
 namespace OWC
@@ -19,7 +22,7 @@ namespace OWC
 		m_Camera = std::make_unique<RTCamera>(m_InterLayerData->imageData);
 		m_Camera->GetSettings().ScreenSize = Vec2(Application::GetConstInstance().GetWindowSize());
 		m_CameraSettingsUpdated = true;
-		m_Scene = BaseScene::CreateScene(Scene::Basic);
+		LoadScene(Scene::Basic);
 		m_InterLayerData->numberOfSamples = 1; // Start at 1 to avoid division by zero
 	}
 
@@ -27,6 +30,12 @@ namespace OWC
 	{
 		if (!m_ToggleRaytracedImage && m_RayTracingStateUpdated)
 		{
+			m_Camera->StopPasses();
+			if (m_ThreadScalingBenchmark.IsRunning())
+			{
+				m_ThreadScalingBenchmark.Cancel();
+				m_ThreadScalingBenchmark.ApplySettings(m_Camera->GetSettings());
+			}
 			m_InterLayerData->imageData.clear();
 			m_InterLayerData->imageScreenSize = Vec2u(0);
 			m_InterLayerData->ImageUpdates |= 0b10;
@@ -52,6 +61,30 @@ namespace OWC
 		{
 			m_Camera->UpdateCameraSettings();
 
+			// the render threads are stopped at this point so the scene can move and the BVH can be swapped out under them
+			bool sceneMoved = m_AnimateScene &&
+				m_Scene->Animate(std::chrono::duration<f32>(std::chrono::high_resolution_clock::now() - m_AnimationStartTime).count());
+			if (auto* bvh = dynamic_cast<SplitBVH*>(m_Scene->GetHitable().get()))
+			{
+				// first, moving to or from the quantized tree builds again
+				bvh->SetUseWideBVH(m_UseWideBVH);
+				bvh->SetUseQuantizedBVH(m_UseQuantizedBVH);
+				if (m_BVHRebuildRequested)
+				{
+					bvh->SetUseSphereBatches(m_UseSphereBatches);
+					bvh->Rebuild(m_RequestedBVHBuildMode);
+				}
+				else if (sceneMoved)
+					bvh->Update();
+			}
+			m_BVHRebuildRequested = false;
+
+			if (m_OcclusionBenchmarkRequested)
+			{
+				m_OcclusionBenchmark.Run(*m_Scene->GetHitable(), m_Camera->GetSettings().Position);
+				m_OcclusionBenchmarkRequested = false;
+			}
+
 			for (auto& pixel : m_InterLayerData->imageData)
 				pixel = Vec4(0.0f);
 
@@ -59,12 +92,34 @@ namespace OWC
 			m_CameraSettingsUpdated = false;
 		}
 
-		if (RenderFrame())
+		if (RenderPassReturnData numberOfPasses = RenderFrame())
 		{
 			m_LastFrameTime = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - m_LastTimePoint).count();
 			m_LastTimePoint = std::chrono::high_resolution_clock::now();
-			m_InterLayerData->numberOfSamples++;
+			m_InterLayerData->numberOfSamples += numberOfPasses;
 			m_InterLayerData->ImageUpdates |= 0b01;
+
+			// the last step hands the user's thread count and layout back
+			if (m_ThreadScalingBenchmark.OnPassCompleted(m_Camera->GetRenderStats()))
+			{
+				m_ThreadScalingBenchmark.ApplySettings(m_Camera->GetSettings());
+				m_CameraSettingsUpdated = true;
+			}
+
+			// the next frame of the animation starts once this one has a pass
+			if (m_AnimateScene)
+				m_CameraSettingsUpdated = true;
+
+			if (const auto* bvh = dynamic_cast<const SplitBVH*>(m_Scene->GetHitable().get());
+				bvh != nullptr && m_BVHBuildBenchmark.OnPassCompleted(m_Camera->GetRenderStats(), bvh->GetStats()))
+			{
+				m_RequestedBVHBuildMode = m_BVHBuildBenchmark.GetBuildMode();
+				m_BVHRebuildRequested = true;
+				m_CameraSettingsUpdated = true;
+			}
+
+			if (m_PrimaryRayPacketBenchmark.OnPassCompleted(m_Camera->GetRenderStats()))
+				ApplyPrimaryRayPacketBenchmarkSettings();
 		}
 	}
 
@@ -79,14 +134,26 @@ namespace OWC
 			"BT. 1886",
 			"Custom"
 		};
-		constexpr std::array<const char*, 6> sceneNames = {
+		constexpr std::array<const char*, BVHBuildBenchmark::NumberOfBuildModes> bvhBuildModeNames = {
+			"Median",
+			"Binned SAH",
+			"Spatial Split (SBVH)"
+		};
+		constexpr std::array<const char*, static_cast<uSize>(TileDistribution::Count)> tileDistributionNames = {
+			"Work Stealing",
+			"Strided (no stealing)"
+		};
+		constexpr std::array<const char*, 9> sceneNames = {
 			"Basic",
 //			"RandTest",
 			"DuelGreySpheres",
 			"DielectricTest",
 			"MetalTest",
 			"EarthScene",
-			"Book1FinalRender"
+			"Book1FinalRender",
+			"MeshTest",
+			"InstanceTest",
+			"Book1FinalRender (Sphere Ground)"
 		};
 
 		ImGui::Begin("CPU Ray Tracer");
@@ -103,8 +170,7 @@ namespace OWC
 
 			if (ImGui::Combo("Scene", &m_CurrentSceneIndex, sceneNames.data(), static_cast<i32>(sceneNames.size())))
 			{
-				auto selectedScene = static_cast<Scene>(m_CurrentSceneIndex);
-				m_Scene = BaseScene::CreateScene(selectedScene);
+				LoadScene(static_cast<Scene>(m_CurrentSceneIndex));
 				m_Scene->SetBaseCameraSettings(m_Camera->GetSettings());
 				m_CameraSettingsUpdated = true;
 
@@ -115,6 +181,26 @@ namespace OWC
 					pixel = Vec4(0.0f);
 			}
 
+			if (const SceneArena* arena = m_Scene->GetArena())
+				ImGui::Text("Scene build time %.3f ms\narena %s objects, %s KiB", m_SceneBuildTime,
+					std::format("{}", arena->GetNumberOfObjects()).c_str(), std::format("{}", arena->GetSize() / 1024).c_str());
+			else
+				ImGui::Text("Scene build time %.3f ms", m_SceneBuildTime);
+
+			if (const MaterialRegistry* materialRegistry = m_Scene->GetMaterialRegistry())
+				ImGui::Text("materials %s unique of %s asked for, textures %s",
+					std::format("{}", materialRegistry->GetNumberOfMaterials()).c_str(),
+					std::format("{}", materialRegistry->GetNumberOfRequests()).c_str(),
+					std::format("{}", materialRegistry->GetNumberOfTextures()).c_str());
+
+			m_Scene->OnImGuiRender();
+
+			if (ImGui::Checkbox("Animate Scene (BVH refit every pass)", &m_AnimateScene))
+			{
+				m_AnimationStartTime = std::chrono::high_resolution_clock::now();
+				m_CameraSettingsUpdated = true;
+			}
+
 			if (ImGui::Combo("Gamma Correction", &m_CurrentGammaIndex, gammaCorrectionNames.data(), static_cast<i32>(gammaCorrectionNames.size())))
 			{
 				auto gamma = static_cast<GammaCorrection>(m_CurrentGammaIndex);
@@ -172,8 +258,120 @@ namespace OWC
 			}
 
 			bool isMultiThreadedUpdated = ImGui::Checkbox("Multi-Threaded Rendering", &m_IsMultiThreaded);
+			if (m_IsMultiThreaded)
+				isMultiThreadedUpdated |= ImGui::SliderInt("Render Threads", &m_Camera->GetSettings().NumberOfThreads, 1, static_cast<i32>(std::thread::hardware_concurrency()));
 			if (isMultiThreadedUpdated)
 				m_CameraSettingsUpdated = true;
+
+			// picked up at the start of the next pass, no need to restart accumulation
+			Vec2i& tileSize = m_Camera->GetSettings().TileSize;
+			if (ImGui::InputInt2("Tile Size", glm::value_ptr(tileSize)))
+				tileSize = glm::clamp(tileSize, Vec2i(1), Vec2i(512));
+			auto tileDistributionIndex = static_cast<i32>(m_Camera->GetSettings().Distribution);
+			if (ImGui::Combo("Tile Distribution", &tileDistributionIndex, tileDistributionNames.data(), static_cast<i32>(tileDistributionNames.size())))
+				m_Camera->GetSettings().Distribution = static_cast<TileDistribution>(tileDistributionIndex);
+			ImGui::Checkbox(std::format("Primary Ray Packets ({} rays)", RayPacketWidth).c_str(), &m_Camera->GetSettings().UsePrimaryRayPackets);
+			ImGui::Checkbox("Wavefront Path Tracing", &m_Camera->GetSettings().UseWavefront);
+
+			const RenderStats& renderStats = m_Camera->GetRenderStats();
+			ImGui::Text(
+				"Pass time %.3f ms, thread utilization %.1f%% (%s)\ntiles %s, stolen tiles %u\npasses per merge %u\n%.1f BVH nodes/ray, %.2f primitives/ray\n%.3f hits finalized/ray of %.3f candidates/ray",
+				renderStats.PassTime,
+				renderStats.ThreadUtilization * 100.0f,
+				tileDistributionNames[static_cast<uSize>(renderStats.Distribution)],
+				std::format("{}", renderStats.NumberOfTiles).c_str(),
+				renderStats.NumberOfSteals,
+				renderStats.NumberOfMergedPasses,
+				renderStats.NodesVisitedPerRay,
+				renderStats.PrimitiveTestsPerRay,
+				renderStats.FinalizedHitsPerRay,
+				renderStats.CandidateHitsPerRay
+			);
+
+			if (const auto* bvh = dynamic_cast<const SplitBVH*>(m_Scene->GetHitable().get()))
+			{
+				auto buildModeIndex = static_cast<i32>(bvh->GetBuildMode());
+				if (ImGui::Combo("BVH Builder", &buildModeIndex, bvhBuildModeNames.data(), static_cast<i32>(bvhBuildModeNames.size())))
+				{
+					m_RequestedBVHBuildMode = static_cast<BVHBuildMode>(buildModeIndex);
+					m_BVHRebuildRequested = true;
+					m_CameraSettingsUpdated = true;
+				}
+
+				if (ImGui::Checkbox(std::format("Wide BVH ({} children per node)", WideBVHWidth).c_str(), &m_UseWideBVH))
+					m_CameraSettingsUpdated = true;
+
+				if (m_UseWideBVH && ImGui::Checkbox("Quantized Wide BVH (8 bit child bounds)", &m_UseQuantizedBVH))
+					m_CameraSettingsUpdated = true;
+
+				if (ImGui::Checkbox(std::format("Sphere Batch Leaves ({} spheres per leaf)", SphereBatchWidth).c_str(), &m_UseSphereBatches))
+				{
+					m_RequestedBVHBuildMode = bvh->GetBuildMode();
+					m_BVHRebuildRequested = true;
+					m_CameraSettingsUpdated = true;
+				}
+
+				const BVHStats& bvhStats = bvh->GetStats();
+				ImGui::Text(
+					"BVH SAH cost %.2f, build time %.3f ms on %s tasks\nnodes %s, leaves %s, depth %s, wide nodes %s\nnode memory %s KiB: binary %s KiB, wide %s KiB, quantized %s KiB\nreferences %s, spatial splits %s, sphere batches %s\ntriangles %s, triangle batches %s, unbounded objects %s\nrefits since build %s, last refit %.3f ms, SAH cost at build %.2f",
+					bvhStats.SAHCost,
+					bvhStats.BuildTime,
+					std::format("{}", bvhStats.NumberOfBuildTasks + 1).c_str(),
+					std::format("{}", bvhStats.NumberOfNodes).c_str(),
+					std::format("{}", bvhStats.NumberOfLeaves).c_str(),
+					std::format("{}", bvhStats.Depth).c_str(),
+					std::format("{}", bvhStats.NumberOfWideNodes).c_str(),
+					std::format("{}", bvhStats.ResidentNodesSize / 1024).c_str(),
+					std::format("{}", bvhStats.NodesSize / 1024).c_str(),
+					std::format("{}", bvhStats.WideNodesSize / 1024).c_str(),
+					std::format("{}", bvhStats.QuantizedNodesSize / 1024).c_str(),
+					std::format("{}", bvhStats.NumberOfReferences).c_str(),
+					std::format("{}", bvhStats.NumberOfSpatialSplits).c_str(),
+					std::format("{}", bvhStats.NumberOfSphereBatches).c_str(),
+					std::format("{}", bvhStats.NumberOfTriangles).c_str(),
+					std::format("{}", bvhStats.NumberOfTriangleBatches).c_str(),
+					std::format("{}", bvhStats.NumberOfUnboundedObjects).c_str(),
+					std::format("{}", bvhStats.NumberOfRefits).c_str(),
+					bvhStats.RefitTime,
+					bvhStats.BuildSAHCost
+				);
+
+				if (!m_BVHBuildBenchmark.IsRunning() && ImGui::Button("Run BVH Builder Benchmark"))
+				{
+					m_BVHBuildBenchmark.Start(bvh->GetBuildMode());
+					m_RequestedBVHBuildMode = m_BVHBuildBenchmark.GetBuildMode();
+					m_BVHRebuildRequested = true;
+					m_CameraSettingsUpdated = true;
+				}
+				m_BVHBuildBenchmark.ImGuiRender();
+
+				if (!m_PrimaryRayPacketBenchmark.IsRunning() && ImGui::Button("Run Primary Ray Packet Benchmark"))
+				{
+					m_PrimaryRayPacketBenchmark.Start(m_UseWideBVH, m_UseQuantizedBVH, m_Camera->GetSettings().UsePrimaryRayPackets);
+					ApplyPrimaryRayPacketBenchmarkSettings();
+				}
+				m_PrimaryRayPacketBenchmark.ImGuiRender();
+			}
+
+			if (!m_ThreadScalingBenchmark.IsRunning() && ImGui::Button("Run Thread Scaling Benchmark"))
+			{
+				m_ThreadScalingBenchmark.Start(std::thread::hardware_concurrency(), m_Camera->GetSettings());
+				m_CameraSettingsUpdated = true;
+			}
+			else if (m_ThreadScalingBenchmark.IsRunning() && ImGui::Button("Cancel Thread Scaling Benchmark"))
+			{
+				m_ThreadScalingBenchmark.Cancel();
+				m_ThreadScalingBenchmark.ApplySettings(m_Camera->GetSettings());
+				m_CameraSettingsUpdated = true;
+			}
+			m_ThreadScalingBenchmark.ImGuiRender();
+
+			if (ImGui::Button("Run Occlusion Benchmark"))
+			{
+				m_OcclusionBenchmarkRequested = true;
+				m_CameraSettingsUpdated = true;
+			}
+			m_OcclusionBenchmark.ImGuiRender();
 		}
 		ImGui::End();
 
@@ -223,12 +421,27 @@ namespace OWC
 
 	OWC::RenderPassReturnData CPURayTracer::RenderFrame()
 	{
+		if (m_ThreadScalingBenchmark.IsRunning())
+		{
+			m_ThreadScalingBenchmark.ApplySettings(m_Camera->GetSettings());
+			return m_Camera->MultiThreadedRenderPass(m_Scene->GetHitable());
+		}
+
 		if (m_IsMultiThreaded)
 			return m_Camera->MultiThreadedRenderPass(m_Scene->GetHitable());
 		else
 			return m_Camera->SingleThreadedRenderPass(m_Scene->GetHitable());
 	}
 
+	void CPURayTracer::LoadScene(Scene scene)
+	{
+		m_Scene = nullptr; // freeing the old scene is not part of building the new one
+
+		auto buildStartTime = std::chrono::high_resolution_clock::now();
+		m_Scene = BaseScene::CreateScene(scene);
+		m_SceneBuildTime = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - buildStartTime).count();
+	}
+
 	void CPURayTracer::UpdateGammaValue(GammaCorrection gammaCorrection) const
 	{
 		switch (gammaCorrection)
@@ -254,4 +467,13 @@ namespace OWC
 			std::unreachable();
 		}
 	}
+
+	void CPURayTracer::ApplyPrimaryRayPacketBenchmarkSettings()
+	{
+		// the BVH picks the tree form up in OnUpdate, moving to or from the quantized tree rebuilds it
+		m_UseWideBVH = m_PrimaryRayPacketBenchmark.GetUseWideBVH();
+		m_UseQuantizedBVH = m_PrimaryRayPacketBenchmark.GetUseQuantizedBVH();
+		m_Camera->GetSettings().UsePrimaryRayPackets = m_PrimaryRayPacketBenchmark.GetUsePrimaryRayPackets();
+		m_CameraSettingsUpdated = true;
+	}
 }
\ No newline at end of file
@@ -5,6 +5,11 @@
 #include "ImageLoader.hpp"
 #include "Scene.hpp"
 #include "Camera.hpp"
+#include "SplitBVH.hpp"
+#include "ThreadScalingBenchmark.hpp"
+#include "BVHBuildBenchmark.hpp"
+#include "OcclusionBenchmark.hpp"
+#include "PrimaryRayPacketBenchmark.hpp"
 
 #include <memory>
 #include <bitset>
@@ -41,8 +46,12 @@ namespace OWC
 
 	private:
 		RenderPassReturnData RenderFrame();
+		// replaces m_Scene and times how long the new one took to build
+		void LoadScene(Scene scene);
 
 		void UpdateGammaValue(GammaCorrection gammaCorrection) const;
+		// sets the BVH form and camera ray mode of the step m_PrimaryRayPacketBenchmark is on, or the user's once it is done
+		void ApplyPrimaryRayPacketBenchmarkSettings();
 
 	private:
 		std::chrono::time_point<std::chrono::high_resolution_clock> m_LastTimePoint{};
@@ -56,10 +65,27 @@ namespace OWC
 		i32	m_CurrentGammaIndex = 3; // Default to Gamma 2.2
 		f32 m_CustomGammaValue = 2.2f;
 		f32 m_LastFrameTime = 0.0f;
+		f32 m_SceneBuildTime = 0.0f; // ms, BVH build included
 
 		bool m_IsMultiThreaded = false;
 
+		bool m_BVHRebuildRequested = false;
+		BVHBuildMode m_RequestedBVHBuildMode = BVHBuildMode::BinnedSAH;
+		bool m_UseWideBVH = true;
+		bool m_UseQuantizedBVH = true;
+		bool m_UseSphereBatches = true;
+
+		// the scene is animated one pass at a time and its BVH refit between passes
+		bool m_AnimateScene = false;
+		std::chrono::time_point<std::chrono::high_resolution_clock> m_AnimationStartTime{};
+
 		std::unique_ptr<BaseScene> m_Scene = nullptr;
 		std::unique_ptr<RTCamera> m_Camera = nullptr;
+
+		ThreadScalingBenchmark m_ThreadScalingBenchmark;
+		BVHBuildBenchmark m_BVHBuildBenchmark;
+		OcclusionBenchmark m_OcclusionBenchmark;
+		PrimaryRayPacketBenchmark m_PrimaryRayPacketBenchmark;
+		bool m_OcclusionBenchmarkRequested = false; // run once the render threads are stopped
 	};
 }
@@ -0,0 +1,93 @@
+﻿#include "OcclusionBenchmark.hpp"
+#include "Application.hpp"
+#include "LinearBVH.hpp"
+#include "OWCRand.hpp"
+
+#include <chrono>
+#include <format>
+#include <limits>
+#include <vector>
+
+
+namespace OWC
+{
+	namespace
+	{
+		constexpr f32 s_ShadowRayOffset = 0.001f; // the same offset the camera starts its bounces with
+
+		template<typename TraceFunction>
+		OcclusionBenchmark::Result MeasureTraces(const std::vector<Ray>& rays, TraceFunction&& traceFunction)
+		{
+			OcclusionBenchmark::Result result;
+
+			(void)LinearBVH::TakeThreadTraversalStats(); // drops whatever was counted before
+			auto startTime = std::chrono::high_resolution_clock::now();
+			for (const Ray& ray : rays)
+				result.NumberOfOccludedRays += traceFunction(ray) ? 1 : 0;
+			f32 seconds = std::chrono::duration<f32>(std::chrono::high_resolution_clock::now() - startTime).count();
+			TraversalStats traversalStats = LinearBVH::TakeThreadTraversalStats();
+
+			// per ray rather than per traversal, a ray through an instance walks more than one tree
+			f32 invNumberOfRays = 1.0f / static_cast<f32>(glm::max(rays.size(), uSize(1)));
+			result.RaysPerSecond = seconds > 0.0f ? static_cast<f32>(rays.size()) / seconds : 0.0f;
+			result.NodesVisitedPerRay = static_cast<f32>(traversalStats.NumberOfNodesVisited) * invNumberOfRays;
+			result.PrimitiveTestsPerRay = static_cast<f32>(traversalStats.NumberOfPrimitiveTests) * invNumberOfRays;
+			return result;
+		}
+	}
+
+	void OcclusionBenchmark::Run(const BaseHitable& hitable, const Point& cameraPosition)
+	{
+		// the shadow rays start where rays from the camera first hit something and leave in a random direction on the camera's side,
+		// they are all made before either run so both trace exactly the same rays
+		std::vector<Ray> shadowRays;
+		shadowRays.reserve(NumberOfCameraRays);
+		for (uSize i = 0; i != NumberOfCameraRays; i++)
+		{
+			Ray cameraRay;
+			cameraRay.SetOrigin(cameraPosition);
+			cameraRay.SetNormalizedDirection(Rand::FastUnitVector());
+
+			Interval range(s_ShadowRayOffset, std::numeric_limits<f32>::max());
+			HitData hitData;
+			if (!hitable.IsHit(cameraRay, range, hitData))
+				continue;
+
+			Vec3 shadowDirection = Rand::FastUnitVector();
+			if (glm::dot(shadowDirection, cameraRay.GetDirection()) > 0.0f)
+				shadowDirection = -shadowDirection;
+
+			Ray& shadowRay = shadowRays.emplace_back();
+			shadowRay.SetOrigin(cameraRay.GetOrigin() + cameraRay.GetDirection() * range.GetMax());
+			shadowRay.SetNormalizedDirection(shadowDirection);
+		}
+
+		m_ClosestHitResult = MeasureTraces(shadowRays, [&hitable](const Ray& ray) {
+			Interval range(s_ShadowRayOffset, std::numeric_limits<f32>::max());
+			HitData hitData;
+			return hitable.IsHit(ray, range, hitData);
+		});
+		m_AnyHitResult = MeasureTraces(shadowRays, [&hitable](const Ray& ray) {
+			return hitable.IsOccluded(ray, Interval(s_ShadowRayOffset, std::numeric_limits<f32>::max()));
+		});
+		m_NumberOfShadowRays = shadowRays.size();
+		m_HasRun = true;
+	}
+
+	void OcclusionBenchmark::ImGuiRender() const
+	{
+		if (!m_HasRun)
+			return;
+
+		ImGui::Text("%s shadow rays, %s occluded", std::format("{}", m_NumberOfShadowRays).c_str(), std::format("{}", m_AnyHitResult.NumberOfOccludedRays).c_str());
+		auto renderResult = [](const char* name, const Result& result) {
+			ImGui::Text("%s: %.2f Mrays/s, %.1f nodes/ray, %.2f primitives/ray", name, result.RaysPerSecond * 1e-6f, result.NodesVisitedPerRay, result.PrimitiveTestsPerRay);
+		};
+		renderResult("IsHit", m_ClosestHitResult);
+		renderResult("IsOccluded", m_AnyHitResult);
+
+		// both have to agree on every ray, anything else is a bug in one of the IsOccluded overrides
+		if (m_ClosestHitResult.NumberOfOccludedRays != m_AnyHitResult.NumberOfOccludedRays)
+			ImGui::Text("IsHit disagrees, it found %s occluded rays", std::format("{}", m_ClosestHitResult.NumberOfOccludedRays).c_str());
+	}
+}
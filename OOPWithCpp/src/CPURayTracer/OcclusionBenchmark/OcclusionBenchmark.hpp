@@ -0,0 +1,43 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+
+
+namespace OWC
+{
+	// Traces one set of shadow rays through the current scene on the calling thread twice, for the closest hit with IsHit
+	// and for any hit with IsOccluded, and records how fast each one is and how many nodes and primitives it had to test.
+	class OcclusionBenchmark
+	{
+	public:
+		static constexpr uSize NumberOfCameraRays = 1 << 18;
+
+		struct Result
+		{
+			f32 RaysPerSecond = 0.0f;
+			f32 NodesVisitedPerRay = 0.0f;
+			f32 PrimitiveTestsPerRay = 0.0f;
+			uSize NumberOfOccludedRays = 0;
+		};
+
+	public:
+		OcclusionBenchmark() = default;
+		~OcclusionBenchmark() = default;
+
+		OcclusionBenchmark(const OcclusionBenchmark&) = delete;
+		OcclusionBenchmark& operator=(const OcclusionBenchmark&) = delete;
+		OcclusionBenchmark(OcclusionBenchmark&&) = delete;
+		OcclusionBenchmark& operator=(OcclusionBenchmark&&) = delete;
+
+		// the render threads have to be stopped, they share the hitable and their traversal stats are per thread anyway
+		void Run(const BaseHitable& hitable, const Point& cameraPosition);
+
+		void ImGuiRender() const;
+
+	private:
+		Result m_ClosestHitResult;
+		Result m_AnyHitResult;
+		uSize m_NumberOfShadowRays = 0;
+		bool m_HasRun = false;
+	};
+}
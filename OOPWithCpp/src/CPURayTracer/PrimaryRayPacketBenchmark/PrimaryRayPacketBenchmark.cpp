@@ -0,0 +1,86 @@
+﻿#include "PrimaryRayPacketBenchmark.hpp"
+#include "Application.hpp"
+
+
+namespace OWC
+{
+	void PrimaryRayPacketBenchmark::Start(bool originalUseWideBVH, bool originalUseQuantizedBVH, bool originalUsePrimaryRayPackets)
+	{
+		m_OriginalUseWideBVH = originalUseWideBVH;
+		m_OriginalUseQuantizedBVH = originalUseQuantizedBVH;
+		m_OriginalUsePrimaryRayPackets = originalUsePrimaryRayPackets;
+		m_NumberOfResults = 0;
+		m_CurrentStep = 0;
+		m_PassesInStep = 0;
+		m_MeasuredResult = Result();
+		m_IsRunning = true;
+	}
+
+	bool PrimaryRayPacketBenchmark::OnPassCompleted(const RenderStats& renderStats)
+	{
+		if (!m_IsRunning)
+			return false;
+
+		// a merge can hold several passes, the stats are the last one's so they stand in for every measured pass in it
+		uSize warmupPassesLeft = s_WarmupPasses - glm::min(m_PassesInStep, s_WarmupPasses);
+		m_PassesInStep += renderStats.NumberOfMergedPasses;
+		if (m_PassesInStep <= s_WarmupPasses)
+			return false;
+
+		auto measuredPasses = static_cast<f32>(renderStats.NumberOfMergedPasses - warmupPassesLeft);
+		m_MeasuredResult.NodesVisitedPerRay += renderStats.NodesVisitedPerRay * measuredPasses;
+		m_MeasuredResult.PrimitiveTestsPerRay += renderStats.PrimitiveTestsPerRay * measuredPasses;
+		m_MeasuredResult.SamplesPerSecond += renderStats.SamplesPerSecond * measuredPasses;
+		if (m_PassesInStep < s_WarmupPasses + s_MeasuredPasses)
+			return false;
+
+		f32 invMeasuredPasses = 1.0f / static_cast<f32>(m_PassesInStep - s_WarmupPasses);
+		Result& result = m_Results[m_CurrentStep];
+		result.NodesVisitedPerRay = m_MeasuredResult.NodesVisitedPerRay * invMeasuredPasses;
+		result.PrimitiveTestsPerRay = m_MeasuredResult.PrimitiveTestsPerRay * invMeasuredPasses;
+		result.SamplesPerSecond = m_MeasuredResult.SamplesPerSecond * invMeasuredPasses;
+		m_NumberOfResults = m_CurrentStep + 1;
+
+		m_PassesInStep = 0;
+		m_MeasuredResult = Result();
+
+		m_CurrentStep++;
+		if (m_CurrentStep == NumberOfSteps)
+			m_IsRunning = false; // the getters now return the original settings so they are put back
+
+		return true;
+	}
+
+	void PrimaryRayPacketBenchmark::ImGuiRender() const
+	{
+		constexpr std::array<const char*, NumberOfTreeForms> treeFormNames = {
+			"Binary",
+			"Wide",
+			"Quantized Wide"
+		};
+		constexpr std::array<const char*, 2> rayModeNames = {
+			"single rays",
+			"packets"
+		};
+
+		if (m_IsRunning)
+			ImGui::Text("Benchmarking %s BVH with %s", treeFormNames[m_CurrentStep / 2], rayModeNames[m_CurrentStep % 2]);
+
+		// the nodes and primitives are per ray over every bounce, only the camera rays are traced differently
+		for (uSize i = 0; i != m_NumberOfResults; i++)
+		{
+			const Result& result = m_Results[i];
+			ImGui::Text(
+				"%s, %s: %.2f Msamples/s, %.1f nodes/ray, %.2f primitives/ray",
+				treeFormNames[i / 2],
+				rayModeNames[i % 2],
+				result.SamplesPerSecond * 1e-6f,
+				result.NodesVisitedPerRay,
+				result.PrimitiveTestsPerRay
+			);
+
+			if (i % 2 == 1 && m_Results[i - 1].SamplesPerSecond > 0.0f)
+				ImGui::Text("    packets x%.2f", result.SamplesPerSecond / m_Results[i - 1].SamplesPerSecond);
+		}
+	}
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "Camera.hpp"
+
+#include <array>
+
+
+namespace OWC
+{
+	// Renders the current scene with camera rays traced one at a time and then as RayPackets on each form of the BVH in turn,
+	// the binary tree, the float wide tree and the quantized wide tree, and records the samples per second of each.
+	// Packets only have their own walk of the binary and quantized trees, on the float wide tree they fall back to the binary one.
+	class PrimaryRayPacketBenchmark
+	{
+	public:
+		static constexpr uSize NumberOfTreeForms = 3;
+		static constexpr uSize NumberOfSteps = 2 * NumberOfTreeForms; // every tree form with single rays then packets
+
+		struct Result
+		{
+			f32 NodesVisitedPerRay = 0.0f;
+			f32 PrimitiveTestsPerRay = 0.0f;
+			f32 SamplesPerSecond = 0.0f;
+		};
+
+	public:
+		PrimaryRayPacketBenchmark() = default;
+		~PrimaryRayPacketBenchmark() = default;
+
+		PrimaryRayPacketBenchmark(const PrimaryRayPacketBenchmark&) = delete;
+		PrimaryRayPacketBenchmark& operator=(const PrimaryRayPacketBenchmark&) = delete;
+		PrimaryRayPacketBenchmark(PrimaryRayPacketBenchmark&&) = delete;
+		PrimaryRayPacketBenchmark& operator=(PrimaryRayPacketBenchmark&&) = delete;
+
+		// the original settings are handed back by the getters once the benchmark is done
+		void Start(bool originalUseWideBVH, bool originalUseQuantizedBVH, bool originalUsePrimaryRayPackets);
+		OWC_FORCE_INLINE bool IsRunning() const { return m_IsRunning; }
+
+		// settings the renderer should use for the step being measured
+		OWC_FORCE_INLINE bool GetUseWideBVH() const { return m_IsRunning ? m_CurrentStep / 2 != 0 : m_OriginalUseWideBVH; }
+		OWC_FORCE_INLINE bool GetUseQuantizedBVH() const { return m_IsRunning ? m_CurrentStep / 2 == 2 : m_OriginalUseQuantizedBVH; }
+		OWC_FORCE_INLINE bool GetUsePrimaryRayPackets() const { return m_IsRunning ? m_CurrentStep % 2 != 0 : m_OriginalUsePrimaryRayPackets; }
+
+		// returns true when the benchmark moved on to the next step and the getters have to be applied again
+		bool OnPassCompleted(const RenderStats& renderStats);
+
+		void ImGuiRender() const;
+
+	private:
+		static constexpr uSize s_WarmupPasses = 2;
+		static constexpr uSize s_MeasuredPasses = 8;
+
+		std::array<Result, NumberOfSteps> m_Results;
+		uSize m_NumberOfResults = 0;
+		uSize m_CurrentStep = 0;
+		uSize m_PassesInStep = 0;
+		Result m_MeasuredResult;
+		bool m_OriginalUseWideBVH = true;
+		bool m_OriginalUseQuantizedBVH = true;
+		bool m_OriginalUsePrimaryRayPackets = true;
+		bool m_IsRunning = false;
+	};
+}
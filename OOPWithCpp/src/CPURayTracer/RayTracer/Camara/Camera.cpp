@@ -2,6 +2,7 @@
 #include "Camera.hpp"
 #include "Ray.hpp"
 #include "OWCRand.hpp"
+#include "BaseMaterial.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/euler_angles.hpp>
@@ -12,132 +13,87 @@
 
 namespace OWC
 {
+	RTCamera::RTCamera(std::vector<Colour>& pixels)
+		: m_ThreadPool([this](uSize threadIndex) { ThreadedRenderPass(threadIndex); }), m_Pixels(pixels) {}
+
 	RTCamera::~RTCamera()
 	{
-		m_EndThreads = true;
-
-		for (const ThreadData& renderThreadData : m_RenderThreadsData)
-			while (!renderThreadData.IsFinished)
-				std::this_thread::yield();
+		StopPasses();
+		m_ThreadPool.Shutdown();
 	}
 
 	RenderPassReturnData RTCamera::SingleThreadedRenderPass(const std::shared_ptr<BaseHitable>& hittables)
 	{
-		if (m_SingleThreadedModeNeedsSetup)
-		{
-			m_SingleThreadedModeNeedsSetup = false;
-			m_MultiThreadedModeNeedsSetup = true;
-
-			// yield all threads before destroying their data
-			m_EndThreads = true;
-			for (const ThreadData& renderThreadData : m_RenderThreadsData)
-				while (!renderThreadData.IsFinished)
-					std::this_thread::yield();
-
-			m_RenderThreadsData.clear();
-			m_RenderThreads.clear();
-			m_EndThreads = false;
-			m_RenderThreadsData.resize(1);
-			m_RenderThreads.reserve(1);
-			ThreadData& renderThreadData = m_RenderThreadsData[0];
-			m_RenderThreads.emplace_back(
-				[this](ThreadData& data)
-				{
-					ThreadedRenderPass(data);
-				},
-				std::ref(m_RenderThreadsData[0])
-			);
-			renderThreadData.StartIndex = 0;
-			renderThreadData.Step = 1;
-			renderThreadData.Hittables = hittables;
-			m_HoldAllThreads = true;
-			m_RenderThreads[0].detach();
-			UpdateCameraSettings();
-		}
-		// guaranteed to be only be one thread data in single threaded mode
-		else if (m_RenderThreadsData[0].IsFinished)
-		{
-			std::ranges::move(m_SampleAccumulationBuffer, m_Pixels.begin());
-			m_RenderThreadsData[0].Hittables = hittables;
-			m_RenderThreadsData[0].IsFinished = false;
-			return true;
-		}
+		return RenderPass(hittables, 1);
+	}
 
-		return false;
+	RenderPassReturnData RTCamera::MultiThreadedRenderPass(const std::shared_ptr<BaseHitable>& hittables)
+	{
+		return RenderPass(hittables, static_cast<uSize>(glm::max(m_Settings.NumberOfThreads, 1)));
 	}
 
-	OWC::RenderPassReturnData RTCamera::MultiThreadedRenderPass(const std::shared_ptr<BaseHitable>& hittables)
+	RenderPassReturnData RTCamera::RenderPass(const std::shared_ptr<BaseHitable>& hittables, uSize threadCount)
 	{
-		if (m_MultiThreadedModeNeedsSetup)
+		if (m_ThreadPool.GetActiveThreadCount() != threadCount)
 		{
-			m_MultiThreadedModeNeedsSetup = false;
-			m_SingleThreadedModeNeedsSetup = true;
-
-			// yield all threads before destroying their data
-			m_EndThreads = true;
-			for (const ThreadData& renderThreadData : m_RenderThreadsData)
-				while (!renderThreadData.IsFinished)
-					std::this_thread::yield();
-
-			m_RenderThreadsData.clear();
-			m_RenderThreads.clear();
-			m_EndThreads = false;
-			uSize threadCount = std::thread::hardware_concurrency() - 1; // leave one core free for main thread
+			// threads past the new count are parked rather than destroyed so switching back costs nothing
+			StopPasses();
+			m_ThreadPool.SetActiveThreadCount(threadCount);
 			m_RenderThreadsData.resize(threadCount);
-			m_RenderThreads.reserve(threadCount);
-			for (uSize i = 0; i != threadCount; i++)
-			{
-				m_RenderThreads.emplace_back(
-					[this](ThreadData& data)
-					{
-						ThreadedRenderPass(data);
-					},
-					std::ref(m_RenderThreadsData[i])
-				);
-
-				ThreadData& renderThreadData = m_RenderThreadsData[i];
-				renderThreadData.StartIndex = i;
-				renderThreadData.Step = threadCount;
-				renderThreadData.Hittables = hittables;
-			}
-			m_HoldAllThreads = true;
-			for (std::jthread& thread : m_RenderThreads)
-				thread.detach();
 			UpdateCameraSettings();
 		}
-		else
+
 		{
-			bool notAllFinished = false; // reduce number of comparisons
-			for (const ThreadData& renderThreadData : m_RenderThreadsData)
-				notAllFinished |= !renderThreadData.IsFinished;
+			// picked up by whichever thread starts the next pass, m_Settings itself is only touched by the main thread
+			std::scoped_lock lock(m_PassBuffersMutex);
+			m_PendingPassSettings.ImageSize = Vec2u(m_Settings.ScreenSize);
+			m_PendingPassSettings.TileSize = Vec2u(glm::max(m_Settings.TileSize, Vec2i(1)));
+			m_PendingPassSettings.Distribution = m_Settings.Distribution;
+			m_PendingPassSettings.NumberOfSamplesPerPass = m_Settings.NumberOfSamplesPerPass;
+			// 1x1 strided tiles are the old per pixel split, padding every pixel out to its own cache line would make the baseline a different layout
+			bool isPixelSplit = m_Settings.Distribution == TileDistribution::Strided && m_PendingPassSettings.TileSize == Vec2u(1);
+			m_PendingPassSettings.UseTiledAccumulation = m_Settings.UseTiledAccumulation && !isPixelSplit;
+			m_PendingPassSettings.UsePrimaryRayPackets = m_Settings.UsePrimaryRayPackets;
+			m_PendingPassSettings.UseWavefront = m_Settings.UseWavefront;
+		}
 
-			if (notAllFinished)
-				return false;
+		if (!m_PassesRunning)
+		{
+			StartPasses(hittables);
+			return 0;
+		}
 
-			std::ranges::move(m_SampleAccumulationBuffer, m_Pixels.begin());
-			for (ThreadData& renderThreadData : m_RenderThreadsData)
-			{
-				renderThreadData.Hittables = hittables;
-				renderThreadData.IsFinished = false;
-			}
-			return true;
+		PassBuffer* readyPassBuffer = nullptr;
+		{
+			std::scoped_lock lock(m_PassBuffersMutex);
+			for (PassBuffer& passBuffer : m_PassBuffers)
+				if (passBuffer.State == PassBufferState::Ready)
+					readyPassBuffer = &passBuffer;
 		}
-		return false;
+
+		if (readyPassBuffer == nullptr)
+			return 0;
+
+		// render threads never touch a ready buffer so it can be merged without holding the lock
+		MergePassBuffer(*readyPassBuffer);
+		m_RenderStats = readyPassBuffer->Stats;
+		m_RenderStats.NumberOfMergedPasses = readyPassBuffer->NumberOfPasses;
+
+		std::scoped_lock lock(m_PassBuffersMutex);
+		readyPassBuffer->State = PassBufferState::Free;
+		return readyPassBuffer->NumberOfPasses;
 	}
 
 	void RTCamera::UpdateCameraSettings()
 	{
-		m_HoldAllThreads = true;
-		for (const ThreadData& data : m_RenderThreadsData)
-			while (!data.IsFinished)
-				std::this_thread::yield();
-
-		m_SampleAccumulationBuffer.resize(m_Pixels.size());
-		for (Colour& pixel : m_SampleAccumulationBuffer)
-			pixel = Colour(0.0f);
+		StopPasses(); // any pass that was running has been cut short so its samples are thrown away
 
 		m_ActiveMaxBounces = m_Settings.MaxBounces;
-		m_BouncedColours.resize((m_ActiveMaxBounces + 2) * m_RenderThreadsData.size()); // +1 for lost ray colour and +1 for low bounce count working correctly
+		// +1 for lost ray colour and +1 for low bounce count working correctly
+		// then rounded up to whole cache lines so no two threads ever write to the same line
+		constexpr uSize bouncedColoursPerCacheLine = CacheLineSize / sizeof(ColourX2);
+		m_BouncedColoursStride = (static_cast<uSize>(m_ActiveMaxBounces + 2) + bouncedColoursPerCacheLine - 1) & ~(bouncedColoursPerCacheLine - 1);
+		m_BouncedColours.resize(m_BouncedColoursStride * m_RenderThreadsData.size());
 
 		Vec3 rotationInRadians = glm::radians(m_Settings.Rotation);
 		Mat4 rotationMatrix = glm::eulerAngleYXZ(rotationInRadians.y, rotationInRadians.x, rotationInRadians.z);
@@ -154,11 +110,156 @@ namespace OWC
 
 		m_PixelDeltaU = viewportU / m_Settings.ScreenSize.x;
 		m_PixelDeltaV = viewportV / m_Settings.ScreenSize.y;
+		m_PixelSpreadAngle = glm::length(m_PixelDeltaV) / m_Settings.FocalLength;
 
 		Point viewportUpperLeft = m_Settings.Position - (m_Settings.FocalLength * forward) - 0.5f * (viewportU + viewportV);
 		m_Pixel100Location = viewportUpperLeft + 0.5f * (m_PixelDeltaU + m_PixelDeltaV);
+	}
 
-		m_HoldAllThreads = false;
+	void RTCamera::StartPasses(const std::shared_ptr<BaseHitable>& hittables)
+	{
+		m_PassHittables = hittables;
+		m_RenderingPassBuffer = 0;
+		PreparePassBuffer(m_PassBuffers[0], false);
+
+		m_ThreadsInPass.store(m_RenderThreadsData.size(), std::memory_order_relaxed);
+		m_PassStartTime = std::chrono::steady_clock::now();
+		m_PassesRunning = true;
+
+		// the threads stay in ThreadedRenderPass and chain passes back to back until StopPasses
+		m_ThreadPool.StartPass();
+	}
+
+	void RTCamera::StopPasses()
+	{
+		m_AbortPass.store(true, std::memory_order_relaxed);
+		// wake the threads waiting for the rest of a pass to finish
+		m_PassGeneration.fetch_add(1, std::memory_order_release);
+		m_PassGeneration.notify_all();
+		m_ThreadPool.WaitForPass();
+
+		m_PassesRunning = false;
+		for (PassBuffer& passBuffer : m_PassBuffers)
+		{
+			passBuffer.State = PassBufferState::Free;
+			passBuffer.Samples.clear();
+		}
+
+		m_AbortPass.store(false, std::memory_order_relaxed);
+	}
+
+	void RTCamera::FinishPass()
+	{
+		std::scoped_lock lock(m_PassBuffersMutex);
+
+		if (!m_AbortPass.load(std::memory_order_relaxed))
+		{
+			PassBuffer& renderingPassBuffer = m_PassBuffers[m_RenderingPassBuffer];
+			renderingPassBuffer.NumberOfPasses++;
+			UpdatePassStats(renderingPassBuffer);
+
+			PassBuffer& otherPassBuffer = m_PassBuffers[m_RenderingPassBuffer ^ 1];
+			if (otherPassBuffer.State == PassBufferState::Free)
+			{
+				renderingPassBuffer.State = PassBufferState::Ready;
+				m_RenderingPassBuffer ^= 1;
+				PreparePassBuffer(otherPassBuffer, false);
+			}
+			else // the main thread has not merged the other buffer yet, add another pass on top of this one rather than wait for it
+				PreparePassBuffer(renderingPassBuffer, true);
+
+			m_PassStartTime = std::chrono::steady_clock::now();
+		}
+
+		m_ThreadsInPass.store(m_RenderThreadsData.size(), std::memory_order_relaxed);
+		m_PassGeneration.fetch_add(1, std::memory_order_release);
+		m_PassGeneration.notify_all();
+	}
+
+	void RTCamera::PreparePassBuffer(PassBuffer& passBuffer, bool keepLayout)
+	{
+		if (!keepLayout)
+		{
+			// the layout is fixed until the buffer is merged so the UI can change it while threads are running
+			bool wasRowMajor = !passBuffer.Settings.UseTiledAccumulation;
+			passBuffer.Settings = m_PendingPassSettings;
+			passBuffer.NumberOfPasses = 0;
+			passBuffer.Scheduler.Reset(passBuffer.Settings.ImageSize, passBuffer.Settings.TileSize, m_RenderThreadsData.size(), passBuffer.Settings.Distribution);
+
+			if (passBuffer.Settings.UseTiledAccumulation)
+				passBuffer.Samples.resize(passBuffer.Scheduler.GetTiledBufferSize()); // the first pass overwrites every pixel so no clear is needed
+			else
+			{
+				// merging clears a row major buffer so it only needs clearing here when it held something else
+				uSize numberOfPixels = static_cast<uSize>(passBuffer.Settings.ImageSize.x) * static_cast<uSize>(passBuffer.Settings.ImageSize.y);
+				if (!wasRowMajor || passBuffer.Samples.size() != numberOfPixels)
+					passBuffer.Samples.assign(numberOfPixels, Colour(0.0f));
+			}
+		}
+		else
+			passBuffer.Scheduler.Reset(passBuffer.Settings.ImageSize, passBuffer.Settings.TileSize, m_RenderThreadsData.size(), passBuffer.Settings.Distribution);
+
+		passBuffer.State = PassBufferState::Rendering;
+	}
+
+	void RTCamera::UpdatePassStats(PassBuffer& passBuffer) const
+	{
+		f32 longestThreadTime = 0.0f;
+		f32 totalThreadTime = 0.0f;
+		TraversalStats traversalStats;
+		for (const ThreadData& renderThreadData : m_RenderThreadsData)
+		{
+			f32 threadTime = std::chrono::duration<f32, std::milli>(renderThreadData.FinishTime - m_PassStartTime).count();
+			longestThreadTime = glm::max(longestThreadTime, threadTime);
+			totalThreadTime += threadTime;
+			traversalStats += renderThreadData.PassTraversalStats;
+		}
+
+		uSize numberOfSamples = static_cast<uSize>(passBuffer.Settings.ImageSize.x) * static_cast<uSize>(passBuffer.Settings.ImageSize.y) *
+			static_cast<uSize>(passBuffer.Settings.NumberOfSamplesPerPass);
+
+		RenderStats& stats = passBuffer.Stats;
+		stats.NumberOfTiles = passBuffer.Scheduler.GetNumberOfTiles();
+		stats.NumberOfSteals = passBuffer.Scheduler.GetNumberOfSteals();
+		stats.Distribution = passBuffer.Scheduler.GetDistribution();
+		stats.PassTime = longestThreadTime;
+		stats.SamplesPerSecond = longestThreadTime > 0.0f ? static_cast<f32>(numberOfSamples) * 1000.0f / longestThreadTime : 0.0f;
+		// a thread is only idle once there are no tiles left to steal, so the gap between its finish time and the slowest thread is the lost time
+		stats.ThreadUtilization = longestThreadTime > 0.0f ?
+			totalThreadTime / (longestThreadTime * static_cast<f32>(m_RenderThreadsData.size())) :
+			1.0f;
+
+		auto numberOfTraversals = static_cast<f32>(glm::max(traversalStats.NumberOfTraversals, u64(1)));
+		stats.NodesVisitedPerRay = static_cast<f32>(traversalStats.NumberOfNodesVisited) / numberOfTraversals;
+		stats.PrimitiveTestsPerRay = static_cast<f32>(traversalStats.NumberOfPrimitiveTests) / numberOfTraversals;
+		stats.CandidateHitsPerRay = static_cast<f32>(traversalStats.NumberOfCandidateHits) / numberOfTraversals;
+		stats.FinalizedHitsPerRay = static_cast<f32>(traversalStats.NumberOfClosestHits) / numberOfTraversals;
+	}
+
+	void RTCamera::MergePassBuffer(PassBuffer& passBuffer)
+	{
+		if (!passBuffer.Settings.UseTiledAccumulation)
+		{
+			for (uSize i = 0; i != m_Pixels.size(); i++)
+			{
+				m_Pixels[i] += passBuffer.Samples[i];
+				passBuffer.Samples[i] = Colour(0.0f);
+			}
+			return;
+		}
+
+		uSize imageWidth = passBuffer.Settings.ImageSize.x;
+		for (uSize tileIndex = 0; tileIndex != passBuffer.Scheduler.GetNumberOfTiles(); tileIndex++)
+		{
+			Tile tile = passBuffer.Scheduler.GetTile(tileIndex);
+			const Colour* tilePixel = passBuffer.Samples.data() + tile.BufferOffset;
+			for (u32 y = tile.Start.y; y != tile.End.y; y++)
+			{
+				Colour* imageRow = m_Pixels.data() + y * imageWidth;
+				for (u32 x = tile.Start.x; x != tile.End.x; x++)
+					imageRow[x] += *tilePixel++;
+			}
+		}
 	}
 
 	Ray RTCamera::CreateRay(uSize i, uSize j) const
@@ -171,17 +272,39 @@ namespace OWC
 		return Ray{ m_Settings.Position, rayDirection };
 	}
 
-	Colour RTCamera::RayColour(Ray& ray, size_t bouncedColoursOffset, const std::shared_ptr<BaseHitable>& hittables)
+	void RTCamera::CreateRayPacket(uSize i, uSize j, uSize numberOfRays, RayPacket& packet) const
+	{
+		packet.ActiveMask = 0;
+		for (uSize lane = 0; lane != numberOfRays; lane++)
+			packet.SetRay(lane, CreateRay(i, j + lane), Interval(0.001f, std::numeric_limits<f32>::max()));
+
+		packet.PadInactiveLanes();
+	}
+
+	Colour RTCamera::RayColour(Ray& ray, size_t bouncedColoursOffset, const std::shared_ptr<BaseHitable>& hittables, const HitData* primaryHit)
 	{
 		bool missed = false;
 		bool scattered = true;
 		i32 i = 0;
 
+		// the ray cone of the path, its width at the last hit and how fast it grows from there
+		f32 coneWidth = 0.0f;
+		f32 coneSpread = m_PixelSpreadAngle;
+
 		for (; i != m_ActiveMaxBounces + 1 && scattered; i++)
 		{
 			HitData hitData;
-			Interval tRange(0.001f, std::numeric_limits<f32>::max());
-			bool hasHit = hittables->IsHit(ray, tRange, hitData);
+			bool hasHit = false;
+			if (i == 0 && primaryHit != nullptr)
+			{
+				hitData = *primaryHit;
+				hasHit = hitData.object != nullptr;
+			}
+			else
+			{
+				Interval tRange(0.001f, std::numeric_limits<f32>::max());
+				hasHit = hittables->IsHit(ray, tRange, hitData);
+			}
 			if (!hasHit)
 			{
 				m_BouncedColours[bouncedColoursOffset + i][0] = Colour(0.0f);
@@ -190,9 +313,16 @@ namespace OWC
 				break;
 			}
 
-			m_BouncedColours[bouncedColoursOffset + i][0] = hitData.material->Albedo(hitData);
-			m_BouncedColours[bouncedColoursOffset + i][1] = hitData.material->Emitted(ray, hitData);
-			scattered = hitData.material->Scatter(ray, hitData);
+			coneWidth += coneSpread * hitData.t;
+			hitData.footprint = coneWidth;
+			BaseHitable::FinalizeClosestHit(ray, hitData);
+
+			// shaded through the compiled material, a switch the built in materials inline into rather than three virtual calls
+			const CompiledMaterial& material = *hitData.material;
+			m_BouncedColours[bouncedColoursOffset + i][0] = material.Albedo(hitData);
+			m_BouncedColours[bouncedColoursOffset + i][1] = material.Emitted(ray, hitData);
+			scattered = material.Scatter(ray, hitData);
+			coneSpread = material.ScatteredConeSpread(coneSpread);
 		}
 
 		if (i == m_ActiveMaxBounces + 1)
@@ -215,27 +345,137 @@ namespace OWC
 		return finalColour;
 	}
 
-	void RTCamera::ThreadedRenderPass(ThreadData& data)
+	void RTCamera::ThreadedRenderPass(uSize threadIndex)
 	{
-		while (true)
+		uSize bouncedColoursOffset = m_BouncedColoursStride * threadIndex;
+		u32 passGeneration = m_PassGeneration.load(std::memory_order_acquire);
+
+		while (!m_AbortPass.load(std::memory_order_relaxed))
 		{
-			data.IsFinished = true;
-			while ((data.IsFinished || m_HoldAllThreads) && !m_EndThreads)
-				std::this_thread::yield();
+			RenderTiles(m_PassBuffers[m_RenderingPassBuffer], threadIndex, bouncedColoursOffset);
+			m_RenderThreadsData[threadIndex].FinishTime = std::chrono::steady_clock::now();
+			m_RenderThreadsData[threadIndex].PassTraversalStats = LinearBVH::TakeThreadTraversalStats();
 
-			if (m_EndThreads)
-				break;
+			// the last thread out starts the next pass so the threads never wait on the main thread between passes
+			if (m_ThreadsInPass.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				FinishPass();
+			else
+				m_PassGeneration.wait(passGeneration, std::memory_order_acquire);
+
+			passGeneration = m_PassGeneration.load(std::memory_order_acquire);
+		}
+	}
+
+	void RTCamera::RenderTiles(PassBuffer& passBuffer, uSize threadIndex, uSize bouncedColoursOffset)
+	{
+		const PassSettings& passSettings = passBuffer.Settings;
+		uSize imageWidth = passSettings.ImageSize.x;
+		bool isFirstPass = passBuffer.NumberOfPasses == 0;
+
+		Tile tile;
+		while (!m_AbortPass.load(std::memory_order_relaxed) && passBuffer.Scheduler.Pop(threadIndex, tile))
+		{
+			// the tile owns its own cache lines in the tiled pass buffer and every pixel is written once after all its samples are summed
+			// the row major layout shares cache lines at the edges of each tile with the neighbouring tiles
+			Colour* tilePixel = passBuffer.Samples.data() + tile.BufferOffset;
+			auto writePixel = [&](u32 x, u32 y, const Colour& pixelColour) {
+				if (!passSettings.UseTiledAccumulation)
+					passBuffer.Samples[y * imageWidth + x] += pixelColour;
+				else if (isFirstPass)
+					*tilePixel++ = pixelColour;
+				else
+					*tilePixel++ += pixelColour;
+			};
+
+			if (passSettings.UseWavefront)
+			{
+				u32 tileWidth = tile.End.x - tile.Start.x;
+				u32 numberOfTilePixels = tileWidth * (tile.End.y - tile.Start.y);
+				auto numberOfSamples = static_cast<u32>(glm::max(passSettings.NumberOfSamplesPerPass, 1));
+				u32 pixelsPerWave = glm::max(static_cast<u32>(WavefrontIntegrator::MaxPathsPerWave) / numberOfSamples, 1u);
+				WavefrontIntegrator& integrator = m_RenderThreadsData[threadIndex].Integrator;
+
+				for (u32 firstPixel = 0; firstPixel < numberOfTilePixels && !m_AbortPass.load(std::memory_order_relaxed); firstPixel += pixelsPerWave)
+				{
+					u32 numberOfPixels = glm::min(pixelsPerWave, numberOfTilePixels - firstPixel);
+					RenderWave(passSettings, tile, firstPixel, numberOfPixels, integrator);
+
+					// the samples of a pixel are next to each other in the wave
+					for (u32 i = 0; i != numberOfPixels; i++)
+					{
+						Colour pixelColour(0.0f);
+						for (u32 sample = 0; sample != numberOfSamples; sample++)
+							pixelColour += integrator.GetRadiance(static_cast<uSize>(i) * numberOfSamples + sample);
+
+						writePixel(tile.Start.x + (firstPixel + i) % tileWidth, tile.Start.y + (firstPixel + i) / tileWidth, pixelColour);
+					}
+				}
+				continue;
+			}
 
-			uSize bouncedColoursOffset = (m_ActiveMaxBounces + 2) * data.StartIndex; // reuse start index for offset
-			Vec2us screenSize(m_Settings.ScreenSize);
+			// spans are one packet wide, or a single pixel when packets are off
+			u32 spanWidth = passSettings.UsePrimaryRayPackets ? static_cast<u32>(RayPacketWidth) : 1;
+			std::array<Colour, RayPacketWidth> spanColours;
 
-			for (uSize pixel = data.StartIndex; pixel < screenSize.x * screenSize.y; pixel += data.Step)
-				for (i32 sample = 0; sample != m_Settings.NumberOfSamplesPerPass && !m_HoldAllThreads && !m_EndThreads; sample++)
+			for (u32 y = tile.Start.y; y != tile.End.y; y++)
+				for (u32 x = tile.Start.x; x < tile.End.x; x += spanWidth)
 				{
-					Ray ray = CreateRay(pixel / screenSize.x, pixel % screenSize.x);
+					u32 numberOfPixels = glm::min(spanWidth, tile.End.x - x);
+					RenderSpan(passSettings, y, x, numberOfPixels, spanColours.data(), bouncedColoursOffset);
 
-					m_SampleAccumulationBuffer[pixel] += RayColour(ray, bouncedColoursOffset, data.Hittables);
+					for (u32 i = 0; i != numberOfPixels; i++)
+						writePixel(x + i, y, spanColours[i]);
 				}
 		}
 	}
+
+	void RTCamera::RenderSpan(const PassSettings& passSettings, u32 y, u32 x, u32 numberOfPixels, Colour* spanColours, uSize bouncedColoursOffset)
+	{
+		std::fill_n(spanColours, numberOfPixels, Colour(0.0f));
+
+		for (i32 sample = 0; sample != passSettings.NumberOfSamplesPerPass && !m_AbortPass.load(std::memory_order_relaxed); sample++)
+		{
+			if (!passSettings.UsePrimaryRayPackets)
+			{
+				for (u32 i = 0; i != numberOfPixels; i++)
+				{
+					Ray ray = CreateRay(y, x + i);
+					spanColours[i] += RayColour(ray, bouncedColoursOffset, m_PassHittables);
+				}
+				continue;
+			}
+
+			// the camera rays of a span are coherent so they are traced together, each then bounces on its own
+			alignas(64) RayPacket packet;
+			CreateRayPacket(y, x, numberOfPixels, packet);
+			m_PassHittables->IsHitPacket(packet, packet.ActiveMask);
+
+			for (u32 i = 0; i != numberOfPixels; i++)
+			{
+				HitData primaryHit;
+				primaryHit.Record(packet.HitObjects[i], packet.TMax[i], packet.HitPrimitives[i], packet.HitInstances[i]);
+
+				Ray ray = packet.GetRay(i);
+				spanColours[i] += RayColour(ray, bouncedColoursOffset, m_PassHittables, &primaryHit);
+			}
+		}
+	}
+
+	void RTCamera::RenderWave(const PassSettings& passSettings, const Tile& tile, u32 firstPixel, u32 numberOfPixels, WavefrontIntegrator& integrator)
+	{
+		auto numberOfSamples = static_cast<u32>(glm::max(passSettings.NumberOfSamplesPerPass, 1));
+		u32 tileWidth = tile.End.x - tile.Start.x;
+
+		// every sample of a pixel is its own path
+		integrator.BeginWave(static_cast<uSize>(numberOfPixels) * numberOfSamples, m_PixelSpreadAngle);
+		for (u32 i = 0; i != numberOfPixels; i++)
+		{
+			u32 x = tile.Start.x + (firstPixel + i) % tileWidth;
+			u32 y = tile.Start.y + (firstPixel + i) / tileWidth;
+			for (u32 sample = 0; sample != numberOfSamples; sample++)
+				integrator.SetPrimaryRay(static_cast<uSize>(i) * numberOfSamples + sample, CreateRay(y, x));
+		}
+
+		integrator.Trace(*m_PassHittables, m_ActiveMaxBounces, passSettings.UsePrimaryRayPackets);
+	}
 }
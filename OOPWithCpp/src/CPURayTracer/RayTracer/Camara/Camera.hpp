@@ -1,16 +1,29 @@
 ﻿#pragma once
 #include "Core.hpp"
 #include "Ray.hpp"
+#include "RayPacket.hpp"
 #include "BaseHittable.hpp"
+#include "LinearBVH.hpp"
+#include "AlignedAllocator.hpp"
+#include "TileScheduler.hpp"
+#include "WavefrontIntegrator.hpp"
+#include "RenderThreadPool.hpp"
 
 #include <vector>
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <atomic>
 #include <thread>
 #include <memory>
 
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
 
 namespace OWC
 {
-	using RenderPassReturnData = bool;
+	using RenderPassReturnData = u32; // number of passes added to the image, 0 when none finished since the last call
 
 	struct CameraRenderSettings
 	{
@@ -25,22 +38,74 @@ namespace OWC
 
 		i32 NumberOfSamplesPerPass = 1;
 		i32 MaxBounces = 16;
+
+		Vec2i TileSize{ 32, 32 };
+		TileDistribution Distribution = TileDistribution::WorkStealing;
+		bool UseTiledAccumulation = true; // false writes every sample straight into a row major buffer, kept to compare against
+		bool UsePrimaryRayPackets = true; // traces camera rays RayPacketWidth at a time, bounces are always traced one ray at a time
+		bool UseWavefront = false; // traces tiles a bounce at a time with WavefrontIntegrator instead of a whole path per pixel
+		i32 NumberOfThreads = static_cast<i32>(glm::max(std::thread::hardware_concurrency(), 2u) - 1); // leave one core free for main thread
+	};
+
+	struct RenderStats
+	{
+		uSize NumberOfTiles = 0;
+		u32 NumberOfSteals = 0;
+		f32 PassTime = 0.0f; // ms
+		f32 SamplesPerSecond = 0.0f;
+		f32 ThreadUtilization = 0.0f; // 0 to 1, time threads spent rendering over the time the pass took
+		TileDistribution Distribution = TileDistribution::WorkStealing; // how the tiles of the pass were handed out
+		f32 NodesVisitedPerRay = 0.0f; // BVH nodes tested per traversal, only counted for rays traced through a BVH
+		f32 PrimitiveTestsPerRay = 0.0f;
+		f32 CandidateHitsPerRay = 0.0f; // hits that shrank the range, each of these used to work out its shading data
+		f32 FinalizedHitsPerRay = 0.0f; // closest hits, the only ones that work out shading data now
+		u32 NumberOfMergedPasses = 0; // passes added to the image by the last merge, more than 1 when the main thread fell behind the render threads
 	};
 
 	class RTCamera
 	{
 	private:
-		struct ThreadData
+		struct alignas(64) ThreadData
+		{
+			std::chrono::steady_clock::time_point FinishTime{};
+			TraversalStats PassTraversalStats;
+			WavefrontIntegrator Integrator;
+		};
+
+		// settings a pass is started with, copied from m_Settings by the main thread so render threads can start passes on their own
+		struct PassSettings
+		{
+			Vec2u ImageSize{ 0 };
+			Vec2u TileSize{ 1 };
+			TileDistribution Distribution = TileDistribution::WorkStealing;
+			i32 NumberOfSamplesPerPass = 1;
+			bool UseTiledAccumulation = true;
+			bool UsePrimaryRayPackets = true;
+			bool UseWavefront = false;
+		};
+
+		enum class PassBufferState : u8
 		{
-			uSize StartIndex = 0;
-			uSize Step = 0;
-			std::shared_ptr<BaseHitable> Hittables = nullptr;
-			bool IsFinished = false;
+			Free = 0,  // merged into the image, can be rendered into
+			Rendering, // render threads are adding passes to it
+			Ready      // holds finished passes waiting for the main thread to merge them
+		};
+
+		// Render threads fill one buffer while the main thread merges the other, when the main thread falls behind
+		// the render threads keep adding passes to the buffer they are in instead of waiting for it.
+		struct PassBuffer
+		{
+			TileScheduler Scheduler;
+			CacheAlignedVector<Colour> Samples;
+			PassSettings Settings;
+			RenderStats Stats;
+			u32 NumberOfPasses = 0;
+			PassBufferState State = PassBufferState::Free;
 		};
 
 	public:
 		RTCamera() = delete;
-		explicit RTCamera(std::vector<Colour>& pixels) : m_Pixels(pixels) {}
+		explicit RTCamera(std::vector<Colour>& pixels);
 		~RTCamera();
 
 		RTCamera(const RTCamera&) = delete;
@@ -49,18 +114,39 @@ namespace OWC
 		RTCamera& operator=(RTCamera&&) = delete;
 
 		OWC_FORCE_INLINE CameraRenderSettings& GetSettings() { return m_Settings; }
+		OWC_FORCE_INLINE const RenderStats& GetRenderStats() const { return m_RenderStats; }
 
 		RenderPassReturnData SingleThreadedRenderPass(const std::shared_ptr<BaseHitable>& hittables);
 		RenderPassReturnData MultiThreadedRenderPass(const std::shared_ptr<BaseHitable>& hittables);
 
 		void UpdateCameraSettings();
 
+		// render threads keep chaining passes until stopped, the next render pass call starts them again
+		void StopPasses();
+
 	private:
 		Ray CreateRay(uSize i, uSize j) const;
+		// rays for numberOfRays pixels of row i starting at column j, one per lane from lane 0
+		void CreateRayPacket(uSize i, uSize j, uSize numberOfRays, RayPacket& packet) const;
 
-		Colour RayColour(Ray& ray, size_t bouncedColoursOffset, const std::shared_ptr<BaseHitable>& hittables);
+		// primaryHit is the first hit of the ray when it was already traced as part of a packet
+		Colour RayColour(Ray& ray, size_t bouncedColoursOffset, const std::shared_ptr<BaseHitable>& hittables, const HitData* primaryHit = nullptr);
 
-		void ThreadedRenderPass(ThreadData& data);
+		RenderPassReturnData RenderPass(const std::shared_ptr<BaseHitable>& hittables, uSize threadCount);
+
+		void ThreadedRenderPass(uSize threadIndex);
+		void RenderTiles(PassBuffer& passBuffer, uSize threadIndex, uSize bouncedColoursOffset);
+		// sums every sample of the pass for numberOfPixels pixels of row y starting at column x
+		void RenderSpan(const PassSettings& passSettings, u32 y, u32 x, u32 numberOfPixels, Colour* spanColours, uSize bouncedColoursOffset);
+		// traces every sample of the pass for numberOfPixels pixels of the tile, starting at firstPixel in row order, as one wave
+		// the radiance of sample s of pixel i is left in the integrator at path i * NumberOfSamplesPerPass + s
+		void RenderWave(const PassSettings& passSettings, const Tile& tile, u32 firstPixel, u32 numberOfPixels, WavefrontIntegrator& integrator);
+
+		void StartPasses(const std::shared_ptr<BaseHitable>& hittables);
+		void FinishPass();
+		void PreparePassBuffer(PassBuffer& passBuffer, bool keepLayout);
+		void UpdatePassStats(PassBuffer& passBuffer) const;
+		void MergePassBuffer(PassBuffer& passBuffer);
 
 	private:
 		CameraRenderSettings m_Settings;
@@ -68,17 +154,29 @@ namespace OWC
 		Point m_Pixel100Location = Point(0.0f);
 		Vec3 m_PixelDeltaU = Vec3(0.0f);
 		Vec3 m_PixelDeltaV = Vec3(0.0f);
+		f32 m_PixelSpreadAngle = 0.0f; // the spread of the ray cone through a pixel, see HitData::footprint
 
 		std::vector<ThreadData> m_RenderThreadsData;
-		std::vector<std::jthread> m_RenderThreads;
+		RenderThreadPool m_ThreadPool;
+
+		std::array<PassBuffer, 2> m_PassBuffers;
+		uSize m_RenderingPassBuffer = 0; // only changed by the thread finishing a pass, published to the others through m_PassGeneration
+		std::mutex m_PassBuffersMutex; // guards the buffer states and m_PendingPassSettings
+		PassSettings m_PendingPassSettings;
+
+		RenderStats m_RenderStats;
+		std::shared_ptr<BaseHitable> m_PassHittables = nullptr;
+		std::chrono::steady_clock::time_point m_PassStartTime{};
+		bool m_PassesRunning = false;
+		alignas(64) std::atomic<bool> m_AbortPass = false;
+		alignas(64) std::atomic<u32> m_PassGeneration = 0;
+		alignas(64) std::atomic<uSize> m_ThreadsInPass = 0;
 
 		std::vector<Colour>& m_Pixels;
-		std::vector<Colour> m_SampleAccumulationBuffer;
-		std::vector<ColourX2> m_BouncedColours;
+		CacheAlignedVector<ColourX2> m_BouncedColours;
+		uSize m_BouncedColoursStride = 0;
 		i32 m_ActiveMaxBounces = 0;
-		bool m_EndThreads = false;
-		bool m_HoldAllThreads = false;
-		bool m_SingleThreadedModeNeedsSetup = true;
-		bool m_MultiThreadedModeNeedsSetup = true;
 	};
 }
+
+#pragma warning(pop)
@@ -0,0 +1,85 @@
+﻿#include "RenderThreadPool.hpp"
+
+
+namespace OWC
+{
+	RenderThreadPool::~RenderThreadPool()
+	{
+		Shutdown();
+	}
+
+	void RenderThreadPool::SetActiveThreadCount(uSize threadCount)
+	{
+		WaitForPass();
+
+		m_Workers.reserve(threadCount);
+		for (uSize i = m_Workers.size(); i < threadCount; i++)
+		{
+			Worker& worker = *m_Workers.emplace_back(std::make_unique<Worker>());
+			worker.Thread = std::jthread(
+				[this](Worker& threadWorker, uSize threadIndex)
+				{
+					WorkerLoop(threadWorker, threadIndex);
+				},
+				std::ref(worker), i
+			);
+		}
+
+		m_ActiveThreadCount = threadCount;
+	}
+
+	void RenderThreadPool::StartPass()
+	{
+		m_RunningThreads.store(static_cast<u32>(m_ActiveThreadCount), std::memory_order_relaxed);
+
+		for (uSize i = 0; i != m_ActiveThreadCount; i++)
+		{
+			Worker& worker = *m_Workers[i];
+			worker.State.store(WorkerState::Running, std::memory_order_release);
+			worker.State.notify_one();
+		}
+	}
+
+	void RenderThreadPool::WaitForPass() const
+	{
+		u32 runningThreads = m_RunningThreads.load(std::memory_order_acquire);
+		while (runningThreads != 0)
+		{
+			m_RunningThreads.wait(runningThreads, std::memory_order_acquire);
+			runningThreads = m_RunningThreads.load(std::memory_order_acquire);
+		}
+	}
+
+	void RenderThreadPool::Shutdown()
+	{
+		WaitForPass();
+
+		for (const std::unique_ptr<Worker>& worker : m_Workers)
+		{
+			worker->State.store(WorkerState::Exit, std::memory_order_release);
+			worker->State.notify_one();
+		}
+
+		// jthread joins on destruction
+		m_Workers.clear();
+		m_ActiveThreadCount = 0;
+	}
+
+	void RenderThreadPool::WorkerLoop(Worker& worker, uSize threadIndex)
+	{
+		while (true)
+		{
+			worker.State.wait(WorkerState::Parked, std::memory_order_acquire);
+
+			if (worker.State.load(std::memory_order_acquire) == WorkerState::Exit)
+				return;
+
+			m_PassFunction(threadIndex);
+
+			// park before reporting the pass as finished so the next StartPass can not be overwritten
+			worker.State.store(WorkerState::Parked, std::memory_order_release);
+			if (m_RunningThreads.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				m_RunningThreads.notify_all();
+		}
+	}
+}
@@ -0,0 +1,65 @@
+﻿#pragma once
+#include "Core.hpp"
+
+#include <vector>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <functional>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// Persistent pool of render threads.
+	// Threads are parked on an atomic wait between passes so they use no CPU time while there is nothing to render,
+	// and threads past the active count stay parked instead of being destroyed so changing the thread count does not churn threads.
+	class RenderThreadPool
+	{
+	public:
+		using PassFunction = std::function<void(uSize threadIndex)>;
+
+	public:
+		RenderThreadPool() = delete;
+		explicit RenderThreadPool(PassFunction passFunction) : m_PassFunction(std::move(passFunction)) {}
+		~RenderThreadPool();
+
+		RenderThreadPool(const RenderThreadPool&) = delete;
+		RenderThreadPool& operator=(const RenderThreadPool&) = delete;
+		RenderThreadPool(RenderThreadPool&&) = delete;
+		RenderThreadPool& operator=(RenderThreadPool&&) = delete;
+
+		// waits for the current pass, then spawns threads if more are needed than have ever been created
+		void SetActiveThreadCount(uSize threadCount);
+		OWC_FORCE_INLINE uSize GetActiveThreadCount() const { return m_ActiveThreadCount; }
+
+		// wakes the active threads to each run the pass function once, must only be called once the previous pass is finished
+		void StartPass();
+		OWC_FORCE_INLINE bool IsPassFinished() const { return m_RunningThreads.load(std::memory_order_acquire) == 0; }
+		void WaitForPass() const;
+
+		// waits for the current pass then joins every thread, the pool can not be used afterwards
+		void Shutdown();
+
+	private:
+		enum class WorkerState : u8 { Parked = 0, Running, Exit };
+
+		struct alignas(64) Worker
+		{
+			std::atomic<WorkerState> State = WorkerState::Parked;
+			std::jthread Thread;
+		};
+
+		void WorkerLoop(Worker& worker, uSize threadIndex);
+
+	private:
+		PassFunction m_PassFunction;
+		std::vector<std::unique_ptr<Worker>> m_Workers;
+		uSize m_ActiveThreadCount = 0;
+		alignas(64) std::atomic<u32> m_RunningThreads = 0;
+	};
+}
+
+#pragma warning(pop)
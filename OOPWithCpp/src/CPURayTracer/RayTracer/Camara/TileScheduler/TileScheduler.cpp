@@ -0,0 +1,126 @@
+﻿#include "TileScheduler.hpp"
+
+
+namespace OWC
+{
+	void TileScheduler::Reset(const Vec2u& imageSize, const Vec2u& tileSize, uSize numberOfQueues, TileDistribution distribution)
+	{
+		if (m_NumberOfQueues != numberOfQueues)
+		{
+			m_Queues = std::make_unique<TileQueue[]>(numberOfQueues);
+			m_NumberOfQueues = numberOfQueues;
+		}
+
+		m_ImageSize = imageSize;
+		m_Distribution = distribution;
+		m_NumberOfSteals.store(0, std::memory_order_relaxed);
+
+		m_TileSize = glm::max(tileSize, Vec2u(1));
+		m_NumberOfTiles = (imageSize + m_TileSize - Vec2u(1)) / m_TileSize;
+		m_TotalNumberOfTiles = static_cast<uSize>(m_NumberOfTiles.x) * static_cast<uSize>(m_NumberOfTiles.y);
+
+		m_TiledBufferSize = 0;
+		if (m_TotalNumberOfTiles != 0)
+		{
+			u32 lastRowHeight = imageSize.y - (m_NumberOfTiles.y - 1) * m_TileSize.y;
+			m_TiledBufferSize = (m_NumberOfTiles.y - 1) * GetTileRowBufferSize(m_TileSize.y) + GetTileRowBufferSize(lastRowHeight);
+		}
+
+		if (m_Distribution == TileDistribution::Strided)
+		{
+			for (uSize queueIndex = 0; queueIndex != m_NumberOfQueues; queueIndex++)
+			{
+				m_Queues[queueIndex].TileIndices.clear();
+				m_Queues[queueIndex].TileIndices.shrink_to_fit();
+				m_Queues[queueIndex].NextStridedTile = queueIndex;
+			}
+			return;
+		}
+
+		// give each queue a contiguous run of tiles so a thread works on neighbouring pixels until it has to steal
+		u32 tileIndex = 0;
+		for (uSize queueIndex = 0; queueIndex != m_NumberOfQueues; queueIndex++)
+		{
+			std::deque<u32>& tileIndices = m_Queues[queueIndex].TileIndices;
+			tileIndices.clear();
+
+			auto endTileIndex = static_cast<u32>((m_TotalNumberOfTiles * (queueIndex + 1)) / m_NumberOfQueues);
+			for (; tileIndex != endTileIndex; tileIndex++)
+				tileIndices.push_back(tileIndex);
+		}
+	}
+
+	Tile TileScheduler::GetTile(uSize tileIndex) const
+	{
+		Vec2u tilePosition(static_cast<u32>(tileIndex % m_NumberOfTiles.x), static_cast<u32>(tileIndex / m_NumberOfTiles.x));
+
+		Tile tile;
+		tile.Start = tilePosition * m_TileSize;
+		tile.End = glm::min(tile.Start + m_TileSize, m_ImageSize);
+
+		// every row of tiles above is full height, the tiles before it in its own row are all full width and as high as this one
+		constexpr uSize pixelsPerCacheLine = CacheLineSize / sizeof(Colour);
+		uSize numberOfPixels = static_cast<uSize>(m_TileSize.x) * static_cast<uSize>(tile.End.y - tile.Start.y);
+		tile.BufferOffset = tilePosition.y * GetTileRowBufferSize(m_TileSize.y) +
+			tilePosition.x * ((numberOfPixels + pixelsPerCacheLine - 1) & ~(pixelsPerCacheLine - 1));
+		return tile;
+	}
+
+	bool TileScheduler::Pop(uSize queueIndex, Tile& tile)
+	{
+		TileQueue& queue = m_Queues[queueIndex];
+		if (m_Distribution == TileDistribution::Strided)
+		{
+			if (queue.NextStridedTile >= m_TotalNumberOfTiles)
+				return false;
+
+			tile = GetTile(queue.NextStridedTile);
+			queue.NextStridedTile += m_NumberOfQueues;
+			return true;
+		}
+
+		{
+			std::scoped_lock lock(queue.Mutex);
+			if (!queue.TileIndices.empty())
+			{
+				tile = GetTile(queue.TileIndices.front());
+				queue.TileIndices.pop_front();
+				return true;
+			}
+		}
+
+		return Steal(queueIndex, tile);
+	}
+
+	bool TileScheduler::Steal(uSize thiefIndex, Tile& tile)
+	{
+		// start with the next queue along so thieves spread out over the victims instead of all hitting queue 0
+		for (uSize i = 1; i < m_NumberOfQueues; i++)
+		{
+			TileQueue& victim = m_Queues[(thiefIndex + i) % m_NumberOfQueues];
+			std::scoped_lock lock(victim.Mutex);
+			if (victim.TileIndices.empty())
+				continue;
+
+			// take from the back, the owner is working from the front
+			tile = GetTile(victim.TileIndices.back());
+			victim.TileIndices.pop_back();
+			m_NumberOfSteals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		return false;
+	}
+
+	uSize TileScheduler::GetTileRowBufferSize(u32 tileHeight) const
+	{
+		constexpr uSize pixelsPerCacheLine = CacheLineSize / sizeof(Colour);
+		auto paddedSize = [tileHeight](u32 tileWidth) {
+			uSize numberOfPixels = static_cast<uSize>(tileWidth) * static_cast<uSize>(tileHeight);
+			return (numberOfPixels + pixelsPerCacheLine - 1) & ~(pixelsPerCacheLine - 1);
+		};
+
+		u32 lastColumnWidth = m_ImageSize.x - (m_NumberOfTiles.x - 1) * m_TileSize.x;
+		return (m_NumberOfTiles.x - 1) * paddedSize(m_TileSize.x) + paddedSize(lastColumnWidth);
+	}
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "AlignedAllocator.hpp"
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	struct Tile
+	{
+		Vec2u Start{ 0 };
+		Vec2u End{ 0 };
+		uSize BufferOffset = 0; // first pixel of the tile in a tiled pass buffer, always on a new cache line
+	};
+
+	// WorkStealing is the default, Strided gives thread n tiles n, n + threads, ... and never steals, like the fixed
+	// StartIndex/Step pixel split the scheduler replaced so the gain can still be measured, with 1x1 tiles RTCamera
+	// accumulates into the row major buffer so that is the old split in both work and memory layout
+	enum class TileDistribution : u8 { WorkStealing = 0, Strided, Count };
+
+	// Splits the image into tiles and hands them out to the render threads.
+	// Every thread owns a queue filled with a contiguous run of tiles, once its own queue is empty it steals from the back of the other queues
+	// so a pass only ends when there is no work left anywhere instead of when the slowest fixed slice of the image is done.
+	class TileScheduler
+	{
+	public:
+		TileScheduler() = default;
+		~TileScheduler() = default;
+
+		TileScheduler(const TileScheduler&) = delete;
+		TileScheduler& operator=(const TileScheduler&) = delete;
+		TileScheduler(TileScheduler&&) = delete;
+		TileScheduler& operator=(TileScheduler&&) = delete;
+
+		// must only be called while no thread is popping tiles
+		void Reset(const Vec2u& imageSize, const Vec2u& tileSize, uSize numberOfQueues, TileDistribution distribution = TileDistribution::WorkStealing);
+
+		bool Pop(uSize queueIndex, Tile& tile);
+
+		OWC_FORCE_INLINE const Vec2u& GetImageSize() const { return m_ImageSize; }
+		OWC_FORCE_INLINE TileDistribution GetDistribution() const { return m_Distribution; }
+		// tiles are worked out from their index rather than stored, a pass of 1x1 tiles would otherwise hold a Tile per pixel
+		Tile GetTile(uSize tileIndex) const;
+		OWC_FORCE_INLINE uSize GetNumberOfTiles() const { return m_TotalNumberOfTiles; }
+		OWC_FORCE_INLINE u32 GetNumberOfSteals() const { return m_NumberOfSteals.load(std::memory_order_relaxed); }
+
+		// number of pixels needed to store every tile contiguously with each tile padded out to whole cache lines
+		OWC_FORCE_INLINE uSize GetTiledBufferSize() const { return m_TiledBufferSize; }
+
+	private:
+		bool Steal(uSize thiefIndex, Tile& tile);
+
+	private:
+		struct alignas(CacheLineSize) TileQueue
+		{
+			std::mutex Mutex;
+			std::deque<u32> TileIndices; // only for WorkStealing
+			uSize NextStridedTile = 0; // only for Strided, nothing else touches a queue then so it needs no lock
+		};
+
+		// size of a tiled pass buffer row of tiles that are tileHeight high, every tile padded out to whole cache lines
+		uSize GetTileRowBufferSize(u32 tileHeight) const;
+
+		Vec2u m_TileSize{ 1 };
+		Vec2u m_NumberOfTiles{ 0 };
+		uSize m_TotalNumberOfTiles = 0;
+		std::unique_ptr<TileQueue[]> m_Queues = nullptr;
+		uSize m_NumberOfQueues = 0;
+		uSize m_TiledBufferSize = 0;
+		Vec2u m_ImageSize{ 0 };
+		TileDistribution m_Distribution = TileDistribution::WorkStealing;
+		std::atomic<u32> m_NumberOfSteals = 0;
+	};
+}
+
+#pragma warning(pop)
@@ -1 +1,30 @@
 ﻿#include "BaseHittable.hpp"
+
+#include <bit>
+
+
+namespace OWC
+{
+	u32 __vectorcall BaseHitable::IsHitPacket(RayPacket& packet, u32 laneMask) const
+	{
+		u32 hitMask = 0;
+		while (laneMask != 0)
+		{
+			auto lane = static_cast<uSize>(std::countr_zero(laneMask));
+			laneMask &= laneMask - 1;
+
+			HitData hitData;
+			Interval range(packet.TMin[lane], packet.TMax[lane]);
+			if (IsHit(packet.GetRay(lane), range, hitData))
+			{
+				packet.TMax[lane] = range.GetMax();
+				packet.HitObjects[lane] = hitData.object;
+				packet.HitPrimitives[lane] = hitData.primitiveIndex;
+				packet.HitInstances[lane] = hitData.instance;
+				hitMask |= 1u << lane;
+			}
+		}
+
+		return hitMask;
+	}
+}
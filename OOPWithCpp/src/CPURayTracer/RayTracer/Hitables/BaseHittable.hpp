@@ -1,16 +1,12 @@
 ﻿#pragma once
-#define BaseHittable_HPP
 #include "Core.hpp"
 #include "Ray.hpp"
+#include "RayPacket.hpp"
 #include "Interval.hpp"
 #include "AABB.hpp"
 
 #include "glm/glm.hpp"
 
-#ifndef BASEMATERIAL_HPP
-#include "BaseMaterial.hpp"
-#endif // !BASEMATERIAL_HPP
-
 #pragma warning(push)
 #pragma warning(disable: 4324) // structure was padded due to alignment specifier
 
@@ -18,14 +14,27 @@
 namespace OWC
 {
 	class BaseMaterial;
-
-	struct alignas(64) HitData
+	struct CompiledMaterial;
+	class BaseHitable;
+
+	// traversal only records the distance and the object of the closest hit so far
+	// the rest is left uninitialized until the object that won fills it in with BaseHitable::FinalizeHit
+	// objects made of many primitives, like TriangleMesh, also record which of them was hit
+	// and a hit found through an Instance records the instance too so it can be finalized back in world space
+	struct alignas(16) HitData
 	{
-		Vec3 normal{};
-		Vec3 point{};
-		BaseMaterial* material = nullptr;
-		Vec2 uv{};
-		bool frontFace = false;
+		Vec3 normal;
+		Vec3 point;
+		const CompiledMaterial* material; // what the hit is shaded with, see BaseMaterial::GetCompiled
+		Vec2 uv;
+		const BaseHitable* object = nullptr;
+		const BaseHitable* instance = nullptr; // the Instance object was hit through, nullptr when it was hit directly
+		f32 t = 0.0f;
+		u32 primitiveIndex = 0;
+		bool frontFace;
+		// width of the ray cone where it hit, what textures pick their mip level from, 0 samples the finest level
+		// the integrator sets it in world units before FinalizeHit and primitives with UVs turn it into UV units
+		f32 footprint = 0.0f;
 
 		OWC_FORCE_INLINE void SetFaceNormal(const Ray& ray, const Vec3& outwardNormal)
 		{
@@ -33,231 +42,17 @@ namespace OWC
 			normal = frontFace ? outwardNormal : -outwardNormal;
 		}
 
-#if AVX512
-		HitData() noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m512i zero = _mm512_setzero_si512();
-			_mm512_store_si512(this, zero);
-		}
-
-		~HitData()
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-			
-			__m512i zero = _mm512_setzero_si512();
-			_mm512_store_si512(this, zero);
-		}
-
-		HitData(const HitData& other) noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m512i data1 = _mm512_load_si512(&other);
-			_mm512_store_si512(this, data1);
-		}
-
-		HitData(const HitData&& old) noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m512i data1 = _mm512_load_si512(&old);
-			_mm512_store_si512(this, data1);
-		}
-
-		OWC_FORCE_INLINE HitData& operator=(const HitData& other) noexcept
-		{
-			// VA_IGNORE: self-assignment is safe for fixed-size aligned copy
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m512i data1 = _mm512_load_si512(&other);
-			_mm512_store_si512(this, data1);
-			return *this;
-		}
-
-		HitData& operator=(const HitData&& old) noexcept
+		OWC_FORCE_INLINE void Record(const BaseHitable* hitObject, f32 hitT, u32 hitPrimitiveIndex = 0, const BaseHitable* hitInstance = nullptr)
 		{
-			// VA_IGNORE: self-assignment is safe for fixed-size aligned move
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m512i data1 = _mm512_load_si512(&old);
-			_mm512_store_si512(this, data1);
-
-			return *this;
-		}
-
-#elif AVX2
-		HitData() noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m256i zero = _mm256_setzero_si256();
-			_mm256_store_si256(std::bit_cast<__m256i*>(this), zero);
-			_mm256_store_si256(std::bit_cast<__m256i*>(std::bit_cast<u8*>(this) + 32), zero);
+			object = hitObject;
+			instance = hitInstance;
+			t = hitT;
+			primitiveIndex = hitPrimitiveIndex;
 		}
-
-		~HitData() noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m256i zero = _mm256_setzero_si256();
-			_mm256_store_si256(std::bit_cast<__m256i*>(this), zero);
-			_mm256_store_si256(std::bit_cast<__m256i*>(std::bit_cast<u8*>(this) + 32), zero);
-		}
-
-		HitData(const HitData& other) noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m256i data1 = _mm256_load_si256(std::bit_cast<__m256i*>(&other));
-			_mm256_store_si256(std::bit_cast<__m256i*>(this), data1);
-
-			__m256i data2 = _mm256_load_si256(std::bit_cast<const __m256i*>(std::bit_cast<const u8*>(&other) + 32));
-			_mm256_store_si256(std::bit_cast<__m256i*>(std::bit_cast<u8*>(this) + 32), data2);
-		}
-
-		HitData(const HitData&& old) noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m256i data1 = _mm256_load_si256(std::bit_cast<__m256i*>(&old));
-			_mm256_store_si256(std::bit_cast<__m256i*>(this), data1);
-
-			__m256i data2 = _mm256_load_si256(std::bit_cast<const __m256i*>(std::bit_cast<const u8*>(&old) + 32));
-			_mm256_store_si256(std::bit_cast<__m256i*>(std::bit_cast<u8*>(this) + 32), data2);
-		}
-
-		HitData& operator=(const HitData& other) noexcept
-		{
-			// VA_IGNORE: self-assignment is safe for fixed-size aligned copy
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m256i data1 = _mm256_load_si256(std::bit_cast<__m256i*>(&other));
-			_mm256_store_si256(std::bit_cast<__m256i*>(this), data1);
-
-			__m256i data2 = _mm256_load_si256(std::bit_cast<const __m256i*>(std::bit_cast<const u8*>(&other) + 32));
-			_mm256_store_si256(std::bit_cast<__m256i*>(std::bit_cast<u8*>(this) + 32), data2);
-
-			return *this;
-		}
-
-		HitData& operator=(const HitData&& old) noexcept
-		{
-			// VA_IGNORE: self-assignment is safe for fixed-size aligned move
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m256i data1 = _mm256_load_si256(std::bit_cast<__m256i*>(&old));
-			_mm256_store_si256(std::bit_cast<__m256i*>(this), data1);
-
-			__m256i data2 = _mm256_load_si256(std::bit_cast<const __m256i*>(std::bit_cast<const u8*>(&old) + 32));
-			_mm256_store_si256(std::bit_cast<__m256i*>(std::bit_cast<u8*>(this) + 32), data2);
-
-			return *this;
-		}
-#else // SSE4.2
-		HitData() noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m128i zero = _mm_setzero_si128();
-			_mm_store_si128(std::bit_cast<__m128i*>(this), zero);
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 16), zero);
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 32), zero);
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 48), zero);
-		}
-
-		~HitData() noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m128i zero = _mm_setzero_si128();
-			_mm_store_si128(std::bit_cast<__m128i*>(this), zero);
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 16), zero);
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 32), zero);
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 48), zero);
-		}
-
-		HitData(const HitData& other) noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m128i data1 = _mm_load_si128(std::bit_cast<const __m128i*>(&other));
-			_mm_store_si128(std::bit_cast<__m128i*>(this), data1);
-			__m128i data2 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&other) + 16));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 16), data2);
-			__m128i data3 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&other) + 32));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 32), data3);
-			__m128i data4 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&other) + 48));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 48), data4);
-		}
-
-		HitData(const HitData&& old) noexcept
-		{
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m128i data1 = _mm_load_si128(std::bit_cast<const __m128i*>(&old));
-			_mm_store_si128(std::bit_cast<__m128i*>(this), data1);
-			__m128i data2 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&old) + 16));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 16), data2);
-			__m128i data3 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&old) + 32));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 32), data3);
-			__m128i data4 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&old) + 48));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 48), data4);
-		}
-
-		HitData& operator=(const HitData& other) noexcept
-		{
-			// VA_IGNORE: self-assignment is safe for fixed-size aligned copy
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m128i data1 = _mm_load_si128(std::bit_cast<const __m128i*>(&other));
-			_mm_store_si128(std::bit_cast<__m128i*>(this), data1);
-			__m128i data2 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&other) + 16));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 16), data2);
-			__m128i data3 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&other) + 32));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 32), data3);
-			__m128i data4 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&other) + 48));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 48), data4);
-			return *this;
-		}
-
-		HitData& operator=(const HitData&& old) noexcept
-		{
-			// VA_IGNORE: self-assignment is safe for fixed-size aligned move
-			static_assert(sizeof(HitData) == 64, "HitData size is not 64 bytes!");
-			static_assert(alignof(HitData) == 64, "HitData alignment is not 64 bytes!");
-
-			__m128i data1 = _mm_load_si128(std::bit_cast<const __m128i*>(&old));
-			_mm_store_si128(std::bit_cast<__m128i*>(this), data1);
-			__m128i data2 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&old) + 16));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 16), data2);
-			__m128i data3 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&old) + 32));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 32), data3);
-			__m128i data4 = _mm_load_si128(std::bit_cast<const __m128i*>(std::bit_cast<const u8*>(&old) + 48));
-			_mm_store_si128(std::bit_cast<__m128i*>(std::bit_cast<u8*>(this) + 48), data4);
-			return *this;
-		}
-#endif // AVX512, AVX2, SSE4.2
 	};
 
+	static_assert(sizeof(HitData) == 80, "HitData size is not 80 bytes!");
+
 	class BaseHitable
 	{
 	public:
@@ -269,9 +64,26 @@ namespace OWC
 		BaseHitable(BaseHitable&&) = delete;
 		BaseHitable& operator=(BaseHitable&&) = delete;
 
+		// shrinks range to the closest hit and records it in hitData, nothing else in hitData is filled in until FinalizeHit
 		virtual bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const = 0;
+		// fills in the point, normal, UV and material of a hit this object recorded, called once per ray on the closest hit only
+		// aggregates record the primitive that was hit rather than themselves so only primitives need to override it
+		virtual void __vectorcall FinalizeHit(const Ray& /*ray*/, HitData& /*hitData*/) const {}
+		// finalizes the closest hit of a trace, through the instance it was found in if there is one
+		static OWC_FORCE_INLINE void __vectorcall FinalizeClosestHit(const Ray& ray, HitData& hitData)
+		{
+			const BaseHitable* finalizer = hitData.instance != nullptr ? hitData.instance : hitData.object;
+			finalizer->FinalizeHit(ray, hitData);
+		}
+		// closest hit for the lanes of a packet in laneMask, shrinks their TMax and records the primitive hit, returns the lanes that hit
+		// the default traces the lanes one at a time through IsHit
+		virtual u32 __vectorcall IsHitPacket(RayPacket& packet, u32 laneMask) const;
+		// any hit query, returns as soon as anything is hit within range without working out which hit is closest or any shading data
+		virtual bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const = 0;
 
 		virtual AABB GetAABB() const = 0;
+		// infinite objects have AABB::Univers as their bounds, a BVH keeps them out of its tree and tests them on every ray instead
+		virtual bool IsUnbounded() const { return false; }
 
 		virtual Colour BackgroundColour(const Ray& ray) const
 		{
@@ -296,6 +108,11 @@ namespace OWC
 			return false;
 		}
 
+		bool __vectorcall IsOccluded(const Ray&, const Interval&) const override
+		{
+			return false;
+		}
+
 		AABB GetAABB() const override
 		{
 			return AABB::Empty;
@@ -1,6 +1,8 @@
 ﻿#include "Core.hpp"
 #include "Hittables.hpp"
 
+#include <algorithm>
+
 
 namespace OWC
 {
@@ -51,4 +53,19 @@ namespace OWC
 
 		return hasAnyHit;
 	}
+
+	bool __vectorcall Hitables::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		return std::ranges::any_of(m_Hitables, [&ray, &range](const auto& hittable) { return hittable->IsOccluded(ray, range); });
+	}
+
+	u32 __vectorcall Hitables::IsHitPacket(RayPacket& packet, u32 laneMask) const
+	{
+		u32 hitMask = 0;
+
+		for (const auto& hittable : m_Hitables)
+			hitMask |= hittable->IsHitPacket(packet, laneMask);
+
+		return hitMask;
+	}
 }
\ No newline at end of file
@@ -27,6 +27,8 @@ namespace OWC
 		OWC_FORCE_INLINE const std::function<Colour(const Ray& ray)>& GetBackgroundFunction() const { return m_BackgroundFunction; }
 
 		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+		u32 __vectorcall IsHitPacket(RayPacket& packet, u32 laneMask) const override;
 
 		AABB GetAABB() const override { return m_AABB; }
 
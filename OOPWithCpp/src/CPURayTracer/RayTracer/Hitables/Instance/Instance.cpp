@@ -0,0 +1,121 @@
+﻿#include "Instance.hpp"
+
+#include <array>
+#include <bit>
+#include <limits>
+
+
+namespace OWC
+{
+	Instance::Instance(const std::shared_ptr<const BaseHitable>& object, const Mat4& objectToWorld)
+		: Instance(*object, objectToWorld)
+	{
+		m_ObjectOwner = object;
+	}
+
+	Instance::Instance(const BaseHitable& object, const Mat4& objectToWorld)
+		: m_Object(&object)
+	{
+		SetTransform(objectToWorld);
+	}
+
+	void Instance::SetTransform(const Mat4& objectToWorld)
+	{
+		Mat3 linear(objectToWorld);
+		Vec3 translation(objectToWorld[3]);
+
+		m_WorldToObject = glm::inverse(linear);
+		m_WorldToObjectTranslation = -(m_WorldToObject * translation);
+
+		// the corners of an unbounded object are at infinity and do not transform to anything useful
+		if (m_Object->IsUnbounded())
+		{
+			m_AABB = AABB::Univers;
+			return;
+		}
+
+		// the world bounds are the bounds of the object's transformed corners
+		AABB objectAABB = m_Object->GetAABB();
+		const Interval& x = objectAABB.GetAxisInterval(AABB::Axis::x);
+		const Interval& y = objectAABB.GetAxisInterval(AABB::Axis::y);
+		const Interval& z = objectAABB.GetAxisInterval(AABB::Axis::z);
+
+		Point worldMin(std::numeric_limits<f32>::max());
+		Point worldMax(-std::numeric_limits<f32>::max());
+		for (u32 corner = 0; corner != 8; corner++)
+		{
+			Point objectCorner((corner & 1) != 0 ? x.GetMax() : x.GetMin(), (corner & 2) != 0 ? y.GetMax() : y.GetMin(), (corner & 4) != 0 ? z.GetMax() : z.GetMin());
+			Point worldCorner = linear * objectCorner + translation;
+			worldMin = glm::min(worldMin, worldCorner);
+			worldMax = glm::max(worldMax, worldCorner);
+		}
+		m_AABB = AABB(worldMin, worldMax);
+	}
+
+	bool __vectorcall Instance::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		f32 scale;
+		Ray objectRay = ToObjectSpace(ray, scale);
+		Interval objectRange(range.GetMin() * scale, range.GetMax() * scale);
+		if (!m_Object->IsHit(objectRay, objectRange, hitData))
+			return false;
+
+		range.SetMax(objectRange.GetMax() / scale);
+		hitData.t = range.GetMax();
+		hitData.instance = this;
+		return true;
+	}
+
+	u32 __vectorcall Instance::IsHitPacket(RayPacket& packet, u32 laneMask) const
+	{
+		if (laneMask == 0)
+			return 0;
+
+		// lanes outside laneMask are filled with the first lane in it so the object's SIMD tests never work on garbage
+		auto firstLane = static_cast<uSize>(std::countr_zero(laneMask));
+		RayPacket objectPacket;
+		RayPacket::Lanes scales;
+		for (uSize lane = 0; lane != RayPacketWidth; lane++)
+		{
+			uSize sourceLane = (laneMask & (1u << lane)) != 0 ? lane : firstLane;
+			Ray objectRay = ToObjectSpace(packet.GetRay(sourceLane), scales[lane]);
+			objectPacket.SetRay(lane, objectRay, Interval(packet.TMin[sourceLane] * scales[lane], packet.TMax[sourceLane] * scales[lane]));
+		}
+		objectPacket.ActiveMask = laneMask;
+
+		u32 hitMask = m_Object->IsHitPacket(objectPacket, laneMask);
+		for (u32 lanes = hitMask; lanes != 0; lanes &= lanes - 1)
+		{
+			auto lane = static_cast<uSize>(std::countr_zero(lanes));
+			packet.TMax[lane] = objectPacket.TMax[lane] / scales[lane];
+			packet.HitObjects[lane] = objectPacket.HitObjects[lane];
+			packet.HitPrimitives[lane] = objectPacket.HitPrimitives[lane];
+			packet.HitInstances[lane] = this;
+		}
+
+		return hitMask;
+	}
+
+	bool __vectorcall Instance::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		f32 scale;
+		Ray objectRay = ToObjectSpace(ray, scale);
+		return m_Object->IsOccluded(objectRay, Interval(range.GetMin() * scale, range.GetMax() * scale));
+	}
+
+	void __vectorcall Instance::FinalizeHit(const Ray& ray, HitData& hitData) const
+	{
+		f32 scale;
+		Ray objectRay = ToObjectSpace(ray, scale);
+
+		f32 worldT = hitData.t;
+		hitData.t = worldT * scale;
+		hitData.footprint *= scale;
+		hitData.object->FinalizeHit(objectRay, hitData);
+		hitData.t = worldT;
+
+		// an affine transform keeps which side of the surface the ray is on so the face normal only needs moving, not flipping again
+		hitData.point = ray.GetPointAtDistance(worldT);
+		hitData.normal = glm::normalize(glm::transpose(m_WorldToObject) * hitData.normal);
+	}
+}
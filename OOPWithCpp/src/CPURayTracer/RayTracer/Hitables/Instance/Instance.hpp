@@ -0,0 +1,69 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+#include "Ray.hpp"
+#include "AABB.hpp"
+
+#include <memory>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// One placement of a shared object, usually the SplitBVH of a block of primitives, under an affine transform.
+	// A SplitBVH over instances is the top level of a two level BVH, the bottom level is built once and every instance
+	// only holds a pointer to it and its transform so moving instances only means rebuilding the top level over their bounds.
+	// Rays are moved into object space instead of the object into world space, instances of instances are not supported
+	class Instance : public BaseHitable
+	{
+	public:
+		Instance() = delete;
+		Instance(const std::shared_ptr<const BaseHitable>& object, const Mat4& objectToWorld);
+		// does not own the object, which has to outlive the instance, for instances in a SceneArena that the object itself keeps alive
+		Instance(const BaseHitable& object, const Mat4& objectToWorld);
+		~Instance() override = default;
+
+		Instance(const Instance&) = delete;
+		Instance& operator=(const Instance&) = delete;
+		Instance(Instance&&) = delete;
+		Instance& operator=(Instance&&) = delete;
+
+		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		// moves the lanes in laneMask into object space as one packet so the object's own packet traversal is used
+		u32 __vectorcall IsHitPacket(RayPacket& packet, u32 laneMask) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+		// hitData.object is the primitive of the object that was hit, it is finalized in object space and the result moved back to world space
+		void __vectorcall FinalizeHit(const Ray& ray, HitData& hitData) const override;
+
+		AABB GetAABB() const override { return m_AABB; }
+		bool IsUnbounded() const override { return m_Object->IsUnbounded(); }
+
+		// only the last 3 rows of the transform are used, the BVH the instance is in has to be rebuilt before the next trace
+		void SetTransform(const Mat4& objectToWorld);
+		OWC_FORCE_INLINE const BaseHitable& GetObject() const { return *m_Object; }
+
+	private:
+		// the object space ray has a normalized direction like every other ray so distances along it are scale times those along the world ray
+		OWC_FORCE_INLINE Ray __vectorcall ToObjectSpace(const Ray& ray, f32& scale) const
+		{
+			Vec3 direction = m_WorldToObject * ray.GetDirection();
+			scale = glm::length(direction);
+
+			Ray objectRay;
+			objectRay.SetOrigin(m_WorldToObject * ray.GetOrigin() + m_WorldToObjectTranslation);
+			objectRay.SetNormalizedDirection(direction / scale);
+			return objectRay;
+		}
+
+	private:
+		const BaseHitable* m_Object;
+		std::shared_ptr<const BaseHitable> m_ObjectOwner; // empty when something else owns the object
+		Mat3 m_WorldToObject{ 1.0f }; // linear part, its transpose moves normals back to world space
+		Vec3 m_WorldToObjectTranslation{ 0.0f };
+		AABB m_AABB = AABB::Empty;
+	};
+}
+
+#pragma warning(pop)
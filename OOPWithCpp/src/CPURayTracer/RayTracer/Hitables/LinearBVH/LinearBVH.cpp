@@ -0,0 +1,998 @@
+﻿#include "LinearBVH.hpp"
+
+#include <bit>
+#include <cmath>
+#include <limits>
+
+
+namespace OWC
+{
+	namespace
+	{
+		OWC_FORCE_INLINE f32 SurfaceArea(const std::array<f32, 6>& bounds)
+		{
+			Vec3 size(bounds[1] - bounds[0], bounds[3] - bounds[2], bounds[5] - bounds[4]);
+			return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+		}
+
+		// a BVH under an Instance is walked from inside a primitive test of the BVH above it,
+		// only the outermost walk on a thread counts as a ray, every level still counts its nodes and primitives
+		thread_local u32 s_TraversalDepth = 0;
+
+		class TraversalDepthScope
+		{
+		public:
+			OWC_FORCE_INLINE TraversalDepthScope() : m_IsOutermost(s_TraversalDepth++ == 0) {}
+			OWC_FORCE_INLINE ~TraversalDepthScope() { s_TraversalDepth--; }
+
+			TraversalDepthScope(const TraversalDepthScope&) = delete;
+			TraversalDepthScope& operator=(const TraversalDepthScope&) = delete;
+			TraversalDepthScope(TraversalDepthScope&&) = delete;
+			TraversalDepthScope& operator=(TraversalDepthScope&&) = delete;
+
+			OWC_FORCE_INLINE bool IsOutermost() const { return m_IsOutermost; }
+
+		private:
+			bool m_IsOutermost;
+		};
+	}
+
+	LinearBVH::LinearBVH(BVHNodeArray&& nodes, std::vector<std::shared_ptr<BaseHitable>>&& primitives, bool useQuantizedNodes)
+		: m_Nodes(std::move(nodes)), m_Primitives(std::move(primitives)), m_UseQuantizedNodes(useQuantizedNodes)
+	{
+		if (!m_Nodes.empty())
+			m_RootBounds = m_Nodes[0].Bounds;
+
+		BuildWideTree();
+	}
+
+	bool __vectorcall LinearBVH::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		if (m_Nodes.empty())
+			return false;
+
+		TraversalDepthScope traversalDepth;
+
+		std::array<u32, MaxDepth> nodeStack;
+		uSize stackSize = 0;
+		u32 nodeIndex = 0;
+		bool hasHit = false;
+
+		// children are split along SplitAxis with the lower half first, a ray heading down that axis visits the second child first
+		// indexed by AABB::Axis, none never swaps
+		const Vec3& direction = ray.GetDirection();
+		const std::array<bool, 4> isDirectionNegative = { direction.x < 0.0f, direction.y < 0.0f, direction.z < 0.0f, false };
+
+		// counted in registers and written to the thread's stats once at the end
+		u64 numberOfNodesVisited = 0;
+		u64 numberOfPrimitiveTests = 0;
+		u64 numberOfCandidateHits = 0;
+
+		while (true)
+		{
+			const BVHNode& node = m_Nodes[nodeIndex];
+			numberOfNodesVisited++;
+			if (node.IsHit(ray, range))
+			{
+				if (!node.IsLeaf())
+				{
+					u32 nearChild = nodeIndex + 1;
+					u32 farChild = node.Offset;
+					if (isDirectionNegative[+node.SplitAxis])
+						std::swap(nearChild, farChild);
+
+					// the far child is tested again once popped, by then range may have shrunk past it
+					nodeStack[stackSize++] = farChild;
+					nodeIndex = nearChild;
+					continue;
+				}
+
+				for (u32 i = node.Offset; i != node.Offset + node.NumberOfPrimitives; i++)
+				{
+					bool isPrimitiveHit = m_Primitives.IsHit(i, ray, range, hitData);
+					hasHit |= isPrimitiveHit;
+					numberOfCandidateHits += isPrimitiveHit;
+				}
+				numberOfPrimitiveTests += node.NumberOfPrimitives;
+			}
+
+			if (stackSize == 0)
+				break;
+
+			nodeIndex = nodeStack[--stackSize];
+		}
+
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		traversalStats.NumberOfTraversals += traversalDepth.IsOutermost();
+		traversalStats.NumberOfNodesVisited += numberOfNodesVisited;
+		traversalStats.NumberOfPrimitiveTests += numberOfPrimitiveTests;
+		traversalStats.NumberOfCandidateHits += numberOfCandidateHits;
+		traversalStats.NumberOfClosestHits += traversalDepth.IsOutermost() && hasHit;
+
+		return hasHit;
+	}
+
+	bool __vectorcall LinearBVH::IsHitWide(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		if (m_WideNodes.empty())
+			return false;
+
+		TraversalDepthScope traversalDepth;
+
+		// an entry is skipped when popped if the closest hit found since it was pushed is nearer than the child's entry distance
+		struct StackEntry
+		{
+			u32 NodeIndex;
+			f32 EntryDistance;
+		};
+
+		// every node pushes at most all but one of its children per level
+		std::array<StackEntry, MaxDepth * WideBVHWidth> nodeStack;
+		uSize stackSize = 0;
+		u32 nodeIndex = 0;
+		bool hasHit = false;
+
+		const WideBVHRay wideRay(ray);
+		alignas(64) WideBVHNode::ChildDistances childDistances;
+		std::array<u32, WideBVHWidth> orderedChildren;
+
+		u64 numberOfNodesVisited = 0;
+		u64 numberOfPrimitiveTests = 0;
+		u64 numberOfCandidateHits = 0;
+
+		while (true)
+		{
+			const WideBVHNode& node = m_WideNodes[nodeIndex];
+			numberOfNodesVisited++;
+
+			// insertion sort of the children hit by entry distance, nearest first, there are at most WideBVHWidth of them and usually one or two
+			u32 hitMask = node.IntersectChildren(wideRay, range.GetMin(), range.GetMax(), childDistances);
+			uSize numberOfChildrenHit = 0;
+			while (hitMask != 0)
+			{
+				u32 child = static_cast<u32>(std::countr_zero(hitMask));
+				hitMask &= hitMask - 1;
+
+				uSize insertIndex = numberOfChildrenHit++;
+				for (; insertIndex != 0 && childDistances[orderedChildren[insertIndex - 1]] > childDistances[child]; insertIndex--)
+					orderedChildren[insertIndex] = orderedChildren[insertIndex - 1];
+				orderedChildren[insertIndex] = child;
+			}
+
+			// leaves are tested straight away front to back so their hits can cull the children behind them before those are pushed
+			uSize numberOfInteriorChildren = 0;
+			for (uSize i = 0; i != numberOfChildrenHit; i++)
+			{
+				u32 child = orderedChildren[i];
+				if (childDistances[child] >= range.GetMax())
+					break;
+
+				if (!node.IsLeafChild(child))
+				{
+					orderedChildren[numberOfInteriorChildren++] = child;
+					continue;
+				}
+
+				u32 firstPrimitive = node.Offsets[child];
+				for (u32 j = firstPrimitive; j != firstPrimitive + node.NumberOfPrimitives[child]; j++)
+				{
+					bool isPrimitiveHit = m_Primitives.IsHit(j, ray, range, hitData);
+					hasHit |= isPrimitiveHit;
+					numberOfCandidateHits += isPrimitiveHit;
+				}
+				numberOfPrimitiveTests += node.NumberOfPrimitives[child];
+			}
+
+			// pushed farthest first so the nearest child is visited next
+			while (numberOfInteriorChildren != 0)
+			{
+				u32 child = orderedChildren[--numberOfInteriorChildren];
+				if (childDistances[child] < range.GetMax())
+					nodeStack[stackSize++] = { node.Offsets[child], childDistances[child] };
+			}
+
+			while (stackSize != 0 && nodeStack[stackSize - 1].EntryDistance >= range.GetMax())
+				stackSize--;
+
+			if (stackSize == 0)
+				break;
+
+			nodeIndex = nodeStack[--stackSize].NodeIndex;
+		}
+
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		traversalStats.NumberOfTraversals += traversalDepth.IsOutermost();
+		traversalStats.NumberOfNodesVisited += numberOfNodesVisited;
+		traversalStats.NumberOfPrimitiveTests += numberOfPrimitiveTests;
+		traversalStats.NumberOfCandidateHits += numberOfCandidateHits;
+		traversalStats.NumberOfClosestHits += traversalDepth.IsOutermost() && hasHit;
+
+		return hasHit;
+	}
+
+	bool __vectorcall LinearBVH::IsHitQuantized(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		// IsHitWide over the quantized nodes, the primitives of the leaf children follow each other in m_Primitives from PrimitiveBaseIndex
+		if (m_QuantizedNodes.empty())
+			return false;
+
+		TraversalDepthScope traversalDepth;
+
+		struct StackEntry
+		{
+			u32 NodeIndex;
+			f32 EntryDistance;
+		};
+
+		std::array<StackEntry, MaxDepth * WideBVHWidth> nodeStack;
+		uSize stackSize = 0;
+		u32 nodeIndex = 0;
+		bool hasHit = false;
+
+		const WideBVHRay wideRay(ray);
+		alignas(64) QuantizedWideBVHNode::ChildDistances childDistances;
+		std::array<u32, WideBVHWidth> orderedChildren;
+
+		u64 numberOfNodesVisited = 0;
+		u64 numberOfPrimitiveTests = 0;
+		u64 numberOfCandidateHits = 0;
+
+		while (true)
+		{
+			const QuantizedWideBVHNode& node = m_QuantizedNodes[nodeIndex];
+			numberOfNodesVisited++;
+
+			u32 hitMask = node.IntersectChildren(wideRay, range.GetMin(), range.GetMax(), childDistances);
+			uSize numberOfChildrenHit = 0;
+			while (hitMask != 0)
+			{
+				u32 child = static_cast<u32>(std::countr_zero(hitMask));
+				hitMask &= hitMask - 1;
+
+				uSize insertIndex = numberOfChildrenHit++;
+				for (; insertIndex != 0 && childDistances[orderedChildren[insertIndex - 1]] > childDistances[child]; insertIndex--)
+					orderedChildren[insertIndex] = orderedChildren[insertIndex - 1];
+				orderedChildren[insertIndex] = child;
+			}
+
+			uSize numberOfInteriorChildren = 0;
+			for (uSize i = 0; i != numberOfChildrenHit; i++)
+			{
+				u32 child = orderedChildren[i];
+				if (childDistances[child] >= range.GetMax())
+					break;
+
+				if (!node.IsLeafChild(child))
+				{
+					orderedChildren[numberOfInteriorChildren++] = child;
+					continue;
+				}
+
+				u32 firstPrimitive = node.PrimitiveBaseIndex + node.ChildOffsets[child];
+				for (u32 j = firstPrimitive; j != firstPrimitive + node.NumberOfPrimitives[child]; j++)
+				{
+					bool isPrimitiveHit = m_Primitives.IsHit(j, ray, range, hitData);
+					hasHit |= isPrimitiveHit;
+					numberOfCandidateHits += isPrimitiveHit;
+				}
+				numberOfPrimitiveTests += node.NumberOfPrimitives[child];
+			}
+
+			while (numberOfInteriorChildren != 0)
+			{
+				u32 child = orderedChildren[--numberOfInteriorChildren];
+				if (childDistances[child] < range.GetMax())
+					nodeStack[stackSize++] = { node.ChildBaseIndex + node.ChildOffsets[child], childDistances[child] };
+			}
+
+			while (stackSize != 0 && nodeStack[stackSize - 1].EntryDistance >= range.GetMax())
+				stackSize--;
+
+			if (stackSize == 0)
+				break;
+
+			nodeIndex = nodeStack[--stackSize].NodeIndex;
+		}
+
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		traversalStats.NumberOfTraversals += traversalDepth.IsOutermost();
+		traversalStats.NumberOfNodesVisited += numberOfNodesVisited;
+		traversalStats.NumberOfPrimitiveTests += numberOfPrimitiveTests;
+		traversalStats.NumberOfCandidateHits += numberOfCandidateHits;
+		traversalStats.NumberOfClosestHits += traversalDepth.IsOutermost() && hasHit;
+
+		return hasHit;
+	}
+
+	u32 __vectorcall LinearBVH::IsHitPacket(RayPacket& packet, u32 laneMask) const
+	{
+		if (HasQuantizedNodes())
+			return IsHitPacketQuantized(packet, laneMask);
+
+		if (m_Nodes.empty() || laneMask == 0)
+			return 0;
+
+		TraversalDepthScope traversalDepth;
+
+		// the lanes still hitting a node are carried down with it so its children only test those
+		struct StackEntry
+		{
+			u32 NodeIndex;
+			u32 LaneMask;
+		};
+
+		std::array<StackEntry, MaxDepth> nodeStack;
+		uSize stackSize = 0;
+		StackEntry entry = { 0, laneMask };
+		u32 hitMask = 0;
+
+		// a node is counted once for the whole packet, so nodes per ray shows how much the packet shares
+		u64 numberOfNodesVisited = 0;
+		u64 numberOfPrimitiveTests = 0;
+		u64 numberOfCandidateHits = 0;
+
+		while (true)
+		{
+			const BVHNode& node = m_Nodes[entry.NodeIndex];
+			numberOfNodesVisited++;
+
+			// rays popped later are tested again against their shrunk TMax
+			u32 nodeLaneMask = packet.IntersectAABB(node.Bounds.data(), entry.LaneMask);
+			if (nodeLaneMask != 0)
+			{
+				if (!node.IsLeaf())
+				{
+					// primary rays are coherent so the first ray's direction orders the children for the whole packet
+					u32 nearChild = entry.NodeIndex + 1;
+					u32 farChild = node.Offset;
+					auto firstLane = static_cast<uSize>(std::countr_zero(nodeLaneMask));
+					if (node.SplitAxis != AABB::Axis::none && packet.Direction[+node.SplitAxis][firstLane] < 0.0f)
+						std::swap(nearChild, farChild);
+
+					nodeStack[stackSize++] = { farChild, nodeLaneMask };
+					entry = { nearChild, nodeLaneMask };
+					continue;
+				}
+
+				for (u32 i = node.Offset; i != node.Offset + node.NumberOfPrimitives; i++)
+				{
+					u32 primitiveHitMask = m_Primitives.IsHitPacket(i, packet, nodeLaneMask);
+					hitMask |= primitiveHitMask;
+					numberOfCandidateHits += static_cast<u64>(std::popcount(primitiveHitMask));
+				}
+				numberOfPrimitiveTests += static_cast<u64>(node.NumberOfPrimitives) * static_cast<u64>(std::popcount(nodeLaneMask));
+			}
+
+			if (stackSize == 0)
+				break;
+
+			entry = nodeStack[--stackSize];
+		}
+
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		traversalStats.NumberOfTraversals += traversalDepth.IsOutermost() ? static_cast<u64>(std::popcount(laneMask)) : 0;
+		traversalStats.NumberOfNodesVisited += numberOfNodesVisited;
+		traversalStats.NumberOfPrimitiveTests += numberOfPrimitiveTests;
+		traversalStats.NumberOfCandidateHits += numberOfCandidateHits;
+		traversalStats.NumberOfClosestHits += traversalDepth.IsOutermost() ? static_cast<u64>(std::popcount(hitMask)) : 0;
+
+		return hitMask;
+	}
+
+	u32 __vectorcall LinearBVH::IsHitPacketQuantized(RayPacket& packet, u32 laneMask) const
+	{
+		// IsHitPacket over the quantized nodes, every child box is decoded and tested against the packet on its own
+		if (laneMask == 0)
+			return 0;
+
+		TraversalDepthScope traversalDepth;
+
+		struct StackEntry
+		{
+			u32 NodeIndex;
+			u32 LaneMask;
+		};
+
+		std::array<StackEntry, MaxDepth * WideBVHWidth> nodeStack;
+		uSize stackSize = 0;
+		StackEntry entry = { 0, laneMask };
+		u32 hitMask = 0;
+
+		std::array<StackEntry, WideBVHWidth> interiorChildren;
+		std::array<f32, WideBVHWidth> interiorChildDistances;
+
+		u64 numberOfNodesVisited = 0;
+		u64 numberOfPrimitiveTests = 0;
+		u64 numberOfCandidateHits = 0;
+
+		while (true)
+		{
+			const QuantizedWideBVHNode& node = m_QuantizedNodes[entry.NodeIndex];
+			numberOfNodesVisited++;
+
+			// primary rays are coherent so the first ray orders the children for the whole packet, by how far along it their centres are
+			auto firstLane = static_cast<uSize>(std::countr_zero(entry.LaneMask));
+			const Vec3 firstOrigin(packet.Origin[0][firstLane], packet.Origin[1][firstLane], packet.Origin[2][firstLane]);
+			const Vec3 firstDirection(packet.Direction[0][firstLane], packet.Direction[1][firstLane], packet.Direction[2][firstLane]);
+
+			uSize numberOfInteriorChildren = 0;
+			for (u32 childMask = node.ChildMask; childMask != 0; childMask &= childMask - 1)
+			{
+				auto child = static_cast<uSize>(std::countr_zero(childMask));
+				const std::array<f32, 6> childBounds = node.GetChildBounds(child);
+
+				// rays popped later are tested again against their shrunk TMax
+				u32 childLaneMask = packet.IntersectAABB(childBounds.data(), entry.LaneMask);
+				if (childLaneMask == 0)
+					continue;
+
+				if (!node.IsLeafChild(child))
+				{
+					const Vec3 centre(childBounds[0] + childBounds[1], childBounds[2] + childBounds[3], childBounds[4] + childBounds[5]);
+					f32 distance = glm::dot(0.5f * centre - firstOrigin, firstDirection);
+
+					uSize insertIndex = numberOfInteriorChildren++;
+					for (; insertIndex != 0 && interiorChildDistances[insertIndex - 1] > distance; insertIndex--)
+					{
+						interiorChildren[insertIndex] = interiorChildren[insertIndex - 1];
+						interiorChildDistances[insertIndex] = interiorChildDistances[insertIndex - 1];
+					}
+					interiorChildren[insertIndex] = { node.ChildBaseIndex + node.ChildOffsets[child], childLaneMask };
+					interiorChildDistances[insertIndex] = distance;
+					continue;
+				}
+
+				u32 firstPrimitive = node.PrimitiveBaseIndex + node.ChildOffsets[child];
+				for (u32 i = firstPrimitive; i != firstPrimitive + node.NumberOfPrimitives[child]; i++)
+				{
+					u32 primitiveHitMask = m_Primitives.IsHitPacket(i, packet, childLaneMask);
+					hitMask |= primitiveHitMask;
+					numberOfCandidateHits += static_cast<u64>(std::popcount(primitiveHitMask));
+				}
+				numberOfPrimitiveTests += static_cast<u64>(node.NumberOfPrimitives[child]) * static_cast<u64>(std::popcount(childLaneMask));
+			}
+
+			// far to near so the nearest is popped first
+			while (numberOfInteriorChildren != 0)
+				nodeStack[stackSize++] = interiorChildren[--numberOfInteriorChildren];
+
+			if (stackSize == 0)
+				break;
+
+			entry = nodeStack[--stackSize];
+		}
+
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		traversalStats.NumberOfTraversals += traversalDepth.IsOutermost() ? static_cast<u64>(std::popcount(laneMask)) : 0;
+		traversalStats.NumberOfNodesVisited += numberOfNodesVisited;
+		traversalStats.NumberOfPrimitiveTests += numberOfPrimitiveTests;
+		traversalStats.NumberOfCandidateHits += numberOfCandidateHits;
+		traversalStats.NumberOfClosestHits += traversalDepth.IsOutermost() ? static_cast<u64>(std::popcount(hitMask)) : 0;
+
+		return hitMask;
+	}
+
+	bool __vectorcall LinearBVH::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		if (m_Nodes.empty())
+			return false;
+
+		TraversalDepthScope traversalDepth;
+
+		std::array<u32, MaxDepth> nodeStack;
+		uSize stackSize = 0;
+		u32 nodeIndex = 0;
+		bool isOccluded = false;
+
+		u64 numberOfNodesVisited = 0;
+		u64 numberOfPrimitiveTests = 0;
+
+		while (true)
+		{
+			const BVHNode& node = m_Nodes[nodeIndex];
+			numberOfNodesVisited++;
+			if (node.IsHit(ray, range))
+			{
+				if (!node.IsLeaf())
+				{
+					nodeStack[stackSize++] = node.Offset;
+					nodeIndex++;
+					continue;
+				}
+
+				for (u32 i = node.Offset; i != node.Offset + node.NumberOfPrimitives && !isOccluded; i++)
+				{
+					isOccluded = m_Primitives.IsOccluded(i, ray, range);
+					numberOfPrimitiveTests++;
+				}
+
+				if (isOccluded)
+					break;
+			}
+
+			if (stackSize == 0)
+				break;
+
+			nodeIndex = nodeStack[--stackSize];
+		}
+
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		traversalStats.NumberOfTraversals += traversalDepth.IsOutermost();
+		traversalStats.NumberOfNodesVisited += numberOfNodesVisited;
+		traversalStats.NumberOfPrimitiveTests += numberOfPrimitiveTests;
+
+		return isOccluded;
+	}
+
+	bool __vectorcall LinearBVH::IsOccludedWide(const Ray& ray, const Interval& range) const
+	{
+		if (m_WideNodes.empty())
+			return false;
+
+		TraversalDepthScope traversalDepth;
+
+		std::array<u32, MaxDepth * WideBVHWidth> nodeStack;
+		uSize stackSize = 0;
+		u32 nodeIndex = 0;
+		bool isOccluded = false;
+
+		const WideBVHRay wideRay(ray);
+		alignas(64) WideBVHNode::ChildDistances childDistances;
+
+		u64 numberOfNodesVisited = 0;
+		u64 numberOfPrimitiveTests = 0;
+
+		while (!isOccluded)
+		{
+			const WideBVHNode& node = m_WideNodes[nodeIndex];
+			numberOfNodesVisited++;
+
+			u32 hitMask = node.IntersectChildren(wideRay, range.GetMin(), range.GetMax(), childDistances);
+			while (hitMask != 0 && !isOccluded)
+			{
+				u32 child = static_cast<u32>(std::countr_zero(hitMask));
+				hitMask &= hitMask - 1;
+
+				if (!node.IsLeafChild(child))
+				{
+					nodeStack[stackSize++] = node.Offsets[child];
+					continue;
+				}
+
+				u32 firstPrimitive = node.Offsets[child];
+				for (u32 i = firstPrimitive; i != firstPrimitive + node.NumberOfPrimitives[child] && !isOccluded; i++)
+				{
+					isOccluded = m_Primitives.IsOccluded(i, ray, range);
+					numberOfPrimitiveTests++;
+				}
+			}
+
+			if (stackSize == 0)
+				break;
+
+			nodeIndex = nodeStack[--stackSize];
+		}
+
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		traversalStats.NumberOfTraversals += traversalDepth.IsOutermost();
+		traversalStats.NumberOfNodesVisited += numberOfNodesVisited;
+		traversalStats.NumberOfPrimitiveTests += numberOfPrimitiveTests;
+
+		return isOccluded;
+	}
+
+	bool __vectorcall LinearBVH::IsOccludedQuantized(const Ray& ray, const Interval& range) const
+	{
+		// IsOccludedWide over the quantized nodes
+		if (m_QuantizedNodes.empty())
+			return false;
+
+		TraversalDepthScope traversalDepth;
+
+		std::array<u32, MaxDepth * WideBVHWidth> nodeStack;
+		uSize stackSize = 0;
+		u32 nodeIndex = 0;
+		bool isOccluded = false;
+
+		const WideBVHRay wideRay(ray);
+		alignas(64) QuantizedWideBVHNode::ChildDistances childDistances;
+
+		u64 numberOfNodesVisited = 0;
+		u64 numberOfPrimitiveTests = 0;
+
+		while (!isOccluded)
+		{
+			const QuantizedWideBVHNode& node = m_QuantizedNodes[nodeIndex];
+			numberOfNodesVisited++;
+
+			u32 hitMask = node.IntersectChildren(wideRay, range.GetMin(), range.GetMax(), childDistances);
+			while (hitMask != 0 && !isOccluded)
+			{
+				u32 child = static_cast<u32>(std::countr_zero(hitMask));
+				hitMask &= hitMask - 1;
+
+				if (!node.IsLeafChild(child))
+				{
+					nodeStack[stackSize++] = node.ChildBaseIndex + node.ChildOffsets[child];
+					continue;
+				}
+
+				u32 firstPrimitive = node.PrimitiveBaseIndex + node.ChildOffsets[child];
+				for (u32 i = firstPrimitive; i != firstPrimitive + node.NumberOfPrimitives[child] && !isOccluded; i++)
+				{
+					isOccluded = m_Primitives.IsOccluded(i, ray, range);
+					numberOfPrimitiveTests++;
+				}
+			}
+
+			if (stackSize == 0)
+				break;
+
+			nodeIndex = nodeStack[--stackSize];
+		}
+
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		traversalStats.NumberOfTraversals += traversalDepth.IsOutermost();
+		traversalStats.NumberOfNodesVisited += numberOfNodesVisited;
+		traversalStats.NumberOfPrimitiveTests += numberOfPrimitiveTests;
+
+		return isOccluded;
+	}
+
+	TraversalStats LinearBVH::TakeThreadTraversalStats()
+	{
+		TraversalStats& traversalStats = GetThreadTraversalStats();
+		TraversalStats takenStats = traversalStats;
+		traversalStats = TraversalStats();
+		return takenStats;
+	}
+
+	TraversalStats& LinearBVH::GetThreadTraversalStats()
+	{
+		thread_local TraversalStats traversalStats;
+		return traversalStats;
+	}
+
+	void LinearBVH::Refit()
+	{
+		if (IsEmpty())
+			return;
+
+		m_Primitives.Refit();
+		if (HasQuantizedNodes())
+		{
+			// the child bounds are quantized again in place, the primitives stay in the order the tree was built with
+			m_RootBounds = RefitQuantizedNode(m_QuantizedNodes, 0);
+			return;
+		}
+
+		RefitNodes(m_Nodes);
+		m_RootBounds = m_Nodes[0].Bounds;
+
+		// collapsing again is as cheap as refitting the wide nodes and opens the children that are largest now
+		CollapseWideNodes();
+	}
+
+	std::array<f32, 6> LinearBVH::RefitQuantizedNode(QuantizedWideBVHNodeArray& nodes, u32 nodeIndex) const
+	{
+		// every child is fit before the node itself, the node's grid is placed over the children's floats and not their rounded bytes
+		std::array<std::array<f32, 6>, WideBVHWidth> childBounds;
+		std::array<f32, 6> nodeBounds = { std::numeric_limits<f32>::infinity(), -std::numeric_limits<f32>::infinity(),
+			std::numeric_limits<f32>::infinity(), -std::numeric_limits<f32>::infinity(),
+			std::numeric_limits<f32>::infinity(), -std::numeric_limits<f32>::infinity() };
+
+		const u8 childMask = nodes[nodeIndex].ChildMask;
+		for (u32 remainingChildren = childMask; remainingChildren != 0; remainingChildren &= remainingChildren - 1)
+		{
+			auto child = static_cast<uSize>(std::countr_zero(remainingChildren));
+			const QuantizedWideBVHNode& node = nodes[nodeIndex];
+			if (node.IsLeafChild(child))
+			{
+				AABB bounds = AABB::Empty;
+				u32 firstPrimitive = node.PrimitiveBaseIndex + node.ChildOffsets[child];
+				for (u32 i = firstPrimitive; i != firstPrimitive + node.NumberOfPrimitives[child]; i++)
+					bounds.Expand(m_Primitives.GetAABB(i));
+
+				for (AABB::Axis axis = AABB::Axis::x; axis <= AABB::Axis::z; axis++)
+				{
+					const Interval& axisInterval = bounds.GetAxisInterval(axis);
+					childBounds[child][2 * +axis] = axisInterval.GetMin();
+					childBounds[child][2 * +axis + 1] = axisInterval.GetMax();
+				}
+			}
+			else
+			{
+				childBounds[child] = RefitQuantizedNode(nodes, node.ChildBaseIndex + node.ChildOffsets[child]);
+			}
+
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				nodeBounds[2 * axis] = glm::min(nodeBounds[2 * axis], childBounds[child][2 * axis]);
+				nodeBounds[2 * axis + 1] = glm::max(nodeBounds[2 * axis + 1], childBounds[child][2 * axis + 1]);
+			}
+		}
+
+		QuantizedWideBVHNode& node = nodes[nodeIndex];
+		node.SetNodeBounds(nodeBounds);
+		for (u32 remainingChildren = childMask; remainingChildren != 0; remainingChildren &= remainingChildren - 1)
+		{
+			auto child = static_cast<uSize>(std::countr_zero(remainingChildren));
+			node.SetChildBounds(child, childBounds[child]);
+		}
+
+		return nodeBounds;
+	}
+
+	void LinearBVH::RefitNodes(BVHNodeArray& nodes) const
+	{
+		// children are always stored after their parent so walking the array backwards is bottom up
+		for (uSize nodeIndex = nodes.size(); nodeIndex-- != 0;)
+		{
+			BVHNode& node = nodes[nodeIndex];
+			if (node.IsLeaf())
+			{
+				AABB bounds = AABB::Empty;
+				for (u32 i = node.Offset; i != node.Offset + node.NumberOfPrimitives; i++)
+					bounds.Expand(m_Primitives.GetAABB(i));
+				node.SetBounds(bounds);
+				continue;
+			}
+
+			const BVHNode& firstChild = nodes[nodeIndex + 1];
+			const BVHNode& secondChild = nodes[node.Offset];
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				node.Bounds[2 * axis] = glm::min(firstChild.Bounds[2 * axis], secondChild.Bounds[2 * axis]);
+				node.Bounds[2 * axis + 1] = glm::max(firstChild.Bounds[2 * axis + 1], secondChild.Bounds[2 * axis + 1]);
+			}
+		}
+	}
+
+	void LinearBVH::SetUseQuantizedNodes(bool useQuantizedNodes)
+	{
+		// the binary nodes are gone once the quantized nodes are built so there is nothing left to collapse the float wide nodes from
+		if (useQuantizedNodes == m_UseQuantizedNodes || HasQuantizedNodes())
+			return;
+
+		m_UseQuantizedNodes = useQuantizedNodes;
+		BuildWideTree();
+	}
+
+	uSize LinearBVH::GatherWideChildren(u32 nodeIndex, std::array<u32, WideBVHWidth>& children) const
+	{
+		uSize numberOfChildren = 0;
+
+		const BVHNode& node = m_Nodes[nodeIndex];
+		if (node.IsLeaf()) // only happens at the root of a tree that is a single leaf
+		{
+			children[numberOfChildren++] = nodeIndex;
+		}
+		else
+		{
+			children[numberOfChildren++] = nodeIndex + 1;
+			children[numberOfChildren++] = node.Offset;
+
+			while (numberOfChildren != WideBVHWidth)
+			{
+				uSize largestChild = WideBVHWidth;
+				f32 largestSurfaceArea = -1.0f;
+				for (uSize i = 0; i != numberOfChildren; i++)
+				{
+					const BVHNode& child = m_Nodes[children[i]];
+					if (!child.IsLeaf() && child.GetSurfaceArea() > largestSurfaceArea)
+					{
+						largestChild = i;
+						largestSurfaceArea = child.GetSurfaceArea();
+					}
+				}
+
+				if (largestChild == WideBVHWidth)
+					break;
+
+				u32 openedNode = children[largestChild];
+				children[largestChild] = openedNode + 1;
+				children[numberOfChildren++] = m_Nodes[openedNode].Offset;
+			}
+		}
+
+		return numberOfChildren;
+	}
+
+	u32 LinearBVH::CollapseNode(u32 nodeIndex)
+	{
+		std::array<u32, WideBVHWidth> children{};
+		uSize numberOfChildren = GatherWideChildren(nodeIndex, children);
+
+		u32 wideIndex = static_cast<u32>(m_WideNodes.size());
+		m_WideNodes.emplace_back();
+		m_WideNodes[wideIndex].NumberOfChildren = static_cast<u32>(numberOfChildren);
+
+		for (uSize i = 0; i != numberOfChildren; i++)
+		{
+			const BVHNode& child = m_Nodes[children[i]];
+			// collapsing the child can grow m_WideNodes so the node is looked up again after each one
+			u32 offset = child.IsLeaf() ? child.Offset : CollapseNode(children[i]);
+
+			WideBVHNode& wideNode = m_WideNodes[wideIndex];
+			wideNode.SetChildBounds(i, child.Bounds);
+			wideNode.Offsets[i] = offset;
+			wideNode.NumberOfPrimitives[i] = child.NumberOfPrimitives;
+		}
+
+		return wideIndex;
+	}
+
+	void LinearBVH::BuildWideTree()
+	{
+		if (m_UseQuantizedNodes)
+			BuildQuantizedNodes();
+		else
+			m_QuantizedNodes = QuantizedWideBVHNodeArray();
+
+		if (HasQuantizedNodes())
+		{
+			// traversal, packets, Refit and the SAH cost all work on the quantized nodes, going back to the other forms takes a new tree
+			m_WideNodes = WideBVHNodeArray();
+			m_Nodes = BVHNodeArray();
+			return;
+		}
+
+		CollapseWideNodes();
+	}
+
+	void LinearBVH::CollapseWideNodes()
+	{
+		m_WideNodes.clear();
+		if (m_Nodes.empty())
+			return;
+
+		// every wide node holds at least two binary interior nodes
+		m_WideNodes.reserve(m_Nodes.size() / 2 + 1);
+		CollapseNode(0);
+	}
+
+	void LinearBVH::BuildQuantizedNodes()
+	{
+		m_QuantizedNodes.clear();
+		if (m_Nodes.empty())
+			return;
+
+		std::vector<u32> primitiveOrder;
+		primitiveOrder.reserve(m_Primitives.size());
+		m_QuantizedNodes.reserve(m_Nodes.size() / 2 + 1);
+		m_QuantizedNodes.emplace_back();
+		if (!CollapseQuantizedNode(0, 0, primitiveOrder))
+		{
+			m_QuantizedNodes = QuantizedWideBVHNodeArray();
+			return;
+		}
+
+		// the primitives are moved into the order the quantized nodes read them in instead of keeping an index per primitive,
+		// only done here as Refit keeps the tree's shape and with it the order
+		m_Primitives.Reorder(primitiveOrder);
+	}
+
+	bool LinearBVH::CollapseQuantizedNode(u32 nodeIndex, u32 quantizedIndex, std::vector<u32>& primitiveOrder)
+	{
+		std::array<u32, WideBVHWidth> children{};
+		uSize numberOfChildren = GatherWideChildren(nodeIndex, children);
+
+		QuantizedWideBVHNode node;
+		node.SetNodeBounds(m_Nodes[nodeIndex].Bounds);
+		node.ChildMask = static_cast<u8>((1u << numberOfChildren) - 1);
+		node.ChildBaseIndex = static_cast<u32>(m_QuantizedNodes.size());
+		node.PrimitiveBaseIndex = static_cast<u32>(primitiveOrder.size());
+
+		u32 numberOfInteriorChildren = 0;
+		for (uSize i = 0; i != numberOfChildren; i++)
+		{
+			const BVHNode& child = m_Nodes[children[i]];
+			node.SetChildBounds(i, child.Bounds);
+			if (!child.IsLeaf())
+			{
+				node.ChildOffsets[i] = static_cast<u8>(numberOfInteriorChildren++);
+				continue;
+			}
+
+			uSize primitiveOffset = primitiveOrder.size() - node.PrimitiveBaseIndex;
+			if (primitiveOffset > QuantizedWideBVHNode::MaxQuantizedValue || child.NumberOfPrimitives > QuantizedWideBVHNode::MaxQuantizedValue)
+				return false;
+
+			node.ChildOffsets[i] = static_cast<u8>(primitiveOffset);
+			node.NumberOfPrimitives[i] = static_cast<u8>(child.NumberOfPrimitives);
+			for (u32 j = child.Offset; j != child.Offset + child.NumberOfPrimitives; j++)
+				primitiveOrder.emplace_back(j);
+		}
+
+		// the interior children are allocated together before any of them is filled in so they sit next to each other
+		m_QuantizedNodes[quantizedIndex] = node;
+		m_QuantizedNodes.resize(m_QuantizedNodes.size() + numberOfInteriorChildren);
+		for (uSize i = 0; i != numberOfChildren; i++)
+		{
+			if (!node.IsLeafChild(i) && !CollapseQuantizedNode(children[i], node.ChildBaseIndex + node.ChildOffsets[i], primitiveOrder))
+				return false;
+		}
+
+		return true;
+	}
+
+	f32 LinearBVH::GetSAHCost() const
+	{
+		return HasQuantizedNodes() ? GetSAHCost(m_QuantizedNodes, m_RootBounds) : GetSAHCost(m_Nodes);
+	}
+
+	f32 LinearBVH::GetRefitSAHCost() const
+	{
+		if (HasQuantizedNodes())
+		{
+			QuantizedWideBVHNodeArray refitNodes = m_QuantizedNodes;
+			std::array<f32, 6> refitRootBounds = RefitQuantizedNode(refitNodes, 0);
+			return GetSAHCost(refitNodes, refitRootBounds);
+		}
+
+		BVHNodeArray refitNodes = m_Nodes;
+		RefitNodes(refitNodes);
+		return GetSAHCost(refitNodes);
+	}
+
+	f32 LinearBVH::GetSAHCost(const BVHNodeArray& nodes)
+	{
+		if (nodes.empty())
+			return 0.0f;
+
+		// a flat or unbounded root gives every node a 0 / 0 or inf / inf chance of being hit, a ray that reaches it tests every primitive instead
+		f32 rootSurfaceArea = nodes[0].GetSurfaceArea();
+		if (!(rootSurfaceArea > 0.0f) || std::isinf(rootSurfaceArea))
+		{
+			f32 primitiveCost = 0.0f;
+			for (const BVHNode& node : nodes)
+				if (node.IsLeaf())
+					primitiveCost += PrimitiveIntersectionCost * static_cast<f32>(node.NumberOfPrimitives);
+			return primitiveCost;
+		}
+
+		f32 invRootSurfaceArea = 1.0f / rootSurfaceArea;
+		f32 cost = 0.0f;
+		for (const BVHNode& node : nodes)
+		{
+			f32 nodeCost = node.IsLeaf() ?
+				PrimitiveIntersectionCost * static_cast<f32>(node.NumberOfPrimitives) :
+				NodeTraversalCost;
+			cost += nodeCost * node.GetSurfaceArea() * invRootSurfaceArea;
+		}
+
+		return cost;
+	}
+	f32 LinearBVH::GetSAHCost(const QuantizedWideBVHNodeArray& nodes, const std::array<f32, 6>& rootBounds)
+	{
+		if (nodes.empty())
+			return 0.0f;
+
+		// GetSAHCost of the binary nodes with every child of a wide node weighted by its decoded box, so the rounding counts against the tree too
+		f32 rootSurfaceArea = SurfaceArea(rootBounds);
+		if (!(rootSurfaceArea > 0.0f) || std::isinf(rootSurfaceArea))
+		{
+			f32 primitiveCost = 0.0f;
+			for (const QuantizedWideBVHNode& node : nodes)
+				for (u8 numberOfPrimitives : node.NumberOfPrimitives)
+					primitiveCost += PrimitiveIntersectionCost * static_cast<f32>(numberOfPrimitives);
+			return primitiveCost;
+		}
+
+		f32 invRootSurfaceArea = 1.0f / rootSurfaceArea;
+		f32 cost = NodeTraversalCost; // the root is always entered
+		for (const QuantizedWideBVHNode& node : nodes)
+		{
+			for (u32 childMask = node.ChildMask; childMask != 0; childMask &= childMask - 1)
+			{
+				auto child = static_cast<uSize>(std::countr_zero(childMask));
+				f32 childCost = node.IsLeafChild(child) ?
+					PrimitiveIntersectionCost * static_cast<f32>(node.NumberOfPrimitives[child]) :
+					NodeTraversalCost;
+				cost += childCost * SurfaceArea(node.GetChildBounds(child)) * invRootSurfaceArea;
+			}
+		}
+
+		return cost;
+	}
+}
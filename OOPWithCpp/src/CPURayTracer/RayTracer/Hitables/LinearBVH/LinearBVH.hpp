@@ -0,0 +1,185 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+#include "AABB.hpp"
+#include "AlignedAllocator.hpp"
+#include "WideBVHNode.hpp"
+#include "QuantizedWideBVHNode.hpp"
+#include "PrimitiveArray.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	struct alignas(32) BVHNode
+	{
+		// same layout as the intervals of an AABB so AABB::IsHit can test a node directly
+		std::array<f32, 6> Bounds{};
+		u32 Offset = 0; // leaf: first primitive, interior: index of the second child, the first child is always the next node
+		u16 NumberOfPrimitives = 0; // 0 for interior nodes
+		AABB::Axis SplitAxis = AABB::Axis::none;
+		u8 Padding = 0;
+
+		OWC_FORCE_INLINE bool IsLeaf() const { return NumberOfPrimitives != 0; }
+
+		OWC_FORCE_INLINE bool __vectorcall IsHit(const Ray& ray, const Interval& rayT) const
+		{
+			return AABB::IsHit(Bounds.data(), ray, rayT);
+		}
+
+		OWC_FORCE_INLINE f32 GetSurfaceArea() const
+		{
+			Vec3 size(Bounds[1] - Bounds[0], Bounds[3] - Bounds[2], Bounds[5] - Bounds[4]);
+			return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+		}
+
+		OWC_FORCE_INLINE void SetBounds(const AABB& aabb)
+		{
+			for (AABB::Axis axis = AABB::Axis::x; axis <= AABB::Axis::z; axis++)
+			{
+				const Interval& axisInterval = aabb.GetAxisInterval(axis);
+				Bounds[2 * +axis] = axisInterval.GetMin();
+				Bounds[2 * +axis + 1] = axisInterval.GetMax();
+			}
+		}
+	};
+
+	static_assert(sizeof(BVHNode) == 32, "BVHNode size is not 32 bytes!");
+
+	using BVHNodeArray = CacheAlignedVector<BVHNode>;
+	using WideBVHNodeArray = CacheAlignedVector<WideBVHNode>;
+	using QuantizedWideBVHNodeArray = CacheAlignedVector<QuantizedWideBVHNode>;
+
+	// counted per thread by every traversal so the camera can report how much work each ray does
+	struct TraversalStats
+	{
+		u64 NumberOfTraversals = 0; // rays traced from the top, the walk through the BVH of an instance they hit is not another one
+		u64 NumberOfNodesVisited = 0;
+		u64 NumberOfPrimitiveTests = 0;
+		u64 NumberOfCandidateHits = 0; // primitive hits that shrank the range, only the last one of a traversal is finalized
+		u64 NumberOfClosestHits = 0;
+
+		OWC_FORCE_INLINE TraversalStats& operator+=(const TraversalStats& other)
+		{
+			NumberOfTraversals += other.NumberOfTraversals;
+			NumberOfNodesVisited += other.NumberOfNodesVisited;
+			NumberOfPrimitiveTests += other.NumberOfPrimitiveTests;
+			NumberOfCandidateHits += other.NumberOfCandidateHits;
+			NumberOfClosestHits += other.NumberOfClosestHits;
+			return *this;
+		}
+	};
+
+	// Compiled BVH, nodes are stored depth first in one array and the primitives of each leaf are contiguous
+	// so a ray walks the tree with an explicit stack, leaves intersect through PrimitiveArray so built in primitives take no virtual call either
+	// the binary tree is also collapsed into a WideBVHWidth wide tree over the same primitives, kept either with 8 bit child bounds
+	// which IsHitQuantized walks or with float bounds which IsHitWide walks. The quantized nodes replace the binary ones as well,
+	// packets, Refit and the SAH cost all work on them, so a quantized tree is nothing but QuantizedWideBVHNodes
+	class LinearBVH
+	{
+	public:
+		// a node only pushes one child per level so the stack can never be deeper than the tree
+		static constexpr uSize MaxDepth = 64;
+
+		// cost model used by the builders and GetSAHCost, relative cost of testing a node against intersecting a primitive
+		static constexpr f32 NodeTraversalCost = 1.0f;
+		static constexpr f32 PrimitiveIntersectionCost = 1.0f;
+
+	public:
+		LinearBVH() = default;
+		explicit LinearBVH(BVHNodeArray&& nodes, std::vector<std::shared_ptr<BaseHitable>>&& primitives, bool useQuantizedNodes = true);
+		~LinearBVH() = default;
+
+		LinearBVH(const LinearBVH&) = delete;
+		LinearBVH& operator=(const LinearBVH&) = delete;
+		LinearBVH(LinearBVH&&) = default;
+		LinearBVH& operator=(LinearBVH&&) = default;
+
+		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const;
+		bool __vectorcall IsHitWide(const Ray& ray, Interval& range, HitData& hitData) const;
+		// any hit order does not matter so these walk children in memory order and stop at the first primitive hit
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const;
+		bool __vectorcall IsOccludedWide(const Ray& ray, const Interval& range) const;
+		// the wide tree again with a third of the memory per node, HasQuantizedNodes has to be checked first and the binary and float wide nodes are gone when it is true
+		bool __vectorcall IsHitQuantized(const Ray& ray, Interval& range, HitData& hitData) const;
+		bool __vectorcall IsOccludedQuantized(const Ray& ray, const Interval& range) const;
+		// walks the packet down the quantized tree, or the binary one without it, while any of its lanes still hits a node, see BaseHitable::IsHitPacket
+		u32 __vectorcall IsHitPacket(RayPacket& packet, u32 laneMask) const;
+
+		// stats of every traversal made on the calling thread since the last call, resets them
+		static TraversalStats TakeThreadTraversalStats();
+
+		// grows or shrinks every node to fit its primitives where they are now without changing the tree, O(n) in the number of nodes
+		// must not be called while rays are being traced, the tree gets slower the further primitives move from where it was built
+		void Refit();
+
+		// picks which form of the wide tree is collapsed from the binary tree, quantized nodes are only used when the tree can be quantized
+		// and the float wide nodes stay otherwise. Once quantized the binary nodes are released too so turning it off is ignored
+		// and needs a new LinearBVH, must not be called while rays are being traced
+		void SetUseQuantizedNodes(bool useQuantizedNodes);
+
+		// expected cost of tracing a ray that hits the root, every node weighted by the chance of entering it (its area over the root's)
+		// measured on the quantized nodes when there are any, so only compare it against costs of the same tree
+		f32 GetSAHCost() const;
+		// GetSAHCost of the tree as Refit would leave it without anything having moved, without changing the tree
+		// leaves refit to whole primitives so this is higher than GetSAHCost when spatial splits clipped the references of some
+		f32 GetRefitSAHCost() const;
+
+		OWC_FORCE_INLINE bool IsEmpty() const { return m_Nodes.empty() && m_QuantizedNodes.empty(); }
+		// in the layout of BVHNode::Bounds, kept up to date by Refit
+		OWC_FORCE_INLINE const std::array<f32, 6>& GetRootBounds() const { return m_RootBounds; }
+		// empty once the tree is quantized
+		OWC_FORCE_INLINE const BVHNodeArray& GetNodes() const { return m_Nodes; }
+		OWC_FORCE_INLINE const WideBVHNodeArray& GetWideNodes() const { return m_WideNodes; }
+		OWC_FORCE_INLINE const QuantizedWideBVHNodeArray& GetQuantizedNodes() const { return m_QuantizedNodes; }
+		// false only for an empty tree or one with a leaf too big to count in a byte, which only a build cut short at MaxDepth makes
+		OWC_FORCE_INLINE bool HasQuantizedNodes() const { return !m_QuantizedNodes.empty(); }
+		// what the tree was built or last set to use, HasQuantizedNodes says whether it could
+		OWC_FORCE_INLINE bool UsesQuantizedNodes() const { return m_UseQuantizedNodes; }
+		// bytes of the quantized nodes, their leaf children address the primitives directly so that is all they need
+		OWC_FORCE_INLINE uSize GetQuantizedSize() const { return m_QuantizedNodes.size() * sizeof(QuantizedWideBVHNode); }
+		// bytes of every node array the tree keeps, only the quantized nodes once the tree is quantized
+		OWC_FORCE_INLINE uSize GetResidentSize() const { return m_Nodes.size() * sizeof(BVHNode) + m_WideNodes.size() * sizeof(WideBVHNode) + GetQuantizedSize(); }
+		OWC_FORCE_INLINE const PrimitiveArray& GetPrimitives() const { return m_Primitives; }
+
+	private:
+		static TraversalStats& GetThreadTraversalStats();
+		static f32 GetSAHCost(const BVHNodeArray& nodes);
+		static f32 GetSAHCost(const QuantizedWideBVHNodeArray& nodes, const std::array<f32, 6>& rootBounds);
+
+		u32 __vectorcall IsHitPacketQuantized(RayPacket& packet, u32 laneMask) const;
+
+		// fits the bounds of every node to the primitives of its leaves, bottom up
+		void RefitNodes(BVHNodeArray& nodes) const;
+		// fits the node's children to their primitives and quantizes them again in place, returns the node's new bounds
+		std::array<f32, 6> RefitQuantizedNode(QuantizedWideBVHNodeArray& nodes, u32 nodeIndex) const;
+
+		// pulls the binary children of the node up until it has WideBVHWidth of them, opening the largest first, returns how many there are
+		uSize GatherWideChildren(u32 nodeIndex, std::array<u32, WideBVHWidth>& children) const;
+		// collapses the node into a new wide node, returns the wide node's index
+		u32 CollapseNode(u32 nodeIndex);
+		// collapses the binary tree into the form of the wide tree in use and releases the other, and the binary tree with it once quantized
+		void BuildWideTree();
+		void CollapseWideNodes();
+		void BuildQuantizedNodes();
+		// fills in the already allocated quantized node, returns false if a leaf does not fit the node's byte offsets
+		// primitiveOrder gets the primitives of every leaf child in the order the quantized nodes address them
+		bool CollapseQuantizedNode(u32 nodeIndex, u32 quantizedIndex, std::vector<u32>& primitiveOrder);
+
+	private:
+		BVHNodeArray m_Nodes;
+		WideBVHNodeArray m_WideNodes;
+		QuantizedWideBVHNodeArray m_QuantizedNodes;
+		PrimitiveArray m_Primitives;
+		std::array<f32, 6> m_RootBounds{};
+		bool m_UseQuantizedNodes = true;
+	};
+}
+
+#pragma warning(pop)
@@ -0,0 +1,141 @@
+﻿#include "Plane.hpp"
+#include "BaseMaterial.hpp"
+
+#include <bit>
+
+
+namespace OWC
+{
+	Plane::Plane(const Point& point, const Vec3& normal, const std::shared_ptr<BaseMaterial>& mat)
+		: Plane(point, normal, *mat)
+	{
+		m_MaterialOwner = mat;
+	}
+
+	Plane::Plane(const Point& point, const Vec3& normal, const BaseMaterial& mat)
+		: m_Normal(glm::normalize(normal)), m_Point(point), m_Material(&mat)
+	{
+		m_Distance = glm::dot(m_Normal, m_Point);
+
+		// any axis not too close to the normal gives a tangent
+		Vec3 helper = glm::abs(m_Normal.x) < 0.9f ? Vec3(1.0f, 0.0f, 0.0f) : Vec3(0.0f, 1.0f, 0.0f);
+		m_Tangent = glm::normalize(glm::cross(helper, m_Normal));
+		m_Bitangent = glm::cross(m_Normal, m_Tangent);
+	}
+
+	bool __vectorcall Plane::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		f32 t;
+		if (!SolveDistance(ray, range, t))
+			return false;
+
+		range.SetMax(t);
+		hitData.Record(this, t);
+
+		return true;
+	}
+
+	bool __vectorcall Plane::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		f32 t;
+		return SolveDistance(ray, range, t);
+	}
+
+	void __vectorcall Plane::FinalizeHit(const Ray& ray, HitData& hitData) const
+	{
+		hitData.point = ray.GetPointAtDistance(hitData.t);
+		hitData.SetFaceNormal(ray, m_Normal);
+
+		Vec3 offset = hitData.point - m_Point;
+		hitData.uv = glm::fract(Vec2(glm::dot(offset, m_Tangent), glm::dot(offset, m_Bitangent)));
+
+		hitData.material = &m_Material->GetCompiled();
+	}
+
+	u32 __vectorcall Plane::IsHitPacket(RayPacket& packet, u32 laneMask) const
+	{
+		// same distance as IsHit for every lane at once, parallel lanes are masked out before their infinite or NaN distance is compared
+#if AVX512
+		__m512 AVX512f32_Denominator = _mm512_mul_ps(_mm512_set1_ps(m_Normal.x), _mm512_load_ps(packet.Direction[0].data()));
+		AVX512f32_Denominator = _mm512_fmadd_ps(_mm512_set1_ps(m_Normal.y), _mm512_load_ps(packet.Direction[1].data()), AVX512f32_Denominator);
+		AVX512f32_Denominator = _mm512_fmadd_ps(_mm512_set1_ps(m_Normal.z), _mm512_load_ps(packet.Direction[2].data()), AVX512f32_Denominator);
+
+		__m512 AVX512f32_Numerator = _mm512_fnmadd_ps(_mm512_set1_ps(m_Normal.x), _mm512_load_ps(packet.Origin[0].data()), _mm512_set1_ps(m_Distance));
+		AVX512f32_Numerator = _mm512_fnmadd_ps(_mm512_set1_ps(m_Normal.y), _mm512_load_ps(packet.Origin[1].data()), AVX512f32_Numerator);
+		AVX512f32_Numerator = _mm512_fnmadd_ps(_mm512_set1_ps(m_Normal.z), _mm512_load_ps(packet.Origin[2].data()), AVX512f32_Numerator);
+
+		__mmask16 hitMask = _mm512_mask_cmp_ps_mask(static_cast<__mmask16>(laneMask), _mm512_abs_ps(AVX512f32_Denominator), _mm512_set1_ps(ParallelEpsilon), _CMP_GE_OQ);
+		if (hitMask == 0)
+			return 0;
+
+		__m512 AVX512f32_T = _mm512_div_ps(AVX512f32_Numerator, AVX512f32_Denominator);
+		hitMask = _mm512_mask_cmp_ps_mask(hitMask, AVX512f32_T, _mm512_load_ps(packet.TMin.data()), _CMP_GE_OQ);
+		hitMask = _mm512_mask_cmp_ps_mask(hitMask, AVX512f32_T, _mm512_load_ps(packet.TMax.data()), _CMP_LE_OQ);
+
+		_mm512_mask_store_ps(packet.TMax.data(), hitMask, AVX512f32_T);
+		auto packetHitMask = static_cast<u32>(hitMask);
+#elif AVX2
+		__m256 AVX2f32_Denominator = _mm256_mul_ps(_mm256_set1_ps(m_Normal.x), _mm256_load_ps(packet.Direction[0].data()));
+		AVX2f32_Denominator = _mm256_fmadd_ps(_mm256_set1_ps(m_Normal.y), _mm256_load_ps(packet.Direction[1].data()), AVX2f32_Denominator);
+		AVX2f32_Denominator = _mm256_fmadd_ps(_mm256_set1_ps(m_Normal.z), _mm256_load_ps(packet.Direction[2].data()), AVX2f32_Denominator);
+
+		__m256 AVX2f32_Numerator = _mm256_fnmadd_ps(_mm256_set1_ps(m_Normal.x), _mm256_load_ps(packet.Origin[0].data()), _mm256_set1_ps(m_Distance));
+		AVX2f32_Numerator = _mm256_fnmadd_ps(_mm256_set1_ps(m_Normal.y), _mm256_load_ps(packet.Origin[1].data()), AVX2f32_Numerator);
+		AVX2f32_Numerator = _mm256_fnmadd_ps(_mm256_set1_ps(m_Normal.z), _mm256_load_ps(packet.Origin[2].data()), AVX2f32_Numerator);
+
+		// clearing the sign bit gives the absolute value
+		__m256 AVX2f32_AbsDenominator = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), AVX2f32_Denominator);
+		__m256 AVX2f32_T = _mm256_div_ps(AVX2f32_Numerator, AVX2f32_Denominator);
+		__m256 AVX2f32_TMax = _mm256_load_ps(packet.TMax.data());
+
+		__m256 AVX2f32_HitLanes = _mm256_and_ps(_mm256_cmp_ps(AVX2f32_AbsDenominator, _mm256_set1_ps(ParallelEpsilon), _CMP_GE_OQ),
+			_mm256_and_ps(_mm256_cmp_ps(AVX2f32_T, _mm256_load_ps(packet.TMin.data()), _CMP_GE_OQ), _mm256_cmp_ps(AVX2f32_T, AVX2f32_TMax, _CMP_LE_OQ)));
+
+		u32 packetHitMask = static_cast<u32>(_mm256_movemask_ps(AVX2f32_HitLanes)) & laneMask;
+		if (packetHitMask == 0)
+			return 0;
+
+		// expands the hit bits back into a lane mask so only the lanes in laneMask that hit have their TMax replaced
+		const __m256i AVX2i32_LaneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		AVX2f32_HitLanes = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<i32>(packetHitMask)), AVX2i32_LaneBits), AVX2i32_LaneBits));
+		_mm256_store_ps(packet.TMax.data(), _mm256_blendv_ps(AVX2f32_TMax, AVX2f32_T, AVX2f32_HitLanes));
+#else
+		__m128 SSEf32_Denominator = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(m_Normal.x), _mm_load_ps(packet.Direction[0].data())),
+			_mm_mul_ps(_mm_set1_ps(m_Normal.y), _mm_load_ps(packet.Direction[1].data()))),
+			_mm_mul_ps(_mm_set1_ps(m_Normal.z), _mm_load_ps(packet.Direction[2].data())));
+
+		__m128 SSEf32_Numerator = _mm_sub_ps(_mm_set1_ps(m_Distance), _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(m_Normal.x), _mm_load_ps(packet.Origin[0].data())),
+			_mm_mul_ps(_mm_set1_ps(m_Normal.y), _mm_load_ps(packet.Origin[1].data()))),
+			_mm_mul_ps(_mm_set1_ps(m_Normal.z), _mm_load_ps(packet.Origin[2].data()))));
+
+		// clearing the sign bit gives the absolute value
+		__m128 SSEf32_AbsDenominator = _mm_andnot_ps(_mm_set1_ps(-0.0f), SSEf32_Denominator);
+		__m128 SSEf32_T = _mm_div_ps(SSEf32_Numerator, SSEf32_Denominator);
+		__m128 SSEf32_TMax = _mm_load_ps(packet.TMax.data());
+
+		__m128 SSEf32_HitLanes = _mm_and_ps(_mm_cmpge_ps(SSEf32_AbsDenominator, _mm_set1_ps(ParallelEpsilon)),
+			_mm_and_ps(_mm_cmpge_ps(SSEf32_T, _mm_load_ps(packet.TMin.data())), _mm_cmple_ps(SSEf32_T, SSEf32_TMax)));
+
+		u32 packetHitMask = static_cast<u32>(_mm_movemask_ps(SSEf32_HitLanes)) & laneMask;
+		if (packetHitMask == 0)
+			return 0;
+
+		// expands the hit bits back into a lane mask so only the lanes in laneMask that hit have their TMax replaced
+		const __m128i SSEi32_LaneBits = _mm_setr_epi32(1, 2, 4, 8);
+		SSEf32_HitLanes = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<i32>(packetHitMask)), SSEi32_LaneBits), SSEi32_LaneBits));
+		_mm_store_ps(packet.TMax.data(), _mm_blendv_ps(SSEf32_TMax, SSEf32_T, SSEf32_HitLanes));
+#endif
+
+		for (u32 hitLanes = packetHitMask; hitLanes != 0; hitLanes &= hitLanes - 1)
+		{
+			auto lane = static_cast<uSize>(std::countr_zero(hitLanes));
+			packet.HitObjects[lane] = this;
+			packet.HitPrimitives[lane] = 0;
+			packet.HitInstances[lane] = nullptr;
+		}
+
+		return packetHitMask;
+	}
+}
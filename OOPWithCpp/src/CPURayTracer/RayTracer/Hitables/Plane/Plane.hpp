@@ -0,0 +1,67 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+#include "Ray.hpp"
+#include "AABB.hpp"
+
+#include <memory>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// An infinite plane through a point, its bounds are the whole universe so a BVH can not cull it.
+	// SplitBVH keeps unbounded objects like it in a list next to the tree and tests them on every ray instead,
+	// one dot product and a divide, rather than a huge sphere standing in for the ground that overlaps every node.
+	class Plane : public BaseHitable
+	{
+	public:
+		Plane() = delete;
+		Plane(const Point& point, const Vec3& normal, const std::shared_ptr<BaseMaterial>& mat);
+		// does not own the material, which has to outlive the plane, as one from the same SceneArena does
+		Plane(const Point& point, const Vec3& normal, const BaseMaterial& mat);
+		~Plane() override = default;
+
+		Plane(const Plane&) = delete;
+		Plane& operator=(const Plane&) = delete;
+		Plane(Plane&&) = delete;
+		Plane& operator=(Plane&&) = delete;
+
+		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+		void __vectorcall FinalizeHit(const Ray& ray, HitData& hitData) const override;
+		u32 __vectorcall IsHitPacket(RayPacket& packet, u32 laneMask) const override;
+
+		AABB GetAABB() const override { return AABB::Univers; }
+		bool IsUnbounded() const override { return true; }
+
+		OWC_FORCE_INLINE const Vec3& GetNormal() const { return m_Normal; }
+
+	private:
+		// rays parallel to the plane miss it
+		static constexpr f32 ParallelEpsilon = 1e-8f;
+
+		OWC_FORCE_INLINE bool __vectorcall SolveDistance(const Ray& ray, const Interval& range, f32& t) const
+		{
+			f32 denominator = glm::dot(m_Normal, ray.GetDirection());
+			if (glm::abs(denominator) < ParallelEpsilon)
+				return false;
+
+			t = (m_Distance - glm::dot(m_Normal, ray.GetOrigin())) / denominator;
+			return range.Contains(t);
+		}
+
+	private:
+		Vec3 m_Normal;
+		Vec3 m_Tangent; // with m_Bitangent the axes of the UV, which repeat every unit
+		Vec3 m_Bitangent;
+		Point m_Point;
+		f32 m_Distance; // dot(normal, point) for every point on the plane
+		const BaseMaterial* m_Material;
+		std::shared_ptr<const BaseMaterial> m_MaterialOwner; // empty when something else owns the material
+	};
+}
+
+#pragma warning(pop)
@@ -0,0 +1,82 @@
+﻿#include "PrimitiveArray.hpp"
+
+
+namespace OWC
+{
+	PrimitiveArray::PrimitiveArray(std::vector<std::shared_ptr<BaseHitable>>&& primitives)
+		: m_Objects(std::move(primitives))
+	{
+		// the type is only looked up once here, the tags stand in for the vtable from then on
+		m_References.reserve(m_Objects.size());
+		for (const std::shared_ptr<BaseHitable>& object : m_Objects)
+		{
+			PrimitiveReference& reference = m_References.emplace_back();
+			if (const auto* sphere = dynamic_cast<const Sphere*>(object.get()))
+			{
+				reference.Type = PrimitiveType::Sphere;
+				reference.Index = static_cast<u32>(m_Spheres.size());
+				m_Spheres.emplace_back(CompiledSphere{ sphere->GetCenter(), sphere->GetRadius() * sphere->GetRadius() });
+				m_SphereSources.emplace_back(sphere);
+			}
+			else if (auto* sphereBatch = dynamic_cast<SphereBatch*>(object.get()))
+			{
+				reference.Type = PrimitiveType::SphereBatch;
+				reference.Index = static_cast<u32>(m_SphereBatches.size());
+				m_SphereBatches.emplace_back(sphereBatch);
+			}
+			else if (const auto* triangleBatch = dynamic_cast<const TriangleBatch*>(object.get()))
+			{
+				reference.Type = PrimitiveType::TriangleBatch;
+				reference.Index = static_cast<u32>(m_TriangleBatches.size());
+				m_TriangleBatches.emplace_back(triangleBatch);
+			}
+			else if (const auto* instance = dynamic_cast<const Instance*>(object.get()))
+			{
+				reference.Type = PrimitiveType::Instance;
+				reference.Index = static_cast<u32>(m_Instances.size());
+				m_Instances.emplace_back(instance);
+			}
+			else if (const auto* quad = dynamic_cast<const Quad*>(object.get()))
+			{
+				reference.Type = PrimitiveType::Quad;
+				reference.Index = static_cast<u32>(m_Quads.size());
+				m_Quads.emplace_back(quad);
+			}
+			else
+			{
+				reference.Type = PrimitiveType::Other;
+				reference.Index = static_cast<u32>(m_Others.size());
+				m_Others.emplace_back(object.get());
+			}
+		}
+	}
+
+	void PrimitiveArray::Refit()
+	{
+		for (uSize i = 0; i != m_Spheres.size(); i++)
+		{
+			const Sphere* source = m_SphereSources[i];
+			m_Spheres[i].Center = source->GetCenter();
+			m_Spheres[i].RadiusSquared = source->GetRadius() * source->GetRadius();
+		}
+
+		for (SphereBatch* sphereBatch : m_SphereBatches)
+			sphereBatch->Refit();
+	}
+
+	void PrimitiveArray::Reorder(const std::vector<u32>& order)
+	{
+		std::vector<PrimitiveReference> references;
+		std::vector<std::shared_ptr<BaseHitable>> objects;
+		references.reserve(order.size());
+		objects.reserve(order.size());
+		for (u32 primitiveIndex : order)
+		{
+			references.emplace_back(m_References[primitiveIndex]);
+			objects.emplace_back(std::move(m_Objects[primitiveIndex]));
+		}
+
+		m_References = std::move(references);
+		m_Objects = std::move(objects);
+	}
+}
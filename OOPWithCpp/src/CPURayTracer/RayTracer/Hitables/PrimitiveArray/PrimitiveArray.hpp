@@ -0,0 +1,141 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+#include "AlignedAllocator.hpp"
+#include "Sphere.hpp"
+#include "SphereBatch.hpp"
+#include "TriangleBatch.hpp"
+#include "Instance.hpp"
+#include "Quad.hpp"
+
+#include <memory>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// the primitives PrimitiveArray can intersect without a virtual call, anything else is Other
+	enum class PrimitiveType : u8
+	{
+		Sphere = 0,
+		SphereBatch,
+		TriangleBatch,
+		Instance,
+		Quad,
+		Other
+	};
+
+	// Compiled leaf primitives of a LinearBVH, every primitive is a type tag and an index into a flat array of that type
+	// so intersecting one is a switch with the sphere test inlined instead of a virtual call through a shared_ptr
+	class PrimitiveArray
+	{
+	public:
+		PrimitiveArray() = default;
+		explicit PrimitiveArray(std::vector<std::shared_ptr<BaseHitable>>&& primitives);
+		~PrimitiveArray() = default;
+
+		PrimitiveArray(const PrimitiveArray&) = delete;
+		PrimitiveArray& operator=(const PrimitiveArray&) = delete;
+		PrimitiveArray(PrimitiveArray&&) = default;
+		PrimitiveArray& operator=(PrimitiveArray&&) = default;
+
+		OWC_FORCE_INLINE bool __vectorcall IsHit(u32 primitiveIndex, const Ray& ray, Interval& range, HitData& hitData) const
+		{
+			const PrimitiveReference& reference = m_References[primitiveIndex];
+			switch (reference.Type)
+			{
+			case PrimitiveType::Sphere:
+			{
+				const CompiledSphere& sphere = m_Spheres[reference.Index];
+				f32 root;
+				if (!Sphere::SolveNearestRoot(sphere.Center, sphere.RadiusSquared, ray, range, root))
+					return false;
+
+				range.SetMax(root);
+				hitData.Record(m_SphereSources[reference.Index], root);
+				return true;
+			}
+			case PrimitiveType::SphereBatch:   return m_SphereBatches[reference.Index]->SphereBatch::IsHit(ray, range, hitData);
+			case PrimitiveType::TriangleBatch: return m_TriangleBatches[reference.Index]->TriangleBatch::IsHit(ray, range, hitData);
+			case PrimitiveType::Instance:      return m_Instances[reference.Index]->Instance::IsHit(ray, range, hitData);
+			case PrimitiveType::Quad:          return m_Quads[reference.Index]->Quad::IsHit(ray, range, hitData);
+			default:                           return m_Others[reference.Index]->IsHit(ray, range, hitData);
+			}
+		}
+
+		OWC_FORCE_INLINE bool __vectorcall IsOccluded(u32 primitiveIndex, const Ray& ray, const Interval& range) const
+		{
+			const PrimitiveReference& reference = m_References[primitiveIndex];
+			switch (reference.Type)
+			{
+			case PrimitiveType::Sphere:
+			{
+				const CompiledSphere& sphere = m_Spheres[reference.Index];
+				f32 root;
+				return Sphere::SolveNearestRoot(sphere.Center, sphere.RadiusSquared, ray, range, root);
+			}
+			case PrimitiveType::SphereBatch:   return m_SphereBatches[reference.Index]->SphereBatch::IsOccluded(ray, range);
+			case PrimitiveType::TriangleBatch: return m_TriangleBatches[reference.Index]->TriangleBatch::IsOccluded(ray, range);
+			case PrimitiveType::Instance:      return m_Instances[reference.Index]->Instance::IsOccluded(ray, range);
+			case PrimitiveType::Quad:          return m_Quads[reference.Index]->Quad::IsOccluded(ray, range);
+			default:                           return m_Others[reference.Index]->IsOccluded(ray, range);
+			}
+		}
+
+		OWC_FORCE_INLINE u32 __vectorcall IsHitPacket(u32 primitiveIndex, RayPacket& packet, u32 laneMask) const
+		{
+			const PrimitiveReference& reference = m_References[primitiveIndex];
+			switch (reference.Type)
+			{
+			case PrimitiveType::Sphere:        return m_SphereSources[reference.Index]->Sphere::IsHitPacket(packet, laneMask);
+			case PrimitiveType::SphereBatch:   return m_SphereBatches[reference.Index]->SphereBatch::IsHitPacket(packet, laneMask);
+			case PrimitiveType::TriangleBatch: return m_TriangleBatches[reference.Index]->TriangleBatch::IsHitPacket(packet, laneMask);
+			case PrimitiveType::Instance:      return m_Instances[reference.Index]->Instance::IsHitPacket(packet, laneMask);
+			case PrimitiveType::Quad:          return m_Quads[reference.Index]->Quad::IsHitPacket(packet, laneMask);
+			default:                           return m_Others[reference.Index]->IsHitPacket(packet, laneMask);
+			}
+		}
+
+		// reads every sphere again after they moved, the triangles of meshes are copied once as a mesh only moves as a whole through an Instance
+		void Refit();
+		// puts the primitive at order[i] at i, only the references move, the compiled primitives they point at stay where they are
+		void Reorder(const std::vector<u32>& order);
+
+		OWC_FORCE_INLINE AABB GetAABB(u32 primitiveIndex) const { return m_Objects[primitiveIndex]->GetAABB(); }
+		OWC_FORCE_INLINE uSize size() const { return m_References.size(); }
+		OWC_FORCE_INLINE const std::vector<std::shared_ptr<BaseHitable>>& GetObjects() const { return m_Objects; }
+
+	private:
+		struct PrimitiveReference
+		{
+			u32 Index = 0; // into the array of Type
+			PrimitiveType Type = PrimitiveType::Other;
+		};
+
+		// a copy of what the sphere test reads so it never touches the Sphere until the hit is finalized
+		// the Sphere is found from the same index in m_SphereSources so four of these share a cache line instead of two
+		struct alignas(16) CompiledSphere
+		{
+			Vec3 Center{ 0.0f };
+			f32 RadiusSquared = 0.0f;
+		};
+
+		static_assert(sizeof(CompiledSphere) == 16, "CompiledSphere size is not 16 bytes!");
+
+	private:
+		std::vector<PrimitiveReference> m_References; // in leaf order
+		CacheAlignedVector<CompiledSphere> m_Spheres;
+		std::vector<const Sphere*> m_SphereSources; // same index as m_Spheres, only read for a hit
+		std::vector<SphereBatch*> m_SphereBatches; // not const so they can be refit
+		std::vector<const TriangleBatch*> m_TriangleBatches;
+		std::vector<const Instance*> m_Instances;
+		std::vector<const Quad*> m_Quads;
+		std::vector<const BaseHitable*> m_Others;
+		std::vector<std::shared_ptr<BaseHitable>> m_Objects; // owns everything the arrays point to
+	};
+}
+
+#pragma warning(pop)
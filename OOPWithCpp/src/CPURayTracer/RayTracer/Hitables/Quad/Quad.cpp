@@ -0,0 +1,221 @@
+﻿#include "Quad.hpp"
+#include "BaseMaterial.hpp"
+
+#include <bit>
+
+
+namespace OWC
+{
+	Quad::Quad(const Point& q, const Vec3& u, const Vec3& v, const std::shared_ptr<BaseMaterial>& mat)
+		: m_Q(q), m_Material(mat)
+	{
+		Vec3 n = glm::cross(u, v);
+		Vec3 w = n / glm::dot(n, n);
+		m_AlphaAxis = glm::cross(v, w);
+		m_BetaAxis = glm::cross(w, u);
+
+		m_Normal = glm::normalize(n);
+		m_Distance = glm::dot(m_Normal, m_Q);
+		m_UVDensity = glm::sqrt(glm::length(m_AlphaAxis) * glm::length(m_BetaAxis));
+
+		m_AABB = AABB(AABB(m_Q, m_Q + u + v), AABB(m_Q + u, m_Q + v));
+	}
+
+	bool __vectorcall Quad::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		f32 t;
+		f32 alpha;
+		f32 beta;
+		if (!Solve(ray, range, t, alpha, beta))
+			return false;
+
+		range.SetMax(t);
+		hitData.Record(this, t);
+
+		return true;
+	}
+
+	bool __vectorcall Quad::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		f32 t;
+		f32 alpha;
+		f32 beta;
+		return Solve(ray, range, t, alpha, beta);
+	}
+
+	void __vectorcall Quad::FinalizeHit(const Ray& ray, HitData& hitData) const
+	{
+		hitData.point = ray.GetPointAtDistance(hitData.t);
+		hitData.SetFaceNormal(ray, m_Normal);
+
+		Vec3 planarHit = hitData.point - m_Q;
+		hitData.uv = Vec2(glm::dot(planarHit, m_AlphaAxis), glm::dot(planarHit, m_BetaAxis));
+		hitData.footprint *= m_UVDensity;
+
+		hitData.material = &m_Material->GetCompiled();
+	}
+
+	u32 __vectorcall Quad::IsHitPacket(RayPacket& packet, u32 laneMask) const
+	{
+		// same test as IsHit for every lane at once, parallel lanes are masked out before their infinite or NaN distance is compared
+#if AVX512
+		__m512 AVX512f32_DirectionX = _mm512_load_ps(packet.Direction[0].data());
+		__m512 AVX512f32_DirectionY = _mm512_load_ps(packet.Direction[1].data());
+		__m512 AVX512f32_DirectionZ = _mm512_load_ps(packet.Direction[2].data());
+
+		__m512 AVX512f32_Denominator = _mm512_mul_ps(_mm512_set1_ps(m_Normal.x), AVX512f32_DirectionX);
+		AVX512f32_Denominator = _mm512_fmadd_ps(_mm512_set1_ps(m_Normal.y), AVX512f32_DirectionY, AVX512f32_Denominator);
+		AVX512f32_Denominator = _mm512_fmadd_ps(_mm512_set1_ps(m_Normal.z), AVX512f32_DirectionZ, AVX512f32_Denominator);
+
+		__mmask16 hitMask = _mm512_mask_cmp_ps_mask(static_cast<__mmask16>(laneMask), _mm512_abs_ps(AVX512f32_Denominator), _mm512_set1_ps(ParallelEpsilon), _CMP_GE_OQ);
+		if (hitMask == 0)
+			return 0;
+
+		// the origin relative to the corner, the numerator is the distance from it to the plane along the normal
+		__m512 AVX512f32_QOX = _mm512_sub_ps(_mm512_load_ps(packet.Origin[0].data()), _mm512_set1_ps(m_Q.x));
+		__m512 AVX512f32_QOY = _mm512_sub_ps(_mm512_load_ps(packet.Origin[1].data()), _mm512_set1_ps(m_Q.y));
+		__m512 AVX512f32_QOZ = _mm512_sub_ps(_mm512_load_ps(packet.Origin[2].data()), _mm512_set1_ps(m_Q.z));
+
+		__m512 AVX512f32_Numerator = _mm512_mul_ps(_mm512_set1_ps(m_Normal.x), AVX512f32_QOX);
+		AVX512f32_Numerator = _mm512_fmadd_ps(_mm512_set1_ps(m_Normal.y), AVX512f32_QOY, AVX512f32_Numerator);
+		AVX512f32_Numerator = _mm512_fmadd_ps(_mm512_set1_ps(m_Normal.z), AVX512f32_QOZ, AVX512f32_Numerator);
+
+		__m512 AVX512f32_T = _mm512_div_ps(_mm512_sub_ps(_mm512_setzero_ps(), AVX512f32_Numerator), AVX512f32_Denominator);
+		hitMask = _mm512_mask_cmp_ps_mask(hitMask, AVX512f32_T, _mm512_load_ps(packet.TMin.data()), _CMP_GE_OQ);
+		hitMask = _mm512_mask_cmp_ps_mask(hitMask, AVX512f32_T, _mm512_load_ps(packet.TMax.data()), _CMP_LE_OQ);
+		if (hitMask == 0)
+			return 0;
+
+		__m512 AVX512f32_PlanarHitX = _mm512_fmadd_ps(AVX512f32_T, AVX512f32_DirectionX, AVX512f32_QOX);
+		__m512 AVX512f32_PlanarHitY = _mm512_fmadd_ps(AVX512f32_T, AVX512f32_DirectionY, AVX512f32_QOY);
+		__m512 AVX512f32_PlanarHitZ = _mm512_fmadd_ps(AVX512f32_T, AVX512f32_DirectionZ, AVX512f32_QOZ);
+
+		__m512 AVX512f32_Alpha = _mm512_mul_ps(AVX512f32_PlanarHitX, _mm512_set1_ps(m_AlphaAxis.x));
+		AVX512f32_Alpha = _mm512_fmadd_ps(AVX512f32_PlanarHitY, _mm512_set1_ps(m_AlphaAxis.y), AVX512f32_Alpha);
+		AVX512f32_Alpha = _mm512_fmadd_ps(AVX512f32_PlanarHitZ, _mm512_set1_ps(m_AlphaAxis.z), AVX512f32_Alpha);
+
+		__m512 AVX512f32_Beta = _mm512_mul_ps(AVX512f32_PlanarHitX, _mm512_set1_ps(m_BetaAxis.x));
+		AVX512f32_Beta = _mm512_fmadd_ps(AVX512f32_PlanarHitY, _mm512_set1_ps(m_BetaAxis.y), AVX512f32_Beta);
+		AVX512f32_Beta = _mm512_fmadd_ps(AVX512f32_PlanarHitZ, _mm512_set1_ps(m_BetaAxis.z), AVX512f32_Beta);
+
+		const __m512 AVX512f32_One = _mm512_set1_ps(1.0f);
+		hitMask = _mm512_mask_cmp_ps_mask(hitMask, AVX512f32_Alpha, _mm512_setzero_ps(), _CMP_GE_OQ);
+		hitMask = _mm512_mask_cmp_ps_mask(hitMask, AVX512f32_Alpha, AVX512f32_One, _CMP_LE_OQ);
+		hitMask = _mm512_mask_cmp_ps_mask(hitMask, AVX512f32_Beta, _mm512_setzero_ps(), _CMP_GE_OQ);
+		hitMask = _mm512_mask_cmp_ps_mask(hitMask, AVX512f32_Beta, AVX512f32_One, _CMP_LE_OQ);
+
+		_mm512_mask_store_ps(packet.TMax.data(), hitMask, AVX512f32_T);
+		auto packetHitMask = static_cast<u32>(hitMask);
+#elif AVX2
+		__m256 AVX2f32_DirectionX = _mm256_load_ps(packet.Direction[0].data());
+		__m256 AVX2f32_DirectionY = _mm256_load_ps(packet.Direction[1].data());
+		__m256 AVX2f32_DirectionZ = _mm256_load_ps(packet.Direction[2].data());
+
+		__m256 AVX2f32_Denominator = _mm256_mul_ps(_mm256_set1_ps(m_Normal.x), AVX2f32_DirectionX);
+		AVX2f32_Denominator = _mm256_fmadd_ps(_mm256_set1_ps(m_Normal.y), AVX2f32_DirectionY, AVX2f32_Denominator);
+		AVX2f32_Denominator = _mm256_fmadd_ps(_mm256_set1_ps(m_Normal.z), AVX2f32_DirectionZ, AVX2f32_Denominator);
+
+		// the origin relative to the corner, the numerator is the distance from it to the plane along the normal
+		__m256 AVX2f32_QOX = _mm256_sub_ps(_mm256_load_ps(packet.Origin[0].data()), _mm256_set1_ps(m_Q.x));
+		__m256 AVX2f32_QOY = _mm256_sub_ps(_mm256_load_ps(packet.Origin[1].data()), _mm256_set1_ps(m_Q.y));
+		__m256 AVX2f32_QOZ = _mm256_sub_ps(_mm256_load_ps(packet.Origin[2].data()), _mm256_set1_ps(m_Q.z));
+
+		__m256 AVX2f32_Numerator = _mm256_mul_ps(_mm256_set1_ps(m_Normal.x), AVX2f32_QOX);
+		AVX2f32_Numerator = _mm256_fmadd_ps(_mm256_set1_ps(m_Normal.y), AVX2f32_QOY, AVX2f32_Numerator);
+		AVX2f32_Numerator = _mm256_fmadd_ps(_mm256_set1_ps(m_Normal.z), AVX2f32_QOZ, AVX2f32_Numerator);
+
+		__m256 AVX2f32_T = _mm256_div_ps(_mm256_sub_ps(_mm256_setzero_ps(), AVX2f32_Numerator), AVX2f32_Denominator);
+		__m256 AVX2f32_TMax = _mm256_load_ps(packet.TMax.data());
+
+		__m256 AVX2f32_PlanarHitX = _mm256_fmadd_ps(AVX2f32_T, AVX2f32_DirectionX, AVX2f32_QOX);
+		__m256 AVX2f32_PlanarHitY = _mm256_fmadd_ps(AVX2f32_T, AVX2f32_DirectionY, AVX2f32_QOY);
+		__m256 AVX2f32_PlanarHitZ = _mm256_fmadd_ps(AVX2f32_T, AVX2f32_DirectionZ, AVX2f32_QOZ);
+
+		__m256 AVX2f32_Alpha = _mm256_mul_ps(AVX2f32_PlanarHitX, _mm256_set1_ps(m_AlphaAxis.x));
+		AVX2f32_Alpha = _mm256_fmadd_ps(AVX2f32_PlanarHitY, _mm256_set1_ps(m_AlphaAxis.y), AVX2f32_Alpha);
+		AVX2f32_Alpha = _mm256_fmadd_ps(AVX2f32_PlanarHitZ, _mm256_set1_ps(m_AlphaAxis.z), AVX2f32_Alpha);
+
+		__m256 AVX2f32_Beta = _mm256_mul_ps(AVX2f32_PlanarHitX, _mm256_set1_ps(m_BetaAxis.x));
+		AVX2f32_Beta = _mm256_fmadd_ps(AVX2f32_PlanarHitY, _mm256_set1_ps(m_BetaAxis.y), AVX2f32_Beta);
+		AVX2f32_Beta = _mm256_fmadd_ps(AVX2f32_PlanarHitZ, _mm256_set1_ps(m_BetaAxis.z), AVX2f32_Beta);
+
+		// clearing the sign bit gives the absolute value
+		const __m256 AVX2f32_One = _mm256_set1_ps(1.0f);
+		__m256 AVX2f32_HitLanes = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), AVX2f32_Denominator), _mm256_set1_ps(ParallelEpsilon), _CMP_GE_OQ);
+		AVX2f32_HitLanes = _mm256_and_ps(AVX2f32_HitLanes, _mm256_and_ps(_mm256_cmp_ps(AVX2f32_T, _mm256_load_ps(packet.TMin.data()), _CMP_GE_OQ), _mm256_cmp_ps(AVX2f32_T, AVX2f32_TMax, _CMP_LE_OQ)));
+		AVX2f32_HitLanes = _mm256_and_ps(AVX2f32_HitLanes, _mm256_and_ps(_mm256_cmp_ps(AVX2f32_Alpha, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(AVX2f32_Alpha, AVX2f32_One, _CMP_LE_OQ)));
+		AVX2f32_HitLanes = _mm256_and_ps(AVX2f32_HitLanes, _mm256_and_ps(_mm256_cmp_ps(AVX2f32_Beta, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(AVX2f32_Beta, AVX2f32_One, _CMP_LE_OQ)));
+
+		u32 packetHitMask = static_cast<u32>(_mm256_movemask_ps(AVX2f32_HitLanes)) & laneMask;
+		if (packetHitMask == 0)
+			return 0;
+
+		// expands the hit bits back into a lane mask so only the lanes in laneMask that hit have their TMax replaced
+		const __m256i AVX2i32_LaneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		AVX2f32_HitLanes = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<i32>(packetHitMask)), AVX2i32_LaneBits), AVX2i32_LaneBits));
+		_mm256_store_ps(packet.TMax.data(), _mm256_blendv_ps(AVX2f32_TMax, AVX2f32_T, AVX2f32_HitLanes));
+#else
+		__m128 SSEf32_DirectionX = _mm_load_ps(packet.Direction[0].data());
+		__m128 SSEf32_DirectionY = _mm_load_ps(packet.Direction[1].data());
+		__m128 SSEf32_DirectionZ = _mm_load_ps(packet.Direction[2].data());
+
+		__m128 SSEf32_Denominator = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(m_Normal.x), SSEf32_DirectionX),
+			_mm_mul_ps(_mm_set1_ps(m_Normal.y), SSEf32_DirectionY)),
+			_mm_mul_ps(_mm_set1_ps(m_Normal.z), SSEf32_DirectionZ));
+
+		// the origin relative to the corner, the numerator is the distance from it to the plane along the normal
+		__m128 SSEf32_QOX = _mm_sub_ps(_mm_load_ps(packet.Origin[0].data()), _mm_set1_ps(m_Q.x));
+		__m128 SSEf32_QOY = _mm_sub_ps(_mm_load_ps(packet.Origin[1].data()), _mm_set1_ps(m_Q.y));
+		__m128 SSEf32_QOZ = _mm_sub_ps(_mm_load_ps(packet.Origin[2].data()), _mm_set1_ps(m_Q.z));
+
+		__m128 SSEf32_Numerator = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(m_Normal.x), SSEf32_QOX),
+			_mm_mul_ps(_mm_set1_ps(m_Normal.y), SSEf32_QOY)),
+			_mm_mul_ps(_mm_set1_ps(m_Normal.z), SSEf32_QOZ));
+
+		__m128 SSEf32_T = _mm_div_ps(_mm_sub_ps(_mm_setzero_ps(), SSEf32_Numerator), SSEf32_Denominator);
+		__m128 SSEf32_TMax = _mm_load_ps(packet.TMax.data());
+
+		__m128 SSEf32_PlanarHitX = _mm_add_ps(_mm_mul_ps(SSEf32_T, SSEf32_DirectionX), SSEf32_QOX);
+		__m128 SSEf32_PlanarHitY = _mm_add_ps(_mm_mul_ps(SSEf32_T, SSEf32_DirectionY), SSEf32_QOY);
+		__m128 SSEf32_PlanarHitZ = _mm_add_ps(_mm_mul_ps(SSEf32_T, SSEf32_DirectionZ), SSEf32_QOZ);
+
+		__m128 SSEf32_Alpha = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(SSEf32_PlanarHitX, _mm_set1_ps(m_AlphaAxis.x)),
+			_mm_mul_ps(SSEf32_PlanarHitY, _mm_set1_ps(m_AlphaAxis.y))),
+			_mm_mul_ps(SSEf32_PlanarHitZ, _mm_set1_ps(m_AlphaAxis.z)));
+
+		__m128 SSEf32_Beta = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(SSEf32_PlanarHitX, _mm_set1_ps(m_BetaAxis.x)),
+			_mm_mul_ps(SSEf32_PlanarHitY, _mm_set1_ps(m_BetaAxis.y))),
+			_mm_mul_ps(SSEf32_PlanarHitZ, _mm_set1_ps(m_BetaAxis.z)));
+
+		// clearing the sign bit gives the absolute value
+		const __m128 SSEf32_One = _mm_set1_ps(1.0f);
+		__m128 SSEf32_HitLanes = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), SSEf32_Denominator), _mm_set1_ps(ParallelEpsilon));
+		SSEf32_HitLanes = _mm_and_ps(SSEf32_HitLanes, _mm_and_ps(_mm_cmpge_ps(SSEf32_T, _mm_load_ps(packet.TMin.data())), _mm_cmple_ps(SSEf32_T, SSEf32_TMax)));
+		SSEf32_HitLanes = _mm_and_ps(SSEf32_HitLanes, _mm_and_ps(_mm_cmpge_ps(SSEf32_Alpha, _mm_setzero_ps()), _mm_cmple_ps(SSEf32_Alpha, SSEf32_One)));
+		SSEf32_HitLanes = _mm_and_ps(SSEf32_HitLanes, _mm_and_ps(_mm_cmpge_ps(SSEf32_Beta, _mm_setzero_ps()), _mm_cmple_ps(SSEf32_Beta, SSEf32_One)));
+
+		u32 packetHitMask = static_cast<u32>(_mm_movemask_ps(SSEf32_HitLanes)) & laneMask;
+		if (packetHitMask == 0)
+			return 0;
+
+		// expands the hit bits back into a lane mask so only the lanes in laneMask that hit have their TMax replaced
+		const __m128i SSEi32_LaneBits = _mm_setr_epi32(1, 2, 4, 8);
+		SSEf32_HitLanes = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<i32>(packetHitMask)), SSEi32_LaneBits), SSEi32_LaneBits));
+		_mm_store_ps(packet.TMax.data(), _mm_blendv_ps(SSEf32_TMax, SSEf32_T, SSEf32_HitLanes));
+#endif
+
+		for (u32 hitLanes = packetHitMask; hitLanes != 0; hitLanes &= hitLanes - 1)
+		{
+			auto lane = static_cast<uSize>(std::countr_zero(hitLanes));
+			packet.HitObjects[lane] = this;
+			packet.HitPrimitives[lane] = 0;
+			packet.HitInstances[lane] = nullptr;
+		}
+
+		return packetHitMask;
+	}
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+#include "Ray.hpp"
+#include "AABB.hpp"
+
+#include <memory>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// A parallelogram with a corner at q and sides u and v, walls, floors and area lights that would otherwise be 2 triangles.
+	// It is bounded so it goes in a BVH like any other primitive, the hit point is tested against the sides with 2 dot products
+	class Quad : public BaseHitable
+	{
+	public:
+		Quad() = delete;
+		Quad(const Point& q, const Vec3& u, const Vec3& v, const std::shared_ptr<BaseMaterial>& mat);
+		~Quad() override = default;
+
+		Quad(const Quad&) = delete;
+		Quad& operator=(const Quad&) = delete;
+		Quad(Quad&&) = delete;
+		Quad& operator=(Quad&&) = delete;
+
+		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+		void __vectorcall FinalizeHit(const Ray& ray, HitData& hitData) const override;
+		u32 __vectorcall IsHitPacket(RayPacket& packet, u32 laneMask) const override;
+
+		AABB GetAABB() const override { return m_AABB; }
+
+	private:
+		// rays parallel to the quad miss it
+		static constexpr f32 ParallelEpsilon = 1e-8f;
+
+		// the distance to the plane of the quad and where on it the ray lands, alpha along u and beta along v, both in [0, 1] inside the quad
+		OWC_FORCE_INLINE bool __vectorcall Solve(const Ray& ray, const Interval& range, f32& t, f32& alpha, f32& beta) const
+		{
+			f32 denominator = glm::dot(m_Normal, ray.GetDirection());
+			if (glm::abs(denominator) < ParallelEpsilon)
+				return false;
+
+			t = (m_Distance - glm::dot(m_Normal, ray.GetOrigin())) / denominator;
+			if (!range.Contains(t))
+				return false;
+
+			Vec3 planarHit = ray.GetPointAtDistance(t) - m_Q;
+			alpha = glm::dot(planarHit, m_AlphaAxis);
+			beta = glm::dot(planarHit, m_BetaAxis);
+			return alpha >= 0.0f && alpha <= 1.0f && beta >= 0.0f && beta <= 1.0f;
+		}
+
+	private:
+		Point m_Q;
+		Vec3 m_Normal;
+		Vec3 m_AlphaAxis; // cross(v, w) with w = n / dot(n, n) for the unnormalized n = cross(u, v), so dot(q + a * u + b * v - q, m_AlphaAxis) = a
+		Vec3 m_BetaAxis; // cross(w, u)
+		f32 m_Distance; // dot(normal, q)
+		f32 m_UVDensity; // UV units per world unit, the geometric mean of the two sides
+		AABB m_AABB;
+		std::shared_ptr<BaseMaterial> m_Material;
+	};
+}
+
+#pragma warning(pop)
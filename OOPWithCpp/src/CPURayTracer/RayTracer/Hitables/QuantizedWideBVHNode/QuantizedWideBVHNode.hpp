@@ -0,0 +1,166 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "Ray.hpp"
+#include "WideBVHNode.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// WideBVHNode with every child's bounds stored as 8 bit steps from the node's own minimum instead of floats, a step is a power of two
+	// wide enough for 255 of them to span the node and the bounds are rounded outwards against the decoded floats so the boxes only ever grow.
+	// Interior children are stored one after another so a child is a byte offset from ChildBaseIndex,
+	// and LinearBVH orders its primitives so those of the leaf children sit one after another from PrimitiveBaseIndex
+	struct QuantizedWideBVHNode
+	{
+		using ChildDistances = WideBVHNode::ChildDistances;
+
+		static constexpr u32 MaxQuantizedValue = 255;
+
+		std::array<f32, 3> Origin{}; // the node's minimum
+		std::array<i8, 3> Exponents{}; // a step on each axis is 2^Exponent
+		u8 ChildMask = 0; // children in use
+		u32 ChildBaseIndex = 0;
+		u32 PrimitiveBaseIndex = 0;
+		std::array<std::array<u8, WideBVHWidth>, 6> QuantizedBounds{}; // same rows as WideBVHNode::Bounds
+		std::array<u8, WideBVHWidth> ChildOffsets{}; // interior: from ChildBaseIndex, leaf: from PrimitiveBaseIndex
+		std::array<u8, WideBVHWidth> NumberOfPrimitives{}; // 0 for interior children
+
+		OWC_FORCE_INLINE bool IsLeafChild(uSize child) const { return NumberOfPrimitives[child] != 0; }
+
+		OWC_FORCE_INLINE f32 GetScale(uSize axis) const
+		{
+			return std::bit_cast<f32>(static_cast<u32>(Exponents[axis] + 127) << 23);
+		}
+
+		// takes the bounds in the layout of BVHNode::Bounds, has to be called before any SetChildBounds
+		OWC_FORCE_INLINE void SetNodeBounds(const std::array<f32, 6>& bounds)
+		{
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				Origin[axis] = bounds[2 * axis];
+				f32 extent = bounds[2 * axis + 1] - bounds[2 * axis];
+
+				i32 exponent = extent > 0.0f ? static_cast<i32>(glm::ceil(glm::log2(extent / static_cast<f32>(MaxQuantizedValue)))) : -126;
+				exponent = glm::clamp(exponent, -126, 127);
+				// checked against the decoded float rather than extent, the origin is not a multiple of the step so the addition
+				// rounds and extent was rounded too, any child's maximum then always has a byte that decodes at or above it
+				while (exponent < 127 && Origin[axis] + static_cast<f32>(MaxQuantizedValue) * std::bit_cast<f32>(static_cast<u32>(exponent + 127) << 23) < bounds[2 * axis + 1])
+					exponent++;
+				Exponents[axis] = static_cast<i8>(exponent);
+			}
+		}
+
+		// rounds outwards so the decoded box always holds the child
+		OWC_FORCE_INLINE void SetChildBounds(uSize child, const std::array<f32, 6>& bounds)
+		{
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				f32 scale = GetScale(axis);
+				f32 invScale = 1.0f / scale; // exact as scale is a power of two
+
+				auto quantizedMin = static_cast<i32>(glm::floor((bounds[2 * axis] - Origin[axis]) * invScale));
+				auto quantizedMax = static_cast<i32>(glm::ceil((bounds[2 * axis + 1] - Origin[axis]) * invScale));
+				quantizedMin = glm::clamp(quantizedMin, 0, static_cast<i32>(MaxQuantizedValue));
+				quantizedMax = glm::clamp(quantizedMax, 0, static_cast<i32>(MaxQuantizedValue));
+
+				// the subtraction above can round either way
+				while (quantizedMin != 0 && Origin[axis] + static_cast<f32>(quantizedMin) * scale > bounds[2 * axis])
+					quantizedMin--;
+				while (quantizedMax != static_cast<i32>(MaxQuantizedValue) && Origin[axis] + static_cast<f32>(quantizedMax) * scale < bounds[2 * axis + 1])
+					quantizedMax++;
+
+				QuantizedBounds[2 * axis][child] = static_cast<u8>(quantizedMin);
+				QuantizedBounds[2 * axis + 1][child] = static_cast<u8>(quantizedMax);
+			}
+		}
+
+		// the child's decoded box in the layout of BVHNode::Bounds, holds the bounds SetChildBounds was given
+		OWC_FORCE_INLINE std::array<f32, 6> GetChildBounds(uSize child) const
+		{
+			std::array<f32, 6> bounds;
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				f32 scale = GetScale(axis);
+				bounds[2 * axis] = Origin[axis] + static_cast<f32>(QuantizedBounds[2 * axis][child]) * scale;
+				bounds[2 * axis + 1] = Origin[axis] + static_cast<f32>(QuantizedBounds[2 * axis + 1][child]) * scale;
+			}
+
+			return bounds;
+		}
+
+		// WideBVHNode::IntersectChildren with the bounds decoded to floats in register first
+		OWC_FORCE_INLINE u32 __vectorcall IntersectChildren(const WideBVHRay& ray, f32 tMin, f32 tMax, ChildDistances& childDistances) const
+		{
+#if AVX2
+			__m256 AVX2f32_TNear = _mm256_set1_ps(tMin);
+			__m256 AVX2f32_TFar = _mm256_set1_ps(tMax);
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				__m256 AVX2f32_Scale = _mm256_set1_ps(GetScale(axis));
+				__m256 AVX2f32_Origin = _mm256_set1_ps(Origin[axis]);
+				__m256 AVX2f32_InvDirection = _mm256_set1_ps(ray.InvDirection[static_cast<i32>(axis)]);
+				__m256 AVX2f32_OriginTimesInvDirection = _mm256_set1_ps(ray.OriginTimesInvDirection[static_cast<i32>(axis)]);
+
+				// 8 bytes widened to 8 floats, decoded with one fused multiply add
+				__m256 AVX2f32_NearQuantized = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(QuantizedBounds[ray.NearBoundsRow[axis]].data()))));
+				__m256 AVX2f32_FarQuantized = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(QuantizedBounds[ray.FarBoundsRow[axis]].data()))));
+				__m256 AVX2f32_NearBound = _mm256_fmadd_ps(AVX2f32_NearQuantized, AVX2f32_Scale, AVX2f32_Origin);
+				__m256 AVX2f32_FarBound = _mm256_fmadd_ps(AVX2f32_FarQuantized, AVX2f32_Scale, AVX2f32_Origin);
+
+				__m256 AVX2f32_AxisTNear = _mm256_fmsub_ps(AVX2f32_NearBound, AVX2f32_InvDirection, AVX2f32_OriginTimesInvDirection);
+				__m256 AVX2f32_AxisTFar = _mm256_fmsub_ps(AVX2f32_FarBound, AVX2f32_InvDirection, AVX2f32_OriginTimesInvDirection);
+				AVX2f32_TNear = _mm256_max_ps(AVX2f32_TNear, AVX2f32_AxisTNear);
+				AVX2f32_TFar = _mm256_min_ps(AVX2f32_TFar, AVX2f32_AxisTFar);
+			}
+
+			_mm256_store_ps(childDistances.data(), AVX2f32_TNear);
+#if AVX512
+			return static_cast<u32>(_mm256_cmp_ps_mask(AVX2f32_TNear, AVX2f32_TFar, _CMP_LT_OQ)) & ChildMask;
+#else
+			return static_cast<u32>(_mm256_movemask_ps(_mm256_cmp_ps(AVX2f32_TNear, AVX2f32_TFar, _CMP_LT_OQ))) & ChildMask;
+#endif
+#else
+			__m128 SSEf32_TNear = _mm_set1_ps(tMin);
+			__m128 SSEf32_TFar = _mm_set1_ps(tMax);
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				__m128 SSEf32_Scale = _mm_set1_ps(GetScale(axis));
+				__m128 SSEf32_Origin = _mm_set1_ps(Origin[axis]);
+				__m128 SSEf32_InvDirection = _mm_set1_ps(ray.InvDirection[static_cast<i32>(axis)]);
+				__m128 SSEf32_OriginTimesInvDirection = _mm_set1_ps(ray.OriginTimesInvDirection[static_cast<i32>(axis)]);
+
+				i32 nearBytes;
+				i32 farBytes;
+				std::memcpy(&nearBytes, QuantizedBounds[ray.NearBoundsRow[axis]].data(), sizeof(nearBytes));
+				std::memcpy(&farBytes, QuantizedBounds[ray.FarBoundsRow[axis]].data(), sizeof(farBytes));
+				__m128 SSEf32_NearBound = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(nearBytes))), SSEf32_Scale), SSEf32_Origin);
+				__m128 SSEf32_FarBound = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(farBytes))), SSEf32_Scale), SSEf32_Origin);
+
+				__m128 SSEf32_AxisTNear = _mm_sub_ps(_mm_mul_ps(SSEf32_NearBound, SSEf32_InvDirection), SSEf32_OriginTimesInvDirection);
+				__m128 SSEf32_AxisTFar = _mm_sub_ps(_mm_mul_ps(SSEf32_FarBound, SSEf32_InvDirection), SSEf32_OriginTimesInvDirection);
+				SSEf32_TNear = _mm_max_ps(SSEf32_TNear, SSEf32_AxisTNear);
+				SSEf32_TFar = _mm_min_ps(SSEf32_TFar, SSEf32_AxisTFar);
+			}
+
+			_mm_store_ps(childDistances.data(), SSEf32_TNear);
+			return static_cast<u32>(_mm_movemask_ps(_mm_cmplt_ps(SSEf32_TNear, SSEf32_TFar))) & ChildMask;
+#endif
+		}
+	};
+
+	// against the 256 and 128 bytes of a WideBVHNode
+#if AVX2
+	static_assert(sizeof(QuantizedWideBVHNode) == 88, "QuantizedWideBVHNode size is not 88 bytes!");
+#else
+	static_assert(sizeof(QuantizedWideBVHNode) == 56, "QuantizedWideBVHNode size is not 56 bytes!");
+#endif
+}
+
+#pragma warning(pop)
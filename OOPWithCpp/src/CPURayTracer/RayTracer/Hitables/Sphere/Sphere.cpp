@@ -1,43 +1,175 @@
 ﻿#include "Sphere.hpp"
+#include "BaseMaterial.hpp"
 
 #include <glm/gtx/norm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <bit>
+
 
 namespace OWC
 {
 	bool __vectorcall Sphere::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		f32 root;
+		if (!SolveNearestRoot(m_Center, m_Radius * m_Radius, ray, range, root))
+			return false;
+
+		range.SetMax(root);
+		hitData.Record(this, root);
+
+		return true;
+	}
+
+	void __vectorcall Sphere::FinalizeHit(const Ray& ray, HitData& hitData) const
+	{
+		hitData.point = ray.GetPointAtDistance(hitData.t);
+
+		Vec3 normal = (hitData.point - m_Center) * m_InvRadius;
+		hitData.SetFaceNormal(ray, normal);
+		hitData.uv = GetSphereUV(hitData.normal);
+		hitData.footprint *= m_InvRadius * glm::one_over_pi<f32>(); // v goes from pole to pole
+
+		hitData.material = &m_Material->GetCompiled();
+	}
+
+	bool __vectorcall Sphere::IsOccluded(const Ray& ray, const Interval& range) const
 	{
 		Vec3 oc = m_Center - ray.GetOrigin();
 
-		constexpr f32 a = 1.0f; // ray direction is normalized so the length squared will alway be 1
 		f32 h = glm::dot(oc, ray.GetDirection());
 		f32 c = glm::length2(oc) - m_Radius * m_Radius;
 
-		f32 discriminant = h * h - a * c;
+		f32 discriminant = h * h - c;
 		if (discriminant <= 0.0f)
 			return false;
 
 		f32 sqrtDiscriminant = glm::sqrt(discriminant);
+		return range.Contains(h - sqrtDiscriminant) || range.Contains(h + sqrtDiscriminant);
+	}
 
-		f32 root = (h - sqrtDiscriminant) / a;
-		if (!range.Contains(root))
-		{
-			root = (h + sqrtDiscriminant) / a;
-			if (!range.Contains(root))
-				return false;
-		}
+	u32 __vectorcall Sphere::IsHitPacket(RayPacket& packet, u32 laneMask) const
+	{
+		// same quadratic as IsHit with every lane solved at once, lanes outside laneMask or without a root in range are left alone
+#if AVX512
+		__m512 AVX512f32_OCX = _mm512_sub_ps(_mm512_set1_ps(m_Center.x), _mm512_load_ps(packet.Origin[0].data()));
+		__m512 AVX512f32_OCY = _mm512_sub_ps(_mm512_set1_ps(m_Center.y), _mm512_load_ps(packet.Origin[1].data()));
+		__m512 AVX512f32_OCZ = _mm512_sub_ps(_mm512_set1_ps(m_Center.z), _mm512_load_ps(packet.Origin[2].data()));
 
-		range.SetMax(root);
-		hitData.point = ray.GetPointAtDistance(root);
+		__m512 AVX512f32_H = _mm512_mul_ps(AVX512f32_OCX, _mm512_load_ps(packet.Direction[0].data()));
+		AVX512f32_H = _mm512_fmadd_ps(AVX512f32_OCY, _mm512_load_ps(packet.Direction[1].data()), AVX512f32_H);
+		AVX512f32_H = _mm512_fmadd_ps(AVX512f32_OCZ, _mm512_load_ps(packet.Direction[2].data()), AVX512f32_H);
 
-		Vec3 normal = (hitData.point - m_Center) * m_InvRadius;
-		hitData.SetFaceNormal(ray, normal);
-		hitData.uv = GetSphereUV(hitData.normal);
+		__m512 AVX512f32_C = _mm512_fmsub_ps(AVX512f32_OCX, AVX512f32_OCX, _mm512_set1_ps(m_Radius * m_Radius));
+		AVX512f32_C = _mm512_fmadd_ps(AVX512f32_OCY, AVX512f32_OCY, AVX512f32_C);
+		AVX512f32_C = _mm512_fmadd_ps(AVX512f32_OCZ, AVX512f32_OCZ, AVX512f32_C);
 
-		hitData.material = m_Material.get();
+		__m512 AVX512f32_Discriminant = _mm512_fmsub_ps(AVX512f32_H, AVX512f32_H, AVX512f32_C);
+		__mmask16 validMask = _mm512_mask_cmp_ps_mask(static_cast<__mmask16>(laneMask), AVX512f32_Discriminant, _mm512_setzero_ps(), _CMP_GT_OQ);
+		if (validMask == 0)
+			return 0;
 
-		return true;
+		__m512 AVX512f32_SqrtDiscriminant = _mm512_sqrt_ps(AVX512f32_Discriminant);
+		__m512 AVX512f32_TMin = _mm512_load_ps(packet.TMin.data());
+		__m512 AVX512f32_TMax = _mm512_load_ps(packet.TMax.data());
+
+		__m512 AVX512f32_NearRoot = _mm512_sub_ps(AVX512f32_H, AVX512f32_SqrtDiscriminant);
+		__mmask16 nearMask = _mm512_mask_cmp_ps_mask(validMask, AVX512f32_NearRoot, AVX512f32_TMin, _CMP_GE_OQ);
+		nearMask = _mm512_mask_cmp_ps_mask(nearMask, AVX512f32_NearRoot, AVX512f32_TMax, _CMP_LE_OQ);
+
+		__m512 AVX512f32_FarRoot = _mm512_add_ps(AVX512f32_H, AVX512f32_SqrtDiscriminant);
+		__mmask16 farMask = _mm512_mask_cmp_ps_mask(validMask & ~nearMask, AVX512f32_FarRoot, AVX512f32_TMin, _CMP_GE_OQ);
+		farMask = _mm512_mask_cmp_ps_mask(farMask, AVX512f32_FarRoot, AVX512f32_TMax, _CMP_LE_OQ);
+
+		__mmask16 hitMask = nearMask | farMask;
+		_mm512_mask_store_ps(packet.TMax.data(), hitMask, _mm512_mask_blend_ps(nearMask, AVX512f32_FarRoot, AVX512f32_NearRoot));
+		auto packetHitMask = static_cast<u32>(hitMask);
+#elif AVX2
+		__m256 AVX2f32_OCX = _mm256_sub_ps(_mm256_set1_ps(m_Center.x), _mm256_load_ps(packet.Origin[0].data()));
+		__m256 AVX2f32_OCY = _mm256_sub_ps(_mm256_set1_ps(m_Center.y), _mm256_load_ps(packet.Origin[1].data()));
+		__m256 AVX2f32_OCZ = _mm256_sub_ps(_mm256_set1_ps(m_Center.z), _mm256_load_ps(packet.Origin[2].data()));
+
+		__m256 AVX2f32_H = _mm256_mul_ps(AVX2f32_OCX, _mm256_load_ps(packet.Direction[0].data()));
+		AVX2f32_H = _mm256_fmadd_ps(AVX2f32_OCY, _mm256_load_ps(packet.Direction[1].data()), AVX2f32_H);
+		AVX2f32_H = _mm256_fmadd_ps(AVX2f32_OCZ, _mm256_load_ps(packet.Direction[2].data()), AVX2f32_H);
+
+		__m256 AVX2f32_C = _mm256_fmsub_ps(AVX2f32_OCX, AVX2f32_OCX, _mm256_set1_ps(m_Radius * m_Radius));
+		AVX2f32_C = _mm256_fmadd_ps(AVX2f32_OCY, AVX2f32_OCY, AVX2f32_C);
+		AVX2f32_C = _mm256_fmadd_ps(AVX2f32_OCZ, AVX2f32_OCZ, AVX2f32_C);
+
+		__m256 AVX2f32_Discriminant = _mm256_fmsub_ps(AVX2f32_H, AVX2f32_H, AVX2f32_C);
+		u32 validMask = static_cast<u32>(_mm256_movemask_ps(_mm256_cmp_ps(AVX2f32_Discriminant, _mm256_setzero_ps(), _CMP_GT_OQ))) & laneMask;
+		if (validMask == 0)
+			return 0;
+
+		// lanes with a negative discriminant get NaN roots which fail every ordered compare below
+		__m256 AVX2f32_SqrtDiscriminant = _mm256_sqrt_ps(AVX2f32_Discriminant);
+		__m256 AVX2f32_TMin = _mm256_load_ps(packet.TMin.data());
+		__m256 AVX2f32_TMax = _mm256_load_ps(packet.TMax.data());
+
+		__m256 AVX2f32_NearRoot = _mm256_sub_ps(AVX2f32_H, AVX2f32_SqrtDiscriminant);
+		__m256 AVX2f32_NearInRange = _mm256_and_ps(_mm256_cmp_ps(AVX2f32_NearRoot, AVX2f32_TMin, _CMP_GE_OQ), _mm256_cmp_ps(AVX2f32_NearRoot, AVX2f32_TMax, _CMP_LE_OQ));
+
+		__m256 AVX2f32_FarRoot = _mm256_add_ps(AVX2f32_H, AVX2f32_SqrtDiscriminant);
+		__m256 AVX2f32_FarInRange = _mm256_and_ps(_mm256_cmp_ps(AVX2f32_FarRoot, AVX2f32_TMin, _CMP_GE_OQ), _mm256_cmp_ps(AVX2f32_FarRoot, AVX2f32_TMax, _CMP_LE_OQ));
+
+		u32 packetHitMask = static_cast<u32>(_mm256_movemask_ps(_mm256_or_ps(AVX2f32_NearInRange, AVX2f32_FarInRange))) & validMask;
+
+		// expands the hit bits back into a lane mask so only the lanes that hit have their TMax replaced
+		const __m256i AVX2i32_LaneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		__m256 AVX2f32_HitLanes = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<i32>(packetHitMask)), AVX2i32_LaneBits), AVX2i32_LaneBits));
+		__m256 AVX2f32_Root = _mm256_blendv_ps(AVX2f32_FarRoot, AVX2f32_NearRoot, AVX2f32_NearInRange);
+		_mm256_store_ps(packet.TMax.data(), _mm256_blendv_ps(AVX2f32_TMax, AVX2f32_Root, AVX2f32_HitLanes));
+#else
+		__m128 SSEf32_OCX = _mm_sub_ps(_mm_set1_ps(m_Center.x), _mm_load_ps(packet.Origin[0].data()));
+		__m128 SSEf32_OCY = _mm_sub_ps(_mm_set1_ps(m_Center.y), _mm_load_ps(packet.Origin[1].data()));
+		__m128 SSEf32_OCZ = _mm_sub_ps(_mm_set1_ps(m_Center.z), _mm_load_ps(packet.Origin[2].data()));
+
+		__m128 SSEf32_H = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(SSEf32_OCX, _mm_load_ps(packet.Direction[0].data())),
+			_mm_mul_ps(SSEf32_OCY, _mm_load_ps(packet.Direction[1].data()))),
+			_mm_mul_ps(SSEf32_OCZ, _mm_load_ps(packet.Direction[2].data())));
+
+		__m128 SSEf32_C = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(SSEf32_OCX, SSEf32_OCX),
+			_mm_mul_ps(SSEf32_OCY, SSEf32_OCY)),
+			_mm_mul_ps(SSEf32_OCZ, SSEf32_OCZ)),
+			_mm_set1_ps(m_Radius * m_Radius));
+
+		__m128 SSEf32_Discriminant = _mm_sub_ps(_mm_mul_ps(SSEf32_H, SSEf32_H), SSEf32_C);
+		u32 validMask = static_cast<u32>(_mm_movemask_ps(_mm_cmpgt_ps(SSEf32_Discriminant, _mm_setzero_ps()))) & laneMask;
+		if (validMask == 0)
+			return 0;
+
+		// lanes with a negative discriminant get NaN roots which fail every ordered compare below
+		__m128 SSEf32_SqrtDiscriminant = _mm_sqrt_ps(SSEf32_Discriminant);
+		__m128 SSEf32_TMin = _mm_load_ps(packet.TMin.data());
+		__m128 SSEf32_TMax = _mm_load_ps(packet.TMax.data());
+
+		__m128 SSEf32_NearRoot = _mm_sub_ps(SSEf32_H, SSEf32_SqrtDiscriminant);
+		__m128 SSEf32_NearInRange = _mm_and_ps(_mm_cmpge_ps(SSEf32_NearRoot, SSEf32_TMin), _mm_cmple_ps(SSEf32_NearRoot, SSEf32_TMax));
+
+		__m128 SSEf32_FarRoot = _mm_add_ps(SSEf32_H, SSEf32_SqrtDiscriminant);
+		__m128 SSEf32_FarInRange = _mm_and_ps(_mm_cmpge_ps(SSEf32_FarRoot, SSEf32_TMin), _mm_cmple_ps(SSEf32_FarRoot, SSEf32_TMax));
+
+		u32 packetHitMask = static_cast<u32>(_mm_movemask_ps(_mm_or_ps(SSEf32_NearInRange, SSEf32_FarInRange))) & validMask;
+
+		// expands the hit bits back into a lane mask so only the lanes that hit have their TMax replaced
+		const __m128i SSEi32_LaneBits = _mm_setr_epi32(1, 2, 4, 8);
+		__m128 SSEf32_HitLanes = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<i32>(packetHitMask)), SSEi32_LaneBits), SSEi32_LaneBits));
+		__m128 SSEf32_Root = _mm_blendv_ps(SSEf32_FarRoot, SSEf32_NearRoot, SSEf32_NearInRange);
+		_mm_store_ps(packet.TMax.data(), _mm_blendv_ps(SSEf32_TMax, SSEf32_Root, SSEf32_HitLanes));
+#endif
+
+		for (u32 hitLanes = packetHitMask; hitLanes != 0; hitLanes &= hitLanes - 1)
+		{
+			auto lane = static_cast<uSize>(std::countr_zero(hitLanes));
+			packet.HitObjects[lane] = this;
+			packet.HitPrimitives[lane] = 0;
+			packet.HitInstances[lane] = nullptr;
+		}
+
+		return packetHitMask;
 	}
 
 	AABB Sphere::GetAABB() const
@@ -3,6 +3,8 @@
 #include "Ray.hpp"
 #include "AABB.hpp"
 
+#include <glm/gtx/norm.hpp>
+
 #include <memory>
 
 #pragma warning(push)
@@ -15,7 +17,9 @@ namespace OWC
 	{
 	public:
 		Sphere() = delete;
-		OWC_FORCE_INLINE Sphere(const Vec3& center, f32 radius, const std::shared_ptr<BaseMaterial>& mat) : m_Radius(radius), m_InvRadius(1.0f / radius), m_Center(center), m_Material(mat) {}
+		OWC_FORCE_INLINE Sphere(const Vec3& center, f32 radius, const std::shared_ptr<BaseMaterial>& mat) : Sphere(center, radius, *mat) { m_MaterialOwner = mat; }
+		// does not own the material, which has to outlive the sphere, as one from the same SceneArena does
+		OWC_FORCE_INLINE Sphere(const Vec3& center, f32 radius, const BaseMaterial& mat) : m_Radius(radius), m_InvRadius(1.0f / radius), m_Center(center), m_Material(&mat) {}
 		~Sphere() override = default;
 
 		Sphere(const Sphere&) = delete;
@@ -24,9 +28,40 @@ namespace OWC
 		Sphere& operator=(Sphere&&) = delete;
 
 		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+		void __vectorcall FinalizeHit(const Ray& ray, HitData& hitData) const override;
+		u32 __vectorcall IsHitPacket(RayPacket& packet, u32 laneMask) const override;
 
 		AABB GetAABB() const override;
 
+		OWC_FORCE_INLINE const Vec3& GetCenter() const { return m_Center; }
+		OWC_FORCE_INLINE f32 GetRadius() const { return m_Radius; }
+		// the BVH the sphere is in has to be refit or rebuilt before the next trace
+		OWC_FORCE_INLINE void SetCenter(const Vec3& center) { m_Center = center; }
+
+		// the nearest root in range of the ray against a sphere, shared by IsHit and the compiled spheres of PrimitiveArray
+		static OWC_FORCE_INLINE bool __vectorcall SolveNearestRoot(const Vec3& center, f32 radiusSquared, const Ray& ray, const Interval& range, f32& root)
+		{
+			Vec3 oc = center - ray.GetOrigin();
+
+			constexpr f32 a = 1.0f; // ray direction is normalized so the length squared will alway be 1
+			f32 h = glm::dot(oc, ray.GetDirection());
+			f32 c = glm::length2(oc) - radiusSquared;
+
+			f32 discriminant = h * h - a * c;
+			if (discriminant <= 0.0f)
+				return false;
+
+			f32 sqrtDiscriminant = glm::sqrt(discriminant);
+
+			root = (h - sqrtDiscriminant) / a;
+			if (range.Contains(root))
+				return true;
+
+			root = (h + sqrtDiscriminant) / a;
+			return range.Contains(root);
+		}
+
 	private:
 		static Vec2 GetSphereUV(const Vec3& point);
 
@@ -34,7 +69,8 @@ namespace OWC
 		f32 m_Radius;
 		f32 m_InvRadius;
 		Vec3 m_Center;
-		std::shared_ptr<BaseMaterial> m_Material;
+		const BaseMaterial* m_Material;
+		std::shared_ptr<const BaseMaterial> m_MaterialOwner; // empty when something else owns the material
 	};
 }
 
@@ -0,0 +1,162 @@
+﻿#include "SphereBatch.hpp"
+
+#include <bit>
+#include <limits>
+
+
+namespace OWC
+{
+	SphereBatch::SphereBatch(std::span<const Sphere* const> spheres)
+		: m_NumberOfSpheres(glm::min(spheres.size(), SphereBatchWidth))
+	{
+		for (uSize lane = 0; lane != m_NumberOfSpheres; lane++)
+			m_Spheres[lane] = spheres[lane];
+
+		m_LaneMask = static_cast<u32>((u64(1) << m_NumberOfSpheres) - 1);
+		Refit();
+	}
+
+	void SphereBatch::Refit()
+	{
+		m_AABB = AABB::Empty;
+		for (uSize lane = 0; lane != m_NumberOfSpheres; lane++)
+		{
+			const Sphere* sphere = m_Spheres[lane];
+			m_CenterX[lane] = sphere->GetCenter().x;
+			m_CenterY[lane] = sphere->GetCenter().y;
+			m_CenterZ[lane] = sphere->GetCenter().z;
+			m_RadiusSquared[lane] = sphere->GetRadius() * sphere->GetRadius();
+			m_AABB.Expand(sphere->GetAABB());
+		}
+	}
+
+	bool __vectorcall SphereBatch::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		alignas(64) std::array<f32, SphereBatchWidth> roots;
+		u32 hitMask = IntersectSpheres(ray, range, roots);
+		if (hitMask == 0)
+			return false;
+
+		// few lanes hit at once, a scan over them is cheaper than a horizontal min across the register
+		auto nearestLane = static_cast<uSize>(std::countr_zero(hitMask));
+		for (hitMask &= hitMask - 1; hitMask != 0; hitMask &= hitMask - 1)
+		{
+			auto lane = static_cast<uSize>(std::countr_zero(hitMask));
+			if (roots[lane] < roots[nearestLane])
+				nearestLane = lane;
+		}
+
+		range.SetMax(roots[nearestLane]);
+		hitData.Record(m_Spheres[nearestLane], roots[nearestLane]);
+		return true;
+	}
+
+	bool __vectorcall SphereBatch::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		alignas(64) std::array<f32, SphereBatchWidth> roots;
+		return IntersectSpheres(ray, range, roots) != 0;
+	}
+
+	u32 __vectorcall SphereBatch::IntersectSpheres(const Ray& ray, const Interval& range, std::array<f32, SphereBatchWidth>& roots) const
+	{
+		// the quadratic of Sphere::IsHit with the ray broadcast and one sphere per lane
+#if AVX512
+		__m512 AVX512f32_OCX = _mm512_sub_ps(_mm512_load_ps(m_CenterX.data()), _mm512_set1_ps(ray.GetOrigin().x));
+		__m512 AVX512f32_OCY = _mm512_sub_ps(_mm512_load_ps(m_CenterY.data()), _mm512_set1_ps(ray.GetOrigin().y));
+		__m512 AVX512f32_OCZ = _mm512_sub_ps(_mm512_load_ps(m_CenterZ.data()), _mm512_set1_ps(ray.GetOrigin().z));
+
+		__m512 AVX512f32_H = _mm512_mul_ps(AVX512f32_OCX, _mm512_set1_ps(ray.GetDirection().x));
+		AVX512f32_H = _mm512_fmadd_ps(AVX512f32_OCY, _mm512_set1_ps(ray.GetDirection().y), AVX512f32_H);
+		AVX512f32_H = _mm512_fmadd_ps(AVX512f32_OCZ, _mm512_set1_ps(ray.GetDirection().z), AVX512f32_H);
+
+		__m512 AVX512f32_C = _mm512_fmsub_ps(AVX512f32_OCX, AVX512f32_OCX, _mm512_load_ps(m_RadiusSquared.data()));
+		AVX512f32_C = _mm512_fmadd_ps(AVX512f32_OCY, AVX512f32_OCY, AVX512f32_C);
+		AVX512f32_C = _mm512_fmadd_ps(AVX512f32_OCZ, AVX512f32_OCZ, AVX512f32_C);
+
+		__m512 AVX512f32_Discriminant = _mm512_fmsub_ps(AVX512f32_H, AVX512f32_H, AVX512f32_C);
+		__mmask16 validMask = _mm512_mask_cmp_ps_mask(static_cast<__mmask16>(m_LaneMask), AVX512f32_Discriminant, _mm512_setzero_ps(), _CMP_GT_OQ);
+		if (validMask == 0)
+			return 0;
+
+		__m512 AVX512f32_SqrtDiscriminant = _mm512_sqrt_ps(AVX512f32_Discriminant);
+		__m512 AVX512f32_TMin = _mm512_set1_ps(range.GetMin());
+		__m512 AVX512f32_TMax = _mm512_set1_ps(range.GetMax());
+
+		__m512 AVX512f32_NearRoot = _mm512_sub_ps(AVX512f32_H, AVX512f32_SqrtDiscriminant);
+		__mmask16 nearMask = _mm512_mask_cmp_ps_mask(validMask, AVX512f32_NearRoot, AVX512f32_TMin, _CMP_GE_OQ);
+		nearMask = _mm512_mask_cmp_ps_mask(nearMask, AVX512f32_NearRoot, AVX512f32_TMax, _CMP_LE_OQ);
+
+		__m512 AVX512f32_FarRoot = _mm512_add_ps(AVX512f32_H, AVX512f32_SqrtDiscriminant);
+		__mmask16 farMask = _mm512_mask_cmp_ps_mask(validMask & ~nearMask, AVX512f32_FarRoot, AVX512f32_TMin, _CMP_GE_OQ);
+		farMask = _mm512_mask_cmp_ps_mask(farMask, AVX512f32_FarRoot, AVX512f32_TMax, _CMP_LE_OQ);
+
+		_mm512_store_ps(roots.data(), _mm512_mask_blend_ps(nearMask, AVX512f32_FarRoot, AVX512f32_NearRoot));
+		return static_cast<u32>(nearMask | farMask);
+#elif AVX2
+		__m256 AVX2f32_OCX = _mm256_sub_ps(_mm256_load_ps(m_CenterX.data()), _mm256_set1_ps(ray.GetOrigin().x));
+		__m256 AVX2f32_OCY = _mm256_sub_ps(_mm256_load_ps(m_CenterY.data()), _mm256_set1_ps(ray.GetOrigin().y));
+		__m256 AVX2f32_OCZ = _mm256_sub_ps(_mm256_load_ps(m_CenterZ.data()), _mm256_set1_ps(ray.GetOrigin().z));
+
+		__m256 AVX2f32_H = _mm256_mul_ps(AVX2f32_OCX, _mm256_set1_ps(ray.GetDirection().x));
+		AVX2f32_H = _mm256_fmadd_ps(AVX2f32_OCY, _mm256_set1_ps(ray.GetDirection().y), AVX2f32_H);
+		AVX2f32_H = _mm256_fmadd_ps(AVX2f32_OCZ, _mm256_set1_ps(ray.GetDirection().z), AVX2f32_H);
+
+		__m256 AVX2f32_C = _mm256_fmsub_ps(AVX2f32_OCX, AVX2f32_OCX, _mm256_load_ps(m_RadiusSquared.data()));
+		AVX2f32_C = _mm256_fmadd_ps(AVX2f32_OCY, AVX2f32_OCY, AVX2f32_C);
+		AVX2f32_C = _mm256_fmadd_ps(AVX2f32_OCZ, AVX2f32_OCZ, AVX2f32_C);
+
+		__m256 AVX2f32_Discriminant = _mm256_fmsub_ps(AVX2f32_H, AVX2f32_H, AVX2f32_C);
+		u32 validMask = static_cast<u32>(_mm256_movemask_ps(_mm256_cmp_ps(AVX2f32_Discriminant, _mm256_setzero_ps(), _CMP_GT_OQ))) & m_LaneMask;
+		if (validMask == 0)
+			return 0;
+
+		// lanes with a negative discriminant get NaN roots which fail every ordered compare below
+		__m256 AVX2f32_SqrtDiscriminant = _mm256_sqrt_ps(AVX2f32_Discriminant);
+		__m256 AVX2f32_TMin = _mm256_set1_ps(range.GetMin());
+		__m256 AVX2f32_TMax = _mm256_set1_ps(range.GetMax());
+
+		__m256 AVX2f32_NearRoot = _mm256_sub_ps(AVX2f32_H, AVX2f32_SqrtDiscriminant);
+		__m256 AVX2f32_NearInRange = _mm256_and_ps(_mm256_cmp_ps(AVX2f32_NearRoot, AVX2f32_TMin, _CMP_GE_OQ), _mm256_cmp_ps(AVX2f32_NearRoot, AVX2f32_TMax, _CMP_LE_OQ));
+
+		__m256 AVX2f32_FarRoot = _mm256_add_ps(AVX2f32_H, AVX2f32_SqrtDiscriminant);
+		__m256 AVX2f32_FarInRange = _mm256_and_ps(_mm256_cmp_ps(AVX2f32_FarRoot, AVX2f32_TMin, _CMP_GE_OQ), _mm256_cmp_ps(AVX2f32_FarRoot, AVX2f32_TMax, _CMP_LE_OQ));
+
+		_mm256_store_ps(roots.data(), _mm256_blendv_ps(AVX2f32_FarRoot, AVX2f32_NearRoot, AVX2f32_NearInRange));
+		return static_cast<u32>(_mm256_movemask_ps(_mm256_or_ps(AVX2f32_NearInRange, AVX2f32_FarInRange))) & validMask;
+#else
+		__m128 SSEf32_OCX = _mm_sub_ps(_mm_load_ps(m_CenterX.data()), _mm_set1_ps(ray.GetOrigin().x));
+		__m128 SSEf32_OCY = _mm_sub_ps(_mm_load_ps(m_CenterY.data()), _mm_set1_ps(ray.GetOrigin().y));
+		__m128 SSEf32_OCZ = _mm_sub_ps(_mm_load_ps(m_CenterZ.data()), _mm_set1_ps(ray.GetOrigin().z));
+
+		__m128 SSEf32_H = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(SSEf32_OCX, _mm_set1_ps(ray.GetDirection().x)),
+			_mm_mul_ps(SSEf32_OCY, _mm_set1_ps(ray.GetDirection().y))),
+			_mm_mul_ps(SSEf32_OCZ, _mm_set1_ps(ray.GetDirection().z)));
+
+		__m128 SSEf32_C = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(SSEf32_OCX, SSEf32_OCX),
+			_mm_mul_ps(SSEf32_OCY, SSEf32_OCY)),
+			_mm_mul_ps(SSEf32_OCZ, SSEf32_OCZ)),
+			_mm_load_ps(m_RadiusSquared.data()));
+
+		__m128 SSEf32_Discriminant = _mm_sub_ps(_mm_mul_ps(SSEf32_H, SSEf32_H), SSEf32_C);
+		u32 validMask = static_cast<u32>(_mm_movemask_ps(_mm_cmpgt_ps(SSEf32_Discriminant, _mm_setzero_ps()))) & m_LaneMask;
+		if (validMask == 0)
+			return 0;
+
+		// lanes with a negative discriminant get NaN roots which fail every ordered compare below
+		__m128 SSEf32_SqrtDiscriminant = _mm_sqrt_ps(SSEf32_Discriminant);
+		__m128 SSEf32_TMin = _mm_set1_ps(range.GetMin());
+		__m128 SSEf32_TMax = _mm_set1_ps(range.GetMax());
+
+		__m128 SSEf32_NearRoot = _mm_sub_ps(SSEf32_H, SSEf32_SqrtDiscriminant);
+		__m128 SSEf32_NearInRange = _mm_and_ps(_mm_cmpge_ps(SSEf32_NearRoot, SSEf32_TMin), _mm_cmple_ps(SSEf32_NearRoot, SSEf32_TMax));
+
+		__m128 SSEf32_FarRoot = _mm_add_ps(SSEf32_H, SSEf32_SqrtDiscriminant);
+		__m128 SSEf32_FarInRange = _mm_and_ps(_mm_cmpge_ps(SSEf32_FarRoot, SSEf32_TMin), _mm_cmple_ps(SSEf32_FarRoot, SSEf32_TMax));
+
+		_mm_store_ps(roots.data(), _mm_blendv_ps(SSEf32_FarRoot, SSEf32_NearRoot, SSEf32_NearInRange));
+		return static_cast<u32>(_mm_movemask_ps(_mm_or_ps(SSEf32_NearInRange, SSEf32_FarInRange))) & validMask;
+#endif
+	}
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+#include "Sphere.hpp"
+
+#include <array>
+#include <span>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// one sphere per SIMD lane
+#if AVX512
+	inline constexpr uSize SphereBatchWidth = 16;
+#elif AVX2
+	inline constexpr uSize SphereBatchWidth = 8;
+#else
+	inline constexpr uSize SphereBatchWidth = 4;
+#endif
+
+	// Up to SphereBatchWidth spheres of a BVH leaf stored as SoA and intersected together, built by SplitBVH.
+	// Hits are recorded against the Sphere itself so it finalizes them as usual, the spheres must outlive the batch.
+	class alignas(64) SphereBatch : public BaseHitable
+	{
+	public:
+		SphereBatch() = delete;
+		explicit SphereBatch(std::span<const Sphere* const> spheres);
+		~SphereBatch() override = default;
+
+		SphereBatch(const SphereBatch&) = delete;
+		SphereBatch& operator=(const SphereBatch&) = delete;
+		SphereBatch(SphereBatch&&) = delete;
+		SphereBatch& operator=(SphereBatch&&) = delete;
+
+		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+
+		AABB GetAABB() const override { return m_AABB; }
+
+		OWC_FORCE_INLINE uSize GetNumberOfSpheres() const { return m_NumberOfSpheres; }
+		// copies the spheres again after they moved
+		void Refit();
+
+	private:
+		// lanes with a root inside range, writes the nearest root of each such lane to roots
+		u32 __vectorcall IntersectSpheres(const Ray& ray, const Interval& range, std::array<f32, SphereBatchWidth>& roots) const;
+
+	private:
+		alignas(64) std::array<f32, SphereBatchWidth> m_CenterX{};
+		alignas(64) std::array<f32, SphereBatchWidth> m_CenterY{};
+		alignas(64) std::array<f32, SphereBatchWidth> m_CenterZ{};
+		alignas(64) std::array<f32, SphereBatchWidth> m_RadiusSquared{};
+		std::array<const Sphere*, SphereBatchWidth> m_Spheres{};
+		u32 m_LaneMask = 0; // lanes holding a sphere
+		uSize m_NumberOfSpheres = 0;
+		AABB m_AABB = AABB::Empty;
+	};
+}
+
+#pragma warning(pop)
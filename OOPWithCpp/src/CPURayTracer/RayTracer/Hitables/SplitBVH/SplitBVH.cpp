@@ -1,122 +1,844 @@
 ﻿#include "SplitBVH.hpp"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <future>
+#include <thread>
+#include <bit>
+#include <span>
+#include <cassert>
 
 
 namespace OWC
 {
-	SplitBVH::SplitBVH(const std::shared_ptr<Hitables>& hitables)
+	namespace
+	{
+		OWC_FORCE_INLINE f32 SurfaceArea(const AABB& aabb)
+		{
+			return static_cast<f32>(aabb.GetSurfaceArea());
+		}
+
+		f32 OverlapSurfaceArea(const AABB& a, const AABB& b)
+		{
+			Vec3 size(0.0f);
+			for (AABB::Axis axis = AABB::Axis::x; axis <= AABB::Axis::z; axis++)
+			{
+				const Interval& aInterval = a.GetAxisInterval(axis);
+				const Interval& bInterval = b.GetAxisInterval(axis);
+				size[+axis] = glm::min(aInterval.GetMax(), bInterval.GetMax()) - glm::max(aInterval.GetMin(), bInterval.GetMin());
+				if (size[+axis] <= 0.0f)
+					return 0.0f;
+			}
+
+			return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+		}
+
+		AABB ClipToAxisRange(const AABB& aabb, AABB::Axis axis, f32 min, f32 max)
+		{
+			std::array<Interval, 3> intervals = { aabb.GetAxisInterval(AABB::Axis::x), aabb.GetAxisInterval(AABB::Axis::y), aabb.GetAxisInterval(AABB::Axis::z) };
+			Interval& clippedInterval = intervals[+axis];
+			clippedInterval.SetMinMax(glm::max(clippedInterval.GetMin(), min), glm::min(clippedInterval.GetMax(), max));
+			return AABB(intervals[0], intervals[1], intervals[2]);
+		}
+
+		OWC_FORCE_INLINE uSize GetBinIndex(f32 position, f32 binOrigin, f32 binScale)
+		{
+			return static_cast<uSize>(glm::clamp((position - binOrigin) * binScale, 0.0f, static_cast<f32>(SplitBVH::NumberOfBins - 1)));
+		}
+
+		// the most references a node at depth can hold and still be median split into leaves of at most MaxLeafReferences before LinearBVH::MaxDepth
+		uSize MaxReferencesAtDepth(uSize depth)
+		{
+			auto levelsLeft = static_cast<i32>(LinearBVH::MaxDepth - 1 - depth);
+			return levelsLeft >= std::countl_zero(SplitBVH::MaxLeafReferences) ?
+				std::numeric_limits<uSize>::max() :
+				SplitBVH::MaxLeafReferences << levelsLeft;
+		}
+
+		// takes up to count threads from the build's budget, returns how many it got, they have to be given back with fetch_add once done
+		uSize AcquireBuildThreads(std::atomic<uSize>& freeThreads, uSize count)
+		{
+			uSize available = freeThreads.load(std::memory_order_relaxed);
+			uSize taken;
+			do
+			{
+				taken = glm::min(available, count);
+				if (taken == 0)
+					return 0;
+			} while (!freeThreads.compare_exchange_weak(available, available - taken, std::memory_order_relaxed));
+
+			return taken;
+		}
+
+		// splits [0, count) into up to one chunk per core when there is enough work, runs chunkFunction on every chunk and merges the results in order
+		// the extra chunks only get the threads left in freeThreads, which subtree tasks draw from too, so nested reduces never oversubscribe the cores
+		template<typename Result, typename ChunkFunction, typename MergeFunction>
+		Result ParallelReduce(std::atomic<uSize>& freeThreads, uSize count, uSize minChunkSize, const ChunkFunction& chunkFunction, const MergeFunction& mergeFunction)
+		{
+			uSize numberOfChunks = glm::min(static_cast<uSize>(std::thread::hardware_concurrency()), count / minChunkSize);
+			if (numberOfChunks <= 1)
+				return chunkFunction(uSize(0), count);
+
+			uSize numberOfThreads = AcquireBuildThreads(freeThreads, numberOfChunks - 1);
+			if (numberOfThreads == 0)
+				return chunkFunction(uSize(0), count);
+
+			numberOfChunks = numberOfThreads + 1;
+			uSize chunkSize = (count + numberOfChunks - 1) / numberOfChunks;
+			std::vector<std::future<Result>> chunkResults;
+			chunkResults.reserve(numberOfChunks - 1);
+			for (uSize chunkStart = chunkSize; chunkStart < count; chunkStart += chunkSize)
+				chunkResults.emplace_back(std::async(std::launch::async, chunkFunction, chunkStart, glm::min(chunkStart + chunkSize, count)));
+
+			Result result = chunkFunction(uSize(0), chunkSize);
+			for (std::future<Result>& chunkResult : chunkResults)
+				mergeFunction(result, chunkResult.get());
+
+			freeThreads.fetch_add(numberOfThreads, std::memory_order_relaxed);
+			return result;
+		}
+
+		struct NodeBounds
+		{
+			AABB Bounds = AABB::Empty;
+			Vec3 CentroidMin{ std::numeric_limits<f32>::max() };
+			Vec3 CentroidMax{ -std::numeric_limits<f32>::max() };
+			uSize NumberOfSpheres = 0;
+			uSize NumberOfTriangles = 0;
+		};
+
+		struct ObjectBin
+		{
+			AABB Bounds = AABB::Empty;
+			uSize NumberOfPrimitives = 0;
+		};
+
+		struct SpatialBin
+		{
+			AABB Bounds = AABB::Empty;
+			uSize NumberOfEntries = 0; // references starting in this bin
+			uSize NumberOfExits = 0; // references ending in this bin
+		};
+
+		template<typename Bin>
+		using AxisBins = std::array<std::array<Bin, SplitBVH::NumberOfBins>, 3>;
+
+		template<typename Bin>
+		void MergeBins(AxisBins<Bin>& bins, const AxisBins<Bin>& otherBins)
+		{
+			for (uSize axis = 0; axis != 3; axis++)
+				for (uSize binIndex = 0; binIndex != SplitBVH::NumberOfBins; binIndex++)
+				{
+					Bin& bin = bins[axis][binIndex];
+					const Bin& otherBin = otherBins[axis][binIndex];
+					bin.Bounds = AABB(bin.Bounds, otherBin.Bounds);
+					if constexpr (std::is_same_v<Bin, ObjectBin>)
+						bin.NumberOfPrimitives += otherBin.NumberOfPrimitives;
+					else
+					{
+						bin.NumberOfEntries += otherBin.NumberOfEntries;
+						bin.NumberOfExits += otherBin.NumberOfExits;
+					}
+				}
+		}
+	}
+
+	SplitBVH::SplitBVH(const std::shared_ptr<Hitables>& hitables, BVHBuildMode buildMode)
+		: m_Objects(hitables->GetObjects()), m_BuildMode(buildMode)
 	{
 		m_BackgroundFunction = hitables->GetBackgroundFunction();
+		Build();
+	}
 
-		auto numberOfHitables = static_cast<iSize>(hitables->GetNumberOfObjects());
+	void SplitBVH::Rebuild(BVHBuildMode buildMode)
+	{
+		m_BuildMode = buildMode;
+		Build();
+	}
 
-		if (numberOfHitables == 0)
+	bool SplitBVH::Update()
+	{
+		if (m_LinearBVH.IsEmpty())
+			return false;
+
+		auto refitStartTime = std::chrono::steady_clock::now();
+
+		m_LinearBVH.Refit();
+		m_Stats.SAHCost = m_LinearBVH.GetSAHCost();
+		if (m_Stats.SAHCost > RefitRebuildThreshold * m_Stats.BuildSAHCost)
 		{
-			m_Left = m_Right = std::make_shared<NoHit>();
-			m_AABB = AABB::Empty;
-			return;
+			Build();
+			return true;
 		}
 
-		auto objects = hitables->GetObjects();
-		m_AABB = hitables->GetAABB();
+		const std::array<f32, 6>& rootBounds = m_LinearBVH.GetRootBounds();
+		m_AABB = AABB(Point(rootBounds[0], rootBounds[2], rootBounds[4]), Point(rootBounds[1], rootBounds[3], rootBounds[5]));
+		m_Stats.NumberOfRefits++;
+		UpdateNodeStats();
+		m_Stats.RefitTime = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - refitStartTime).count();
+		return false;
+	}
+
+	void SplitBVH::SetUseWideBVH(bool useWideBVH)
+	{
+		if (useWideBVH == m_UseWideBVH)
+			return;
+
+		m_UseWideBVH = useWideBVH;
+		MatchTreeForm();
+	}
+
+	void SplitBVH::SetUseQuantizedBVH(bool useQuantizedBVH)
+	{
+		if (useQuantizedBVH == m_UseQuantizedBVH)
+			return;
+
+		m_UseQuantizedBVH = useQuantizedBVH;
+		MatchTreeForm();
+	}
+
+	void SplitBVH::MatchTreeForm()
+	{
+		// the binary and float wide trees are kept together so moving between them is free, a quantized tree has neither to go back to
+		// and quantizing a refit tree would leave BuildSAHCost measured on a different tree, so both ways build again
+		if ((m_UseWideBVH && m_UseQuantizedBVH) != m_LinearBVH.UsesQuantizedNodes())
+			Build();
+	}
+
+	bool __vectorcall SplitBVH::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		bool hasAnyHit;
+		if (!m_UseWideBVH)
+			hasAnyHit = m_LinearBVH.IsHit(ray, range, hitData);
+		else
+			hasAnyHit = m_UseQuantizedBVH && m_LinearBVH.HasQuantizedNodes() ?
+				m_LinearBVH.IsHitQuantized(ray, range, hitData) :
+				m_LinearBVH.IsHitWide(ray, range, hitData);
+
+		// after the tree so range has already shrunk to its closest hit
+		for (const auto& object : m_UnboundedObjects)
+			hasAnyHit |= object->IsHit(ray, range, hitData);
+
+		return hasAnyHit;
+	}
+
+	u32 __vectorcall SplitBVH::IsHitPacket(RayPacket& packet, u32 laneMask) const
+	{
+		u32 hitMask = m_LinearBVH.IsHitPacket(packet, laneMask);
+
+		for (const auto& object : m_UnboundedObjects)
+			hitMask |= object->IsHitPacket(packet, laneMask);
+
+		return hitMask;
+	}
+
+	bool __vectorcall SplitBVH::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		// a ground plane blocks most of the shadow rays it is in the way of for the price of one test, so before the tree
+		if (std::ranges::any_of(m_UnboundedObjects, [&ray, &range](const auto& object) { return object->IsOccluded(ray, range); }))
+			return true;
+
+		if (!m_UseWideBVH)
+			return m_LinearBVH.IsOccluded(ray, range);
 
-		if (numberOfHitables == 1)
+		return m_UseQuantizedBVH && m_LinearBVH.HasQuantizedNodes() ?
+			m_LinearBVH.IsOccludedQuantized(ray, range) :
+			m_LinearBVH.IsOccludedWide(ray, range);
+	}
+
+	void SplitBVH::Build()
+	{
+		auto buildStartTime = std::chrono::steady_clock::now();
+
+		m_AABB = AABB::Empty;
+		m_Stats = BVHStats();
+		m_UnboundedObjects.clear();
+		if (m_Objects.empty())
 		{
-			m_Left = objects[0];
-			m_Right = std::make_shared<NoHit>();
+			m_LinearBVH = LinearBVH();
 			return;
 		}
-		if (numberOfHitables == 2)
+
+		PrimitiveSources sources = GatherPrimitiveSources();
+		uSize numberOfPrimitives = sources.Primitives.size();
+		if (numberOfPrimitives == 0)
 		{
-			m_Left = objects[0];
-			m_Right = objects[1];
+			m_LinearBVH = LinearBVH();
 			return;
 		}
 
-		AABB::Axis splitAxis = m_AABB.LongestAxis();
-		std::ranges::sort(objects, [splitAxis](const std::shared_ptr<BaseHitable>& a, const std::shared_ptr<BaseHitable>& b) {
-			return BoxComparison(a, b, splitAxis);
-			});
+		// every thread the build starts, for a subtree or a chunk of a reduce, comes out of this one budget
+		SharedBuildState sharedState;
+		sharedState.FreeThreads = glm::max(static_cast<uSize>(std::thread::hardware_concurrency()), uSize(1)) - 1;
+
+		// GetAABB is a virtual call per object, with millions of objects gathering the references is worth spreading over every core too
+		std::vector<BuildReference> references(numberOfPrimitives);
+		m_AABB = ParallelReduce<AABB>(sharedState.FreeThreads, numberOfPrimitives, MinParallelBinningReferences,
+			[this, &references, &sources](uSize start, uSize end) {
+				AABB chunkAABB = AABB::Empty;
+				for (uSize i = start; i != end; i++)
+				{
+					const BuildPrimitive& primitive = sources.Primitives[i];
+					const TriangleMesh* mesh = sources.Meshes[primitive.ObjectIndex];
+
+					BuildReference& reference = references[i];
+					reference.Bounds = mesh != nullptr ? mesh->GetTriangleAABB(primitive.TriangleIndex) : m_Objects[primitive.ObjectIndex]->GetAABB();
+					reference.Centroid = reference.Bounds.GetCentroid();
+					reference.PrimitiveIndex = static_cast<u32>(i);
+					if (mesh != nullptr)
+						reference.Batch = LeafBatch::Triangle;
+					else if (sources.Spheres[primitive.ObjectIndex] != nullptr)
+						reference.Batch = LeafBatch::Sphere;
+					chunkAABB.Expand(reference.Bounds);
+				}
+				return chunkAABB;
+			},
+			[](AABB& aabb, const AABB& chunkAABB) { aabb.Expand(chunkAABB); }
+		);
+
+		sharedState.NumberOfReferences = numberOfPrimitives;
+		sharedState.MaxNumberOfReferences = m_BuildMode == BVHBuildMode::SpatialSplit ? numberOfPrimitives * MaxReferencesPerPrimitive : numberOfPrimitives;
+		sharedState.MaxParallelDepth = static_cast<uSize>(std::bit_width(std::thread::hardware_concurrency())) + 2;
+		sharedState.MinSpatialSplitOverlap = SpatialSplitOverlapBudget * SurfaceArea(m_AABB);
 
-		if (numberOfHitables == 3)
+		BuildContext context;
+		context.LeafPrimitiveIndices.reserve(sharedState.MaxNumberOfReferences);
+		context.Nodes.reserve(2 * numberOfPrimitives); // a binary tree has at most 2n - 1 nodes, more are only needed after spatial splits
+		BuildNode(context, sharedState, std::move(references), 0);
+
+		std::vector<std::shared_ptr<BaseHitable>> primitives = BuildLeafPrimitives(context.Nodes, context.LeafPrimitiveIndices, sources);
+
+		m_Stats.NumberOfNodes = context.Nodes.size();
+		m_Stats.NumberOfLeaves = static_cast<uSize>(std::ranges::count_if(context.Nodes, [](const BVHNode& node) { return node.IsLeaf(); }));
+		m_Stats.Depth = context.Depth;
+		m_Stats.NumberOfReferences = context.LeafPrimitiveIndices.size();
+		m_Stats.NumberOfSpatialSplits = context.NumberOfSpatialSplits;
+		m_Stats.NumberOfBuildTasks = context.NumberOfBuildTasks;
+
+		m_LinearBVH = LinearBVH(std::move(context.Nodes), std::move(primitives), m_UseWideBVH && m_UseQuantizedBVH);
+
+		UpdateNodeStats();
+		m_Stats.SAHCost = m_LinearBVH.GetSAHCost();
+		// spatial splits clip leaves to part of a primitive which Refit grows back to the whole one, measured against the clipped tree
+		// the first refit of a scene that has not even moved could look past RefitRebuildThreshold and rebuild every frame
+		m_Stats.BuildSAHCost = m_Stats.NumberOfSpatialSplits != 0 ? m_LinearBVH.GetRefitSAHCost() : m_Stats.SAHCost;
+		m_Stats.BuildTime = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - buildStartTime).count();
+	}
+
+	void SplitBVH::UpdateNodeStats()
+	{
+		m_Stats.NumberOfWideNodes = m_LinearBVH.GetWideNodes().size();
+		m_Stats.NodesSize = m_LinearBVH.GetNodes().size() * sizeof(BVHNode);
+		m_Stats.WideNodesSize = m_LinearBVH.GetWideNodes().size() * sizeof(WideBVHNode);
+		m_Stats.QuantizedNodesSize = m_LinearBVH.GetQuantizedSize();
+		m_Stats.ResidentNodesSize = m_LinearBVH.GetResidentSize();
+	}
+
+	SplitBVH::PrimitiveSources SplitBVH::GatherPrimitiveSources()
+	{
+		PrimitiveSources sources;
+		sources.Primitives.reserve(m_Objects.size());
+		sources.Spheres.resize(m_Objects.size(), nullptr);
+		sources.Meshes.resize(m_Objects.size(), nullptr);
+
+		// has to be serial as a mesh adds a primitive per triangle, a cast per object is cheap next to the build
+		for (uSize objectIndex = 0; objectIndex != m_Objects.size(); objectIndex++)
 		{
-			m_Left = std::make_shared<SplitBVH>(objects, 0, 2, PRIVATE());
-			m_Right = objects[2];
-			return;
+			const BaseHitable* object = m_Objects[objectIndex].get();
+			if (object->IsUnbounded())
+			{
+				m_UnboundedObjects.emplace_back(object);
+				continue;
+			}
+
+			if (const auto* mesh = dynamic_cast<const TriangleMesh*>(object))
+			{
+				sources.Meshes[objectIndex] = mesh;
+				for (u32 triangleIndex = 0; triangleIndex != mesh->GetNumberOfTriangles(); triangleIndex++)
+					sources.Primitives.emplace_back(BuildPrimitive{ static_cast<u32>(objectIndex), triangleIndex });
+				m_Stats.NumberOfTriangles += mesh->GetNumberOfTriangles();
+				continue;
+			}
+
+			if (m_UseSphereBatches)
+				sources.Spheres[objectIndex] = dynamic_cast<const Sphere*>(object);
+			sources.Primitives.emplace_back(BuildPrimitive{ static_cast<u32>(objectIndex), 0 });
 		}
 
-		iSize midPoint = numberOfHitables / 2;
-		m_Left = std::make_shared<SplitBVH>(objects, 0, midPoint, PRIVATE());
-		m_Right = std::make_shared<SplitBVH>(objects, midPoint, numberOfHitables, PRIVATE());
+		m_Stats.NumberOfUnboundedObjects = m_UnboundedObjects.size();
+		return sources;
 	}
 
-	SplitBVH::SplitBVH(std::vector<std::shared_ptr<BaseHitable>>& objects, iSize start, iSize end, SplitBVH::PRIVATE)
+	std::vector<std::shared_ptr<BaseHitable>> SplitBVH::BuildLeafPrimitives(BVHNodeArray& nodes, const std::vector<u32>& leafPrimitiveIndices, const PrimitiveSources& sources)
 	{
-		iSize range = end - start;
+		std::vector<std::shared_ptr<BaseHitable>> primitives;
+		primitives.reserve(leafPrimitiveIndices.size());
 
-		[[unlikely]] if (range == 1) // should not happen normally but just in case
+		std::array<const Sphere*, SphereBatchWidth> batchSpheres;
+		std::array<const TriangleMesh*, TriangleBatchWidth> batchMeshes;
+		std::array<u32, TriangleBatchWidth> batchTriangles;
+		uSize numberOfBatchTriangles = 0;
+		auto flushTriangles = [&]() {
+			if (numberOfBatchTriangles == 0)
+				return;
+
+			primitives.emplace_back(std::make_shared<TriangleBatch>(std::span(batchMeshes.data(), numberOfBatchTriangles), std::span(batchTriangles.data(), numberOfBatchTriangles)));
+			numberOfBatchTriangles = 0;
+			m_Stats.NumberOfTriangleBatches++;
+		};
+
+		for (BVHNode& node : nodes)
 		{
-			m_Left = objects[start];
-			m_Right = std::make_shared<NoHit>();
-			m_AABB = m_Left->GetAABB();
+			if (!node.IsLeaf())
+				continue;
+
+			auto leafIndices = std::span(leafPrimitiveIndices).subspan(node.Offset, node.NumberOfPrimitives);
+			node.Offset = static_cast<u32>(primitives.size());
+
+			// a lone sphere is cheaper to test on its own, leaves past MaxDepth can hold more than a batch
+			bool isSphereBatch = leafIndices.size() > 1 && leafIndices.size() <= SphereBatchWidth &&
+				std::ranges::all_of(leafIndices, [&sources](u32 primitiveIndex) { return sources.Spheres[sources.Primitives[primitiveIndex].ObjectIndex] != nullptr; });
+			if (isSphereBatch)
+			{
+				for (uSize i = 0; i != leafIndices.size(); i++)
+					batchSpheres[i] = sources.Spheres[sources.Primitives[leafIndices[i]].ObjectIndex];
+
+				primitives.emplace_back(std::make_shared<SphereBatch>(std::span(batchSpheres.data(), leafIndices.size())));
+				node.NumberOfPrimitives = 1;
+				m_Stats.NumberOfSphereBatches++;
+				continue;
+			}
+
+			// triangles have no object of their own, the ones of a leaf are always gathered into batches
+			for (u32 primitiveIndex : leafIndices)
+			{
+				const BuildPrimitive& primitive = sources.Primitives[primitiveIndex];
+				if (const TriangleMesh* mesh = sources.Meshes[primitive.ObjectIndex])
+				{
+					batchMeshes[numberOfBatchTriangles] = mesh;
+					batchTriangles[numberOfBatchTriangles] = primitive.TriangleIndex;
+					if (++numberOfBatchTriangles == TriangleBatchWidth)
+						flushTriangles();
+				}
+				else
+					primitives.emplace_back(m_Objects[primitive.ObjectIndex]);
+			}
+			flushTriangles();
+
+			assert(primitives.size() - node.Offset <= MaxLeafReferences && "leaf has more primitives than a BVHNode can count");
+			node.NumberOfPrimitives = static_cast<u16>(primitives.size() - node.Offset);
+		}
+
+		return primitives;
+	}
+
+	void SplitBVH::BuildNode(BuildContext& context, SharedBuildState& sharedState, std::vector<BuildReference>&& references, uSize depth) const
+	{
+		uSize nodeIndex = context.Nodes.size();
+		context.Nodes.emplace_back();
+		context.Depth = glm::max(context.Depth, depth + 1);
+
+		NodeBounds nodeBounds = ParallelReduce<NodeBounds>(sharedState.FreeThreads, references.size(), MinParallelBinningReferences,
+			[&references](uSize start, uSize end) {
+				NodeBounds chunkBounds;
+				for (uSize i = start; i != end; i++)
+				{
+					chunkBounds.Bounds.Expand(references[i].Bounds);
+					chunkBounds.CentroidMin = glm::min(chunkBounds.CentroidMin, references[i].Centroid);
+					chunkBounds.CentroidMax = glm::max(chunkBounds.CentroidMax, references[i].Centroid);
+					chunkBounds.NumberOfSpheres += references[i].Batch == LeafBatch::Sphere ? 1 : 0;
+					chunkBounds.NumberOfTriangles += references[i].Batch == LeafBatch::Triangle ? 1 : 0;
+				}
+				return chunkBounds;
+			},
+			[](NodeBounds& bounds, const NodeBounds& chunkBounds) {
+				bounds.Bounds.Expand(chunkBounds.Bounds);
+				bounds.CentroidMin = glm::min(bounds.CentroidMin, chunkBounds.CentroidMin);
+				bounds.CentroidMax = glm::max(bounds.CentroidMax, chunkBounds.CentroidMax);
+				bounds.NumberOfSpheres += chunkBounds.NumberOfSpheres;
+				bounds.NumberOfTriangles += chunkBounds.NumberOfTriangles;
+			}
+		);
+		const AABB& nodeAABB = nodeBounds.Bounds;
+		const Vec3& centroidMin = nodeBounds.CentroidMin;
+		const Vec3& centroidMax = nodeBounds.CentroidMax;
+		context.Nodes[nodeIndex].SetBounds(nodeAABB);
+
+		uSize range = references.size();
+		// up to a batch width of spheres or triangles cost about one primitive test as a SphereBatch or TriangleBatch
+		bool isSphereBatch = nodeBounds.NumberOfSpheres == range && range <= SphereBatchWidth;
+		bool isTriangleBatch = nodeBounds.NumberOfTriangles == range && range <= TriangleBatchWidth;
+		bool isBatch = isSphereBatch || isTriangleBatch;
+		uSize maxLeafSize = isSphereBatch ? SphereBatchWidth : isTriangleBatch ? TriangleBatchWidth : MaxLeafSize;
+		AABB::Axis splitAxis = AABB::Axis::none;
+		std::vector<BuildReference> left;
+		std::vector<BuildReference> right;
+
+		if (depth + 1 != LinearBVH::MaxDepth && m_BuildMode == BVHBuildMode::Median && range > MedianLeafSize)
+		{
+			splitAxis = nodeAABB.LongestAxis();
+			PartitionMedian(references, splitAxis, left, right);
+		}
+		else if (depth + 1 != LinearBVH::MaxDepth && m_BuildMode != BVHBuildMode::Median && range > 1)
+		{
+			f32 invNodeSurfaceArea = 1.0f / SurfaceArea(nodeAABB);
+			SplitCandidate split = FindObjectSplit(sharedState, references, invNodeSurfaceArea, centroidMin, centroidMax);
+
+			// only worth cutting primitives when the object split leaves children that overlap, or when there is no object split at all
+			uSize numberOfReferences = sharedState.NumberOfReferences.load(std::memory_order_relaxed);
+			if (m_BuildMode == BVHBuildMode::SpatialSplit && numberOfReferences < sharedState.MaxNumberOfReferences &&
+				(split.Axis == AABB::Axis::none || OverlapSurfaceArea(split.LeftBounds, split.RightBounds) > sharedState.MinSpatialSplitOverlap))
+			{
+				SplitCandidate spatialSplit = FindSpatialSplit(sharedState, references, invNodeSurfaceArea, nodeAABB);
+				uSize newReferences = spatialSplit.LeftCount + spatialSplit.RightCount - range;
+				if (spatialSplit.Axis != AABB::Axis::none && spatialSplit.Cost < split.Cost && numberOfReferences + newReferences <= sharedState.MaxNumberOfReferences)
+					split = spatialSplit;
+			}
+
+			// a lopsided chain of splits could reach MaxDepth holding more references than a leaf can count, median splits halve the range every level
+			uSize maxChildReferences = MaxReferencesAtDepth(depth + 1);
+			bool isChildTooBig = split.LeftCount > maxChildReferences || split.RightCount > maxChildReferences;
+
+			f32 leafCost = LinearBVH::PrimitiveIntersectionCost * static_cast<f32>(isBatch ? 1 : range);
+			if (split.Axis == AABB::Axis::none || isChildTooBig)
+			{
+				// all centroids in one spot, only a median split can break the range up
+				if (range > maxLeafSize || isChildTooBig)
+				{
+					splitAxis = nodeAABB.LongestAxis();
+					PartitionMedian(references, splitAxis, left, right);
+				}
+			}
+			else if (range > maxLeafSize || split.Cost < leafCost)
+			{
+				splitAxis = split.Axis;
+				if (!split.IsSpatial)
+					PartitionObjects(references, split, left, right);
+				else if (PartitionSpatial(references, split, left, right))
+				{
+					sharedState.NumberOfReferences.fetch_add(left.size() + right.size() - range, std::memory_order_relaxed);
+					context.NumberOfSpatialSplits++;
+				}
+				else // rounding put everything on one side of the plane
+				{
+					splitAxis = nodeAABB.LongestAxis();
+					PartitionMedian(references, splitAxis, left, right);
+				}
+			}
+		}
+
+		if (splitAxis == AABB::Axis::none)
+		{
+			assert(range <= MaxLeafReferences && "leaf has more references than a BVHNode can count");
+			context.Nodes[nodeIndex].Offset = static_cast<u32>(context.LeafPrimitiveIndices.size());
+			context.Nodes[nodeIndex].NumberOfPrimitives = static_cast<u16>(range);
+			for (const BuildReference& reference : references)
+				context.LeafPrimitiveIndices.emplace_back(reference.PrimitiveIndex);
 			return;
 		}
-		if (range == 2)
+
+		// free this level's references before going deeper so only one path of the tree holds memory at a time
+		references.clear();
+		references.shrink_to_fit();
+
+		context.Nodes[nodeIndex].SplitAxis = splitAxis;
+
+		if (depth < sharedState.MaxParallelDepth && left.size() + right.size() >= MinParallelBuildReferences && AcquireBuildThreads(sharedState.FreeThreads, 1) == 1)
 		{
-			m_Left = objects[start];
-			m_Right = objects[start + 1];
-			m_AABB = AABB(m_Left->GetAABB(), m_Right->GetAABB());
+			// the left child is built on another thread while this one builds the right, both into their own context
+			// as the nodes of the right child can only be placed once the size of the left child is known
+			BuildContext leftContext;
+			BuildContext rightContext;
+			std::future<void> leftTask = std::async(std::launch::async, [this, &leftContext, &sharedState, &left, depth]() {
+				BuildNode(leftContext, sharedState, std::move(left), depth + 1);
+				sharedState.FreeThreads.fetch_add(1, std::memory_order_relaxed); // given back as soon as the subtree is done, the right one may take longer
+				});
+			BuildNode(rightContext, sharedState, std::move(right), depth + 1);
+			leftTask.get();
+
+			context.NumberOfBuildTasks++;
+			AppendSubtree(context, leftContext);
+			context.Nodes[nodeIndex].Offset = static_cast<u32>(context.Nodes.size());
+			AppendSubtree(context, rightContext);
 			return;
 		}
 
+		BuildNode(context, sharedState, std::move(left), depth + 1);
+		context.Nodes[nodeIndex].Offset = static_cast<u32>(context.Nodes.size()); // nodes may have been reallocated, never hold a reference across the recursion
+		BuildNode(context, sharedState, std::move(right), depth + 1);
+	}
 
-		m_AABB = AABB::Empty;
-		for (iSize i = start; i < end; i++)
-			m_AABB.Expand(objects[i]->GetAABB());
+	void SplitBVH::AppendSubtree(BuildContext& context, const BuildContext& subtree)
+	{
+		// offsets in the subtree are relative to its own arrays
+		auto nodeOffset = static_cast<u32>(context.Nodes.size());
+		auto leafPrimitiveOffset = static_cast<u32>(context.LeafPrimitiveIndices.size());
+		for (BVHNode node : subtree.Nodes)
+		{
+			node.Offset += node.IsLeaf() ? leafPrimitiveOffset : nodeOffset;
+			context.Nodes.emplace_back(node);
+		}
+		context.LeafPrimitiveIndices.insert(context.LeafPrimitiveIndices.end(), subtree.LeafPrimitiveIndices.begin(), subtree.LeafPrimitiveIndices.end());
 
-		AABB::Axis splitAxis = m_AABB.LongestAxis();
-		std::sort(objects.begin() + start, objects.begin() + end, [splitAxis](const std::shared_ptr<BaseHitable>& a, const std::shared_ptr<BaseHitable>& b) {
-			return BoxComparison(a, b, splitAxis);
-			});
+		context.Depth = glm::max(context.Depth, subtree.Depth);
+		context.NumberOfSpatialSplits += subtree.NumberOfSpatialSplits;
+		context.NumberOfBuildTasks += subtree.NumberOfBuildTasks;
+	}
 
-		if (range == 3)
+	SplitBVH::SplitCandidate SplitBVH::FindObjectSplit(SharedBuildState& sharedState, const std::vector<BuildReference>& references, f32 invNodeSurfaceArea, const Vec3& centroidMin, const Vec3& centroidMax)
+	{
+		SplitCandidate bestSplit;
+		Vec3 centroidExtent = centroidMax - centroidMin;
+		// an axis where every centroid is on one plane keeps a scale of 0 and is skipped, there is nothing to split along it
+		Vec3 binScales(0.0f);
+		for (AABB::Axis axis = AABB::Axis::x; axis <= AABB::Axis::z; axis++)
+			if (centroidExtent[+axis] > 0.0f)
+				binScales[+axis] = static_cast<f32>(NumberOfBins) / centroidExtent[+axis];
+
+		AxisBins<ObjectBin> axisBins = ParallelReduce<AxisBins<ObjectBin>>(sharedState.FreeThreads, references.size(), MinParallelBinningReferences,
+			[&references, &centroidMin, &binScales](uSize start, uSize end) {
+				AxisBins<ObjectBin> chunkBins;
+				for (AABB::Axis axis = AABB::Axis::x; axis <= AABB::Axis::z; axis++)
+				{
+					if (binScales[+axis] == 0.0f)
+						continue;
+
+					for (uSize i = start; i != end; i++)
+					{
+						ObjectBin& bin = chunkBins[+axis][GetBinIndex(references[i].Centroid[+axis], centroidMin[+axis], binScales[+axis])];
+						bin.Bounds.Expand(references[i].Bounds);
+						bin.NumberOfPrimitives++;
+					}
+				}
+				return chunkBins;
+			},
+			MergeBins<ObjectBin>
+		);
+
+		for (AABB::Axis axis = AABB::Axis::x; axis <= AABB::Axis::z; axis++)
 		{
-			m_Left = std::make_shared<SplitBVH>(objects, start, start + 2, PRIVATE());
-			m_Right = objects[start + 2];
-			return;
+			if (binScales[+axis] == 0.0f)
+				continue;
+
+			f32 binScale = binScales[+axis];
+			const std::array<ObjectBin, NumberOfBins>& bins = axisBins[+axis];
+
+			// sweep from the right first so the left sweep can price every plane in one pass
+			std::array<AABB, NumberOfBins - 1> rightBounds;
+			std::array<uSize, NumberOfBins - 1> rightCounts{};
+			AABB accumulatedBounds = AABB::Empty;
+			uSize accumulatedCount = 0;
+			for (uSize binIndex = NumberOfBins - 1; binIndex != 0; binIndex--)
+			{
+				if (bins[binIndex].NumberOfPrimitives != 0)
+				{
+					accumulatedBounds.Expand(bins[binIndex].Bounds);
+					accumulatedCount += bins[binIndex].NumberOfPrimitives;
+				}
+				rightBounds[binIndex - 1] = accumulatedBounds;
+				rightCounts[binIndex - 1] = accumulatedCount;
+			}
+
+			AABB leftBounds = AABB::Empty;
+			uSize leftCount = 0;
+			for (uSize binIndex = 0; binIndex != NumberOfBins - 1; binIndex++)
+			{
+				if (bins[binIndex].NumberOfPrimitives != 0)
+				{
+					leftBounds.Expand(bins[binIndex].Bounds);
+					leftCount += bins[binIndex].NumberOfPrimitives;
+				}
+
+				if (leftCount == 0 || rightCounts[binIndex] == 0)
+					continue;
+
+				f32 cost = LinearBVH::NodeTraversalCost + LinearBVH::PrimitiveIntersectionCost * invNodeSurfaceArea *
+					(SurfaceArea(leftBounds) * static_cast<f32>(leftCount) + SurfaceArea(rightBounds[binIndex]) * static_cast<f32>(rightCounts[binIndex]));
+				if (cost < bestSplit.Cost)
+				{
+					bestSplit.Cost = cost;
+					bestSplit.Axis = axis;
+					bestSplit.Bin = binIndex;
+					bestSplit.BinOrigin = centroidMin[+axis];
+					bestSplit.BinScale = binScale;
+					bestSplit.LeftBounds = leftBounds;
+					bestSplit.RightBounds = rightBounds[binIndex];
+					bestSplit.LeftCount = leftCount;
+					bestSplit.RightCount = rightCounts[binIndex];
+				}
+			}
 		}
 
-		iSize midPoint = range / 2;
-		m_Left = std::make_shared<SplitBVH>(objects, start, start + midPoint, PRIVATE());
-		m_Right = std::make_shared<SplitBVH>(objects, start + midPoint, end, PRIVATE());
+		return bestSplit;
 	}
 
-	bool __vectorcall SplitBVH::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	SplitBVH::SplitCandidate SplitBVH::FindSpatialSplit(SharedBuildState& sharedState, const std::vector<BuildReference>& references, f32 invNodeSurfaceArea, const AABB& nodeAABB)
 	{
-		if (!m_AABB.IsHit(ray, range))
-			return false;
+		SplitCandidate bestSplit;
+		bestSplit.IsSpatial = true;
+
+		// every reference is chopped into the bins it spans so each bin only grows by the part of the primitive inside it
+		AxisBins<SpatialBin> axisBins = ParallelReduce<AxisBins<SpatialBin>>(sharedState.FreeThreads, references.size(), MinParallelBinningReferences,
+			[&references, &nodeAABB](uSize start, uSize end) {
+				AxisBins<SpatialBin> chunkBins;
+				for (AABB::Axis axis = AABB::Axis::x; axis <= AABB::Axis::z; axis++)
+				{
+					const Interval& nodeInterval = nodeAABB.GetAxisInterval(axis);
+					if (nodeInterval.Size() <= 0.0f)
+						continue;
+
+					f32 binOrigin = nodeInterval.GetMin();
+					f32 binScale = static_cast<f32>(NumberOfBins) / nodeInterval.Size();
+					f32 binWidth = nodeInterval.Size() / static_cast<f32>(NumberOfBins);
+					std::array<SpatialBin, NumberOfBins>& bins = chunkBins[+axis];
+					for (uSize i = start; i != end; i++)
+					{
+						const Interval& referenceInterval = references[i].Bounds.GetAxisInterval(axis);
+						uSize firstBin = GetBinIndex(referenceInterval.GetMin(), binOrigin, binScale);
+						uSize lastBin = GetBinIndex(referenceInterval.GetMax(), binOrigin, binScale);
+
+						bins[firstBin].NumberOfEntries++;
+						bins[lastBin].NumberOfExits++;
+						for (uSize binIndex = firstBin; binIndex <= lastBin; binIndex++)
+						{
+							f32 binMin = binOrigin + static_cast<f32>(binIndex) * binWidth;
+							bins[binIndex].Bounds.Expand(ClipToAxisRange(references[i].Bounds, axis, binMin, binMin + binWidth));
+						}
+					}
+				}
+				return chunkBins;
+			},
+			MergeBins<SpatialBin>
+		);
 
-		bool hasHit = m_Left->IsHit(ray, range, hitData);
-		hasHit |= m_Right->IsHit(ray, range, hitData);
+		for (AABB::Axis axis = AABB::Axis::x; axis <= AABB::Axis::z; axis++)
+		{
+			const Interval& nodeInterval = nodeAABB.GetAxisInterval(axis);
+			if (nodeInterval.Size() <= 0.0f)
+				continue;
+
+			f32 binOrigin = nodeInterval.GetMin();
+			f32 binScale = static_cast<f32>(NumberOfBins) / nodeInterval.Size();
+			const std::array<SpatialBin, NumberOfBins>& bins = axisBins[+axis];
+
+			std::array<AABB, NumberOfBins - 1> rightBounds;
+			std::array<uSize, NumberOfBins - 1> rightCounts{};
+			AABB accumulatedBounds = AABB::Empty;
+			uSize accumulatedCount = 0;
+			for (uSize binIndex = NumberOfBins - 1; binIndex != 0; binIndex--)
+			{
+				if (bins[binIndex].NumberOfExits != 0 || bins[binIndex].NumberOfEntries != 0)
+					accumulatedBounds.Expand(bins[binIndex].Bounds);
+				accumulatedCount += bins[binIndex].NumberOfExits;
+				rightBounds[binIndex - 1] = accumulatedBounds;
+				rightCounts[binIndex - 1] = accumulatedCount;
+			}
 
-		return hasHit;
+			AABB leftBounds = AABB::Empty;
+			uSize leftCount = 0;
+			for (uSize binIndex = 0; binIndex != NumberOfBins - 1; binIndex++)
+			{
+				if (bins[binIndex].NumberOfExits != 0 || bins[binIndex].NumberOfEntries != 0)
+					leftBounds.Expand(bins[binIndex].Bounds);
+				leftCount += bins[binIndex].NumberOfEntries;
+
+				if (leftCount == 0 || rightCounts[binIndex] == 0)
+					continue;
+
+				f32 cost = LinearBVH::NodeTraversalCost + LinearBVH::PrimitiveIntersectionCost * invNodeSurfaceArea *
+					(SurfaceArea(leftBounds) * static_cast<f32>(leftCount) + SurfaceArea(rightBounds[binIndex]) * static_cast<f32>(rightCounts[binIndex]));
+				if (cost < bestSplit.Cost)
+				{
+					bestSplit.Cost = cost;
+					bestSplit.Axis = axis;
+					bestSplit.Bin = binIndex;
+					bestSplit.BinOrigin = binOrigin;
+					bestSplit.BinScale = binScale;
+					bestSplit.LeftBounds = leftBounds;
+					bestSplit.RightBounds = rightBounds[binIndex];
+					bestSplit.LeftCount = leftCount;
+					bestSplit.RightCount = rightCounts[binIndex];
+				}
+			}
+		}
+
+		return bestSplit;
 	}
 
-	bool SplitBVH::BoxComparison(const std::shared_ptr<BaseHitable>& a, const std::shared_ptr<BaseHitable>& b, AABB::Axis axis)
+	void SplitBVH::PartitionMedian(std::vector<BuildReference>& references, AABB::Axis axis, std::vector<BuildReference>& left, std::vector<BuildReference>& right)
 	{
-		Interval BoxAAxisInterval = a->GetAABB().GetAxisInterval(axis);
-		Interval BoxBAxisInterval = b->GetAABB().GetAxisInterval(axis);
+		// only the median has to be in place, not the whole range sorted
+		auto midPoint = references.begin() + static_cast<iSize>(references.size() / 2);
+		std::nth_element(references.begin(), midPoint, references.end(), [axis = +axis](const BuildReference& a, const BuildReference& b) {
+			return a.Centroid[axis] < b.Centroid[axis];
+			});
 
-		f32 BoxAAxisIntervalMin = BoxAAxisInterval.GetMin();
-		f32 BoxBAxisIntervalMin = BoxBAxisInterval.GetMin();
+		left.assign(std::make_move_iterator(references.begin()), std::make_move_iterator(midPoint));
+		right.assign(std::make_move_iterator(midPoint), std::make_move_iterator(references.end()));
+	}
 
-		if (!Interval(-1e-4f, 1e-4f).Contains(BoxAAxisIntervalMin - BoxBAxisIntervalMin))
-			return BoxAAxisIntervalMin < BoxBAxisIntervalMin;
+	void SplitBVH::PartitionObjects(std::vector<BuildReference>& references, const SplitCandidate& split, std::vector<BuildReference>& left, std::vector<BuildReference>& right)
+	{
+		auto splitPoint = std::partition(references.begin(), references.end(), [&split, axis = +split.Axis](const BuildReference& reference) {
+			return GetBinIndex(reference.Centroid[axis], split.BinOrigin, split.BinScale) <= split.Bin;
+			});
+
+		left.assign(std::make_move_iterator(references.begin()), std::make_move_iterator(splitPoint));
+		right.assign(std::make_move_iterator(splitPoint), std::make_move_iterator(references.end()));
+	}
+
+	bool SplitBVH::PartitionSpatial(const std::vector<BuildReference>& references, const SplitCandidate& split, std::vector<BuildReference>& left, std::vector<BuildReference>& right)
+	{
+		f32 splitPosition = split.BinOrigin + static_cast<f32>(split.Bin + 1) / split.BinScale;
+		f32 leftSurfaceArea = SurfaceArea(split.LeftBounds);
+		f32 rightSurfaceArea = SurfaceArea(split.RightBounds);
+		auto leftCount = static_cast<f32>(split.LeftCount);
+		auto rightCount = static_cast<f32>(split.RightCount);
+
+		left.reserve(split.LeftCount);
+		right.reserve(split.RightCount);
+		for (const BuildReference& reference : references)
+		{
+			const Interval& referenceInterval = reference.Bounds.GetAxisInterval(split.Axis);
+			if (referenceInterval.GetMax() <= splitPosition)
+			{
+				left.emplace_back(reference);
+				continue;
+			}
+			if (referenceInterval.GetMin() >= splitPosition)
+			{
+				right.emplace_back(reference);
+				continue;
+			}
+
+			// reference unsplitting, a straddling reference is only cut in two when that is cheaper than moving it whole into one child
+			f32 splitCost = leftSurfaceArea * leftCount + rightSurfaceArea * rightCount;
+			f32 leftOnlyCost = SurfaceArea(AABB(split.LeftBounds, reference.Bounds)) * leftCount + rightSurfaceArea * (rightCount - 1.0f);
+			f32 rightOnlyCost = leftSurfaceArea * (leftCount - 1.0f) + SurfaceArea(AABB(split.RightBounds, reference.Bounds)) * rightCount;
+
+			if (leftOnlyCost < splitCost && leftOnlyCost <= rightOnlyCost)
+				left.emplace_back(reference);
+			else if (rightOnlyCost < splitCost)
+				right.emplace_back(reference);
+			else
+			{
+				BuildReference& leftReference = left.emplace_back(reference);
+				leftReference.Bounds = ClipToAxisRange(reference.Bounds, split.Axis, referenceInterval.GetMin(), splitPosition);
+				leftReference.Centroid = leftReference.Bounds.GetCentroid();
+
+				BuildReference& rightReference = right.emplace_back(reference);
+				rightReference.Bounds = ClipToAxisRange(reference.Bounds, split.Axis, splitPosition, referenceInterval.GetMax());
+				rightReference.Centroid = rightReference.Bounds.GetCentroid();
+			}
+		}
 
-		f32 BoxAAxisIntervalMax = BoxAAxisInterval.GetMax();
-		f32 BoxBAxisIntervalMax = BoxBAxisInterval.GetMax();
+		if (!left.empty() && !right.empty())
+			return true;
 
-		return BoxAAxisIntervalMax < BoxBAxisIntervalMax;
+		left.clear();
+		right.clear();
+		return false;
 	}
 }
@@ -5,6 +5,13 @@
 #include "Hittables.hpp"
 
 #include "AABB.hpp"
+#include "LinearBVH.hpp"
+#include "SphereBatch.hpp"
+#include "TriangleBatch.hpp"
+
+#include <vector>
+#include <limits>
+#include <atomic>
 
 #pragma warning(push)
 #pragma warning(disable: 4324) // structure was padded due to alignment specifier
@@ -12,15 +19,64 @@
 
 namespace OWC
 {
+	enum class BVHBuildMode : u8
+	{
+		Median = 0,  // splits the longest axis at the median centroid
+		BinnedSAH,   // tries NumberOfBins planes per axis and takes the cheapest under the surface area heuristic
+		SpatialSplit // BinnedSAH that may also cut primitives in two where the children would overlap too much (SBVH)
+	};
+
+	struct BVHStats
+	{
+		uSize NumberOfNodes = 0;
+		uSize NumberOfLeaves = 0;
+		uSize Depth = 0;
+		uSize NumberOfReferences = 0; // primitives referenced by leaves, more than the number of primitives once spatial splits duplicate some
+		uSize NumberOfSpatialSplits = 0;
+		uSize NumberOfBuildTasks = 0; // subtrees built on their own thread
+		uSize NumberOfWideNodes = 0; // 0 while the wide tree is kept quantized
+		uSize NodesSize = 0; // bytes of the binary nodes, 0 once the tree is quantized
+		uSize WideNodesSize = 0; // bytes, 0 while the wide tree is kept quantized
+		uSize QuantizedNodesSize = 0; // bytes, 0 if the tree is not kept quantized
+		uSize ResidentNodesSize = 0; // bytes of all of the above together
+		uSize NumberOfSphereBatches = 0;
+		uSize NumberOfTriangles = 0; // of every TriangleMesh, each is a primitive of its own to the builder
+		uSize NumberOfTriangleBatches = 0;
+		uSize NumberOfUnboundedObjects = 0; // tested on every ray next to the tree
+		f32 SAHCost = 0.0f; // see LinearBVH::GetSAHCost, lower is better
+		f32 BuildSAHCost = 0.0f; // SAHCost of refitting straight after the last build, above SAHCost when spatial splits clipped leaves
+		f32 BuildTime = 0.0f; // ms
+		uSize NumberOfRefits = 0; // since the last build
+		f32 RefitTime = 0.0f; // ms, of the last refit
+	};
+
+    // Builds a LinearBVH over the objects of a Hitables and traces rays through it
+    // unbounded objects, like a Plane, are kept out of the tree and tested on every ray after it
     class SplitBVH : public BaseHitable
 	{
-	private:
-		struct PRIVATE {};
+	public:
+		static constexpr uSize MedianLeafSize = 2;
+		static constexpr uSize MaxLeafSize = 4;
+		static constexpr uSize NumberOfBins = 16;
+		// a leaf counts its primitives in a u16, leaves forced at LinearBVH::MaxDepth are kept under it by median splitting early enough
+		static constexpr uSize MaxLeafReferences = std::numeric_limits<u16>::max();
+
+		// a spatial split is only tried when the children of the best object split overlap by more than this fraction of the root's surface area
+		static constexpr f32 SpatialSplitOverlapBudget = 1.0e-5f;
+		// cap on references made by spatial splits as a multiple of the number of primitives
+		static constexpr uSize MaxReferencesPerPrimitive = 2;
+
+		// nodes with at least this many references build their children on separate threads while the build has threads to spare
+		static constexpr uSize MinParallelBuildReferences = 4096;
+		// nodes with at least this many references also split their binning across threads, only the top few levels get this big
+		static constexpr uSize MinParallelBinningReferences = 65536;
+
+		// Update rebuilds instead of refitting once a refit has made the SAH cost this many times what it was built with
+		static constexpr f32 RefitRebuildThreshold = 1.5f;
 
     public:
         SplitBVH() = delete;
-		explicit SplitBVH(const std::shared_ptr<Hitables>& hitables);
-		explicit SplitBVH(std::vector<std::shared_ptr<BaseHitable>>& hitables, iSize start, iSize end, SplitBVH::PRIVATE);
+		explicit SplitBVH(const std::shared_ptr<Hitables>& hitables, BVHBuildMode buildMode = BVHBuildMode::BinnedSAH);
         ~SplitBVH() override = default;
 
         SplitBVH(SplitBVH&) = delete;
@@ -28,9 +84,28 @@ namespace OWC
         SplitBVH(SplitBVH&&) = delete;
         SplitBVH& operator=(SplitBVH&&) = delete;
 
+		// must not be called while rays are being traced through the BVH
+		void Rebuild(BVHBuildMode buildMode);
+		// call after moving the objects the BVH was built over, refits the tree to where they are now in O(n) which is all an animated frame needs
+		// and falls back to a Rebuild once the refit tree has degraded past RefitRebuildThreshold, returns true if it rebuilt
+		// must not be called while rays are being traced through the BVH either
+		bool Update();
+		// traces through the WideBVHWidth wide tree instead of the binary one, must not be called while rays are being traced either
+		void SetUseWideBVH(bool useWideBVH);
+		// the wide tree is kept and walked as QuantizedWideBVHNodes instead when it can be, which then is the only tree kept
+		// so moving to or from it rebuilds, same rules as SetUseWideBVH
+		void SetUseQuantizedBVH(bool useQuantizedBVH);
+		// leaves of only spheres are grown to SphereBatchWidth and intersected as one SphereBatch, takes effect on the next Rebuild
+		OWC_FORCE_INLINE void SetUseSphereBatches(bool useSphereBatches) { m_UseSphereBatches = useSphereBatches; }
+
 		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+		// packets walk the quantized tree when there is one and the binary tree otherwise, see LinearBVH::IsHitPacket
+		// the float wide tree has no packet walk of its own, PrimaryRayPacketBenchmark compares every form with and without packets
+		u32 __vectorcall IsHitPacket(RayPacket& packet, u32 laneMask) const override;
 
-		AABB GetAABB() const override { return m_AABB; }
+		AABB GetAABB() const override { return m_UnboundedObjects.empty() ? m_AABB : AABB::Univers; }
+		bool IsUnbounded() const override { return !m_UnboundedObjects.empty(); }
 
 		Colour BackgroundColour(const Ray& ray) const override
 		{
@@ -44,13 +119,111 @@ namespace OWC
 			m_BackgroundFunction = backgroundFunction;
 		}
 
+		OWC_FORCE_INLINE const LinearBVH& GetLinearBVH() const { return m_LinearBVH; }
+		OWC_FORCE_INLINE BVHBuildMode GetBuildMode() const { return m_BuildMode; }
+		OWC_FORCE_INLINE bool UsesWideBVH() const { return m_UseWideBVH; }
+		OWC_FORCE_INLINE bool UsesQuantizedBVH() const { return m_UseQuantizedBVH; }
+		OWC_FORCE_INLINE bool UsesSphereBatches() const { return m_UseSphereBatches; }
+		OWC_FORCE_INLINE const BVHStats& GetStats() const { return m_Stats; }
+
 	private:
-		static bool BoxComparison(const std::shared_ptr<BaseHitable>& a, const std::shared_ptr<BaseHitable>& b, AABB::Axis axis);
+		// leaves made only of one of these are intersected as one SphereBatch or TriangleBatch
+		enum class LeafBatch : u8
+		{
+			None = 0,
+			Sphere, // only when building sphere batches
+			Triangle
+		};
+
+		// a primitive, or the part of one left after spatial splits, as seen by the builder
+		// bounds and centroids are gathered once up front so building never calls back into the primitives
+		struct BuildReference
+		{
+			AABB Bounds;
+			Point Centroid{ 0.0f };
+			u32 PrimitiveIndex = 0; // into PrimitiveSources::Primitives
+			LeafBatch Batch = LeafBatch::None;
+		};
+
+		struct BuildPrimitive
+		{
+			u32 ObjectIndex = 0;
+			u32 TriangleIndex = 0; // only for meshes
+		};
+
+		// what the build references point back to, meshes are opened up into one primitive per triangle
+		struct PrimitiveSources
+		{
+			std::vector<BuildPrimitive> Primitives;
+			std::vector<const Sphere*> Spheres; // per object, nullptr for anything else
+			std::vector<const TriangleMesh*> Meshes; // per object, nullptr for anything else
+		};
+
+		struct SplitCandidate
+		{
+			f32 Cost = std::numeric_limits<f32>::max();
+			AABB::Axis Axis = AABB::Axis::none;
+			bool IsSpatial = false;
+			uSize Bin = 0; // last bin on the left of the split
+			f32 BinOrigin = 0.0f;
+			f32 BinScale = 0.0f; // bins per unit along the axis
+			AABB LeftBounds = AABB::Empty;
+			AABB RightBounds = AABB::Empty;
+			uSize LeftCount = 0;
+			uSize RightCount = 0;
+		};
+
+		// output of one build task, a subtree built on another thread has its own context that is appended to its parent's once done
+		struct BuildContext
+		{
+			std::vector<u32> LeafPrimitiveIndices;
+			BVHNodeArray Nodes;
+			uSize Depth = 0;
+			uSize NumberOfSpatialSplits = 0;
+			uSize NumberOfBuildTasks = 0;
+		};
+
+		// shared by every build task
+		struct SharedBuildState
+		{
+			// tasks check the budget before splitting and add what they made after, so it can be overshot by a few references
+			std::atomic<uSize> NumberOfReferences = 0;
+			uSize MaxNumberOfReferences = 0;
+			uSize MaxParallelDepth = 0; // deeper nodes never spawn tasks, there are enough running to fill every core by then
+			// threads that subtree tasks and ParallelReduce chunks may still start, a task that finds none runs on the thread it is on
+			std::atomic<uSize> FreeThreads = 0;
+			f32 MinSpatialSplitOverlap = 0.0f; // surface area of overlap above which a spatial split is tried
+		};
+
+		void Build();
+		// builds again if the tree kept no longer matches m_UseWideBVH and m_UseQuantizedBVH
+		void MatchTreeForm();
+		// the node counts and sizes of m_Stats from the LinearBVH as it is now
+		void UpdateNodeStats();
+		PrimitiveSources GatherPrimitiveSources();
+		// gathers the primitives of every leaf in node order, leaves of only spheres become one SphereBatch and the triangles of a leaf TriangleBatches
+		std::vector<std::shared_ptr<BaseHitable>> BuildLeafPrimitives(BVHNodeArray& nodes, const std::vector<u32>& leafPrimitiveIndices, const PrimitiveSources& sources);
+		void BuildNode(BuildContext& context, SharedBuildState& sharedState, std::vector<BuildReference>&& references, uSize depth) const;
+		static void AppendSubtree(BuildContext& context, const BuildContext& subtree);
+
+		static SplitCandidate FindObjectSplit(SharedBuildState& sharedState, const std::vector<BuildReference>& references, f32 invNodeSurfaceArea, const Vec3& centroidMin, const Vec3& centroidMax);
+		static SplitCandidate FindSpatialSplit(SharedBuildState& sharedState, const std::vector<BuildReference>& references, f32 invNodeSurfaceArea, const AABB& nodeAABB);
+
+		static void PartitionMedian(std::vector<BuildReference>& references, AABB::Axis axis, std::vector<BuildReference>& left, std::vector<BuildReference>& right);
+		static void PartitionObjects(std::vector<BuildReference>& references, const SplitCandidate& split, std::vector<BuildReference>& left, std::vector<BuildReference>& right);
+		// returns false and leaves left and right empty if every reference ended up on one side
+		static bool PartitionSpatial(const std::vector<BuildReference>& references, const SplitCandidate& split, std::vector<BuildReference>& left, std::vector<BuildReference>& right);
 
     private:
         AABB m_AABB;
-        std::shared_ptr<BaseHitable> m_Left;
-        std::shared_ptr<BaseHitable> m_Right;
+        LinearBVH m_LinearBVH;
+		std::vector<std::shared_ptr<BaseHitable>> m_Objects; // kept for rebuilds, the BVH's own primitive list can hold duplicates
+		std::vector<const BaseHitable*> m_UnboundedObjects; // of m_Objects, their bounds would swallow every node so they are left out of the tree
+		BVHBuildMode m_BuildMode = BVHBuildMode::BinnedSAH;
+		bool m_UseWideBVH = true;
+		bool m_UseQuantizedBVH = true;
+		bool m_UseSphereBatches = true;
+		BVHStats m_Stats;
 		std::function<Colour(const Ray& ray)> m_BackgroundFunction;
     };
 }
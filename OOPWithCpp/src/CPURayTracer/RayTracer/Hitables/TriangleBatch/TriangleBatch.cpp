@@ -0,0 +1,252 @@
+﻿#include "TriangleBatch.hpp"
+
+#include <bit>
+#include <cstring>
+
+
+namespace OWC
+{
+	namespace
+	{
+		// the fallback of WatertightRay::EdgeFunction for the lanes in mask, the SIMD paths only take it when a lane has an edge function of exactly 0
+		template<typename Register>
+		void RecomputeEdgeFunctionsInDouble(u32 mask, const std::array<Register, 3>& x, const std::array<Register, 3>& y, Register& u, Register& v, Register& w)
+		{
+			using Lanes = std::array<f32, TriangleBatchWidth>;
+			static_assert(sizeof(Register) == sizeof(Lanes), "a register holds one lane per triangle");
+
+			std::array<Lanes, 3> xs;
+			std::array<Lanes, 3> ys;
+			std::memcpy(xs.data(), x.data(), sizeof(xs));
+			std::memcpy(ys.data(), y.data(), sizeof(ys));
+
+			Lanes us;
+			Lanes vs;
+			Lanes ws;
+			std::memcpy(us.data(), &u, sizeof(Lanes));
+			std::memcpy(vs.data(), &v, sizeof(Lanes));
+			std::memcpy(ws.data(), &w, sizeof(Lanes));
+
+			for (; mask != 0; mask &= mask - 1)
+			{
+				auto lane = static_cast<uSize>(std::countr_zero(mask));
+				if (us[lane] == 0.0f)
+					us[lane] = WatertightRay::EdgeFunctionInDouble(xs[2][lane], ys[2][lane], xs[1][lane], ys[1][lane]);
+				if (vs[lane] == 0.0f)
+					vs[lane] = WatertightRay::EdgeFunctionInDouble(xs[0][lane], ys[0][lane], xs[2][lane], ys[2][lane]);
+				if (ws[lane] == 0.0f)
+					ws[lane] = WatertightRay::EdgeFunctionInDouble(xs[1][lane], ys[1][lane], xs[0][lane], ys[0][lane]);
+			}
+
+			std::memcpy(&u, us.data(), sizeof(Lanes));
+			std::memcpy(&v, vs.data(), sizeof(Lanes));
+			std::memcpy(&w, ws.data(), sizeof(Lanes));
+		}
+	}
+
+	TriangleBatch::TriangleBatch(std::span<const TriangleMesh* const> meshes, std::span<const u32> triangleIndices)
+		: m_NumberOfTriangles(glm::min(glm::min(meshes.size(), triangleIndices.size()), TriangleBatchWidth))
+	{
+		for (uSize lane = 0; lane != m_NumberOfTriangles; lane++)
+		{
+			for (u32 corner = 0; corner != 3; corner++)
+			{
+				const Point& vertex = meshes[lane]->GetVertex(triangleIndices[lane], corner);
+				m_Vertices[corner][0][lane] = vertex.x;
+				m_Vertices[corner][1][lane] = vertex.y;
+				m_Vertices[corner][2][lane] = vertex.z;
+			}
+
+			m_Meshes[lane] = meshes[lane];
+			m_TriangleIndices[lane] = triangleIndices[lane];
+			m_AABB.Expand(meshes[lane]->GetTriangleAABB(triangleIndices[lane]));
+		}
+
+		m_LaneMask = static_cast<u32>((u64(1) << m_NumberOfTriangles) - 1);
+	}
+
+	bool __vectorcall TriangleBatch::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		alignas(64) std::array<f32, TriangleBatchWidth> distances;
+		u32 hitMask = IntersectTriangles(WatertightRay(ray), range, distances);
+		if (hitMask == 0)
+			return false;
+
+		auto nearestLane = static_cast<uSize>(std::countr_zero(hitMask));
+		for (hitMask &= hitMask - 1; hitMask != 0; hitMask &= hitMask - 1)
+		{
+			auto lane = static_cast<uSize>(std::countr_zero(hitMask));
+			if (distances[lane] < distances[nearestLane])
+				nearestLane = lane;
+		}
+
+		range.SetMax(distances[nearestLane]);
+		hitData.Record(m_Meshes[nearestLane], distances[nearestLane], m_TriangleIndices[nearestLane]);
+		return true;
+	}
+
+	bool __vectorcall TriangleBatch::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		alignas(64) std::array<f32, TriangleBatchWidth> distances;
+		return IntersectTriangles(WatertightRay(ray), range, distances) != 0;
+	}
+
+	u32 __vectorcall TriangleBatch::IntersectTriangles(const WatertightRay& ray, const Interval& range, std::array<f32, TriangleBatchWidth>& distances) const
+	{
+		// WatertightRay::Intersect with the ray broadcast and one triangle per lane, the shear picks which axis of the SoA is read as x, y and z
+		// nothing is fused into an FMA so every ISA rounds the same way as the scalar test and a shared edge is the exact negation of its neighbour's
+		const auto axisX = static_cast<uSize>(ray.AxisX);
+		const auto axisY = static_cast<uSize>(ray.AxisY);
+		const auto axisZ = static_cast<uSize>(ray.AxisZ);
+#if AVX512
+		__m512 AVX512f32_OriginX = _mm512_set1_ps(ray.Origin[ray.AxisX]);
+		__m512 AVX512f32_OriginY = _mm512_set1_ps(ray.Origin[ray.AxisY]);
+		__m512 AVX512f32_OriginZ = _mm512_set1_ps(ray.Origin[ray.AxisZ]);
+		__m512 AVX512f32_ShearX = _mm512_set1_ps(ray.ShearX);
+		__m512 AVX512f32_ShearY = _mm512_set1_ps(ray.ShearY);
+
+		std::array<__m512, 3> AVX512f32_X;
+		std::array<__m512, 3> AVX512f32_Y;
+		std::array<__m512, 3> AVX512f32_Z;
+		for (uSize corner = 0; corner != 3; corner++)
+		{
+			AVX512f32_Z[corner] = _mm512_sub_ps(_mm512_load_ps(m_Vertices[corner][axisZ].data()), AVX512f32_OriginZ);
+			AVX512f32_X[corner] = _mm512_sub_ps(_mm512_sub_ps(_mm512_load_ps(m_Vertices[corner][axisX].data()), AVX512f32_OriginX), _mm512_mul_ps(AVX512f32_ShearX, AVX512f32_Z[corner]));
+			AVX512f32_Y[corner] = _mm512_sub_ps(_mm512_sub_ps(_mm512_load_ps(m_Vertices[corner][axisY].data()), AVX512f32_OriginY), _mm512_mul_ps(AVX512f32_ShearY, AVX512f32_Z[corner]));
+		}
+
+		__m512 AVX512f32_U = _mm512_sub_ps(_mm512_mul_ps(AVX512f32_X[2], AVX512f32_Y[1]), _mm512_mul_ps(AVX512f32_Y[2], AVX512f32_X[1]));
+		__m512 AVX512f32_V = _mm512_sub_ps(_mm512_mul_ps(AVX512f32_X[0], AVX512f32_Y[2]), _mm512_mul_ps(AVX512f32_Y[0], AVX512f32_X[2]));
+		__m512 AVX512f32_W = _mm512_sub_ps(_mm512_mul_ps(AVX512f32_X[1], AVX512f32_Y[0]), _mm512_mul_ps(AVX512f32_Y[1], AVX512f32_X[0]));
+
+		const __m512 AVX512f32_Zero = _mm512_setzero_ps();
+		__mmask16 anyZero = static_cast<__mmask16>(m_LaneMask) & (_mm512_cmp_ps_mask(AVX512f32_U, AVX512f32_Zero, _CMP_EQ_OQ) |
+			_mm512_cmp_ps_mask(AVX512f32_V, AVX512f32_Zero, _CMP_EQ_OQ) | _mm512_cmp_ps_mask(AVX512f32_W, AVX512f32_Zero, _CMP_EQ_OQ));
+		if (anyZero != 0) [[unlikely]]
+			RecomputeEdgeFunctionsInDouble(static_cast<u32>(anyZero), AVX512f32_X, AVX512f32_Y, AVX512f32_U, AVX512f32_V, AVX512f32_W);
+
+		__mmask16 anyNegative = _mm512_cmp_ps_mask(AVX512f32_U, AVX512f32_Zero, _CMP_LT_OQ) | _mm512_cmp_ps_mask(AVX512f32_V, AVX512f32_Zero, _CMP_LT_OQ) | _mm512_cmp_ps_mask(AVX512f32_W, AVX512f32_Zero, _CMP_LT_OQ);
+		__mmask16 anyPositive = _mm512_cmp_ps_mask(AVX512f32_U, AVX512f32_Zero, _CMP_GT_OQ) | _mm512_cmp_ps_mask(AVX512f32_V, AVX512f32_Zero, _CMP_GT_OQ) | _mm512_cmp_ps_mask(AVX512f32_W, AVX512f32_Zero, _CMP_GT_OQ);
+
+		__m512 AVX512f32_Determinant = _mm512_add_ps(_mm512_add_ps(AVX512f32_U, AVX512f32_V), AVX512f32_W);
+		__mmask16 validMask = static_cast<__mmask16>(m_LaneMask) & ~(anyNegative & anyPositive);
+		validMask = _mm512_mask_cmp_ps_mask(validMask, AVX512f32_Determinant, AVX512f32_Zero, _CMP_NEQ_OQ);
+		if (validMask == 0)
+			return 0;
+
+		__m512 AVX512f32_T = _mm512_add_ps(_mm512_add_ps(
+			_mm512_mul_ps(AVX512f32_U, AVX512f32_Z[0]),
+			_mm512_mul_ps(AVX512f32_V, AVX512f32_Z[1])),
+			_mm512_mul_ps(AVX512f32_W, AVX512f32_Z[2]));
+		AVX512f32_T = _mm512_div_ps(_mm512_mul_ps(_mm512_set1_ps(ray.ShearZ), AVX512f32_T), AVX512f32_Determinant);
+
+		validMask = _mm512_mask_cmp_ps_mask(validMask, AVX512f32_T, _mm512_set1_ps(range.GetMin()), _CMP_GE_OQ);
+		validMask = _mm512_mask_cmp_ps_mask(validMask, AVX512f32_T, _mm512_set1_ps(range.GetMax()), _CMP_LE_OQ);
+
+		_mm512_store_ps(distances.data(), AVX512f32_T);
+		return static_cast<u32>(validMask);
+#elif AVX2
+		__m256 AVX2f32_OriginX = _mm256_set1_ps(ray.Origin[ray.AxisX]);
+		__m256 AVX2f32_OriginY = _mm256_set1_ps(ray.Origin[ray.AxisY]);
+		__m256 AVX2f32_OriginZ = _mm256_set1_ps(ray.Origin[ray.AxisZ]);
+		__m256 AVX2f32_ShearX = _mm256_set1_ps(ray.ShearX);
+		__m256 AVX2f32_ShearY = _mm256_set1_ps(ray.ShearY);
+
+		std::array<__m256, 3> AVX2f32_X;
+		std::array<__m256, 3> AVX2f32_Y;
+		std::array<__m256, 3> AVX2f32_Z;
+		for (uSize corner = 0; corner != 3; corner++)
+		{
+			AVX2f32_Z[corner] = _mm256_sub_ps(_mm256_load_ps(m_Vertices[corner][axisZ].data()), AVX2f32_OriginZ);
+			AVX2f32_X[corner] = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(m_Vertices[corner][axisX].data()), AVX2f32_OriginX), _mm256_mul_ps(AVX2f32_ShearX, AVX2f32_Z[corner]));
+			AVX2f32_Y[corner] = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(m_Vertices[corner][axisY].data()), AVX2f32_OriginY), _mm256_mul_ps(AVX2f32_ShearY, AVX2f32_Z[corner]));
+		}
+
+		__m256 AVX2f32_U = _mm256_sub_ps(_mm256_mul_ps(AVX2f32_X[2], AVX2f32_Y[1]), _mm256_mul_ps(AVX2f32_Y[2], AVX2f32_X[1]));
+		__m256 AVX2f32_V = _mm256_sub_ps(_mm256_mul_ps(AVX2f32_X[0], AVX2f32_Y[2]), _mm256_mul_ps(AVX2f32_Y[0], AVX2f32_X[2]));
+		__m256 AVX2f32_W = _mm256_sub_ps(_mm256_mul_ps(AVX2f32_X[1], AVX2f32_Y[0]), _mm256_mul_ps(AVX2f32_Y[1], AVX2f32_X[0]));
+
+		const __m256 AVX2f32_Zero = _mm256_setzero_ps();
+		u32 anyZero = m_LaneMask & static_cast<u32>(_mm256_movemask_ps(_mm256_or_ps(_mm256_or_ps(
+			_mm256_cmp_ps(AVX2f32_U, AVX2f32_Zero, _CMP_EQ_OQ),
+			_mm256_cmp_ps(AVX2f32_V, AVX2f32_Zero, _CMP_EQ_OQ)),
+			_mm256_cmp_ps(AVX2f32_W, AVX2f32_Zero, _CMP_EQ_OQ))));
+		if (anyZero != 0) [[unlikely]]
+			RecomputeEdgeFunctionsInDouble(anyZero, AVX2f32_X, AVX2f32_Y, AVX2f32_U, AVX2f32_V, AVX2f32_W);
+
+		__m256 AVX2f32_AnyNegative = _mm256_or_ps(_mm256_or_ps(
+			_mm256_cmp_ps(AVX2f32_U, AVX2f32_Zero, _CMP_LT_OQ),
+			_mm256_cmp_ps(AVX2f32_V, AVX2f32_Zero, _CMP_LT_OQ)),
+			_mm256_cmp_ps(AVX2f32_W, AVX2f32_Zero, _CMP_LT_OQ));
+		__m256 AVX2f32_AnyPositive = _mm256_or_ps(_mm256_or_ps(
+			_mm256_cmp_ps(AVX2f32_U, AVX2f32_Zero, _CMP_GT_OQ),
+			_mm256_cmp_ps(AVX2f32_V, AVX2f32_Zero, _CMP_GT_OQ)),
+			_mm256_cmp_ps(AVX2f32_W, AVX2f32_Zero, _CMP_GT_OQ));
+
+		__m256 AVX2f32_Determinant = _mm256_add_ps(_mm256_add_ps(AVX2f32_U, AVX2f32_V), AVX2f32_W);
+		__m256 AVX2f32_Valid = _mm256_andnot_ps(_mm256_and_ps(AVX2f32_AnyNegative, AVX2f32_AnyPositive), _mm256_cmp_ps(AVX2f32_Determinant, AVX2f32_Zero, _CMP_NEQ_OQ));
+		u32 validMask = static_cast<u32>(_mm256_movemask_ps(AVX2f32_Valid)) & m_LaneMask;
+		if (validMask == 0)
+			return 0;
+
+		__m256 AVX2f32_T = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(AVX2f32_U, AVX2f32_Z[0]),
+			_mm256_mul_ps(AVX2f32_V, AVX2f32_Z[1])),
+			_mm256_mul_ps(AVX2f32_W, AVX2f32_Z[2]));
+		AVX2f32_T = _mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(ray.ShearZ), AVX2f32_T), AVX2f32_Determinant);
+
+		__m256 AVX2f32_InRange = _mm256_and_ps(
+			_mm256_cmp_ps(AVX2f32_T, _mm256_set1_ps(range.GetMin()), _CMP_GE_OQ),
+			_mm256_cmp_ps(AVX2f32_T, _mm256_set1_ps(range.GetMax()), _CMP_LE_OQ));
+
+		_mm256_store_ps(distances.data(), AVX2f32_T);
+		return static_cast<u32>(_mm256_movemask_ps(AVX2f32_InRange)) & validMask;
+#else
+		__m128 SSEf32_OriginX = _mm_set1_ps(ray.Origin[ray.AxisX]);
+		__m128 SSEf32_OriginY = _mm_set1_ps(ray.Origin[ray.AxisY]);
+		__m128 SSEf32_OriginZ = _mm_set1_ps(ray.Origin[ray.AxisZ]);
+		__m128 SSEf32_ShearX = _mm_set1_ps(ray.ShearX);
+		__m128 SSEf32_ShearY = _mm_set1_ps(ray.ShearY);
+
+		std::array<__m128, 3> SSEf32_X;
+		std::array<__m128, 3> SSEf32_Y;
+		std::array<__m128, 3> SSEf32_Z;
+		for (uSize corner = 0; corner != 3; corner++)
+		{
+			SSEf32_Z[corner] = _mm_sub_ps(_mm_load_ps(m_Vertices[corner][axisZ].data()), SSEf32_OriginZ);
+			SSEf32_X[corner] = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(m_Vertices[corner][axisX].data()), SSEf32_OriginX), _mm_mul_ps(SSEf32_ShearX, SSEf32_Z[corner]));
+			SSEf32_Y[corner] = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(m_Vertices[corner][axisY].data()), SSEf32_OriginY), _mm_mul_ps(SSEf32_ShearY, SSEf32_Z[corner]));
+		}
+
+		__m128 SSEf32_U = _mm_sub_ps(_mm_mul_ps(SSEf32_X[2], SSEf32_Y[1]), _mm_mul_ps(SSEf32_Y[2], SSEf32_X[1]));
+		__m128 SSEf32_V = _mm_sub_ps(_mm_mul_ps(SSEf32_X[0], SSEf32_Y[2]), _mm_mul_ps(SSEf32_Y[0], SSEf32_X[2]));
+		__m128 SSEf32_W = _mm_sub_ps(_mm_mul_ps(SSEf32_X[1], SSEf32_Y[0]), _mm_mul_ps(SSEf32_Y[1], SSEf32_X[0]));
+
+		const __m128 SSEf32_Zero = _mm_setzero_ps();
+		u32 anyZero = m_LaneMask & static_cast<u32>(_mm_movemask_ps(_mm_or_ps(_mm_or_ps(
+			_mm_cmpeq_ps(SSEf32_U, SSEf32_Zero), _mm_cmpeq_ps(SSEf32_V, SSEf32_Zero)), _mm_cmpeq_ps(SSEf32_W, SSEf32_Zero))));
+		if (anyZero != 0) [[unlikely]]
+			RecomputeEdgeFunctionsInDouble(anyZero, SSEf32_X, SSEf32_Y, SSEf32_U, SSEf32_V, SSEf32_W);
+
+		__m128 SSEf32_AnyNegative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(SSEf32_U, SSEf32_Zero), _mm_cmplt_ps(SSEf32_V, SSEf32_Zero)), _mm_cmplt_ps(SSEf32_W, SSEf32_Zero));
+		__m128 SSEf32_AnyPositive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(SSEf32_U, SSEf32_Zero), _mm_cmpgt_ps(SSEf32_V, SSEf32_Zero)), _mm_cmpgt_ps(SSEf32_W, SSEf32_Zero));
+
+		__m128 SSEf32_Determinant = _mm_add_ps(_mm_add_ps(SSEf32_U, SSEf32_V), SSEf32_W);
+		__m128 SSEf32_Valid = _mm_andnot_ps(_mm_and_ps(SSEf32_AnyNegative, SSEf32_AnyPositive), _mm_cmpneq_ps(SSEf32_Determinant, SSEf32_Zero));
+		u32 validMask = static_cast<u32>(_mm_movemask_ps(SSEf32_Valid)) & m_LaneMask;
+		if (validMask == 0)
+			return 0;
+
+		__m128 SSEf32_T = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(SSEf32_U, SSEf32_Z[0]),
+			_mm_mul_ps(SSEf32_V, SSEf32_Z[1])),
+			_mm_mul_ps(SSEf32_W, SSEf32_Z[2]));
+		SSEf32_T = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(ray.ShearZ), SSEf32_T), SSEf32_Determinant);
+
+		__m128 SSEf32_InRange = _mm_and_ps(_mm_cmpge_ps(SSEf32_T, _mm_set1_ps(range.GetMin())), _mm_cmple_ps(SSEf32_T, _mm_set1_ps(range.GetMax())));
+
+		_mm_store_ps(distances.data(), SSEf32_T);
+		return static_cast<u32>(_mm_movemask_ps(SSEf32_InRange)) & validMask;
+#endif
+	}
+}
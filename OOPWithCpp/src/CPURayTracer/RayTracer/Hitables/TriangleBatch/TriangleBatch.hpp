@@ -0,0 +1,61 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+#include "TriangleMesh.hpp"
+
+#include <array>
+#include <span>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// one triangle per SIMD lane
+#if AVX512
+	inline constexpr uSize TriangleBatchWidth = 16;
+#elif AVX2
+	inline constexpr uSize TriangleBatchWidth = 8;
+#else
+	inline constexpr uSize TriangleBatchWidth = 4;
+#endif
+
+	// Up to TriangleBatchWidth triangles of a BVH leaf, possibly from different meshes, stored as SoA and run through the watertight test together.
+	// Built by SplitBVH, hits are recorded against the mesh with the triangle as the primitive index so it finalizes them, the meshes must outlive the batch
+	class alignas(64) TriangleBatch : public BaseHitable
+	{
+	public:
+		TriangleBatch() = delete;
+		explicit TriangleBatch(std::span<const TriangleMesh* const> meshes, std::span<const u32> triangleIndices);
+		~TriangleBatch() override = default;
+
+		TriangleBatch(const TriangleBatch&) = delete;
+		TriangleBatch& operator=(const TriangleBatch&) = delete;
+		TriangleBatch(TriangleBatch&&) = delete;
+		TriangleBatch& operator=(TriangleBatch&&) = delete;
+
+		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+
+		AABB GetAABB() const override { return m_AABB; }
+
+		OWC_FORCE_INLINE uSize GetNumberOfTriangles() const { return m_NumberOfTriangles; }
+
+	private:
+		// lanes hit within range, writes the distance of each such lane to distances
+		u32 __vectorcall IntersectTriangles(const WatertightRay& ray, const Interval& range, std::array<f32, TriangleBatchWidth>& distances) const;
+
+	private:
+		using Lanes = std::array<f32, TriangleBatchWidth>;
+
+		alignas(64) std::array<std::array<Lanes, 3>, 3> m_Vertices{}; // [corner][axis]
+		std::array<const TriangleMesh*, TriangleBatchWidth> m_Meshes{};
+		std::array<u32, TriangleBatchWidth> m_TriangleIndices{};
+		u32 m_LaneMask = 0; // lanes holding a triangle
+		uSize m_NumberOfTriangles = 0;
+		AABB m_AABB = AABB::Empty;
+	};
+}
+
+#pragma warning(pop)
@@ -0,0 +1,104 @@
+﻿#include "TriangleMesh.hpp"
+#include "BaseMaterial.hpp"
+
+
+namespace OWC
+{
+	TriangleMesh::TriangleMesh(std::vector<Point>&& positions, std::vector<u32>&& indices, const std::shared_ptr<BaseMaterial>& material,
+		std::vector<Vec3>&& normals, std::vector<Vec2>&& uvs)
+		: m_Positions(std::move(positions)), m_Normals(std::move(normals)), m_UVs(std::move(uvs)), m_Indices(std::move(indices)), m_Material(material)
+	{
+		m_Indices.resize(m_Indices.size() - m_Indices.size() % 3);
+		if (m_Normals.size() != m_Positions.size())
+			m_Normals.clear();
+		if (m_UVs.size() != m_Positions.size())
+			m_UVs.clear();
+
+		for (u32 triangleIndex = 0; triangleIndex != GetNumberOfTriangles(); triangleIndex++)
+			m_AABB.Expand(GetTriangleAABB(triangleIndex));
+	}
+
+	bool __vectorcall TriangleMesh::IsHit(const Ray& ray, Interval& range, HitData& hitData) const
+	{
+		WatertightRay watertightRay(ray);
+		bool isHit = false;
+		for (u32 triangleIndex = 0; triangleIndex != GetNumberOfTriangles(); triangleIndex++)
+		{
+			f32 t;
+			if (!watertightRay.Intersect(GetVertex(triangleIndex, 0), GetVertex(triangleIndex, 1), GetVertex(triangleIndex, 2), range, t))
+				continue;
+
+			range.SetMax(t);
+			hitData.Record(this, t, triangleIndex);
+			isHit = true;
+		}
+
+		return isHit;
+	}
+
+	bool __vectorcall TriangleMesh::IsOccluded(const Ray& ray, const Interval& range) const
+	{
+		WatertightRay watertightRay(ray);
+		for (u32 triangleIndex = 0; triangleIndex != GetNumberOfTriangles(); triangleIndex++)
+		{
+			f32 t;
+			if (watertightRay.Intersect(GetVertex(triangleIndex, 0), GetVertex(triangleIndex, 1), GetVertex(triangleIndex, 2), range, t))
+				return true;
+		}
+
+		return false;
+	}
+
+	void __vectorcall TriangleMesh::FinalizeHit(const Ray& ray, HitData& hitData) const
+	{
+		const u32* indices = m_Indices.data() + 3 * static_cast<uSize>(hitData.primitiveIndex);
+		const Point& p0 = m_Positions[indices[0]];
+		Vec3 edge1 = m_Positions[indices[1]] - p0;
+		Vec3 edge2 = m_Positions[indices[2]] - p0;
+
+		hitData.point = ray.GetPointAtDistance(hitData.t);
+
+		// the barycentrics are worked out again from the hit point here rather than carried through traversal for every candidate
+		Vec3 toPoint = hitData.point - p0;
+		f32 d11 = glm::dot(edge1, edge1);
+		f32 d12 = glm::dot(edge1, edge2);
+		f32 d22 = glm::dot(edge2, edge2);
+		f32 dp1 = glm::dot(toPoint, edge1);
+		f32 dp2 = glm::dot(toPoint, edge2);
+		f32 invDenominator = 1.0f / (d11 * d22 - d12 * d12);
+		f32 b1 = (d22 * dp1 - d12 * dp2) * invDenominator;
+		f32 b2 = (d11 * dp2 - d12 * dp1) * invDenominator;
+		f32 b0 = 1.0f - b1 - b2;
+
+		Vec3 normal = m_Normals.empty() ?
+			glm::cross(edge1, edge2) :
+			b0 * m_Normals[indices[0]] + b1 * m_Normals[indices[1]] + b2 * m_Normals[indices[2]];
+		hitData.SetFaceNormal(ray, glm::normalize(normal));
+
+		// the footprint is scaled by how much bigger the triangle is in UV space than in world space
+		f32 worldArea = glm::length(glm::cross(edge1, edge2));
+		if (m_UVs.empty())
+		{
+			hitData.uv = Vec2(b1, b2);
+			hitData.footprint *= glm::inversesqrt(worldArea);
+		}
+		else
+		{
+			const Vec2& uv0 = m_UVs[indices[0]];
+			Vec2 uvEdge1 = m_UVs[indices[1]] - uv0;
+			Vec2 uvEdge2 = m_UVs[indices[2]] - uv0;
+			hitData.uv = b0 * uv0 + b1 * m_UVs[indices[1]] + b2 * m_UVs[indices[2]];
+			hitData.footprint *= glm::sqrt(glm::abs(uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x) / worldArea);
+		}
+
+		hitData.material = &m_Material->GetCompiled();
+	}
+
+	AABB TriangleMesh::GetTriangleAABB(u32 triangleIndex) const
+	{
+		const Point& v0 = GetVertex(triangleIndex, 0);
+		const Point& v1 = GetVertex(triangleIndex, 1);
+		const Point& v2 = GetVertex(triangleIndex, 2);
+		return AABB(glm::min(glm::min(v0, v1), v2), glm::max(glm::max(v0, v1), v2));
+	}
+}
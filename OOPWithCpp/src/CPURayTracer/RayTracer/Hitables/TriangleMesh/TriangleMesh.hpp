@@ -0,0 +1,124 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseHittable.hpp"
+#include "Ray.hpp"
+#include "AABB.hpp"
+
+#include <memory>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// A ray set up for the watertight ray/triangle test of Woop et al, the axis the ray is most aligned with becomes z
+	// and the ray is sheared to point straight down it so every triangle is tested in 2D against the origin.
+	// An edge shared by two triangles gets the same edge function in both so no ray slips through between them
+	struct WatertightRay
+	{
+		Point Origin{ 0.0f };
+		f32 ShearX = 0.0f;
+		f32 ShearY = 0.0f;
+		f32 ShearZ = 0.0f;
+		i32 AxisX = 0;
+		i32 AxisY = 1;
+		i32 AxisZ = 2;
+
+		OWC_FORCE_INLINE explicit WatertightRay(const Ray& ray) : Origin(ray.GetOrigin())
+		{
+			const Vec3& direction = ray.GetDirection();
+			Vec3 absDirection = glm::abs(direction);
+			AxisZ = absDirection.x > absDirection.y ? (absDirection.x > absDirection.z ? 0 : 2) : (absDirection.y > absDirection.z ? 1 : 2);
+			AxisX = AxisZ == 2 ? 0 : AxisZ + 1;
+			AxisY = AxisX == 2 ? 0 : AxisX + 1;
+			if (direction[AxisZ] < 0.0f)
+				std::swap(AxisX, AxisY); // keeps the winding so front faces still give positive edge functions
+
+			ShearZ = 1.0f / direction[AxisZ];
+			ShearX = direction[AxisX] * ShearZ;
+			ShearY = direction[AxisY] * ShearZ;
+		}
+
+		// x0 * y1 - y0 * x1 in double precision, the products of two floats are exact in a double so an edge that comes out
+		// exactly 0 in floats is decided the same way for both triangles that share it, as in the paper
+		static OWC_FORCE_INLINE f32 EdgeFunctionInDouble(f32 x0, f32 y0, f32 x1, f32 y1)
+		{
+			return static_cast<f32>(static_cast<f64>(x0) * static_cast<f64>(y1) - static_cast<f64>(y0) * static_cast<f64>(x1));
+		}
+
+		// both products are rounded the same way so the edge function of a shared edge is the exact negation of its neighbour's
+		static OWC_FORCE_INLINE f32 EdgeFunction(f32 x0, f32 y0, f32 x1, f32 y1)
+		{
+			f32 edge = x0 * y1 - y0 * x1;
+			return edge != 0.0f ? edge : EdgeFunctionInDouble(x0, y0, x1, y1);
+		}
+
+		// the distance to the triangle if it is hit within range
+		OWC_FORCE_INLINE bool __vectorcall Intersect(const Point& v0, const Point& v1, const Point& v2, const Interval& range, f32& t) const
+		{
+			Vec3 a = v0 - Origin;
+			Vec3 b = v1 - Origin;
+			Vec3 c = v2 - Origin;
+
+			f32 ax = a[AxisX] - ShearX * a[AxisZ];
+			f32 ay = a[AxisY] - ShearY * a[AxisZ];
+			f32 bx = b[AxisX] - ShearX * b[AxisZ];
+			f32 by = b[AxisY] - ShearY * b[AxisZ];
+			f32 cx = c[AxisX] - ShearX * c[AxisZ];
+			f32 cy = c[AxisY] - ShearY * c[AxisZ];
+
+			f32 u = EdgeFunction(cx, cy, bx, by);
+			f32 v = EdgeFunction(ax, ay, cx, cy);
+			f32 w = EdgeFunction(bx, by, ax, ay);
+			if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+				return false;
+
+			f32 determinant = u + v + w;
+			if (determinant == 0.0f)
+				return false;
+
+			t = ShearZ * (u * a[AxisZ] + v * b[AxisZ] + w * c[AxisZ]) / determinant;
+			return range.Contains(t);
+		}
+	};
+
+	// Indexed triangle mesh, a triangle is three entries of the index buffer into vertex buffers shared by the whole mesh and never an object of its own.
+	// SplitBVH opens meshes up and builds over their triangles which it intersects in TriangleBatch leaves, a mesh tested on its own walks every triangle
+	class TriangleMesh : public BaseHitable
+	{
+	public:
+		TriangleMesh() = delete;
+		// normals and uvs are either empty or one per position, without normals every face is flat shaded and without uvs the barycentrics are used
+		TriangleMesh(std::vector<Point>&& positions, std::vector<u32>&& indices, const std::shared_ptr<BaseMaterial>& material,
+			std::vector<Vec3>&& normals = {}, std::vector<Vec2>&& uvs = {});
+		~TriangleMesh() override = default;
+
+		TriangleMesh(const TriangleMesh&) = delete;
+		TriangleMesh& operator=(const TriangleMesh&) = delete;
+		TriangleMesh(TriangleMesh&&) = delete;
+		TriangleMesh& operator=(TriangleMesh&&) = delete;
+
+		bool __vectorcall IsHit(const Ray& ray, Interval& range, HitData& hitData) const override;
+		bool __vectorcall IsOccluded(const Ray& ray, const Interval& range) const override;
+		// hitData.primitiveIndex is the triangle
+		void __vectorcall FinalizeHit(const Ray& ray, HitData& hitData) const override;
+
+		AABB GetAABB() const override { return m_AABB; }
+
+		OWC_FORCE_INLINE u32 GetNumberOfTriangles() const { return static_cast<u32>(m_Indices.size() / 3); }
+		OWC_FORCE_INLINE const Point& GetVertex(u32 triangleIndex, u32 corner) const { return m_Positions[m_Indices[3 * triangleIndex + corner]]; }
+		AABB GetTriangleAABB(u32 triangleIndex) const;
+
+	private:
+		std::vector<Point> m_Positions;
+		std::vector<Vec3> m_Normals;
+		std::vector<Vec2> m_UVs;
+		std::vector<u32> m_Indices; // three per triangle
+		std::shared_ptr<BaseMaterial> m_Material;
+		AABB m_AABB = AABB::Empty;
+	};
+}
+
+#pragma warning(pop)
@@ -0,0 +1,122 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "Ray.hpp"
+
+#include <array>
+#include <limits>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// one child per SIMD lane, 8 children for the 256 bit builds and 4 for SSE
+#if AVX2
+	inline constexpr uSize WideBVHWidth = 8;
+#else
+	inline constexpr uSize WideBVHWidth = 4;
+#endif
+
+	// ray data needed by WideBVHNode::IntersectChildren, worked out once per traversal instead of once per node
+	struct WideBVHRay
+	{
+		Vec3 InvDirection{ 0.0f };
+		Vec3 OriginTimesInvDirection{ 0.0f };
+		// rows of WideBVHNode::Bounds the ray enters and leaves each axis through, picked by the sign of the direction
+		std::array<u8, 3> NearBoundsRow{};
+		std::array<u8, 3> FarBoundsRow{};
+
+		OWC_FORCE_INLINE explicit WideBVHRay(const Ray& ray)
+			: InvDirection(ray.GetInvDirection()), OriginTimesInvDirection(ray.GetOrigin() * ray.GetInvDirection())
+		{
+			for (u8 axis = 0; axis != 3; axis++)
+			{
+				u8 isNegative = InvDirection[axis] < 0.0f ? 1 : 0;
+				NearBoundsRow[axis] = 2 * axis + isNegative;
+				FarBoundsRow[axis] = 2 * axis + 1 - isNegative;
+			}
+		}
+	};
+
+	// node of a BVH collapsed to WideBVHWidth children, the children's bounds are stored as SoA so they are all tested at once
+	struct alignas(64) WideBVHNode
+	{
+		using ChildDistances = std::array<f32, WideBVHWidth>;
+
+		// row 2 * axis holds every child's minimum on that axis and row 2 * axis + 1 the maximums
+		// unused children get an inverted box so no ray can hit them
+		std::array<std::array<f32, WideBVHWidth>, 6> Bounds;
+		std::array<u32, WideBVHWidth> Offsets{}; // leaf: first primitive, interior: index of the child node
+		std::array<u16, WideBVHWidth> NumberOfPrimitives{}; // 0 for interior children
+		u32 NumberOfChildren = 0;
+
+		OWC_FORCE_INLINE WideBVHNode()
+		{
+			for (uSize row = 0; row != Bounds.size(); row += 2)
+			{
+				Bounds[row].fill(std::numeric_limits<f32>::max());
+				Bounds[row + 1].fill(-std::numeric_limits<f32>::max());
+			}
+		}
+
+		OWC_FORCE_INLINE bool IsLeafChild(uSize child) const { return NumberOfPrimitives[child] != 0; }
+
+		// takes the bounds in the layout of BVHNode::Bounds
+		OWC_FORCE_INLINE void SetChildBounds(uSize child, const std::array<f32, 6>& bounds)
+		{
+			for (uSize row = 0; row != Bounds.size(); row++)
+				Bounds[row][child] = bounds[row];
+		}
+
+		// slab tests the ray against every child, returns a mask with a bit set for each child hit within [tMin, tMax)
+		// and writes the distance the ray enters each child at to childDistances
+		OWC_FORCE_INLINE u32 __vectorcall IntersectChildren(const WideBVHRay& ray, f32 tMin, f32 tMax, ChildDistances& childDistances) const
+		{
+#if AVX2
+			__m256 AVX2f32_TNear = _mm256_set1_ps(tMin);
+			__m256 AVX2f32_TFar = _mm256_set1_ps(tMax);
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				__m256 AVX2f32_InvDirection = _mm256_set1_ps(ray.InvDirection[static_cast<i32>(axis)]);
+				__m256 AVX2f32_OriginTimesInvDirection = _mm256_set1_ps(ray.OriginTimesInvDirection[static_cast<i32>(axis)]);
+				// (bound - origin) * invDirection as one fused multiply subtract
+				__m256 AVX2f32_AxisTNear = _mm256_fmsub_ps(_mm256_load_ps(Bounds[ray.NearBoundsRow[axis]].data()), AVX2f32_InvDirection, AVX2f32_OriginTimesInvDirection);
+				__m256 AVX2f32_AxisTFar = _mm256_fmsub_ps(_mm256_load_ps(Bounds[ray.FarBoundsRow[axis]].data()), AVX2f32_InvDirection, AVX2f32_OriginTimesInvDirection);
+				AVX2f32_TNear = _mm256_max_ps(AVX2f32_TNear, AVX2f32_AxisTNear);
+				AVX2f32_TFar = _mm256_min_ps(AVX2f32_TFar, AVX2f32_AxisTFar);
+			}
+
+			_mm256_store_ps(childDistances.data(), AVX2f32_TNear);
+#if AVX512
+			return static_cast<u32>(_mm256_cmp_ps_mask(AVX2f32_TNear, AVX2f32_TFar, _CMP_LT_OQ));
+#else
+			return static_cast<u32>(_mm256_movemask_ps(_mm256_cmp_ps(AVX2f32_TNear, AVX2f32_TFar, _CMP_LT_OQ)));
+#endif
+#else
+			__m128 SSEf32_TNear = _mm_set1_ps(tMin);
+			__m128 SSEf32_TFar = _mm_set1_ps(tMax);
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				__m128 SSEf32_InvDirection = _mm_set1_ps(ray.InvDirection[static_cast<i32>(axis)]);
+				__m128 SSEf32_OriginTimesInvDirection = _mm_set1_ps(ray.OriginTimesInvDirection[static_cast<i32>(axis)]);
+				__m128 SSEf32_AxisTNear = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(Bounds[ray.NearBoundsRow[axis]].data()), SSEf32_InvDirection), SSEf32_OriginTimesInvDirection);
+				__m128 SSEf32_AxisTFar = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(Bounds[ray.FarBoundsRow[axis]].data()), SSEf32_InvDirection), SSEf32_OriginTimesInvDirection);
+				SSEf32_TNear = _mm_max_ps(SSEf32_TNear, SSEf32_AxisTNear);
+				SSEf32_TFar = _mm_min_ps(SSEf32_TFar, SSEf32_AxisTFar);
+			}
+
+			_mm_store_ps(childDistances.data(), SSEf32_TNear);
+			return static_cast<u32>(_mm_movemask_ps(_mm_cmplt_ps(SSEf32_TNear, SSEf32_TFar)));
+#endif
+		}
+	};
+
+#if AVX2
+	static_assert(sizeof(WideBVHNode) == 256, "WideBVHNode size is not 256 bytes!");
+#else
+	static_assert(sizeof(WideBVHNode) == 128, "WideBVHNode size is not 128 bytes!");
+#endif
+}
+
+#pragma warning(pop)
@@ -1,11 +1,7 @@
 ﻿#pragma once
-#define BASEMATERIAL_HPP
 #include "Core.hpp"
 #include "Ray.hpp"
-
-#ifndef BaseHittable_HPP
-#include "BaseHittable.hpp"
-#endif // !BaseHittable_HPP
+#include "CompiledMaterial.hpp"
 
 
 namespace OWC
@@ -15,7 +11,8 @@ namespace OWC
 	class BaseMaterial
 	{
 	public:
-		BaseMaterial() = default;
+		BaseMaterial() { m_Compiled.Source = this; }
+		explicit BaseMaterial(MaterialType type) { m_Compiled.Type = type; m_Compiled.Source = this; }
 		virtual ~BaseMaterial() = default;
 
 		BaseMaterial(const BaseMaterial&) = delete;
@@ -28,5 +25,19 @@ namespace OWC
 		virtual Colour Emitted(Ray& /*ray*/, const HitData& /*hitData*/) const { return Colour(0.0f); }
 
 		virtual Colour Albedo(HitData& /*data*/) const { return Colour(0.0f); }
+
+		OWC_FORCE_INLINE MaterialType GetType() const { return m_Compiled.Type; }
+		// what the render loop shades with, see CompiledMaterial
+		OWC_FORCE_INLINE const CompiledMaterial& GetCompiled() const { return *m_CompiledEntry; }
+		// shades with a copy of the compiled material kept in a compact table instead of the one inside the material, see MaterialRegistry
+		// the copy has to outlive the material and is not updated if the material changes
+		OWC_FORCE_INLINE void SetCompiledEntry(const CompiledMaterial& entry) { m_CompiledEntry = &entry; }
+
+	protected:
+		// the built in materials fill in their parameters from their constructors
+		CompiledMaterial m_Compiled;
+
+	private:
+		const CompiledMaterial* m_CompiledEntry = &m_Compiled;
 	};
 }
@@ -0,0 +1,21 @@
+﻿#include "CompiledMaterial.hpp"
+#include "BaseMaterial.hpp"
+
+
+namespace OWC
+{
+	Colour CompiledMaterial::AlbedoOther(HitData& hitData) const
+	{
+		return Source->Albedo(hitData);
+	}
+
+	Colour CompiledMaterial::EmittedOther(Ray& ray, const HitData& hitData) const
+	{
+		return Source->Emitted(ray, hitData);
+	}
+
+	bool CompiledMaterial::ScatterOther(Ray& ray, const HitData& hitData) const
+	{
+		return Source->Scatter(ray, hitData);
+	}
+}
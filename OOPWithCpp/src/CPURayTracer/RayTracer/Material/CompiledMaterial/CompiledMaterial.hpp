@@ -0,0 +1,203 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "Ray.hpp"
+#include "BaseHittable.hpp"
+#include "CompiledTexture.hpp"
+
+#include "OWCRand.hpp"
+
+#include <glm/gtx/norm.hpp>
+
+
+namespace OWC
+{
+	class BaseMaterial;
+
+	// the built in materials, so hits can be grouped by material and shaded without virtual calls, any other material is Other
+	enum class MaterialType : u8
+	{
+		Lambertian = 0,
+		Metal,
+		Dielectric,
+		DefusedLight,
+		Other,
+		Count
+	};
+
+	// Flat copy of a material holding everything the shading loop needs, every BaseMaterial builds its own on construction
+	// the built in materials are switched on Type and inline, Other calls back into the virtuals of Source
+	struct CompiledMaterial
+	{
+		// the spread a ray cone opens up to after a diffuse bounce, in radians, a diffuse path is averaging over so much
+		// of the scene that textures further along it are read from coarse mip levels without any visible difference
+		static constexpr f32 DiffuseConeSpread = 0.1f;
+
+		CompiledTexture Texture;
+		Colour Emission{ 0.0f };
+		const BaseMaterial* Source = nullptr;
+		f32 Roughness = 0.0f;
+		f32 RefractiveIndex = 1.0f;
+		f32 InverseRefractiveIndex = 1.0f;
+		MaterialType Type = MaterialType::Other;
+
+		OWC_FORCE_INLINE Colour Albedo(HitData& hitData) const
+		{
+			switch (Type)
+			{
+			case MaterialType::Lambertian:   return AlbedoAs<MaterialType::Lambertian>(hitData);
+			case MaterialType::Metal:        return AlbedoAs<MaterialType::Metal>(hitData);
+			case MaterialType::Dielectric:   return AlbedoAs<MaterialType::Dielectric>(hitData);
+			case MaterialType::DefusedLight: return AlbedoAs<MaterialType::DefusedLight>(hitData);
+			default:                         return AlbedoAs<MaterialType::Other>(hitData);
+			}
+		}
+
+		OWC_FORCE_INLINE Colour Emitted(Ray& ray, const HitData& hitData) const
+		{
+			switch (Type)
+			{
+			case MaterialType::Lambertian:   return EmittedAs<MaterialType::Lambertian>(ray, hitData);
+			case MaterialType::Metal:        return EmittedAs<MaterialType::Metal>(ray, hitData);
+			case MaterialType::Dielectric:   return EmittedAs<MaterialType::Dielectric>(ray, hitData);
+			case MaterialType::DefusedLight: return EmittedAs<MaterialType::DefusedLight>(ray, hitData);
+			default:                         return EmittedAs<MaterialType::Other>(ray, hitData);
+			}
+		}
+
+		OWC_FORCE_INLINE bool Scatter(Ray& ray, const HitData& hitData) const
+		{
+			switch (Type)
+			{
+			case MaterialType::Lambertian:   return ScatterAs<MaterialType::Lambertian>(ray, hitData);
+			case MaterialType::Metal:        return ScatterAs<MaterialType::Metal>(ray, hitData);
+			case MaterialType::Dielectric:   return ScatterAs<MaterialType::Dielectric>(ray, hitData);
+			case MaterialType::DefusedLight: return ScatterAs<MaterialType::DefusedLight>(ray, hitData);
+			default:                         return ScatterAs<MaterialType::Other>(ray, hitData);
+			}
+		}
+
+		// the spread angle of the ray cone leaving a hit, taking the spread it arrived with, curvature of the surface is not accounted for
+		OWC_FORCE_INLINE f32 ScatteredConeSpread(f32 spread) const
+		{
+			switch (Type)
+			{
+			case MaterialType::Lambertian:   return ScatteredConeSpreadAs<MaterialType::Lambertian>(spread);
+			case MaterialType::Metal:        return ScatteredConeSpreadAs<MaterialType::Metal>(spread);
+			case MaterialType::Dielectric:   return ScatteredConeSpreadAs<MaterialType::Dielectric>(spread);
+			case MaterialType::DefusedLight: return ScatteredConeSpreadAs<MaterialType::DefusedLight>(spread);
+			default:                         return ScatteredConeSpreadAs<MaterialType::Other>(spread);
+			}
+		}
+
+		// for callers that already know the type, such as the material bins of WavefrontIntegrator
+		template<MaterialType type>
+		OWC_FORCE_INLINE Colour AlbedoAs(HitData& hitData) const
+		{
+			if constexpr (type == MaterialType::DefusedLight)
+				return Colour(0.0f);
+			else if constexpr (type == MaterialType::Other)
+				return AlbedoOther(hitData);
+			else
+				return Texture.Value(hitData);
+		}
+
+		template<MaterialType type>
+		OWC_FORCE_INLINE Colour EmittedAs(Ray& ray, const HitData& hitData) const
+		{
+			if constexpr (type == MaterialType::DefusedLight)
+				return Emission;
+			else if constexpr (type == MaterialType::Other)
+				return EmittedOther(ray, hitData);
+			else
+				return Colour(0.0f);
+		}
+
+		template<MaterialType type>
+		OWC_FORCE_INLINE bool ScatterAs(Ray& ray, const HitData& hitData) const
+		{
+			if constexpr (type == MaterialType::Lambertian)
+				return ScatterLambertian(ray, hitData);
+			else if constexpr (type == MaterialType::Metal)
+				return ScatterMetal(ray, hitData, Roughness);
+			else if constexpr (type == MaterialType::Dielectric)
+				return ScatterDielectric(ray, hitData, RefractiveIndex, InverseRefractiveIndex);
+			else if constexpr (type == MaterialType::DefusedLight)
+				return false;
+			else
+				return ScatterOther(ray, hitData);
+		}
+
+		template<MaterialType type>
+		OWC_FORCE_INLINE f32 ScatteredConeSpreadAs(f32 spread) const
+		{
+			if constexpr (type == MaterialType::Lambertian)
+				return glm::max(spread, DiffuseConeSpread);
+			else if constexpr (type == MaterialType::Metal)
+				return spread + Roughness * DiffuseConeSpread;
+			else
+				return spread; // mirror like, materials outside the built in set keep the finest mips they can
+		}
+
+		// the scattering of each built in material, their classes forward to these too
+		static OWC_FORCE_INLINE bool ScatterLambertian(Ray& ray, const HitData& hitData)
+		{
+			Vec3 scatterDirection = hitData.normal + Rand::FastUnitVector();
+
+			ray.SetOrigin(hitData.point);
+			Vec3 absScatterDirection = glm::abs(scatterDirection);
+			if (absScatterDirection.x < 1e-8f && absScatterDirection.y < 1e-8f && absScatterDirection.z < 1e-8f)
+				ray.SetNormalizedDirection(hitData.normal); // hitdata normal is normalized
+			else
+				ray.SetDirection(scatterDirection);
+
+			return true;
+		}
+
+		static OWC_FORCE_INLINE bool ScatterMetal(Ray& ray, const HitData& hitData, f32 roughness)
+		{
+			Vec3 newDirection = glm::reflect(ray.GetDirection(), hitData.normal);
+			newDirection = glm::normalize(newDirection) + (Rand::FastUnitVector() * roughness);
+
+			ray = Ray(hitData.point, newDirection);
+			return true;
+		}
+
+		static OWC_FORCE_INLINE bool ScatterDielectric(Ray& ray, const HitData& hitData, f32 refractiveIndex, f32 inverseRefractiveIndex)
+		{
+			f32 ri = hitData.frontFace ? inverseRefractiveIndex : refractiveIndex;
+
+			f32 cosTheta = glm::min(glm::dot(-ray.GetDirection(), hitData.normal), 1.0f);
+			f32 sinTheta = glm::sqrt(1.0f - cosTheta * cosTheta);
+
+			Vec3 newDirection{};
+			Vec2 random = Rand::LinearFastRandVec2(Vec2(0.0f), Vec2(1.0f));
+			if ((ri * sinTheta > 1.0f) || Reflectance(cosTheta, ri) > random.x)
+				newDirection = glm::reflect(ray.GetDirection(), hitData.normal);
+			else
+				newDirection = Refract(ray.GetDirection(), hitData.normal, cosTheta, ri);
+
+			ray = Ray(hitData.point, newDirection);
+			return true;
+		}
+
+	private:
+		static OWC_FORCE_INLINE Point Refract(const Vec3& rayDirection, const Vec3& normal, f32 cosTheta, f32 ri)
+		{
+			Vec3 rOutPerp = ri * (rayDirection + cosTheta * normal);
+			Vec3 rOutParallel = -std::sqrt(glm::abs(1.0f - glm::length2(rOutPerp))) * normal;
+			return rOutPerp + rOutParallel;
+		}
+
+		static OWC_FORCE_INLINE f32 Reflectance(f32 cos, f32 refractiveIndex)
+		{
+			f32 r0 = (1.0f - refractiveIndex) / (1.0f + refractiveIndex);
+			r0 *= r0;
+			return r0 + (1.0f - r0) * glm::pow(1.0f - cos, 5.0f);
+		}
+
+		// BaseMaterial is incomplete here, these make the virtual calls from the .cpp
+		Colour AlbedoOther(HitData& hitData) const;
+		Colour EmittedOther(Ray& ray, const HitData& hitData) const;
+		bool ScatterOther(Ray& ray, const HitData& hitData) const;
+	};
+}
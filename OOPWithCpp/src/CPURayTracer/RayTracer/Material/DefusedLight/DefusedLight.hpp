@@ -10,7 +10,10 @@ namespace OWC
 	public:
 		DefusedLight() = delete;
 		explicit DefusedLight(const Colour& emitColor = Colour(1.0f), const float emitIntensity = 1.0f)
-			: m_EmitColor(emitColor * emitIntensity) {}
+			: BaseMaterial(MaterialType::DefusedLight)
+		{
+			m_Compiled.Emission = emitColor * emitIntensity;
+		}
 		~DefusedLight() override = default;
 
 		DefusedLight(const DefusedLight&) = delete;
@@ -25,10 +28,7 @@ namespace OWC
 
 		Colour Emitted(Ray& /*ray*/, const HitData& /*hitData*/) const override
 		{
-			return m_EmitColor;
+			return m_Compiled.Emission;
 		}
-
-	private:
-		Colour m_EmitColor;
 	};
 }
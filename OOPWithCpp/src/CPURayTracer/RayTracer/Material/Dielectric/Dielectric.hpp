@@ -13,6 +13,8 @@ namespace OWC
 		Dielectric(f32 refractiveIndex);
 		Dielectric(f32 refractiveIndex, const Colour& colour);
 		Dielectric(f32 refractiveIndex, std::shared_ptr<BaseTexture> texture);
+		// does not own the texture, which has to outlive the material, as one from the same SceneArena does
+		Dielectric(f32 refractiveIndex, const BaseTexture& texture);
 		~Dielectric() override = default;
 
 		Dielectric(const Dielectric&) = delete;
@@ -21,16 +23,9 @@ namespace OWC
 		Dielectric& operator=(Dielectric&&) = delete;
 
 		bool Scatter(Ray& ray, const HitData& hitData) const override;
-		Colour Albedo(HitData& data) const override { return m_Texture->Value(data); }
+		Colour Albedo(HitData& data) const override { return m_Compiled.Texture.Value(data); }
 
 	private:
-		Point Refract(const Vec3& rayDirection, const Vec3& normal, f32 cosTheta, f32 ri) const;
-
-		static f32 Reflectance(f32 cos, f32 refractiveIndex);
-
-	private:
-		std::shared_ptr<BaseTexture> m_Texture;
-		f32 m_RefractiveIndex;
-		f32 m_InverseRefractiveIndex; // Precomputed for efficiency, also does not take extra space due to alignment
+		std::shared_ptr<BaseTexture> m_Texture; // kept alive for m_Compiled, empty when something else owns it
 	};
 }
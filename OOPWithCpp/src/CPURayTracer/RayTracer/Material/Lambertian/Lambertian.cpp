@@ -1,35 +1,31 @@
 ﻿#include "Lambertian.hpp"
 #include "SolidTexture.hpp"
-#include "OWCRand.hpp"
 
 
 namespace OWC
 {
-	OWC_FORCE_INLINE static bool operator<(const Vec3& lhs, f32 rhs)
+	Lambertian::Lambertian(const Colour& colour) : BaseMaterial(MaterialType::Lambertian), m_Texture(std::make_shared<SolidTexture>(colour))
 	{
-		Vec3 absLHS(glm::abs(lhs));
-		return absLHS.x < rhs && absLHS.y < rhs && absLHS.z < rhs;
+		m_Compiled.Texture = CompiledTexture(*m_Texture);
 	}
 
-	Lambertian::Lambertian(const Colour& colour) : m_Texture(std::make_shared<SolidTexture>(colour)) {}
+	Lambertian::Lambertian(const std::shared_ptr<BaseTexture>& texture) : Lambertian(*texture)
+	{
+		m_Texture = texture;
+	}
 
-	Lambertian::Lambertian(const std::shared_ptr<BaseTexture>& texture) : m_Texture(texture) {}
+	Lambertian::Lambertian(const BaseTexture& texture) : BaseMaterial(MaterialType::Lambertian)
+	{
+		m_Compiled.Texture = CompiledTexture(texture);
+	}
 
 	bool Lambertian::Scatter(Ray& ray, const HitData& hitData) const
 	{
-		Vec3 scatterDirection = hitData.normal + Rand::FastUnitVector();
-
-		ray.SetOrigin(hitData.point);
-		if (scatterDirection < 1e-8f)
-			ray.SetNormalizedDirection(hitData.normal); // hitdata normal is normalized
-		else 
-			ray.SetDirection(scatterDirection); // hitdata normal is normalized so we can scale by 0.5 to keep it normalized
-
-		return true;
+		return CompiledMaterial::ScatterLambertian(ray, hitData);
 	}
 
 	Colour Lambertian::Albedo(HitData& data) const
 	{
-		return m_Texture->Value(data);
+		return m_Compiled.Texture.Value(data);
 	}
 }
@@ -14,12 +14,14 @@ namespace OWC
 		Lambertian() = delete;
 		explicit Lambertian(const Colour& colour);
 		explicit Lambertian(const std::shared_ptr<BaseTexture>& texture);
+		// does not own the texture, which has to outlive the material, as one from the same SceneArena does
+		explicit Lambertian(const BaseTexture& texture);
 
 		bool Scatter(Ray& ray, const HitData& hitData) const override;
 
 		Colour Albedo(HitData& data) const override;
 
 	private:
-		std::shared_ptr<BaseTexture> m_Texture;
+		std::shared_ptr<BaseTexture> m_Texture; // kept alive for m_Compiled, empty when something else owns it
 	};
 }
@@ -2,31 +2,35 @@
 
 #include "SolidTexture.hpp"
 
-#include "OWCRand.hpp"
-
 
 namespace OWC
 {
 	Metal::Metal(f32 roughness)
-		: m_Texture(std::make_shared<SolidTexture>(1.0f)), m_Roughness(roughness) {}
+		: Metal(roughness, std::make_shared<SolidTexture>(1.0f)) {}
 
 	Metal::Metal(f32 roughness, const Colour& colour)
-		: m_Texture(std::make_shared<SolidTexture>(colour)), m_Roughness(roughness) {}
+		: Metal(roughness, std::make_shared<SolidTexture>(colour)) {}
 
 	Metal::Metal(f32 roughness, const std::shared_ptr<BaseTexture>& texture)
-		: m_Texture(texture), m_Roughness(roughness) {}
+		: Metal(roughness, *texture)
+	{
+		m_Texture = texture;
+	}
 
-	bool Metal::Scatter(Ray& ray, const HitData& hitData) const
+	Metal::Metal(f32 roughness, const BaseTexture& texture)
+		: BaseMaterial(MaterialType::Metal)
 	{
-		Vec3 newDirection = glm::reflect(ray.GetDirection(), hitData.normal);
-		newDirection = glm::normalize(newDirection) + (Rand::FastUnitVector() * m_Roughness);
+		m_Compiled.Texture = CompiledTexture(texture);
+		m_Compiled.Roughness = roughness;
+	}
 
-		ray = Ray(hitData.point, newDirection);
-		return true;
+	bool Metal::Scatter(Ray& ray, const HitData& hitData) const
+	{
+		return CompiledMaterial::ScatterMetal(ray, hitData, m_Compiled.Roughness);
 	}
 
 	Colour Metal::Albedo(HitData& data) const
 	{
-		return m_Texture->Value(data);
+		return m_Compiled.Texture.Value(data);
 	}
 }
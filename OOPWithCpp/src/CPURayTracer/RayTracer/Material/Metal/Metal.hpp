@@ -16,6 +16,8 @@ namespace OWC
 		Metal(f32 roughness);
 		Metal(f32 roughness, const Colour& colour);
 		Metal(f32 roughness, const std::shared_ptr<BaseTexture>& texture);
+		// does not own the texture, which has to outlive the material, as one from the same SceneArena does
+		Metal(f32 roughness, const BaseTexture& texture);
 		~Metal() override = default;
 
 		Metal(const Metal&) = delete;
@@ -27,7 +29,6 @@ namespace OWC
 		Colour Albedo(HitData& data) const override;
 
 	private:
-		std::shared_ptr<BaseTexture> m_Texture = nullptr;
-		f32 m_Roughness = 0.5f;
+		std::shared_ptr<BaseTexture> m_Texture = nullptr; // kept alive for m_Compiled, empty when something else owns it
 	};
 }
\ No newline at end of file
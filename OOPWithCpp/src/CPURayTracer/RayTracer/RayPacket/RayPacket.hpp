@@ -0,0 +1,137 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "Ray.hpp"
+#include "Interval.hpp"
+
+#include <array>
+#include <bit>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	class BaseHitable;
+
+	// one ray per SIMD lane
+#if AVX512
+	inline constexpr uSize RayPacketWidth = 16;
+#elif AVX2
+	inline constexpr uSize RayPacketWidth = 8;
+#else
+	inline constexpr uSize RayPacketWidth = 4;
+#endif
+
+	// rays stored as SoA so a whole packet is tested against a box or primitive at once
+	// lanes are selected with a bit mask, bit n for lane n
+	struct alignas(64) RayPacket
+	{
+		using Lanes = std::array<f32, RayPacketWidth>;
+
+		std::array<Lanes, 3> Origin;
+		std::array<Lanes, 3> Direction; // normalized
+		std::array<Lanes, 3> InvDirection;
+		std::array<Lanes, 3> OriginTimesInvDirection;
+		Lanes TMin;
+		Lanes TMax; // shrinks to the closest hit of each ray
+		std::array<const BaseHitable*, RayPacketWidth> HitObjects; // primitive of the closest hit, nullptr for a miss
+		std::array<u32, RayPacketWidth> HitPrimitives; // HitData::primitiveIndex of the closest hit
+		std::array<const BaseHitable*, RayPacketWidth> HitInstances; // HitData::instance of the closest hit
+		u32 ActiveMask = 0; // lanes that hold a ray
+
+		OWC_FORCE_INLINE void SetRay(uSize lane, const Ray& ray, const Interval& range)
+		{
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				const auto component = static_cast<i32>(axis);
+				Origin[axis][lane] = ray.GetOrigin()[component];
+				Direction[axis][lane] = ray.GetDirection()[component];
+				InvDirection[axis][lane] = ray.GetInvDirection()[component];
+				OriginTimesInvDirection[axis][lane] = ray.GetOrigin()[component] * ray.GetInvDirection()[component];
+			}
+
+			TMin[lane] = range.GetMin();
+			TMax[lane] = range.GetMax();
+			HitObjects[lane] = nullptr;
+			ActiveMask |= 1u << lane;
+		}
+
+		OWC_FORCE_INLINE Ray GetRay(uSize lane) const
+		{
+			Ray ray;
+			ray.SetOrigin(Vec3(Origin[0][lane], Origin[1][lane], Origin[2][lane]));
+			ray.SetNormalizedDirection(Vec3(Direction[0][lane], Direction[1][lane], Direction[2][lane]));
+			return ray;
+		}
+
+		// lanes past the last ray are filled with copies of lane 0 so the SIMD tests never work on garbage, their bits stay clear
+		OWC_FORCE_INLINE void PadInactiveLanes()
+		{
+			for (uSize lane = static_cast<uSize>(std::popcount(ActiveMask)); lane != RayPacketWidth; lane++)
+			{
+				for (uSize axis = 0; axis != 3; axis++)
+				{
+					Origin[axis][lane] = Origin[axis][0];
+					Direction[axis][lane] = Direction[axis][0];
+					InvDirection[axis][lane] = InvDirection[axis][0];
+					OriginTimesInvDirection[axis][lane] = OriginTimesInvDirection[axis][0];
+				}
+
+				TMin[lane] = TMin[0];
+				TMax[lane] = TMax[0];
+				HitObjects[lane] = nullptr;
+			}
+		}
+
+		// slab tests the lanes in laneMask against bounds laid out like BVHNode::Bounds, returns the lanes that hit within [TMin, TMax)
+		OWC_FORCE_INLINE u32 __vectorcall IntersectAABB(const f32* bounds, u32 laneMask) const
+		{
+#if AVX512
+			__m512 AVX512f32_TNear = _mm512_load_ps(TMin.data());
+			__m512 AVX512f32_TFar = _mm512_load_ps(TMax.data());
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				__m512 AVX512f32_InvDirection = _mm512_load_ps(InvDirection[axis].data());
+				__m512 AVX512f32_OriginTimesInvDirection = _mm512_load_ps(OriginTimesInvDirection[axis].data());
+				__m512 AVX512f32_T0 = _mm512_fmsub_ps(_mm512_set1_ps(bounds[2 * axis]), AVX512f32_InvDirection, AVX512f32_OriginTimesInvDirection);
+				__m512 AVX512f32_T1 = _mm512_fmsub_ps(_mm512_set1_ps(bounds[2 * axis + 1]), AVX512f32_InvDirection, AVX512f32_OriginTimesInvDirection);
+				AVX512f32_TNear = _mm512_max_ps(AVX512f32_TNear, _mm512_min_ps(AVX512f32_T0, AVX512f32_T1));
+				AVX512f32_TFar = _mm512_min_ps(AVX512f32_TFar, _mm512_max_ps(AVX512f32_T0, AVX512f32_T1));
+			}
+
+			return static_cast<u32>(_mm512_mask_cmp_ps_mask(static_cast<__mmask16>(laneMask), AVX512f32_TNear, AVX512f32_TFar, _CMP_LT_OQ));
+#elif AVX2
+			__m256 AVX2f32_TNear = _mm256_load_ps(TMin.data());
+			__m256 AVX2f32_TFar = _mm256_load_ps(TMax.data());
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				__m256 AVX2f32_InvDirection = _mm256_load_ps(InvDirection[axis].data());
+				__m256 AVX2f32_OriginTimesInvDirection = _mm256_load_ps(OriginTimesInvDirection[axis].data());
+				__m256 AVX2f32_T0 = _mm256_fmsub_ps(_mm256_set1_ps(bounds[2 * axis]), AVX2f32_InvDirection, AVX2f32_OriginTimesInvDirection);
+				__m256 AVX2f32_T1 = _mm256_fmsub_ps(_mm256_set1_ps(bounds[2 * axis + 1]), AVX2f32_InvDirection, AVX2f32_OriginTimesInvDirection);
+				AVX2f32_TNear = _mm256_max_ps(AVX2f32_TNear, _mm256_min_ps(AVX2f32_T0, AVX2f32_T1));
+				AVX2f32_TFar = _mm256_min_ps(AVX2f32_TFar, _mm256_max_ps(AVX2f32_T0, AVX2f32_T1));
+			}
+
+			return static_cast<u32>(_mm256_movemask_ps(_mm256_cmp_ps(AVX2f32_TNear, AVX2f32_TFar, _CMP_LT_OQ))) & laneMask;
+#else
+			__m128 SSEf32_TNear = _mm_load_ps(TMin.data());
+			__m128 SSEf32_TFar = _mm_load_ps(TMax.data());
+			for (uSize axis = 0; axis != 3; axis++)
+			{
+				__m128 SSEf32_InvDirection = _mm_load_ps(InvDirection[axis].data());
+				__m128 SSEf32_OriginTimesInvDirection = _mm_load_ps(OriginTimesInvDirection[axis].data());
+				__m128 SSEf32_T0 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(bounds[2 * axis]), SSEf32_InvDirection), SSEf32_OriginTimesInvDirection);
+				__m128 SSEf32_T1 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(bounds[2 * axis + 1]), SSEf32_InvDirection), SSEf32_OriginTimesInvDirection);
+				SSEf32_TNear = _mm_max_ps(SSEf32_TNear, _mm_min_ps(SSEf32_T0, SSEf32_T1));
+				SSEf32_TFar = _mm_min_ps(SSEf32_TFar, _mm_max_ps(SSEf32_T0, SSEf32_T1));
+			}
+
+			return static_cast<u32>(_mm_movemask_ps(_mm_cmplt_ps(SSEf32_TNear, SSEf32_TFar))) & laneMask;
+#endif
+		}
+	};
+}
+
+#pragma warning(pop)
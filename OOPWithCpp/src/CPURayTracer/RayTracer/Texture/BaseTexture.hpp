@@ -5,11 +5,25 @@
 
 namespace OWC
 {
+	// the built in textures, so CompiledTexture can read them without virtual calls, any other texture is Other
+	enum class TextureType : u8
+	{
+		Solid = 0,
+		Image,
+		Other
+	};
+
 	class BaseTexture
 	{
 	public:
 		BaseTexture() = default;
+		explicit BaseTexture(TextureType type) : m_Type(type) {}
 		virtual ~BaseTexture() = default;
 		virtual Colour Value(const HitData& p) const = 0;
+
+		OWC_FORCE_INLINE TextureType GetType() const { return m_Type; }
+
+	private:
+		TextureType m_Type = TextureType::Other;
 	};
 }
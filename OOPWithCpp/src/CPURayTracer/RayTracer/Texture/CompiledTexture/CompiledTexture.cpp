@@ -0,0 +1,13 @@
+﻿#include "CompiledTexture.hpp"
+#include "SolidTexture.hpp"
+
+
+namespace OWC
+{
+	CompiledTexture::CompiledTexture(const BaseTexture& texture)
+		: m_Source(&texture), m_Type(texture.GetType())
+	{
+		if (m_Type == TextureType::Solid)
+			m_Colour = static_cast<const SolidTexture&>(texture).GetColour();
+	}
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "BaseTexture.hpp"
+#include "ImageTexture.hpp"
+
+
+namespace OWC
+{
+	// Flat copy of a texture for the shading loop, a solid colour is read straight out of it
+	// and an image is sampled with a direct call, only textures outside the built in set go through the vtable
+	class CompiledTexture
+	{
+	public:
+		CompiledTexture() = default; // black
+		explicit CompiledTexture(const BaseTexture& texture);
+
+		OWC_FORCE_INLINE Colour Value(const HitData& hitData) const
+		{
+			switch (m_Type)
+			{
+			case TextureType::Solid: return m_Colour;
+			case TextureType::Image: return static_cast<const ImageTexture*>(m_Source)->ImageTexture::Value(hitData);
+			default:                 return m_Source->Value(hitData);
+			}
+		}
+
+	private:
+		Colour m_Colour{ 0.0f };
+		const BaseTexture* m_Source = nullptr; // owned by the material the texture was compiled for
+		TextureType m_Type = TextureType::Solid;
+	};
+}
@@ -1,18 +1,177 @@
 ﻿#include "ImageTexture.hpp"
 
+#include "ImageLoader.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+
 
 namespace OWC
 {
-	ImageTexture::ImageTexture(const std::string& imagePath)
-		: m_Image(imagePath) {}
+	namespace
+	{
+		OWC_FORCE_INLINE __m128 __vectorcall Lerp(__m128 a, __m128 b, f32 t)
+		{
+#if AVX2
+			return _mm_fmadd_ps(_mm_sub_ps(b, a), _mm_set1_ps(t), a);
+#else
+			return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+#endif
+		}
+
+		// 2 x 2 box filter, the last row or column of an odd sized level is folded into the last texel before it which averages 3 instead of 2
+		// so every texel of the level above counts towards the level below, a side that is already 1 texel wide is only filtered along the other
+		std::vector<Colour> Downsample(const std::vector<Colour>& colours, u32 width, u32 height, u32 newWidth, u32 newHeight)
+		{
+			std::vector<Colour> downsampled(static_cast<uSize>(newWidth) * newHeight);
+			for (u32 y = 0; y != newHeight; y++)
+			{
+				u32 yBegin = glm::min(2 * y, height - 1);
+				u32 yEnd = y + 1 == newHeight ? height : yBegin + 2;
+				for (u32 x = 0; x != newWidth; x++)
+				{
+					u32 xBegin = glm::min(2 * x, width - 1);
+					u32 xEnd = x + 1 == newWidth ? width : xBegin + 2;
+
+					Colour sum(0.0f);
+					for (u32 sourceY = yBegin; sourceY != yEnd; sourceY++)
+						for (u32 sourceX = xBegin; sourceX != xEnd; sourceX++)
+							sum += colours[static_cast<uSize>(sourceY) * width + sourceX];
+					downsampled[static_cast<uSize>(y) * newWidth + x] = sum / static_cast<f32>((xEnd - xBegin) * (yEnd - yBegin));
+				}
+			}
+			return downsampled;
+		}
+	}
+
+	ImageTexture::ImageTexture(const std::string& imagePath, TexelFormat format, TextureFilter filter)
+		: BaseTexture(TextureType::Image), m_Format(format), m_Filter(filter)
+	{
+		const bool isHDR = ImageLoader::IsHDR(imagePath);
+		if (isHDR && m_Format == TexelFormat::RGBA8sRGB)
+		{
+			Log<LogLevel::Warn>("{} is HDR and would be clipped to RGBA8 sRGB, keeping it as RGB9E5", imagePath);
+			m_Format = TexelFormat::RGB9E5;
+		}
+		m_TexelWords = TexelCodec::GetTexelWords(m_Format);
+
+		// 8 bit files are always read as bytes so every format linearises them through the same sRGB curve,
+		// the loader is dropped at the end so only the compact texels stay in memory
+		const ImageLoader image(imagePath, isHDR ? ImagePixelFormat::RGBA32F : ImagePixelFormat::RGBA8);
+		auto width = static_cast<u32>(image.GetWidth());
+		auto height = static_cast<u32>(image.GetHeight());
+		if (width == 0 || height == 0)
+			return;
+
+		// whole tiles per level, so with 16 texels to a tile every level starts 16 byte aligned in every format
+		uSize numberOfWords = 0;
+		for (u32 levelWidth = width, levelHeight = height;; levelWidth = glm::max(levelWidth / 2, 1u), levelHeight = glm::max(levelHeight / 2, 1u))
+		{
+			MipLevel& level = m_Levels.emplace_back();
+			level.Width = levelWidth;
+			level.Height = levelHeight;
+			level.TilesPerRow = (levelWidth + TileSize - 1) / TileSize;
+			level.Offset = numberOfWords;
+			numberOfWords += static_cast<uSize>(level.TilesPerRow) * ((levelHeight + TileSize - 1) / TileSize) * TexelsPerTile * m_TexelWords;
+
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+		}
+		m_Texels.resize(numberOfWords);
+		m_LevelScale = static_cast<f32>(glm::max(width, height));
+
+		std::vector<Colour> colours;
+		colours.reserve(static_cast<uSize>(width) * height);
+		if (isHDR)
+			colours.assign(image.GetImageData().begin(), image.GetImageData().end());
+		else
+			for (u32 texel : image.GetImageDataRGBA8())
+				colours.emplace_back(TexelCodec::DecodeSRGB(texel));
+
+		if (!isHDR && m_Format == TexelFormat::RGBA8sRGB)
+		{
+			// the file's own bytes, not a round trip through floats
+			const std::vector<u32>& bytes = image.GetImageDataRGBA8();
+			for (u32 y = 0; y != height; y++)
+				for (u32 x = 0; x != width; x++)
+					m_Texels[GetTexelIndex(m_Levels[0], x, y)] = bytes[static_cast<uSize>(y) * width + x];
+		}
+		else
+			EncodeLevel(m_Levels[0], colours);
+
+		// the chain is filtered from the linear colours of the level above rather than from decoded texels
+		for (uSize i = 1; i != m_Levels.size(); i++)
+		{
+			const MipLevel& parent = m_Levels[i - 1];
+			colours = Downsample(colours, parent.Width, parent.Height, m_Levels[i].Width, m_Levels[i].Height);
+			EncodeLevel(m_Levels[i], colours);
+		}
+	}
 
 	OWC::Colour ImageTexture::Value(const HitData& hitData) const
 	{
+		Colour colour(0.0f);
+		if (m_Levels.empty())
+			return colour;
+
 		Vec2 uv = glm::clamp(hitData.uv, Vec2(0.0f), Vec2(1.0f));
 		uv.x = 1.0f - uv.x;
 
-		auto x = static_cast<uSize>(uv.x * static_cast<f32>(m_Image.GetWidth() - 1));
-		auto y = static_cast<uSize>(uv.y * static_cast<f32>(m_Image.GetHeight() - 1));
-		return m_Image.GetPixel(x, y);
+		// the level whose texels are as wide as the footprint
+		auto maxLevel = static_cast<f32>(m_Levels.size() - 1);
+		f32 level = hitData.footprint > 0.0f ? glm::clamp(glm::log2(hitData.footprint * m_LevelScale), 0.0f, maxLevel) : 0.0f;
+
+		switch (m_Filter)
+		{
+		case TextureFilter::Nearest:
+			colour.data = SampleNearest(m_Levels[static_cast<uSize>(level + 0.5f)], uv);
+			break;
+		case TextureFilter::Bilinear:
+			colour.data = SampleBilinear(m_Levels[static_cast<uSize>(level + 0.5f)], uv);
+			break;
+		default:
+		{
+			auto fineLevel = static_cast<uSize>(level);
+			f32 blend = level - static_cast<f32>(fineLevel);
+
+			colour.data = SampleBilinear(m_Levels[fineLevel], uv);
+			if (blend > 0.0f)
+				colour.data = Lerp(colour.data, SampleBilinear(m_Levels[fineLevel + 1], uv), blend);
+			break;
+		}
+		}
+		return colour;
+	}
+
+	__m128 __vectorcall ImageTexture::SampleNearest(const MipLevel& level, const Vec2& uv) const
+	{
+		u32 x = glm::min(static_cast<u32>(uv.x * static_cast<f32>(level.Width)), level.Width - 1);
+		u32 y = glm::min(static_cast<u32>(uv.y * static_cast<f32>(level.Height)), level.Height - 1);
+		return Fetch(level, x, y);
+	}
+
+	__m128 __vectorcall ImageTexture::SampleBilinear(const MipLevel& level, const Vec2& uv) const
+	{
+		// texel centres are at half integers, the texels past the edges are clamped to the edge
+		f32 x = uv.x * static_cast<f32>(level.Width) - 0.5f;
+		f32 y = uv.y * static_cast<f32>(level.Height) - 0.5f;
+		f32 floorX = glm::floor(x);
+		f32 floorY = glm::floor(y);
+
+		auto x0 = static_cast<u32>(glm::max(floorX, 0.0f));
+		auto y0 = static_cast<u32>(glm::max(floorY, 0.0f));
+		u32 x1 = glm::min(static_cast<u32>(floorX + 1.0f), level.Width - 1);
+		u32 y1 = glm::min(static_cast<u32>(floorY + 1.0f), level.Height - 1);
+
+		__m128 top = Lerp(Fetch(level, x0, y0), Fetch(level, x1, y0), x - floorX);
+		__m128 bottom = Lerp(Fetch(level, x0, y1), Fetch(level, x1, y1), x - floorX);
+		return Lerp(top, bottom, y - floorY);
+	}
+
+	void ImageTexture::EncodeLevel(const MipLevel& level, const std::vector<Colour>& colours)
+	{
+		for (u32 y = 0; y != level.Height; y++)
+			for (u32 x = 0; x != level.Width; x++)
+				TexelCodec::Encode(m_Format, colours[static_cast<uSize>(y) * level.Width + x], m_Texels.data() + GetTexelIndex(level, x, y));
 	}
 }
@@ -2,15 +2,34 @@
 #include "Core.hpp"
 #include "BaseTexture.hpp"
 
-#include "ImageLoader.hpp"
+#include "TexelFormat.hpp"
+#include "AlignedAllocator.hpp"
+
+#include <vector>
 
 
 namespace OWC
 {
+	// how ImageTexture filters between texels and mip levels, the level is picked from HitData::footprint
+	enum class TextureFilter : u8
+	{
+		Nearest = 0,	// the nearest texel of the nearest level
+		Bilinear,		// the 4 nearest texels of the nearest level
+		Trilinear		// bilinear in the two levels either side of the footprint, blended between them
+	};
+
+	// An image with a full mip chain, every level is stored in tiles of TileSize x TileSize texels with the texels of a tile
+	// in Morton order, so a lookup and its neighbours share a cache line or two wherever the rays that make them come from
     class ImageTexture : public BaseTexture
     {
     public:
-        ImageTexture(const std::string& imagePath);
+		// a tile of a 4 byte format is one cache line
+		static constexpr u32 TileSize = 4;
+		static constexpr u32 TexelsPerTile = TileSize * TileSize;
+
+    public:
+        // 8 bit images are kept as RGBA8 sRGB by default, an HDR file asked for in RGBA8 sRGB is kept as RGB9E5 instead
+        explicit ImageTexture(const std::string& imagePath, TexelFormat format = TexelFormat::RGBA8sRGB, TextureFilter filter = TextureFilter::Trilinear);
 		~ImageTexture() override = default;
 
 		ImageTexture(const ImageTexture&) = delete;
@@ -20,7 +39,50 @@ namespace OWC
 
         Colour Value(const HitData& p) const override;
 
+		[[nodiscard]] TexelFormat GetFormat() const { return m_Format; }
+		[[nodiscard]] TextureFilter GetFilter() const { return m_Filter; }
+		[[nodiscard]] uSize GetWidth() const { return m_Levels.empty() ? 0 : m_Levels[0].Width; }
+		[[nodiscard]] uSize GetHeight() const { return m_Levels.empty() ? 0 : m_Levels[0].Height; }
+		[[nodiscard]] uSize GetNumberOfMipLevels() const { return m_Levels.size(); }
+		// bytes held by the texels of every level, padding of the edge tiles included
+		[[nodiscard]] uSize GetSize() const { return m_Texels.size() * sizeof(u32); }
+
+	private:
+		struct MipLevel
+		{
+			u32 Width = 0;
+			u32 Height = 0;
+			u32 TilesPerRow = 0;
+			uSize Offset = 0; // the level's first word in m_Texels
+		};
+
+		// the first word of texel x, y of the level in m_Texels
+		OWC_FORCE_INLINE uSize GetTexelIndex(const MipLevel& level, u32 x, u32 y) const
+		{
+			static_assert(TileSize == 4, "the Morton order below interleaves 2 bits of x and y");
+			u32 tile = (y / TileSize) * level.TilesPerRow + x / TileSize;
+			u32 texelInTile = (x & 1u) | ((y & 1u) << 1) | ((x & 2u) << 1) | ((y & 2u) << 2);
+			return level.Offset + (static_cast<uSize>(tile) * TexelsPerTile + texelInTile) * m_TexelWords;
+		}
+
+		OWC_FORCE_INLINE __m128 __vectorcall Fetch(const MipLevel& level, u32 x, u32 y) const
+		{
+			return TexelCodec::Decode(m_Format, m_Texels.data() + GetTexelIndex(level, x, y));
+		}
+
+		// uv in [0, 1]
+		__m128 __vectorcall SampleNearest(const MipLevel& level, const Vec2& uv) const;
+		__m128 __vectorcall SampleBilinear(const MipLevel& level, const Vec2& uv) const;
+
+		// colours are the level's texels row by row
+		void EncodeLevel(const MipLevel& level, const std::vector<Colour>& colours);
+
 	private:
-		ImageLoader m_Image;
+		CacheAlignedVector<u32> m_Texels; // TexelCodec::GetTexelWords(m_Format) words per texel, every level one after another
+		std::vector<MipLevel> m_Levels; // finest first, down to 1 x 1
+		f32 m_LevelScale = 0.0f; // texels across the widest side of level 0, turns a footprint in UV units into texels
+		uSize m_TexelWords = 1;
+		TexelFormat m_Format;
+		TextureFilter m_Filter;
     };
 }
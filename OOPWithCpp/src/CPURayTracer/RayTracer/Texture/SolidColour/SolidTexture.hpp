@@ -9,11 +9,13 @@ namespace OWC
 	{
 	public:
 		SolidTexture() = delete;
-		OWC_FORCE_INLINE explicit SolidTexture(f32 greyScale) : m_Colour(Colour(greyScale)) {}
-		OWC_FORCE_INLINE explicit SolidTexture(const Colour& colour) : m_Colour(colour) {}
+		OWC_FORCE_INLINE explicit SolidTexture(f32 greyScale) : BaseTexture(TextureType::Solid), m_Colour(Colour(greyScale)) {}
+		OWC_FORCE_INLINE explicit SolidTexture(const Colour& colour) : BaseTexture(TextureType::Solid), m_Colour(colour) {}
 
 		inline Colour Value(const HitData&) const override { return m_Colour; }
 
+		OWC_FORCE_INLINE const Colour& GetColour() const { return m_Colour; }
+
 	private:
 		Colour m_Colour;
 	};
@@ -0,0 +1,128 @@
+﻿#include "TexelFormat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+namespace OWC
+{
+	namespace
+	{
+		std::array<f32, 256> BuildSRGBToLinear()
+		{
+			std::array<f32, 256> table{};
+			for (uSize i = 0; i != table.size(); i++)
+			{
+				f64 value = static_cast<f64>(i) / 255.0;
+				table[i] = static_cast<f32>(value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4));
+			}
+			return table;
+		}
+
+		// rounds to nearest even, overflow goes to infinity and NaN stays NaN
+		u16 FloatToHalf(f32 value)
+		{
+			u32 bits = std::bit_cast<u32>(value);
+			const u32 sign = (bits >> 16) & 0x8000u;
+			bits &= 0x7FFFFFFFu;
+
+			u32 half = 0;
+			if (bits >= (127u + 16u) << 23) // too large for a half
+				half = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+			else if (bits < 113u << 23) // a half denormal, let float addition do the rounding
+			{
+				const u32 denormalMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+				half = std::bit_cast<u32>(std::bit_cast<f32>(bits) + std::bit_cast<f32>(denormalMagic)) - denormalMagic;
+			}
+			else
+			{
+				const u32 mantissaOdd = (bits >> 13) & 1u;
+				bits += (static_cast<u32>(15 - 127) << 23) + 0xFFFu + mantissaOdd;
+				half = bits >> 13;
+			}
+			return static_cast<u16>(half | sign);
+		}
+	}
+
+	const std::array<f32, 256> TexelCodec::s_SRGBToLinear = BuildSRGBToLinear();
+
+	const char* TexelCodec::GetName(TexelFormat format)
+	{
+		switch (format)
+		{
+		case TexelFormat::RGBA32F:   return "RGBA32F";
+		case TexelFormat::RGBA8sRGB: return "RGBA8 sRGB";
+		case TexelFormat::RGB9E5:    return "RGB9E5";
+		case TexelFormat::RGBA16F:   return "RGBA16F";
+		default:                     return "Unknown";
+		}
+	}
+
+	Colour TexelCodec::DecodeSRGB(u32 texel)
+	{
+		Colour colour;
+		colour.data = DecodeRGBA8sRGB(texel);
+		return colour;
+	}
+
+	u32 TexelCodec::EncodeRGBA8sRGB(const Colour& colour)
+	{
+		u32 texel = 0;
+		for (uSize i = 0; i != 4; i++)
+		{
+			f32 value = glm::clamp(colour[static_cast<i32>(i)], 0.0f, 1.0f);
+			if (i != 3) // alpha stays linear
+				value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			texel |= static_cast<u32>(value * 255.0f + 0.5f) << (8 * i);
+		}
+		return texel;
+	}
+
+	u32 TexelCodec::EncodeRGB9E5(const Colour& colour)
+	{
+		// as in EXT_texture_shared_exponent
+		constexpr i32 maxExponent = 31;
+		const f32 maxValue = std::ldexp(static_cast<f32>((1u << RGB9E5MantissaBits) - 1u) / static_cast<f32>(1u << RGB9E5MantissaBits),
+			maxExponent - static_cast<i32>(RGB9E5ExponentBias));
+
+		std::array<f32, 3> channels{};
+		for (uSize i = 0; i != 3; i++)
+		{
+			f32 value = colour[static_cast<i32>(i)];
+			channels[i] = value > 0.0f ? std::min(value, maxValue) : 0.0f; // also sends NaN to 0
+		}
+		const f32 maxChannel = std::max({ channels[0], channels[1], channels[2] });
+
+		const i32 bias = static_cast<i32>(RGB9E5ExponentBias);
+		const i32 mantissaBits = static_cast<i32>(RGB9E5MantissaBits);
+		i32 exponent = maxChannel > 0.0f ? std::max(-bias - 1, static_cast<i32>(std::floor(std::log2(maxChannel)))) + 1 + bias : 0;
+		if (std::floor(std::ldexp(maxChannel, -(exponent - bias - mantissaBits)) + 0.5f) == static_cast<f32>(1u << RGB9E5MantissaBits))
+			exponent++; // the largest channel rounded up past 9 bits
+
+		u32 texel = static_cast<u32>(exponent) << 27;
+		for (uSize i = 0; i != 3; i++)
+		{
+			const auto mantissa = static_cast<u32>(std::floor(std::ldexp(channels[i], -(exponent - bias - mantissaBits)) + 0.5f));
+			texel |= std::min(mantissa, 0x1FFu) << (9 * i);
+		}
+		return texel;
+	}
+
+	void TexelCodec::EncodeRGBA16F(const Colour& colour, u32* texel)
+	{
+		texel[0] = static_cast<u32>(FloatToHalf(colour.r)) | (static_cast<u32>(FloatToHalf(colour.g)) << 16);
+		texel[1] = static_cast<u32>(FloatToHalf(colour.b)) | (static_cast<u32>(FloatToHalf(colour.a)) << 16);
+	}
+
+	void TexelCodec::Encode(TexelFormat format, const Colour& colour, u32* texel)
+	{
+		switch (format)
+		{
+		case TexelFormat::RGBA8sRGB: *texel = EncodeRGBA8sRGB(colour); break;
+		case TexelFormat::RGB9E5:    *texel = EncodeRGB9E5(colour); break;
+		case TexelFormat::RGBA16F:   EncodeRGBA16F(colour, texel); break;
+		default:                     std::memcpy(texel, &colour, sizeof(Colour)); break;
+		}
+	}
+}
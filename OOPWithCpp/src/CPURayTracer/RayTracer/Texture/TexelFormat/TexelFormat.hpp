@@ -0,0 +1,117 @@
+﻿#pragma once
+#include "Core.hpp"
+
+#include <array>
+#include <bit>
+
+
+namespace OWC
+{
+	// how ImageTexture keeps its texels in memory
+	enum class TexelFormat : u8
+	{
+		RGBA32F = 0,	// 16 bytes, exact
+		RGBA8sRGB,		// 4 bytes, 8 bit sRGB colour and linear alpha, for ordinary 8 bit images
+		RGB9E5,			// 4 bytes, three 9 bit mantissas sharing a 5 bit exponent, for HDR colour, alpha is always 1
+		RGBA16F			// 8 bytes, a half float per channel
+	};
+
+	// Encodes texels when a texture is loaded and decodes one texel into an __m128 when it is sampled
+	class TexelCodec
+	{
+	public:
+		TexelCodec() = delete;
+
+		// u32 words per texel
+		[[nodiscard]] static constexpr uSize GetTexelWords(TexelFormat format)
+		{
+			switch (format)
+			{
+			case TexelFormat::RGBA32F: return 4;
+			case TexelFormat::RGBA16F: return 2;
+			default:                   return 1;
+			}
+		}
+
+		[[nodiscard]] static const char* GetName(TexelFormat format);
+
+		[[nodiscard]] static Colour DecodeSRGB(u32 texel);
+		[[nodiscard]] static u32 EncodeRGBA8sRGB(const Colour& colour);
+		[[nodiscard]] static u32 EncodeRGB9E5(const Colour& colour);
+		// writes two words
+		static void EncodeRGBA16F(const Colour& colour, u32* texel);
+		// writes GetTexelWords(format) words
+		static void Encode(TexelFormat format, const Colour& colour, u32* texel);
+
+		OWC_FORCE_INLINE static __m128 __vectorcall DecodeRGBA8sRGB(u32 texel)
+		{
+			// three table loads are cheaper than a gather for a single texel
+			return _mm_setr_ps(
+				s_SRGBToLinear[texel & 0xFFu],
+				s_SRGBToLinear[(texel >> 8) & 0xFFu],
+				s_SRGBToLinear[(texel >> 16) & 0xFFu],
+				static_cast<f32>(texel >> 24) * (1.0f / 255.0f)
+			);
+		}
+
+		OWC_FORCE_INLINE static __m128 __vectorcall DecodeRGB9E5(u32 texel)
+		{
+			const __m128i mantissas = _mm_setr_epi32(
+				static_cast<i32>(texel & 0x1FFu),
+				static_cast<i32>((texel >> 9) & 0x1FFu),
+				static_cast<i32>((texel >> 18) & 0x1FFu),
+				0
+			);
+			// 2^(exponent - bias - mantissa bits)
+			const f32 scale = std::bit_cast<f32>(((texel >> 27) + 127u - RGB9E5ExponentBias - RGB9E5MantissaBits) << 23);
+			const __m128 colour = _mm_mul_ps(_mm_cvtepi32_ps(mantissas), _mm_set1_ps(scale));
+			return _mm_blend_ps(colour, _mm_set1_ps(1.0f), 0b1000);
+		}
+
+		OWC_FORCE_INLINE static __m128 __vectorcall DecodeRGBA16F(const u32* texel)
+		{
+			const __m128i halves = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(texel));
+#if AVX2 // F16C ships with every AVX2 CPU
+			return _mm_cvtph_ps(halves);
+#else
+			// widen the halves into floats by rebiasing the exponent, denormals are renormalised by a float subtraction
+			const __m128i SSEi32_Halves = _mm_cvtepu16_epi32(halves);
+			const __m128i SSEi32_ShiftedExponent = _mm_set1_epi32(0x7C00 << 13);
+
+			__m128i SSEi32_Bits = _mm_slli_epi32(_mm_and_si128(SSEi32_Halves, _mm_set1_epi32(0x7FFF)), 13);
+			const __m128i SSEi32_Exponent = _mm_and_si128(SSEi32_Bits, SSEi32_ShiftedExponent);
+			SSEi32_Bits = _mm_add_epi32(SSEi32_Bits, _mm_set1_epi32((127 - 15) << 23));
+
+			const __m128i SSEi32_IsInfOrNaN = _mm_cmpeq_epi32(SSEi32_Exponent, SSEi32_ShiftedExponent);
+			SSEi32_Bits = _mm_add_epi32(SSEi32_Bits, _mm_and_si128(SSEi32_IsInfOrNaN, _mm_set1_epi32((128 - 16) << 23)));
+
+			const __m128i SSEi32_IsDenormal = _mm_cmpeq_epi32(SSEi32_Exponent, _mm_setzero_si128());
+			const __m128 SSEf32_Denormal = _mm_sub_ps(
+				_mm_castsi128_ps(_mm_add_epi32(SSEi32_Bits, _mm_set1_epi32(1 << 23))),
+				_mm_castsi128_ps(_mm_set1_epi32(113 << 23))
+			);
+			__m128 SSEf32_Value = _mm_blendv_ps(_mm_castsi128_ps(SSEi32_Bits), SSEf32_Denormal, _mm_castsi128_ps(SSEi32_IsDenormal));
+
+			const __m128i SSEi32_Sign = _mm_slli_epi32(_mm_and_si128(SSEi32_Halves, _mm_set1_epi32(0x8000)), 16);
+			return _mm_or_ps(SSEf32_Value, _mm_castsi128_ps(SSEi32_Sign));
+#endif
+		}
+
+		OWC_FORCE_INLINE static __m128 __vectorcall Decode(TexelFormat format, const u32* texel)
+		{
+			switch (format)
+			{
+			case TexelFormat::RGBA8sRGB: return DecodeRGBA8sRGB(*texel);
+			case TexelFormat::RGB9E5:    return DecodeRGB9E5(*texel);
+			case TexelFormat::RGBA16F:   return DecodeRGBA16F(texel);
+			default:                     return _mm_load_ps(reinterpret_cast<const f32*>(texel));
+			}
+		}
+
+	private:
+		static constexpr u32 RGB9E5MantissaBits = 9;
+		static constexpr u32 RGB9E5ExponentBias = 15;
+
+		static const std::array<f32, 256> s_SRGBToLinear;
+	};
+}
@@ -0,0 +1,145 @@
+﻿#include "WavefrontIntegrator.hpp"
+#include "RayPacket.hpp"
+
+#include <limits>
+#include <numeric>
+
+
+namespace OWC
+{
+	void WavefrontIntegrator::BeginWave(uSize numberOfPaths, f32 pixelSpreadAngle)
+	{
+		m_Rays.resize(numberOfPaths);
+		m_Hits.resize(numberOfPaths);
+		m_Throughput.assign(numberOfPaths, Colour(1.0f));
+		m_Radiance.assign(numberOfPaths, Colour(0.0f));
+		m_ConeWidths.assign(numberOfPaths, 0.0f);
+		m_ConeSpreads.assign(numberOfPaths, pixelSpreadAngle);
+
+		m_ActivePaths.resize(numberOfPaths);
+		std::iota(m_ActivePaths.begin(), m_ActivePaths.end(), 0u);
+	}
+
+	void WavefrontIntegrator::Trace(const BaseHitable& scene, i32 maxBounces, bool usePrimaryRayPackets)
+	{
+		// a path still bouncing after maxBounces + 1 hits is dropped with whatever it gathered so far, the same as RTCamera::RayColour
+		for (i32 bounce = 0; bounce != maxBounces + 1 && !m_ActivePaths.empty(); bounce++)
+		{
+			if (bounce == 0 && usePrimaryRayPackets)
+				IntersectPrimaryPackets(scene);
+			else
+				Intersect(scene);
+
+			for (u32 path : m_HitPaths)
+			{
+				m_ConeWidths[path] += m_ConeSpreads[path] * m_Hits[path].t;
+				m_Hits[path].footprint = m_ConeWidths[path];
+				BaseHitable::FinalizeClosestHit(m_Rays[path], m_Hits[path]);
+			}
+
+			SortByMaterial();
+
+			// shading puts the paths that scattered back into the active list, grouped by the material they bounced off
+			m_ActivePaths.clear();
+			for (uSize type = 0; type != NumberOfMaterialTypes; type++)
+			{
+				std::span<const u32> bin(m_SortedPaths.data() + m_BinOffsets[type], m_BinOffsets[type + 1] - m_BinOffsets[type]);
+				if (bin.empty())
+					continue;
+
+				switch (static_cast<MaterialType>(type))
+				{
+				case MaterialType::Lambertian:   ShadeBin<MaterialType::Lambertian>(bin); break;
+				case MaterialType::Metal:        ShadeBin<MaterialType::Metal>(bin); break;
+				case MaterialType::Dielectric:   ShadeBin<MaterialType::Dielectric>(bin); break;
+				case MaterialType::DefusedLight: ShadeBin<MaterialType::DefusedLight>(bin); break;
+				default:                         ShadeBin<MaterialType::Other>(bin); break;
+				}
+			}
+		}
+	}
+
+	void WavefrontIntegrator::Intersect(const BaseHitable& scene)
+	{
+		m_HitPaths.clear();
+		for (u32 path : m_ActivePaths)
+		{
+			Interval tRange(0.001f, std::numeric_limits<f32>::max());
+			if (scene.IsHit(m_Rays[path], tRange, m_Hits[path]))
+				m_HitPaths.emplace_back(path);
+			else
+				m_Radiance[path] += m_Throughput[path] * scene.BackgroundColour(m_Rays[path]);
+		}
+	}
+
+	void WavefrontIntegrator::IntersectPrimaryPackets(const BaseHitable& scene)
+	{
+		m_HitPaths.clear();
+
+		alignas(64) RayPacket packet;
+		for (uSize firstPath = 0; firstPath < m_ActivePaths.size(); firstPath += RayPacketWidth)
+		{
+			uSize numberOfRays = glm::min(RayPacketWidth, m_ActivePaths.size() - firstPath);
+
+			packet.ActiveMask = 0;
+			for (uSize lane = 0; lane != numberOfRays; lane++)
+				packet.SetRay(lane, m_Rays[m_ActivePaths[firstPath + lane]], Interval(0.001f, std::numeric_limits<f32>::max()));
+			packet.PadInactiveLanes();
+
+			scene.IsHitPacket(packet, packet.ActiveMask);
+
+			for (uSize lane = 0; lane != numberOfRays; lane++)
+			{
+				u32 path = m_ActivePaths[firstPath + lane];
+				if (packet.HitObjects[lane] != nullptr)
+				{
+					m_Hits[path].Record(packet.HitObjects[lane], packet.TMax[lane], packet.HitPrimitives[lane], packet.HitInstances[lane]);
+					m_HitPaths.emplace_back(path);
+				}
+				else
+					m_Radiance[path] += m_Throughput[path] * scene.BackgroundColour(m_Rays[path]);
+			}
+		}
+	}
+
+	void WavefrontIntegrator::SortByMaterial()
+	{
+		m_BinOffsets.fill(0);
+		for (u32 path : m_HitPaths)
+			m_BinOffsets[static_cast<uSize>(m_Hits[path].material->Type) + 1]++;
+
+		std::partial_sum(m_BinOffsets.begin(), m_BinOffsets.end(), m_BinOffsets.begin());
+
+		std::array<u32, NumberOfMaterialTypes> binEnds;
+		std::copy_n(m_BinOffsets.begin(), NumberOfMaterialTypes, binEnds.begin());
+
+		m_SortedPaths.resize(m_HitPaths.size());
+		for (u32 path : m_HitPaths)
+			m_SortedPaths[binEnds[static_cast<uSize>(m_Hits[path].material->Type)]++] = path;
+	}
+
+	template<MaterialType type>
+	void WavefrontIntegrator::ShadeBin(std::span<const u32> paths)
+	{
+		for (u32 path : paths)
+		{
+			HitData& hitData = m_Hits[path];
+			Ray& ray = m_Rays[path];
+
+			// every hit in the bin is known to be this material so the compiled material is shaded without even the switch
+			// materials outside the built in set all share the Other bin and still go through their vtable
+			const CompiledMaterial& material = *hitData.material;
+			Colour albedo = material.AlbedoAs<type>(hitData);
+			Colour emitted = material.EmittedAs<type>(ray, hitData);
+			bool scattered = material.ScatterAs<type>(ray, hitData);
+			m_ConeSpreads[path] = material.ScatteredConeSpreadAs<type>(m_ConeSpreads[path]);
+
+			m_Radiance[path] += m_Throughput[path] * emitted;
+			if (scattered)
+			{
+				m_Throughput[path] *= albedo;
+				m_ActivePaths.emplace_back(path);
+			}
+		}
+	}
+}
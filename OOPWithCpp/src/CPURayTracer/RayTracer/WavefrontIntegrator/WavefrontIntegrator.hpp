@@ -0,0 +1,67 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "Ray.hpp"
+#include "BaseHittable.hpp"
+#include "BaseMaterial.hpp"
+#include "AlignedAllocator.hpp"
+
+#include <array>
+#include <span>
+#include <vector>
+
+
+namespace OWC
+{
+	// Traces a wave of paths one bounce at a time instead of one path at a time. Every ray of a bounce is intersected,
+	// the hits are finalized, grouped by material type and then each group is shaded in its own loop that calls
+	// the material directly, so the loops stay in one material's code instead of jumping between all of them.
+	class WavefrontIntegrator
+	{
+	public:
+		// keeps the path state of a wave in cache sized buffers, bigger tiles are split into several waves
+		static constexpr uSize MaxPathsPerWave = 4096;
+		static constexpr uSize NumberOfMaterialTypes = static_cast<uSize>(MaterialType::Count);
+
+	public:
+		WavefrontIntegrator() = default;
+		~WavefrontIntegrator() = default;
+
+		WavefrontIntegrator(const WavefrontIntegrator&) = delete;
+		WavefrontIntegrator& operator=(const WavefrontIntegrator&) = delete;
+		WavefrontIntegrator(WavefrontIntegrator&&) = default;
+		WavefrontIntegrator& operator=(WavefrontIntegrator&&) = default;
+
+		// every path of the wave needs its primary ray set before Trace, pixelSpreadAngle is the spread of the primary ray cones
+		void BeginWave(uSize numberOfPaths, f32 pixelSpreadAngle);
+		OWC_FORCE_INLINE void SetPrimaryRay(uSize path, const Ray& ray) { m_Rays[path] = ray; }
+
+		// maxBounces as in CameraRenderSettings, primary rays are intersected as RayPackets when usePrimaryRayPackets is set
+		void Trace(const BaseHitable& scene, i32 maxBounces, bool usePrimaryRayPackets);
+
+		OWC_FORCE_INLINE const Colour& GetRadiance(uSize path) const { return m_Radiance[path]; }
+
+	private:
+		// both fill m_HitPaths with the active paths that hit something and add the background to the ones that missed
+		void Intersect(const BaseHitable& scene);
+		void IntersectPrimaryPackets(const BaseHitable& scene);
+
+		// counting sort of m_HitPaths by material type into m_SortedPaths
+		void SortByMaterial();
+
+		template<MaterialType type>
+		void ShadeBin(std::span<const u32> paths);
+
+	private:
+		CacheAlignedVector<Ray> m_Rays;
+		CacheAlignedVector<HitData> m_Hits;
+		CacheAlignedVector<Colour> m_Throughput;
+		CacheAlignedVector<Colour> m_Radiance;
+		CacheAlignedVector<f32> m_ConeWidths; // as in RTCamera::RayColour
+		CacheAlignedVector<f32> m_ConeSpreads;
+
+		std::vector<u32> m_ActivePaths;
+		std::vector<u32> m_HitPaths;
+		std::vector<u32> m_SortedPaths;
+		std::array<u32, NumberOfMaterialTypes + 1> m_BinOffsets{};
+	};
+}
@@ -4,26 +4,26 @@
 #include "OWCRand.hpp"
 
 #include "Sphere.hpp"
+#include "Plane.hpp"
 #include "SplitBVH.hpp"
 
-#include "Lambertian.hpp"
-#include "Dielectric.hpp"
-#include "Metal.hpp"
-#include "DefusedLight.hpp"
-
-#include "SolidTexture.hpp"
+#include <glm/gtc/constants.hpp>
 
 
 namespace OWC
 {
-	Book1FinalRender::Book1FinalRender()
+	Book1FinalRender::Book1FinalRender(bool useGroundPlane)
+		: m_Arena(std::make_shared<SceneArena>()), m_MaterialRegistry(*m_Arena)
 	{
 		constexpr size_t sqrtNumRandomSpheres = 50;
 		constexpr size_t numRandomSpheres = sqrtNumRandomSpheres * sqrtNumRandomSpheres;
 		constexpr f32 halfsqrtNumRandomSpheresf32 = (static_cast<f32>(sqrtNumRandomSpheres) / 2.0f) + 0.5f;
 
+		m_Arena->Reserve<Sphere>(numRandomSpheres + 5);
+
 		m_SceneObjects = std::make_shared<Hitables>();
 		m_SceneObjects->Reserve(numRandomSpheres + 5);
+		m_AnimatedSpheres.reserve(numRandomSpheres);
 		m_SceneObjects->SetBackgroundFunction([](const Ray& ray)
 			{
 				constexpr f32 scale = 0.4f;
@@ -31,32 +31,41 @@ namespace OWC
 				return (1.0f - t) + t * Colour(0.5f, 0.7f, 1.0f, 1.0f) * scale;
 			});
 
-		std::shared_ptr<BaseMaterial> material = nullptr;
+		// the materials are only pointed at from inside the arena, the primitives are handed out to the BVH
+		auto addSphere = [this](const Point& center, f32 radius, const BaseMaterial& sphereMaterial)
+			{
+				m_SceneObjects->AddObject(m_Arena->Share(m_Arena->Create<Sphere>(center, radius, sphereMaterial)));
+			};
+
+		const BaseMaterial* material = nullptr;
 
 		// Light
 		{
-			material = std::make_shared<DefusedLight>(Colour(1.0f, 1.0f, 1.0f, 1.0f), 5.0f);
-			m_SceneObjects->AddObject(std::make_shared<Sphere>(Point(500.0f, -500.0f, -500.0f), 44.72f, material));
+			material = &m_MaterialRegistry.GetDefusedLight(Colour(1.0f, 1.0f, 1.0f, 1.0f), 5.0f);
+			addSphere(Point(500.0f, -500.0f, -500.0f), 44.72f, *material);
 		}
 		// Glass Sphere
 		{
-			material = std::make_shared<Dielectric>(1.5f);
-			m_SceneObjects->AddObject(std::make_shared<Sphere>(Point(0.0f, -1.0f, 0.0f), 1.0f, material));
+			material = &m_MaterialRegistry.GetDielectric(1.5f);
+			addSphere(Point(0.0f, -1.0f, 0.0f), 1.0f, *material);
 		}
 		// Lambertion Sphere
 		{
-			material = std::make_shared<Lambertian>(Colour(0.4f, 0.2f, 0.1f, 1.0f));
-			m_SceneObjects->AddObject(std::make_shared<Sphere>(Point(-4.0f, -1.0f, 0.0f), 1.0f, material));
+			material = &m_MaterialRegistry.GetLambertian(Colour(0.4f, 0.2f, 0.1f, 1.0f));
+			addSphere(Point(-4.0f, -1.0f, 0.0f), 1.0f, *material);
 		}
 		// Metal Sphere
 		{
-			material = std::make_shared<Metal>(0.0f, Colour(0.7f, 0.6f, 0.5f, 1.0f));
-			m_SceneObjects->AddObject(std::make_shared<Sphere>(Point(4.0f, -1.0f, 0.0f), 1.0f, material));
+			material = &m_MaterialRegistry.GetMetal(0.0f, Colour(0.7f, 0.6f, 0.5f, 1.0f));
+			addSphere(Point(4.0f, -1.0f, 0.0f), 1.0f, *material);
 		}
 		// Ground
 		{
-			material =  std::make_shared<Lambertian>(std::make_shared<SolidTexture>(Colour(0.4f, 0.5f, 0.4f, 1.0f)));
-			m_SceneObjects->AddObject(std::make_shared<Sphere>(Point(0.0f, 1000.0f, 0.0f), 999.7f, material));
+			material = &m_MaterialRegistry.GetLambertian(Colour(0.4f, 0.5f, 0.4f, 1.0f));
+			if (useGroundPlane)
+				m_SceneObjects->AddObject(m_Arena->Share(m_Arena->Create<Plane>(Point(0.0f, 0.3f, 0.0f), Vec3(0.0f, -1.0f, 0.0f), *material)));
+			else
+				addSphere(Point(0.0f, 1000.0f, 0.0f), 999.7f, *material);
 		}
 
 		for (size_t i = 0; i < numRandomSpheres; i++)
@@ -69,33 +78,51 @@ namespace OWC
 			{
 			case 0: // Lambertion
 			{
-				material = std::make_shared<Lambertian>(randColour);
+				material = &m_MaterialRegistry.GetLambertian(randColour);
 				break;
 			}
 			case 1: // Metal
 			{
-				material = std::make_shared<Metal>(Rand::LinearFastRandValue(0.0f, 1.0f), randColour);
+				material = &m_MaterialRegistry.GetMetal(Rand::LinearFastRandValue(0.0f, 1.0f), randColour);
 				break;
 			}
 			case 2: // Dielectric
 			{
-				material = std::make_shared<Dielectric>(Rand::LinearFastRandValue(1.0f / 2.5f, 2.5f), randColour);
+				material = &m_MaterialRegistry.GetDielectric(Rand::LinearFastRandValue(1.0f / 2.5f, 2.5f), randColour);
 				break;
 			}
 			default:
 			{
-				material = std::make_shared<Lambertian>(Colour(Vec3(0.0f), 1.0f)); // black sphere avoids calling null material
+				material = &m_MaterialRegistry.GetLambertian(Colour(Vec3(0.0f), 1.0f)); // black sphere avoids calling null material
 				Log<LogLevel::Error>("Rand int gen gone very wrong expected: 0, 1, 2. Got {}\n created black sphere instead", randInt);
 			}
 			}
 
-			m_SceneObjects->AddObject(std::make_shared<Sphere>(randPoint, 0.2f, material));
+			ArenaHandle<Sphere> sphere = m_Arena->Create<Sphere>(randPoint, 0.2f, *material);
+			m_SceneObjects->AddObject(m_Arena->Share(sphere));
+			m_AnimatedSpheres.emplace_back(AnimatedSphere{ sphere, randPoint, Rand::LinearFastRandValue(0.0f, glm::two_pi<f32>()) });
 		}
 
-		m_Hitable = std::make_shared<SplitBVH>(m_SceneObjects);
+		// the ground plane is kept out of the tree, the ground sphere overlaps every other sphere's node in an object split BVH
+		m_Hitable = std::make_shared<SplitBVH>(m_SceneObjects, useGroundPlane ? BVHBuildMode::BinnedSAH : BVHBuildMode::SpatialSplit);
 //		m_Hitable = m_SceneObjects;
 	}
 
+	bool Book1FinalRender::Animate(f32 time)
+	{
+		constexpr f32 bounceHeight = 0.5f;
+		constexpr f32 bounceSpeed = 2.0f; // radians per second
+
+		// the spheres only move in y and never go below where they rest, so the refit tree stays close to the built one
+		for (const AnimatedSphere& sphere : m_AnimatedSpheres)
+		{
+			f32 height = bounceHeight * glm::abs(glm::sin(time * bounceSpeed + sphere.Phase));
+			m_Arena->Get(sphere.Object).SetCenter(sphere.BaseCenter - Vec3(0.0f, height, 0.0f)); // up is -y
+		}
+
+		return !m_AnimatedSpheres.empty();
+	}
+
 	void Book1FinalRender::SetBaseCameraSettings(CameraRenderSettings& cameraSettings) const
 	{
 		cameraSettings.Position = Point(8.5f, -2.0f, -8.5f);
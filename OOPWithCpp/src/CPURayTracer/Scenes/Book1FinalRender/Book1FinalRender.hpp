@@ -3,6 +3,11 @@
 #include "Scene.hpp"
 
 #include "Hittables.hpp"
+#include "Sphere.hpp"
+#include "SceneArena.hpp"
+#include "MaterialRegistry.hpp"
+
+#include <vector>
 
 
 namespace OWC
@@ -10,7 +15,8 @@ namespace OWC
 	class Book1FinalRender : public BaseScene
 	{
 	public:
-		Book1FinalRender();
+		// the sphere ground is the original scene, kept to compare against the plane in the render stats
+		explicit Book1FinalRender(bool useGroundPlane = true);
 		~Book1FinalRender() override = default;
 
 		Book1FinalRender(const Book1FinalRender&) = delete;
@@ -21,9 +27,24 @@ namespace OWC
 		void SetBaseCameraSettings(CameraRenderSettings& cameraSettings) const override;
 
 		const std::shared_ptr<BaseHitable>& GetHitable() override { return m_Hitable; }
+		// bounces the small random spheres up off the ground, the big ones stay put
+		bool Animate(f32 time) override;
+		const SceneArena* GetArena() const override { return m_Arena.get(); }
+		const MaterialRegistry* GetMaterialRegistry() const override { return &m_MaterialRegistry; }
+
+	private:
+		struct AnimatedSphere
+		{
+			ArenaHandle<Sphere> Object;
+			Point BaseCenter{ 0.0f };
+			f32 Phase = 0.0f; // radians
+		};
 
 	private:
+		std::shared_ptr<SceneArena> m_Arena;
+		MaterialRegistry m_MaterialRegistry; // builds into m_Arena so has to come after it
 		std::shared_ptr<BaseHitable> m_Hitable;
 		std::shared_ptr<Hitables> m_SceneObjects;
+		std::vector<AnimatedSphere> m_AnimatedSpheres;
 	};
 }
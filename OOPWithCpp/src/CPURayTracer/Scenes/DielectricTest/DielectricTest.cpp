@@ -1,6 +1,7 @@
 ﻿#include "DielectricTest.hpp"
 
 #include "Sphere.hpp"
+#include "Plane.hpp"
 #include "SplitBVH.hpp"
 
 #include "Lambertian.hpp"
@@ -23,8 +24,8 @@ namespace OWC
 		// Ground
 		{
 			auto groundMaterial = std::make_shared<Lambertian>(Colour(0.8f, 0.8f, 0.0f, 1.0f));
-			auto groundSphere = std::make_shared<Sphere>(Point(0.0f, 101.0f, 0.0f), 100.0f, groundMaterial);
-			m_SceneObjects->AddObject(groundSphere);
+			auto groundPlane = std::make_shared<Plane>(Point(0.0f, 1.0f, 0.0f), Vec3(0.0f, -1.0f, 0.0f), groundMaterial);
+			m_SceneObjects->AddObject(groundPlane);
 		}
 		// the sun
 		{
@@ -3,11 +3,13 @@
 #include "Sphere.hpp"
 #include "SplitBVH.hpp"
 
-#include "ImageTexture.hpp"
-
 #include "Lambertian.hpp"
 #include "DefusedLight.hpp"
 
+#include <imgui.h>
+
+#include <format>
+
 
 namespace OWC
 {
@@ -22,8 +24,8 @@ namespace OWC
 
 		// Load Earth sphere
 		{
-			auto earthTexture = std::make_shared<ImageTexture>("../Images/EarthMap.jpg");
-			auto earthMaterial = std::make_shared<Lambertian>(earthTexture);
+			m_EarthTexture = std::make_shared<ImageTexture>("../Images/EarthMap.jpg");
+			auto earthMaterial = std::make_shared<Lambertian>(m_EarthTexture);
 			m_SceneObjects->AddObject(std::make_shared<Sphere>(Vec3(0.0f, 0.0f, 0.0f), 1.0f, earthMaterial));
 		}
 		// sun
@@ -44,4 +46,14 @@ namespace OWC
 		cameraSettings.FOV = 50.0f;
 		cameraSettings.FocalLength = 600.0f;
 	}
+
+	void EarthScene::OnImGuiRender()
+	{
+		const uSize floatSize = m_EarthTexture->GetWidth() * m_EarthTexture->GetHeight() * sizeof(Colour);
+		ImGui::Text("earth map %s, %s mip levels, %s KiB (%s KiB as a single RGBA32F level)",
+			TexelCodec::GetName(m_EarthTexture->GetFormat()),
+			std::format("{}", m_EarthTexture->GetNumberOfMipLevels()).c_str(),
+			std::format("{}", m_EarthTexture->GetSize() / 1024).c_str(),
+			std::format("{}", floatSize / 1024).c_str());
+	}
 }
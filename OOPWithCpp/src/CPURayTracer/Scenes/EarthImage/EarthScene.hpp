@@ -2,6 +2,7 @@
 #include "Scene.hpp"
 
 #include "Hittables.hpp"
+#include "ImageTexture.hpp"
 
 #include "memory"
 
@@ -22,8 +23,11 @@ namespace OWC
 		void SetBaseCameraSettings(CameraRenderSettings& cameraSettings) const override;
 		const std::shared_ptr<BaseHitable>& GetHitable() override { return m_Hittable; }
 
+		void OnImGuiRender() override;
+
 	private:
 		std::shared_ptr<Hitables> m_SceneObjects;
 		std::shared_ptr<BaseHitable> m_Hittable;
+		std::shared_ptr<ImageTexture> m_EarthTexture;
 	};
 }
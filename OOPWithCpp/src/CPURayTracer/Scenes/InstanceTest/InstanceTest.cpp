@@ -0,0 +1,157 @@
+﻿#include "InstanceTest.hpp"
+
+#include "Log.hpp"
+#include "OWCRand.hpp"
+
+#include "Sphere.hpp"
+#include "Plane.hpp"
+#include "Instance.hpp"
+#include "SplitBVH.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+
+namespace OWC
+{
+	namespace
+	{
+		// the field of small random spheres from Book1FinalRender on its own, centered on the origin and resting on y = 0.3
+		// the spheres keep the arena alive, the instances in the arena only point at the block so InstanceTest holds it, an instance owning it would keep the arena alive forever
+		std::shared_ptr<SplitBVH> CreateSphereBlock(SceneArena& arena, MaterialRegistry& materialRegistry, size_t sqrtNumberOfSpheres)
+		{
+			const f32 halfSqrtNumberOfSpheres = (static_cast<f32>(sqrtNumberOfSpheres) / 2.0f) + 0.5f;
+
+			arena.Reserve<Sphere>(static_cast<u32>(sqrtNumberOfSpheres * sqrtNumberOfSpheres));
+
+			auto block = std::make_shared<Hitables>();
+			block->Reserve(sqrtNumberOfSpheres * sqrtNumberOfSpheres);
+			const BaseMaterial* material = nullptr;
+			for (size_t i = 0; i < sqrtNumberOfSpheres * sqrtNumberOfSpheres; i++)
+			{
+				Colour randColour = Rand::LinearFastRandVec4(Colour(0.0f, 0.0f, 0.0f, 1.0f), Colour(1.0f));
+				Point randPoint(static_cast<f32>(i % sqrtNumberOfSpheres) - halfSqrtNumberOfSpheres, 0.1, static_cast<f32>(i / sqrtNumberOfSpheres) - halfSqrtNumberOfSpheres);
+				randPoint += Rand::LinearFastRandVec3(Vec3(0.1f, 0.0f, 0.1f), Vec3(0.9f, 0.0f, 0.9f));
+
+				switch (auto randInt = Rand::LinearFastRandValue(0, 3); randInt)
+				{
+				case 0: // Lambertion
+				{
+					material = &materialRegistry.GetLambertian(randColour);
+					break;
+				}
+				case 1: // Metal
+				{
+					material = &materialRegistry.GetMetal(Rand::LinearFastRandValue(0.0f, 1.0f), randColour);
+					break;
+				}
+				case 2: // Dielectric
+				{
+					material = &materialRegistry.GetDielectric(Rand::LinearFastRandValue(1.0f / 2.5f, 2.5f), randColour);
+					break;
+				}
+				default:
+				{
+					material = &materialRegistry.GetLambertian(Colour(Vec3(0.0f), 1.0f)); // black sphere avoids calling null material
+					Log<LogLevel::Error>("Rand int gen gone very wrong expected: 0, 1, 2. Got {}\n created black sphere instead", randInt);
+				}
+				}
+
+				block->AddObject(arena.Share(arena.Create<Sphere>(randPoint, 0.2f, *material)));
+			}
+
+			return std::make_shared<SplitBVH>(block);
+		}
+	}
+
+	InstanceTest::InstanceTest()
+		: m_Arena(std::make_shared<SceneArena>()), m_MaterialRegistry(*m_Arena)
+	{
+		// 2,500 spheres a block, the block's BVH is built once and shared by every instance of it
+		constexpr size_t sqrtNumberOfSpheres = 50;
+		constexpr size_t sqrtNumberOfInstances = 32;
+		constexpr f32 instanceSpacing = static_cast<f32>(sqrtNumberOfSpheres) + 2.0f;
+
+		m_Arena->Reserve<Instance>(static_cast<u32>(sqrtNumberOfInstances * sqrtNumberOfInstances));
+
+		m_SceneObjects = std::make_shared<Hitables>();
+		m_SceneObjects->Reserve(sqrtNumberOfInstances * sqrtNumberOfInstances + 5);
+		m_Instances.reserve(sqrtNumberOfInstances * sqrtNumberOfInstances);
+		m_SceneObjects->SetBackgroundFunction([](const Ray& ray)
+			{
+				constexpr f32 scale = 0.4f;
+				f32 t = 0.5f * (ray.GetDirection().y + 1.0f);
+				return (1.0f - t) + t * Colour(0.5f, 0.7f, 1.0f, 1.0f) * scale;
+			});
+
+		// the materials are only pointed at from inside the arena, the spheres and instances are handed out to the BVH
+		auto addSphere = [this](const Point& center, f32 radius, const BaseMaterial& sphereMaterial)
+			{
+				m_SceneObjects->AddObject(m_Arena->Share(m_Arena->Create<Sphere>(center, radius, sphereMaterial)));
+			};
+
+		const BaseMaterial* material = nullptr;
+
+		// Light
+		{
+			material = &m_MaterialRegistry.GetDefusedLight(Colour(1.0f, 1.0f, 1.0f, 1.0f), 5.0f);
+			addSphere(Point(5000.0f, -5000.0f, -5000.0f), 447.2f, *material);
+		}
+		// Glass Sphere
+		{
+			material = &m_MaterialRegistry.GetDielectric(1.5f);
+			addSphere(Point(0.0f, -1.0f, 0.0f), 1.0f, *material);
+		}
+		// Lambertion Sphere
+		{
+			material = &m_MaterialRegistry.GetLambertian(Colour(0.4f, 0.2f, 0.1f, 1.0f));
+			addSphere(Point(-4.0f, -1.0f, 0.0f), 1.0f, *material);
+		}
+		// Metal Sphere
+		{
+			material = &m_MaterialRegistry.GetMetal(0.0f, Colour(0.7f, 0.6f, 0.5f, 1.0f));
+			addSphere(Point(4.0f, -1.0f, 0.0f), 1.0f, *material);
+		}
+		// Ground, the blocks rest on it at y = 0.3 like they do in their own space
+		{
+			material = &m_MaterialRegistry.GetLambertian(Colour(0.4f, 0.5f, 0.4f, 1.0f));
+			m_SceneObjects->AddObject(m_Arena->Share(m_Arena->Create<Plane>(Point(0.0f, 0.3f, 0.0f), Vec3(0.0f, -1.0f, 0.0f), *material)));
+		}
+
+		// every instance is moved along the ground and turned by a random angle about its up axis
+		m_SphereBlock = CreateSphereBlock(*m_Arena, m_MaterialRegistry, sqrtNumberOfSpheres);
+		constexpr f32 halfGridSize = 0.5f * instanceSpacing * static_cast<f32>(sqrtNumberOfInstances - 1);
+		for (size_t i = 0; i < sqrtNumberOfInstances * sqrtNumberOfInstances; i++)
+		{
+			f32 x = static_cast<f32>(i % sqrtNumberOfInstances) * instanceSpacing - halfGridSize;
+			f32 z = static_cast<f32>(i / sqrtNumberOfInstances) * instanceSpacing - halfGridSize;
+
+			Mat4 objectToWorld = glm::translate(Mat4(1.0f), Vec3(x, 0.0f, z));
+			objectToWorld = glm::rotate(objectToWorld, Rand::LinearFastRandValue(0.0f, glm::two_pi<f32>()), Vec3(0.0f, 1.0f, 0.0f));
+
+			ArenaHandle<Instance> instance = m_Arena->Create<Instance>(*m_SphereBlock, objectToWorld);
+			m_SceneObjects->AddObject(m_Arena->Share(instance));
+			m_Instances.emplace_back(AnimatedInstance{ instance, objectToWorld, Rand::LinearFastRandValue(-1.0f, 1.0f) });
+		}
+
+		// the top level is only built over the instances and the few spheres above so rebuilding it is cheap however many spheres the blocks add up to
+		m_Hittable = std::make_shared<SplitBVH>(m_SceneObjects);
+	}
+
+	bool InstanceTest::Animate(f32 time)
+	{
+		// the blocks turn in place so the top level only needs refitting, never a rebuild
+		for (AnimatedInstance& instance : m_Instances)
+			m_Arena->Get(instance.Object).SetTransform(glm::rotate(instance.BaseTransform, time * instance.SpinSpeed, Vec3(0.0f, 1.0f, 0.0f)));
+
+		return !m_Instances.empty();
+	}
+
+	void InstanceTest::SetBaseCameraSettings(CameraRenderSettings& cameraSettings) const
+	{
+		cameraSettings.Position = Point(8.5f, -4.0f, -8.5f);
+		cameraSettings.Rotation = Vec3(-15.0f, -36.0f, 0.0f);
+		cameraSettings.FOV = 50.0f;
+		cameraSettings.FocalLength = 600.0f;
+	}
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+#include "Core.hpp"
+
+#include "Scene.hpp"
+
+#include "BaseHittable.hpp"
+#include "Hittables.hpp"
+#include "Instance.hpp"
+#include "SceneArena.hpp"
+#include "MaterialRegistry.hpp"
+
+#include <memory>
+#include <vector>
+
+
+namespace OWC
+{
+	class InstanceTest : public BaseScene
+	{
+	public:
+		InstanceTest();
+		~InstanceTest() override = default;
+
+		InstanceTest(InstanceTest&) = delete;
+		InstanceTest operator=(InstanceTest&) = delete;
+		InstanceTest(InstanceTest&&) = delete;
+		InstanceTest operator=(InstanceTest&&) = delete;
+
+		void SetBaseCameraSettings(CameraRenderSettings& cameraSettings) const override;
+		const std::shared_ptr<BaseHitable>& GetHitable() override { return m_Hittable; }
+		// spins every block about its up axis
+		bool Animate(f32 time) override;
+		const SceneArena* GetArena() const override { return m_Arena.get(); }
+		const MaterialRegistry* GetMaterialRegistry() const override { return &m_MaterialRegistry; }
+
+	private:
+		struct AnimatedInstance
+		{
+			ArenaHandle<Instance> Object;
+			Mat4 BaseTransform{ 1.0f };
+			f32 SpinSpeed = 0.0f; // radians per second
+		};
+
+	private:
+		std::shared_ptr<SceneArena> m_Arena;
+		MaterialRegistry m_MaterialRegistry; // builds into m_Arena so has to come after it
+		std::shared_ptr<const BaseHitable> m_SphereBlock; // every instance points at it
+		std::vector<AnimatedInstance> m_Instances;
+		std::shared_ptr<Hitables> m_SceneObjects;
+		std::shared_ptr<BaseHitable> m_Hittable;
+	};
+}
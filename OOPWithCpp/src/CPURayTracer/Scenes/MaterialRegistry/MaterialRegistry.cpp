@@ -0,0 +1,80 @@
+﻿#include "MaterialRegistry.hpp"
+
+#include "Lambertian.hpp"
+#include "Metal.hpp"
+#include "Dielectric.hpp"
+#include "DefusedLight.hpp"
+
+#include "SolidTexture.hpp"
+
+#include <bit>
+
+
+namespace OWC
+{
+	uSize MaterialRegistry::KeyHash::operator()(const Key& key) const
+	{
+		auto hash = static_cast<uSize>(key.Type);
+		for (u32 parameter : key.Parameters)
+			hash ^= parameter + 0x9E3779B9u + (hash << 6) + (hash >> 2);
+
+		return hash;
+	}
+
+	MaterialRegistry::Key MaterialRegistry::MakeKey(MaterialType type, const Colour& colour, f32 parameter)
+	{
+		Key key;
+		key.Type = type;
+		for (uSize i = 0; i != 4; i++)
+			key.Parameters[i] = std::bit_cast<u32>(colour[static_cast<i32>(i)]);
+		key.Parameters[4] = std::bit_cast<u32>(parameter);
+		return key;
+	}
+
+	template<typename Create>
+	const BaseMaterial& MaterialRegistry::GetMaterial(const Key& key, Create&& create)
+	{
+		m_NumberOfRequests++;
+		BaseMaterial*& material = m_Materials[key];
+		if (material == nullptr)
+		{
+			material = &create();
+			material->SetCompiledEntry(m_Arena.Get(m_Arena.Create<CompiledMaterial>(material->GetCompiled())));
+		}
+
+		return *material;
+	}
+
+	const BaseTexture& MaterialRegistry::GetSolidTexture(const Colour& colour)
+	{
+		const BaseTexture*& texture = m_Textures[MakeKey(MaterialType::Other, colour)];
+		if (texture == nullptr)
+			texture = &m_Arena.Get(m_Arena.Create<SolidTexture>(colour));
+
+		return *texture;
+	}
+
+	const BaseMaterial& MaterialRegistry::GetLambertian(const Colour& colour)
+	{
+		return GetMaterial(MakeKey(MaterialType::Lambertian, colour),
+			[this, &colour]() -> BaseMaterial& { return m_Arena.Get(m_Arena.Create<Lambertian>(GetSolidTexture(colour))); });
+	}
+
+	const BaseMaterial& MaterialRegistry::GetMetal(f32 roughness, const Colour& colour)
+	{
+		return GetMaterial(MakeKey(MaterialType::Metal, colour, roughness),
+			[this, roughness, &colour]() -> BaseMaterial& { return m_Arena.Get(m_Arena.Create<Metal>(roughness, GetSolidTexture(colour))); });
+	}
+
+	const BaseMaterial& MaterialRegistry::GetDielectric(f32 refractiveIndex, const Colour& colour)
+	{
+		return GetMaterial(MakeKey(MaterialType::Dielectric, colour, refractiveIndex),
+			[this, refractiveIndex, &colour]() -> BaseMaterial& { return m_Arena.Get(m_Arena.Create<Dielectric>(refractiveIndex, GetSolidTexture(colour))); });
+	}
+
+	const BaseMaterial& MaterialRegistry::GetDefusedLight(const Colour& emitColour, f32 emitIntensity)
+	{
+		return GetMaterial(MakeKey(MaterialType::DefusedLight, emitColour, emitIntensity),
+			[this, emitIntensity, &emitColour]() -> BaseMaterial& { return m_Arena.Get(m_Arena.Create<DefusedLight>(emitColour, emitIntensity)); });
+	}
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "SceneArena.hpp"
+#include "BaseMaterial.hpp"
+#include "BaseTexture.hpp"
+#include "CompiledMaterial.hpp"
+
+#include <array>
+#include <unordered_map>
+
+
+namespace OWC
+{
+	// Hands out one material or texture per set of parameters, asking twice for the same ones gives back the same instance.
+	// Materials are built in the scene's arena and their compiled copies are packed into one pool of CompiledMaterials
+	// that the render loop shades from, so the shading data of a scene is a small dense table rather than a part of every material.
+	// Parameters only match when they are bit for bit the same, the registry has to outlive nothing but the arena it builds into
+	class MaterialRegistry
+	{
+	public:
+		MaterialRegistry() = delete;
+		explicit MaterialRegistry(SceneArena& arena) : m_Arena(arena) {}
+		~MaterialRegistry() = default;
+
+		MaterialRegistry(const MaterialRegistry&) = delete;
+		MaterialRegistry& operator=(const MaterialRegistry&) = delete;
+		MaterialRegistry(MaterialRegistry&&) = delete;
+		MaterialRegistry& operator=(MaterialRegistry&&) = delete;
+
+		// live as long as the arena, for the constructors of objects built in the same arena that take a reference and do not own it
+		const BaseTexture& GetSolidTexture(const Colour& colour);
+		const BaseMaterial& GetLambertian(const Colour& colour);
+		const BaseMaterial& GetMetal(f32 roughness, const Colour& colour = Colour(1.0f));
+		const BaseMaterial& GetDielectric(f32 refractiveIndex, const Colour& colour = Colour(1.0f));
+		const BaseMaterial& GetDefusedLight(const Colour& emitColour, f32 emitIntensity);
+
+		OWC_FORCE_INLINE uSize GetNumberOfMaterials() const { return m_Materials.size(); }
+		OWC_FORCE_INLINE uSize GetNumberOfTextures() const { return m_Textures.size(); }
+		OWC_FORCE_INLINE uSize GetNumberOfRequests() const { return m_NumberOfRequests; } // materials asked for, reused or not
+
+	private:
+		// the type and the bits of every parameter, unused parameters are left 0
+		struct Key
+		{
+			std::array<u32, 5> Parameters{};
+			MaterialType Type = MaterialType::Other;
+
+			bool operator==(const Key&) const = default;
+		};
+
+		struct KeyHash
+		{
+			uSize operator()(const Key& key) const;
+		};
+
+		static Key MakeKey(MaterialType type, const Colour& colour, f32 parameter = 0.0f);
+
+		// builds the material with create if there is none for key yet and gives it an entry in the table
+		template<typename Create>
+		const BaseMaterial& GetMaterial(const Key& key, Create&& create);
+
+	private:
+		SceneArena& m_Arena;
+		std::unordered_map<Key, BaseMaterial*, KeyHash> m_Materials;
+		std::unordered_map<Key, const BaseTexture*, KeyHash> m_Textures; // keyed as MaterialType::Other
+		uSize m_NumberOfRequests = 0;
+	};
+}
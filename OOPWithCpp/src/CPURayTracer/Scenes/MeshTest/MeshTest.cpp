@@ -0,0 +1,114 @@
+﻿#include "MeshTest.hpp"
+
+#include "Sphere.hpp"
+#include "Plane.hpp"
+#include "Quad.hpp"
+#include "TriangleMesh.hpp"
+#include "SplitBVH.hpp"
+
+#include "Lambertian.hpp"
+#include "Metal.hpp"
+#include "DefusedLight.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+
+namespace OWC
+{
+	namespace
+	{
+		// torus around the y axis, without smooth normals every face is shaded flat
+		std::shared_ptr<TriangleMesh> CreateTorus(const Point& center, f32 majorRadius, f32 minorRadius, u32 rings, u32 sides, bool smooth, const std::shared_ptr<BaseMaterial>& material)
+		{
+			std::vector<Point> positions;
+			std::vector<Vec3> normals;
+			std::vector<Vec2> uvs;
+			positions.reserve(static_cast<uSize>(rings) * sides);
+			normals.reserve(static_cast<uSize>(rings) * sides);
+			uvs.reserve(static_cast<uSize>(rings) * sides);
+			for (u32 ring = 0; ring != rings; ring++)
+			{
+				f32 u = glm::two_pi<f32>() * static_cast<f32>(ring) / static_cast<f32>(rings);
+				for (u32 side = 0; side != sides; side++)
+				{
+					f32 v = glm::two_pi<f32>() * static_cast<f32>(side) / static_cast<f32>(sides);
+					Vec3 normal(glm::cos(v) * glm::cos(u), glm::sin(v), glm::cos(v) * glm::sin(u));
+					positions.emplace_back(center + Vec3(majorRadius * glm::cos(u), 0.0f, majorRadius * glm::sin(u)) + minorRadius * normal);
+					normals.emplace_back(normal);
+					uvs.emplace_back(static_cast<f32>(ring) / static_cast<f32>(rings), static_cast<f32>(side) / static_cast<f32>(sides));
+				}
+			}
+
+			// two triangles per quad of the grid, wrapping round in both directions
+			std::vector<u32> indices;
+			indices.reserve(static_cast<uSize>(rings) * sides * 6);
+			for (u32 ring = 0; ring != rings; ring++)
+			{
+				u32 nextRing = (ring + 1) % rings;
+				for (u32 side = 0; side != sides; side++)
+				{
+					u32 nextSide = (side + 1) % sides;
+					u32 a = ring * sides + side;
+					u32 b = nextRing * sides + side;
+					u32 c = nextRing * sides + nextSide;
+					u32 d = ring * sides + nextSide;
+					indices.insert(indices.end(), { a, b, c, a, c, d });
+				}
+			}
+
+			if (!smooth)
+				normals.clear();
+			return std::make_shared<TriangleMesh>(std::move(positions), std::move(indices), material, std::move(normals), std::move(uvs));
+		}
+	}
+
+	MeshTest::MeshTest()
+	{
+		m_SceneObjects = std::make_shared<Hitables>();
+		m_SceneObjects->Reserve(5);
+		m_SceneObjects->SetBackgroundFunction([](const Ray& ray)
+			{
+				constexpr f32 scale = 0.4f;
+				f32 t = 0.5f * (ray.GetDirection().y + 1.0f);
+				return (1.0f - t) + t * Colour(0.5f, 0.7f, 1.0f, 1.0f) * scale;
+			});
+
+		// Ground
+		{
+			auto groundMaterial = std::make_shared<Lambertian>(Colour(0.5f, 0.5f, 0.5f, 1.0f));
+			auto groundPlane = std::make_shared<Plane>(Point(0.0f, 0.5f, 0.0f), Vec3(0.0f, -1.0f, 0.0f), groundMaterial);
+			m_SceneObjects->AddObject(groundPlane);
+		}
+		// the sun
+		{
+			auto sunMaterial = std::make_shared<DefusedLight>(Colour(1.0f, 1.0f, 1.0f, 1.0f), 5.0f);
+			auto sunSphere = std::make_shared<Sphere>(Point(50.0f, -50.0f, -50.0f), 10.0f, sunMaterial);
+			m_SceneObjects->AddObject(sunSphere);
+		}
+
+		// a smooth dense torus next to a faceted coarse one
+		{
+			auto diffuseMaterial = std::make_shared<Lambertian>(Colour(0.1f, 0.2f, 0.5f, 1.0f));
+			m_SceneObjects->AddObject(CreateTorus(Point(-1.2f, 0.2f, 0.0f), 0.7f, 0.3f, 128, 64, true, diffuseMaterial));
+
+			auto metalMaterial = std::make_shared<Metal>(0.1f, Colour(0.8f, 0.6f, 0.2f, 1.0f));
+			m_SceneObjects->AddObject(CreateTorus(Point(1.2f, 0.2f, 0.0f), 0.7f, 0.3f, 24, 12, false, metalMaterial));
+		}
+		// a mirror standing on the ground behind them
+		{
+			auto mirrorMaterial = std::make_shared<Metal>(0.0f, Colour(0.9f, 0.9f, 0.9f, 1.0f));
+			auto mirrorQuad = std::make_shared<Quad>(Point(-2.5f, 0.5f, 1.5f), Vec3(5.0f, 0.0f, 0.0f), Vec3(0.0f, -2.0f, 0.0f), mirrorMaterial);
+			m_SceneObjects->AddObject(mirrorQuad);
+		}
+
+		m_Hittable = std::make_shared<SplitBVH>(m_SceneObjects);
+	}
+
+	void MeshTest::SetBaseCameraSettings(CameraRenderSettings& cameraSettings) const
+	{
+		cameraSettings.Position = Point(0.0f, -1.5f, -5.0f);
+		cameraSettings.Rotation = Vec3(-15.0f, 0.0f, 0.0f);
+		cameraSettings.FOV = 50.0f;
+		cameraSettings.FocalLength = 600.0f;
+	}
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include "Core.hpp"
+
+#include "Scene.hpp"
+
+#include "BaseHittable.hpp"
+#include "Hittables.hpp"
+
+#include <memory>
+
+
+namespace OWC
+{
+	class MeshTest : public BaseScene
+	{
+	public:
+		MeshTest();
+		~MeshTest() override = default;
+
+		MeshTest(MeshTest&) = delete;
+		MeshTest operator=(MeshTest&) = delete;
+		MeshTest(MeshTest&&) = delete;
+		MeshTest operator=(MeshTest&&) = delete;
+
+		void SetBaseCameraSettings(CameraRenderSettings& cameraSettings) const override;
+		const std::shared_ptr<BaseHitable>& GetHitable() override { return m_Hittable; }
+
+	private:
+		std::shared_ptr<Hitables> m_SceneObjects;
+		std::shared_ptr<BaseHitable> m_Hittable;
+	};
+}
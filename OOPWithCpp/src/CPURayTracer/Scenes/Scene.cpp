@@ -6,6 +6,8 @@
 #include "MetalTest.hpp"
 #include "EarthScene.hpp"
 #include "Book1FinalRender.hpp"
+#include "MeshTest.hpp"
+#include "InstanceTest.hpp"
 
 
 namespace OWC
@@ -26,6 +28,12 @@ namespace OWC
 			return std::make_unique<EarthScene>();
 		case Scene::Book1FinalRender:
 			return std::make_unique<Book1FinalRender>();
+		case Scene::MeshTest:
+			return std::make_unique<MeshTest>();
+		case Scene::InstanceTest:
+			return std::make_unique<InstanceTest>();
+		case Scene::Book1FinalRenderSphereGround:
+			return std::make_unique<Book1FinalRender>(false);
 		default:
 			// Return Basic scene as default
 			return std::make_unique<BasicScene>();
@@ -7,6 +7,9 @@
 
 namespace OWC
 {
+	class SceneArena;
+	class MaterialRegistry;
+
 	enum class Scene : u8
 	{ // TODO: Add more scenes
 		Basic , // A basic scene with just a sphere
@@ -15,7 +18,10 @@ namespace OWC
 		DielectricTest,
 		MetalTest,
 		EarthScene,
-		Book1FinalRender
+		Book1FinalRender,
+		MeshTest,
+		InstanceTest,
+		Book1FinalRenderSphereGround // Book1FinalRender with its original ground sphere instead of a plane
 	};
 
 	class BaseScene
@@ -35,6 +41,15 @@ namespace OWC
 
 		virtual void OnImGuiRender() { /* default empty implementation */ }
 
+		// moves the scene's objects to where they are time seconds into its animation, returns true if anything moved
+		// the scene's BVH has to be updated after, see SplitBVH::Update
+		virtual bool Animate(f32 /*time*/) { return false; }
+
+		// where the scene's objects are stored if it builds them in a SceneArena, nullptr otherwise
+		virtual const SceneArena* GetArena() const { return nullptr; }
+		// the registry the scene's materials came from if it has one, nullptr otherwise
+		virtual const MaterialRegistry* GetMaterialRegistry() const { return nullptr; }
+
 		static std::unique_ptr<BaseScene> CreateScene(Scene scene);
 	};
 }
@@ -0,0 +1,34 @@
+﻿#include "SceneArena.hpp"
+
+#include <atomic>
+
+
+namespace OWC
+{
+	uSize SceneArena::GetNumberOfObjects() const
+	{
+		uSize numberOfObjects = 0;
+		for (const auto& pool : m_Pools)
+			if (pool != nullptr)
+				numberOfObjects += pool->GetCount();
+
+		return numberOfObjects;
+	}
+
+	uSize SceneArena::GetSize() const
+	{
+		uSize size = 0;
+		for (const auto& pool : m_Pools)
+			if (pool != nullptr)
+				size += pool->GetSize();
+
+		return size;
+	}
+
+	u32 SceneArena::NextTypeSlot()
+	{
+		// scenes can be built on any thread
+		static std::atomic<u32> nextTypeSlot = 0;
+		return nextTypeSlot.fetch_add(1, std::memory_order_relaxed);
+	}
+}
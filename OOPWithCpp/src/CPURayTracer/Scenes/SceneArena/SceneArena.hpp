@@ -0,0 +1,167 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "AlignedAllocator.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable: 4324) // structure was padded due to alignment specifier
+
+
+namespace OWC
+{
+	// an object in a SceneArena, the index of it in the pool of its type, for a scene to find objects it keeps changing after building
+	template<typename T>
+	struct ArenaHandle
+	{
+		static constexpr u32 InvalidIndex = std::numeric_limits<u32>::max();
+
+		u32 Index = InvalidIndex;
+
+		OWC_FORCE_INLINE bool IsValid() const { return Index != InvalidIndex; }
+	};
+
+	// Storage for the primitives, materials and textures of a scene. Every type gets a pool of cache aligned blocks that objects
+	// are constructed into one after another, so a scene of thousands of spheres is a few allocations instead of a few per sphere,
+	// spheres built together sit next to each other in memory and the whole scene is freed in one go with the arena.
+	// Hitables, SplitBVH and Instance hold objects through shared_ptrs, Share hands out ones that alias the arena instead of each
+	// having a control block of their own, they still take 16 bytes and keep the whole arena alive. Objects of the arena pointing
+	// at each other use Get and the constructors that take a reference, an owning pointer would keep the arena alive forever.
+	// The render loop reads neither, it traces the compiled copies in PrimitiveArray and shades from the CompiledMaterial table
+	class SceneArena : public std::enable_shared_from_this<SceneArena>
+	{
+	public:
+		// objects per block, blocks never move once allocated so neither do the objects in them
+		static constexpr u32 BlockShift = 8;
+		static constexpr u32 BlockSize = 1u << BlockShift;
+
+	public:
+		SceneArena() = default;
+		~SceneArena() = default;
+
+		SceneArena(const SceneArena&) = delete;
+		SceneArena& operator=(const SceneArena&) = delete;
+		SceneArena(SceneArena&&) = delete;
+		SceneArena& operator=(SceneArena&&) = delete;
+
+		template<typename T, typename... Args>
+		ArenaHandle<T> Create(Args&&... args)
+		{
+			return ArenaHandle<T>{ GetPool<T>().Emplace(std::forward<Args>(args)...) };
+		}
+
+		// lives as long as the arena does
+		template<typename T>
+		OWC_FORCE_INLINE T& Get(ArenaHandle<T> handle) { return GetPool<T>().Get(handle.Index); }
+
+		// keeps the whole arena alive for as long as it is held, for handing objects to a Hitables or anything else outside the arena
+		template<typename T>
+		OWC_FORCE_INLINE std::shared_ptr<T> Share(ArenaHandle<T> handle) { return std::shared_ptr<T>(shared_from_this(), &Get(handle)); }
+
+		// makes room for count more objects of T without allocating while they are created
+		template<typename T>
+		void Reserve(u32 count) { GetPool<T>().Reserve(count); }
+
+		uSize GetNumberOfObjects() const;
+		uSize GetSize() const; // bytes of every block
+
+	private:
+		class BasePool
+		{
+		public:
+			BasePool() = default;
+			virtual ~BasePool() = default;
+
+			BasePool(const BasePool&) = delete;
+			BasePool& operator=(const BasePool&) = delete;
+			BasePool(BasePool&&) = delete;
+			BasePool& operator=(BasePool&&) = delete;
+
+			OWC_FORCE_INLINE u32 GetCount() const { return m_Count; }
+			virtual uSize GetSize() const = 0;
+
+		protected:
+			u32 m_Count = 0;
+		};
+
+		template<typename T>
+		class Pool final : public BasePool
+		{
+		public:
+			Pool() = default;
+			~Pool() override
+			{
+				for (u32 i = 0; i != m_Count; i++)
+					Get(i).~T();
+
+				for (T* block : m_Blocks)
+					::operator delete(block, Alignment);
+			}
+
+			Pool(const Pool&) = delete;
+			Pool& operator=(const Pool&) = delete;
+			Pool(Pool&&) = delete;
+			Pool& operator=(Pool&&) = delete;
+
+			template<typename... Args>
+			u32 Emplace(Args&&... args)
+			{
+				if (m_Count == m_Blocks.size() * BlockSize)
+					m_Blocks.emplace_back(static_cast<T*>(::operator new(BlockSize * sizeof(T), Alignment)));
+
+				::new (&Get(m_Count)) T(std::forward<Args>(args)...);
+				return m_Count++;
+			}
+
+			OWC_FORCE_INLINE T& Get(u32 index) { return m_Blocks[index >> BlockShift][index & (BlockSize - 1)]; }
+
+			void Reserve(u32 count)
+			{
+				uSize numberOfBlocks = (static_cast<uSize>(m_Count) + count + BlockSize - 1) >> BlockShift;
+				while (m_Blocks.size() < numberOfBlocks)
+					m_Blocks.emplace_back(static_cast<T*>(::operator new(BlockSize * sizeof(T), Alignment)));
+			}
+
+			uSize GetSize() const override { return m_Blocks.size() * BlockSize * sizeof(T); }
+
+		private:
+			static constexpr std::align_val_t Alignment{ std::max(alignof(T), CacheLineSize) };
+
+			std::vector<T*> m_Blocks;
+		};
+
+		// every type takes the next slot the first time any arena asks for it, so finding a pool is an index rather than a hash of the type
+		static u32 NextTypeSlot();
+
+		template<typename T>
+		static OWC_FORCE_INLINE u32 GetTypeSlot()
+		{
+			static const u32 typeSlot = NextTypeSlot();
+			return typeSlot;
+		}
+
+		template<typename T>
+		OWC_FORCE_INLINE Pool<T>& GetPool()
+		{
+			u32 typeSlot = GetTypeSlot<T>();
+			if (typeSlot >= m_Pools.size())
+				m_Pools.resize(typeSlot + 1);
+
+			std::unique_ptr<BasePool>& pool = m_Pools[typeSlot];
+			if (pool == nullptr)
+				pool = std::make_unique<Pool<T>>();
+
+			return static_cast<Pool<T>&>(*pool);
+		}
+
+	private:
+		std::vector<std::unique_ptr<BasePool>> m_Pools; // indexed by GetTypeSlot, null for types this arena has none of
+	};
+}
+
+#pragma warning(pop)
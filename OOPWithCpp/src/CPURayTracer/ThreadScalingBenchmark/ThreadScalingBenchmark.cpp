@@ -0,0 +1,113 @@
+﻿#include "ThreadScalingBenchmark.hpp"
+#include "Application.hpp"
+
+#include <format>
+
+
+namespace OWC
+{
+	void ThreadScalingBenchmark::Start(uSize maxNumberOfThreads, const CameraRenderSettings& originalSettings)
+	{
+		m_OriginalNumberOfThreads = originalSettings.NumberOfThreads;
+		m_OriginalUseTiledAccumulation = originalSettings.UseTiledAccumulation;
+
+		m_MaxNumberOfThreads = glm::max(maxNumberOfThreads, uSize(1));
+		for (std::vector<f32>& samplesPerSecond : m_SamplesPerSecond)
+		{
+			samplesPerSecond.clear();
+			samplesPerSecond.reserve(m_MaxNumberOfThreads);
+		}
+
+		m_CurrentNumberOfThreads = 1;
+		m_CurrentLayout = Layout::RowMajor;
+		m_PassesInStep = 0;
+		m_MeasuredSamplesPerSecond = 0.0f;
+		m_IsRunning = true;
+	}
+
+	void ThreadScalingBenchmark::ApplySettings(CameraRenderSettings& cameraSettings) const
+	{
+		if (!m_IsRunning)
+		{
+			cameraSettings.NumberOfThreads = m_OriginalNumberOfThreads;
+			cameraSettings.UseTiledAccumulation = m_OriginalUseTiledAccumulation;
+			return;
+		}
+
+		cameraSettings.NumberOfThreads = static_cast<i32>(m_CurrentNumberOfThreads);
+		cameraSettings.UseTiledAccumulation = m_CurrentLayout == Layout::Tiled;
+	}
+
+	bool ThreadScalingBenchmark::OnPassCompleted(const RenderStats& renderStats)
+	{
+		if (!m_IsRunning)
+			return false;
+
+		// a merge can hold several passes, the stats are the last one's so they stand in for every measured pass in it
+		uSize warmupPassesLeft = s_WarmupPasses - glm::min(m_PassesInStep, s_WarmupPasses);
+		m_PassesInStep += renderStats.NumberOfMergedPasses;
+		if (m_PassesInStep <= s_WarmupPasses)
+			return false;
+
+		uSize measuredPasses = renderStats.NumberOfMergedPasses - warmupPassesLeft;
+		m_MeasuredSamplesPerSecond += renderStats.SamplesPerSecond * static_cast<f32>(measuredPasses);
+		if (m_PassesInStep < s_WarmupPasses + s_MeasuredPasses)
+			return false;
+
+		f32 invMeasuredPasses = 1.0f / static_cast<f32>(m_PassesInStep - s_WarmupPasses);
+		m_SamplesPerSecond[static_cast<uSize>(m_CurrentLayout)].push_back(m_MeasuredSamplesPerSecond * invMeasuredPasses);
+		m_PassesInStep = 0;
+		m_MeasuredSamplesPerSecond = 0.0f;
+
+		if (m_CurrentNumberOfThreads != m_MaxNumberOfThreads)
+			m_CurrentNumberOfThreads++;
+		else if (m_CurrentLayout == Layout::RowMajor)
+		{
+			m_CurrentNumberOfThreads = 1;
+			m_CurrentLayout = Layout::Tiled;
+		}
+		else
+			m_IsRunning = false;
+
+		return true;
+	}
+
+	void ThreadScalingBenchmark::ImGuiRender() const
+	{
+		const std::vector<f32>& rowMajor = m_SamplesPerSecond[static_cast<uSize>(Layout::RowMajor)];
+		const std::vector<f32>& tiled = m_SamplesPerSecond[static_cast<uSize>(Layout::Tiled)];
+
+		if (m_IsRunning)
+			ImGui::Text(
+				"Benchmarking %s layout with %s threads",
+				m_CurrentLayout == Layout::Tiled ? "tiled" : "row major",
+				std::format("{}", m_CurrentNumberOfThreads).c_str()
+			);
+
+		if (rowMajor.empty())
+			return;
+
+		ImGui::PlotLines("Row Major (samples/s)", rowMajor.data(), static_cast<i32>(rowMajor.size()));
+		if (!tiled.empty())
+			ImGui::PlotLines("Tiled (samples/s)", tiled.data(), static_cast<i32>(tiled.size()));
+
+		// speed up is relative to the single threaded run of the same layout so the two scaling curves can be compared
+		for (uSize i = 0; i != rowMajor.size(); i++)
+		{
+			f32 rowMajorScaling = rowMajor[i] / rowMajor[0];
+			if (i < tiled.size())
+				ImGui::Text(
+					"%s threads: row major %.2f Msamples/s (x%.2f), tiled %.2f Msamples/s (x%.2f)",
+					std::format("{}", i + 1).c_str(),
+					rowMajor[i] * 1e-6f, rowMajorScaling,
+					tiled[i] * 1e-6f, tiled[i] / tiled[0]
+				);
+			else
+				ImGui::Text(
+					"%s threads: row major %.2f Msamples/s (x%.2f)",
+					std::format("{}", i + 1).c_str(),
+					rowMajor[i] * 1e-6f, rowMajorScaling
+				);
+		}
+	}
+}
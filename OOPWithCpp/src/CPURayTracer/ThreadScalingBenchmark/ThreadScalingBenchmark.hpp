@@ -0,0 +1,54 @@
+﻿#pragma once
+#include "Core.hpp"
+#include "Camera.hpp"
+
+#include <array>
+#include <vector>
+
+
+namespace OWC
+{
+	// Renders the current scene with 1 to N threads, once with every sample written straight into a row major buffer
+	// and once with the tiled cache line aligned pass buffer, and records the samples per second of each run.
+	class ThreadScalingBenchmark
+	{
+	public:
+		enum class Layout : u8 { RowMajor = 0, Tiled, Count };
+
+	public:
+		ThreadScalingBenchmark() = default;
+		~ThreadScalingBenchmark() = default;
+
+		ThreadScalingBenchmark(const ThreadScalingBenchmark&) = delete;
+		ThreadScalingBenchmark& operator=(const ThreadScalingBenchmark&) = delete;
+		ThreadScalingBenchmark(ThreadScalingBenchmark&&) = delete;
+		ThreadScalingBenchmark& operator=(ThreadScalingBenchmark&&) = delete;
+
+		// the thread count and accumulation layout of originalSettings are handed back by ApplySettings once the benchmark is done
+		void Start(uSize maxNumberOfThreads, const CameraRenderSettings& originalSettings);
+		OWC_FORCE_INLINE bool IsRunning() const { return m_IsRunning; }
+		OWC_FORCE_INLINE void Cancel() { m_IsRunning = false; }
+
+		// sets the thread count and accumulation layout of the step being measured, or the original ones when not running
+		void ApplySettings(CameraRenderSettings& cameraSettings) const;
+
+		// returns true when the benchmark moved on to the next step and the image needs to restart
+		bool OnPassCompleted(const RenderStats& renderStats);
+
+		void ImGuiRender() const;
+
+	private:
+		static constexpr uSize s_WarmupPasses = 2;
+		static constexpr uSize s_MeasuredPasses = 8;
+
+		std::array<std::vector<f32>, static_cast<uSize>(Layout::Count)> m_SamplesPerSecond; // indexed by thread count - 1
+		uSize m_MaxNumberOfThreads = 0;
+		uSize m_CurrentNumberOfThreads = 1;
+		Layout m_CurrentLayout = Layout::RowMajor;
+		uSize m_PassesInStep = 0;
+		f32 m_MeasuredSamplesPerSecond = 0.0f;
+		i32 m_OriginalNumberOfThreads = 1;
+		bool m_OriginalUseTiledAccumulation = false;
+		bool m_IsRunning = false;
+	};
+}
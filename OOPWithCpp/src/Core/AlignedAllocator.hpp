@@ -0,0 +1,44 @@
+﻿#pragma once
+#include "Core.hpp"
+
+#include <new>
+#include <vector>
+
+
+namespace OWC
+{
+	inline constexpr uSize CacheLineSize = 64;
+
+	// allocator that over aligns every allocation, used for buffers that are written by several threads at once
+	// so that each thread's region can start on its own cache line
+	template<typename T, uSize Alignment>
+	struct AlignedAllocator
+	{
+		static_assert(Alignment >= alignof(T), "Alignment must be at least the natural alignment of T");
+
+		using value_type = T;
+
+		template<typename U>
+		struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+		AlignedAllocator() noexcept = default;
+		template<typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+		[[nodiscard]] T* allocate(uSize count)
+		{
+			return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+		}
+
+		void deallocate(T* ptr, uSize) noexcept
+		{
+			::operator delete(ptr, std::align_val_t(Alignment));
+		}
+
+		template<typename U>
+		bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+	};
+
+	template<typename T>
+	using CacheAlignedVector = std::vector<T, AlignedAllocator<T, CacheLineSize>>;
+}
@@ -4,15 +4,36 @@
 #include "Log.hpp"
 
 #include <stb_image.h>
+#include <cstring>
 #include <memory>
 
 
 namespace OWC
 {
-	ImageLoader::ImageLoader(std::string_view path)
+	ImageLoader::ImageLoader(std::string_view path, ImagePixelFormat format)
+		: m_Format(format)
 	{
 		i32 tempWidth = 0;
 		i32 tempHeight = 0;
+
+		if (format == ImagePixelFormat::RGBA8)
+		{
+			std::unique_ptr<stbi_uc[], decltype([](stbi_uc ptr[]) { STBI_FREE(ptr); })> imageDataPtr(stbi_load(path.data(), &tempWidth, &tempHeight, nullptr, 4));
+
+			if (!imageDataPtr)
+			{
+				Log<LogLevel::Error>("Failed to load image from path: {}", path);
+				return;
+			}
+
+			m_Width = static_cast<uSize>(tempWidth);
+			m_Height = static_cast<uSize>(tempHeight);
+
+			m_ImageDataRGBA8.resize(m_Width * m_Height);
+			std::memcpy(m_ImageDataRGBA8.data(), imageDataPtr.get(), m_ImageDataRGBA8.size() * sizeof(u32));
+			return;
+		}
+
 		std::unique_ptr<f32[], decltype([](f32 ptr[]) { STBI_FREE(ptr); })> imageDataPtr(stbi_loadf(path.data(), &tempWidth, &tempHeight, nullptr, 4));
 
 		if (!imageDataPtr)
@@ -31,4 +52,9 @@ namespace OWC
 				imageDataPtr[i + 3]		// A
 			);
 	}
+
+	bool ImageLoader::IsHDR(std::string_view path)
+	{
+		return stbi_is_hdr(path.data()) != 0;
+	}
 }
\ No newline at end of file
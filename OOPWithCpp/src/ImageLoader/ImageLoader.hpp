@@ -8,6 +8,12 @@
 
 namespace OWC
 {
+	enum class ImagePixelFormat : u8
+	{
+		RGBA32F = 0,	// linear floats, 16 bytes a pixel
+		RGBA8			// the file's 8 bit values packed into a u32 with red in the low byte, 4 bytes a pixel
+	};
+
 	class ImageLoader
 	{
 	public:
@@ -16,20 +22,29 @@ namespace OWC
 		ImageLoader& operator=(const ImageLoader&) = delete;
 		ImageLoader(ImageLoader&&) = delete;
 		ImageLoader& operator=(ImageLoader&&) = delete;
-		ImageLoader(std::string_view path);
+		ImageLoader(std::string_view path, ImagePixelFormat format = ImagePixelFormat::RGBA32F);
 		virtual ~ImageLoader() = default;
 
+		// the RGBA32F data, empty when loaded as RGBA8
 		[[nodiscard]] const std::vector<Vec4>& GetImageData() const { return m_ImageData; }
+		// the RGBA8 data, empty when loaded as RGBA32F
+		[[nodiscard]] const std::vector<u32>& GetImageDataRGBA8() const { return m_ImageDataRGBA8; }
 		[[nodiscard]] const Vec4& GetPixel(uSize x, uSize y) const { return m_ImageData[y * m_Width + x]; }
 		// expects x and y to be in the range [0.0, 1.0]
 		[[nodiscard]] const Vec4& GetPixel(f32 x, f32 y) const { return m_ImageData[static_cast<uSize>(y * static_cast<f32>(m_Height)) * m_Width + static_cast<uSize>(x * static_cast<f32>(m_Width))]; }
 		[[nodiscard]] uSize GetWidth() const { return m_Width; }
 		[[nodiscard]] uSize GetHeight() const { return m_Height; }
+		[[nodiscard]] ImagePixelFormat GetPixelFormat() const { return m_Format; }
+
+		// true for files holding more than 8 bits a channel, such as .hdr
+		[[nodiscard]] static bool IsHDR(std::string_view path);
 
 	private:
 		std::vector<Vec4> m_ImageData;
+		std::vector<u32> m_ImageDataRGBA8;
 		uSize m_Width = 0;
 		uSize m_Height = 0;
+		ImagePixelFormat m_Format;
 	};
 }
  
\ No newline at end of file